@@ -0,0 +1,73 @@
+#ifndef CAFFE_BATCHER_HPP_
+#define CAFFE_BATCHER_HPP_
+
+#include <future>  // NOLINT(build/c++11)
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/blocking_queue.hpp"
+
+namespace caffe {
+
+/// @brief One input queued on a ForwardBatcher and the promise of its outputs.
+template <typename Dtype>
+struct BatchRequest {
+  vector<Dtype> input;
+  std::promise<vector<shared_ptr<Blob<Dtype> > > > outputs;
+};
+
+/**
+ * @brief Runs the single inputs submitted by many threads through a Net in
+ *        batches.
+ *
+ * A worker thread takes the first queued input, then waits for more until
+ * it holds max_batch_size of them or max_wait_us have passed. It reshapes
+ * the batch axis of the net input to that count, copies the inputs in, runs
+ * one Forward and hands every caller the slices of the output blobs for its
+ * input, each with a batch axis of 1.
+ *
+ * The net must have one input blob with the batch along axis 0, and belongs
+ * to the worker while the batcher lives. Building it with a batch of
+ * max_batch_size keeps any planned activation memory large enough for every
+ * batch. The worker runs in the Caffe::mode() the batcher was built in.
+ */
+template <typename Dtype>
+class ForwardBatcher {
+ public:
+  ForwardBatcher(const shared_ptr<Net<Dtype> >& net, int max_batch_size,
+      int max_wait_us);
+  /// @brief Runs the inputs already queued, then stops the worker.
+  ~ForwardBatcher();
+
+  /**
+   * @brief Queues a copy of input_count() values of input; the future
+   *        becomes ready once the batch holding it has run. Thread-safe.
+   */
+  std::future<vector<shared_ptr<Blob<Dtype> > > > Submit(const Dtype* input);
+
+  /// @brief The number of values of a single input.
+  inline int input_count() const { return input_count_; }
+  inline const shared_ptr<Net<Dtype> >& net() const { return net_; }
+
+ protected:
+  void Run();
+  void ForwardBatch(const vector<shared_ptr<BatchRequest<Dtype> > >& batch);
+
+  shared_ptr<Net<Dtype> > net_;
+  const int max_batch_size_;
+  const int max_wait_us_;
+  int input_count_;
+  Caffe::Brew mode_;
+  /// A null request tells the worker to stop
+  BlockingQueue<shared_ptr<BatchRequest<Dtype> > > requests_;
+  std::thread worker_;
+
+  DISABLE_COPY_AND_ASSIGN(ForwardBatcher);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_BATCHER_HPP_
@@ -24,7 +24,8 @@ template <typename Dtype>
 class Blob {
  public:
   Blob()
-       : data_(), diff_(), count_(0), capacity_(0) {}
+       : data_(), diff_(), count_(0), capacity_(0), data_offset_(0),
+         data_view_(false) {}
 
   /// @brief Deprecated; use <code>Blob(const vector<int>& shape)</code>.
   explicit Blob(const int num, const int channels, const int height,
@@ -104,13 +105,6 @@ class Blob {
     return count(start_axis, num_axes());
   }
 
-#ifdef FORWARD_LESS_MEM
-  void decrease_reference();
-  void default_reference();
-  void increase_reference();
-  void force_delete();
-#endif
-
   /**
    * @brief Returns the 'canonical' version of a (usually) user-specified axis,
    *        allowing for negative indexing (e.g., -1 for the last axis).
@@ -238,6 +232,9 @@ class Blob {
   void FromProto(const BlobProto& proto, bool reshape = true);
   void ToProto(BlobProto* proto, bool write_diff = false) const;
   void ToHalfProto(BlobProto* proto, bool write_diff = false) const;
+  /// @brief Writes the data as symmetric int8 with one scale per index
+  ///        along the first axis, see int8_quantize_weights.
+  void ToInt8Proto(BlobProto* proto) const;
 
   /// @brief Compute the sum of absolute values (L1 norm) of the data.
   Dtype asum_data() const;
@@ -271,6 +268,23 @@ class Blob {
    * shared_ptr calls its destructor when reset with the "=" operator.
    */
   void ShareDiff(const Blob& other);
+  /**
+   * @brief Make the data a view of the count() elements of Blob other's data
+   *        starting at element offset, without copying.
+   *
+   * Writes through either blob are seen by the other. The view is CPU only:
+   * gpu_data() of a view at a nonzero offset is an error. It lasts until the
+   * blob is reshaped to a different count or given data of its own, and
+   * ShareData of a view makes another view of the same elements.
+   */
+  void ShareDataView(const Blob& other, const int offset);
+  /// @brief Whether the data is the elements of other's data at offset.
+  bool IsDataViewOf(const Blob& other, const int offset) const;
+  /// @brief Copy the data of a view into storage of its own.
+  void DetachDataView();
+  inline bool data_view() const { return data_view_; }
+  /// @brief The element of data() at which the data starts.
+  inline int data_offset() const { return data_offset_; }
 
   bool ShapeEquals(const BlobProto& other);
 
@@ -281,6 +295,9 @@ class Blob {
   vector<int> shape_;
   int count_;
   int capacity_;
+  /// Where the data starts in data_, see ShareDataView
+  int data_offset_;
+  bool data_view_;
 
   DISABLE_COPY_AND_ASSIGN(Blob);
 };  // class Blob
@@ -4,6 +4,7 @@
 #ifndef CAFFE_CAFFE_HPP_
 #define CAFFE_CAFFE_HPP_
 
+#include "caffe/batcher.hpp"
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
@@ -20,6 +21,7 @@
 #endif
 #include "caffe/util/benchmark.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/thread_pool.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 
 #endif  // CAFFE_CAFFE_HPP_
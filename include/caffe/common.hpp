@@ -24,6 +24,7 @@
 #include <fstream>  // NOLINT(readability/streams)
 #include <iostream>  // NOLINT(readability/streams)
 #include <map>
+#include <mutex>
 #include <set>
 #include <sstream>
 #include <string>
@@ -146,6 +147,14 @@ class Caffe {
   // Thread local context for Caffe. Moved to common.cpp instead of
   // including boost/thread.hpp to avoid a boost/NVCC issues (#1009, #1010)
   // on OSX. Also fails on Linux with CUDA 7.0.18.
+  //
+  // Every thread gets its own instance, so the mode, the RNG, the command
+  // queue and the kernel objects are never shared between threads. The
+  // OpenCL platform, device, context and math_program are created once per
+  // process and shared by all instances, so buffers and programs built on one
+  // thread are valid on all of them. Several threads can thus run their own
+  // Nets concurrently; a Net used by another thread afterwards needs a
+  // clFinish on the queue of the thread that ran it last.
   static Caffe& Get();
 
   enum Brew { CPU, GPU };
@@ -200,7 +209,26 @@ class Caffe {
   // return the ordinal of the first available device.
   static int FindDevice(const int start_id = 0);
 
+  // Builds program from source, or from the binary cached for that source
+  // and device in opencl_cache_dir() by an earlier build.
   void build_opencl_program(std::string kernel_code, cl_program &program);
+  // Directory holding compiled program binaries for the calling thread;
+  // empty disables the cache. Defaults to the CAFFE_OPENCL_CACHE_DIR
+  // environment variable.
+  inline static const std::string& opencl_cache_dir() {
+    return Get().opencl_cache_dir_;
+  }
+  inline static void set_opencl_cache_dir(const std::string& dir) {
+    Get().opencl_cache_dir_ = dir;
+  }
+  // Returns the kernel of the given name in program, created on first use
+  // and kept until the program is released or the thread exits. Kernels
+  // hold their arguments, so each thread has its own.
+  cl_kernel get_kernel(cl_program program, const std::string& name);
+  // Releases program along with the kernels every thread created from it,
+  // so that a later program at the same address gets new kernels. No other
+  // thread may be running the program.
+  void release_program(cl_program program);
 
   // Parallel training
   inline static int solver_count() { return Get().solver_count_; }
@@ -212,7 +240,8 @@ class Caffe {
   inline static bool root_solver() { return Get().solver_rank_ == 0; }
 
 
-  // Getting platform and device information
+  // Getting platform and device information; all but the command queue
+  // are the same for every thread.
   cl_platform_id platformId = NULL;
   cl_device_id deviceID = NULL;
   cl_uint retNumDevices;
@@ -228,6 +257,12 @@ class Caffe {
   // curandGenerator_t curand_generator_;
 #endif
   shared_ptr<RNG> random_generator_;
+  std::map<std::pair<cl_program, std::string>, cl_kernel> kernels_;
+  // Guards kernels_, which release_program clears from other threads
+  std::mutex kernels_mutex_;
+  std::string opencl_cache_dir_;
+  // Device name and driver version, part of the key of cached binaries
+  std::string device_signature_;
 
   Brew mode_;
 
@@ -242,6 +277,10 @@ class Caffe {
   // The private constructor to avoid duplicate instantiation.
   Caffe();
 
+  // Helpers of build_opencl_program for the on-disk binary cache.
+  bool load_program_binary(const std::string& path, cl_program* program);
+  void save_program_binary(const std::string& path, cl_program program);
+
   DISABLE_COPY_AND_ASSIGN(Caffe);
 };
 
@@ -0,0 +1,122 @@
+#ifndef CAFFE_HOST_ALLOCATOR_HPP_
+#define CAFFE_HOST_ALLOCATOR_HPP_
+
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/// @brief Counters exposed by every HostAllocator.
+struct HostAllocatorStats {
+  /// bytes currently handed out (rounded up to the size class)
+  size_t bytes_live;
+  /// the largest bytes_live seen since construction or the last Reset
+  size_t high_water_mark;
+  /// number of slabs obtained from the system
+  size_t slab_count;
+  /// bytes obtained from the system, including slack and free chunks
+  size_t bytes_reserved;
+};
+
+/**
+ * @brief Source of the host memory behind SyncedMemory.
+ *
+ * All chunks are aligned to kAlignment bytes. CaffeMallocHost allocates from
+ * HostAllocator::Current(), which is the process wide malloc-based allocator
+ * unless a HostAllocatorScope installed another one on the calling thread
+ * (Net does so with its own SlabAllocator).
+ */
+class HostAllocator {
+ public:
+  static const size_t kAlignment = 64;
+
+  virtual ~HostAllocator() {}
+  /// @brief Allocate size bytes; *zeroed tells whether they are known to be 0.
+  virtual void* Allocate(size_t size, bool* zeroed) = 0;
+  virtual void Free(void* ptr) = 0;
+  virtual HostAllocatorStats stats() = 0;
+
+  static const shared_ptr<HostAllocator>& Default();
+  static const shared_ptr<HostAllocator>& Current();
+
+ private:
+  friend class HostAllocatorScope;
+  static void set_current(const shared_ptr<HostAllocator>& allocator);
+};
+
+/// @brief Installs an allocator as HostAllocator::Current() for its lifetime.
+class HostAllocatorScope {
+ public:
+  explicit HostAllocatorScope(const shared_ptr<HostAllocator>& allocator);
+  ~HostAllocatorScope();
+
+ private:
+  shared_ptr<HostAllocator> previous_;
+
+  DISABLE_COPY_AND_ASSIGN(HostAllocatorScope);
+};
+
+/// @brief Plain aligned malloc/free, counting live bytes.
+class MallocHostAllocator : public HostAllocator {
+ public:
+  MallocHostAllocator();
+  virtual void* Allocate(size_t size, bool* zeroed);
+  virtual void Free(void* ptr);
+  virtual HostAllocatorStats stats();
+
+ private:
+  std::mutex mutex_;
+  HostAllocatorStats stats_;
+
+  DISABLE_COPY_AND_ASSIGN(MallocHostAllocator);
+};
+
+/**
+ * @brief Carves chunks out of large slabs and recycles them through
+ *        per-size-class free lists.
+ *
+ * Sizes are rounded up to one of four classes per power of two, so a freed
+ * chunk serves any later request of the same class and the slabs do not
+ * fragment. Slabs are only returned to the system on destruction; Reset()
+ * drops the free lists and rewinds every slab in one call, once all chunks
+ * have been freed (e.g. after the Net that used the arena is gone). While
+ * any chunk is live it changes nothing and returns false.
+ */
+class SlabAllocator : public HostAllocator {
+ public:
+  explicit SlabAllocator(size_t slab_size = 4 << 20);
+  virtual ~SlabAllocator();
+  virtual void* Allocate(size_t size, bool* zeroed);
+  virtual void Free(void* ptr);
+  virtual HostAllocatorStats stats();
+  bool Reset();
+
+  /// @brief Size of the class a request of the given size is served from.
+  static size_t ClassSize(size_t size);
+
+ private:
+  struct Slab {
+    char* raw;
+    char* base;
+    size_t size;
+    size_t used;
+    // bytes below this offset have been handed out at least once
+    size_t dirty;
+  };
+
+  size_t slab_size_;
+  std::vector<Slab> slabs_;
+  std::map<size_t, std::vector<char*> > free_lists_;
+  std::mutex mutex_;
+  HostAllocatorStats stats_;
+
+  DISABLE_COPY_AND_ASSIGN(SlabAllocator);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_HOST_ALLOCATOR_HPP_
@@ -111,14 +111,6 @@ class Layer {
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) = 0;
 
-#ifdef FORWARD_LESS_MEM
-  virtual void Qiaoge_alloc(const vector<Blob<Dtype>*>& bottom,
-                                  const vector<Blob<Dtype>*>& top);
-        
-  virtual void Qiaoge_free(const vector<Blob<Dtype>*>& bottom,
-                                 const vector<Blob<Dtype>*>& top);
-#endif
-
   /**
    * @brief Given the bottom blobs, compute the top blobs and the loss.
    *
@@ -282,6 +274,64 @@ class Layer {
     param_propagate_down_[param_id] = value;
   }
 
+  /**
+   * @brief Hands the layer a scratch blob shared by every layer of the net.
+   *
+   * Called by Net before SetUp. Layers that only need a temporary buffer for
+   * the duration of a single Forward/Backward call (e.g. the im2col columns of
+   * convolution) may Reshape and use it instead of owning one; its contents
+   * are clobbered by the next layer that runs.
+   */
+  virtual void set_shared_workspace(
+      const shared_ptr<Blob<Dtype> >& workspace) {}
+
+  /**
+   * @brief Asks the layer to apply an activation layer reading its output in
+   *        place as part of its own Forward.
+   *
+   * Called by Net after SetUp. Returns true if the layer will compute
+   * activation(Forward(bottom)) from now on, in which case Net no longer runs
+   * the activation layer forward. Backward is unaffected: the activation
+   * layer still backpropagates from the (identical) in-place top.
+   */
+  virtual bool FuseActivation(const shared_ptr<Layer<Dtype> >& activation) {
+    return false;
+  }
+
+  /**
+   * @brief Returns the element of bottom[0] from which top[top_id] is a
+   *        contiguous part of it, or -1 if it is not.
+   *
+   * Called by Net after SetUp; Net may then make top[top_id] a view of
+   * bottom[0] there (see Blob::ShareDataView), which Forward_cpu has to
+   * leave as it is instead of copying.
+   */
+  virtual int TopDataViewOffset(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top, const int top_id) const {
+    return -1;
+  }
+  /// @brief As TopDataViewOffset, for bottom[bottom_id] as a part of top[0].
+  virtual int BottomDataViewOffset(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top, const int bottom_id) const {
+    return -1;
+  }
+
+  /**
+   * @brief Tells the layer its parameter blobs were overwritten.
+   *
+   * Called by Net after copying or sharing trained weights, so that layers
+   * keeping a derived form of their weights (e.g. transformed convolution
+   * filters) can rebuild it once instead of on the next Forward.
+   */
+  virtual void ParamsChanged() {}
+
+  /**
+   * @brief Sets the int8 calibration of the layer, e.g. as stored with its
+   *        trained weights; it takes effect on the next Forward.
+   */
+  void set_quantization_param(const QuantizationParameter& param) {
+    *layer_param_.mutable_quantization_param() = param;
+  }
 
  protected:
   /** The protobuf that stores the layer parameters */
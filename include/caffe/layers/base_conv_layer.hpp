@@ -8,6 +8,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/conv_tuning.hpp"
 #include "caffe/util/im2col.hpp"
 
 namespace caffe {
@@ -20,12 +21,29 @@ template <typename Dtype>
 class BaseConvolutionLayer : public Layer<Dtype> {
  public:
   explicit BaseConvolutionLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
+      : Layer<Dtype>(param), activation_(ACTIVATION_NONE),
+        activation_alpha_(0), activation_channel_shared_(false),
+        winograd_tile_(0), use_depthwise_(false),
+        col_buffer_(new Blob<Dtype>()),
+        winograd_filters_stale_(true), int8_weights_stale_(true),
+        int8_kernels_compiled_(false) {}
+  virtual ~BaseConvolutionLayer();
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
 
+  virtual void set_shared_workspace(
+      const shared_ptr<Blob<Dtype> >& workspace) {
+    col_buffer_ = workspace;
+  }
+  /// @brief Fuses a ReLU, ELU, TanH, Sigmoid or PReLU layer into the write
+  ///        of the output.
+  virtual bool FuseActivation(const shared_ptr<Layer<Dtype> >& activation);
+  /// @brief Transforms the filters again for the WINOGRAD engine and
+  ///        quantizes them again for int8 inference.
+  virtual void ParamsChanged();
+
   virtual inline int MinBottomBlobs() const { return 1; }
   virtual inline int MinTopBlobs() const { return 1; }
   virtual inline bool EqualNumBottomTopBlobs() const { return true; }
@@ -42,6 +60,8 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   void weight_cpu_gemm(const Dtype* input, const Dtype* output, Dtype*
       weights);
   void backward_cpu_bias(Dtype* bias, const Dtype* input);
+  // Applies the fused activation (if any) to the output of one image.
+  void forward_cpu_activation(Dtype* output);
 
   template<class T>
   inline void add_def(std::stringstream& ss,  // NOLINT
@@ -72,8 +92,39 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   virtual std::string generate_fw_kernels(std::string name);
   virtual std::string generate_gemm_core(bool dterm);
   virtual std::string generate_accreg_init(bool dterm, bool load);
+  // Fused activation code for the forward kernels: the extra kernel argument,
+  // the slope pointer setup, and the statement applied to "outval" (in the
+  // output row "globalRow") right before it is stored. grouped kernels count
+  // globalRow from the first output channel of "group".
+  std::string generate_activation_args();
+  std::string generate_activation_ptr(bool grouped);
+  std::string generate_activation();
+  void set_activation_kernel_arg(cl_kernel kernel, int arg_index);
+  // Whether the forward program runs the int8 kernels: with a
+  // quantization_param, for a 2-d convolution that is not depthwise.
+  inline bool use_int8_gpu() {
+    return this->layer_param_.has_quantization_param() && !use_depthwise_ &&
+        num_spatial_axes_ == 2 && !reverse_dimensions();
+  }
+  // The int8 kernels of use_int8_gpu(), for the forward program: name +
+  // "_columns" quantizes the im2col columns of the input, name multiplies
+  // them with the int8 filters, int8_outputs_per_item() output channels of
+  // a pixel per work-item.
+  std::string generate_int8_kernels(std::string name);
+  // Runs the int8 kernels if use_int8_gpu(), compiling them first if the
+  // quantization_param came after SetUp; returns whether it did.
+  bool forward_gpu_int8(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
 
-  cl_program program;
+  /// @brief Sets the tile parameters used by the generated kernels.
+  void set_tile_config(const ConvTileConfig& config);
+  /// @brief The ConvTuningDB key of this layer on the current device.
+  std::string tuning_key();
+  /// @brief Benchmarks the candidate tile configurations of this layer and
+  ///        returns the fastest one.
+  ConvTileConfig TuneTileConfig();
+
+  cl_program program = NULL;
 
 
 #ifndef CPU_ONLY
@@ -109,6 +160,9 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   Blob<int> conv_input_shape_;
   /// @brief The spatial dimensions of the col_buffer.
   vector<int> col_buffer_shape_;
+  /// @brief col_buffer_shape_ for the N-d GPU im2col, which cannot read
+  ///        the shape of a col_buffer_ shared with other layers.
+  Blob<int> col_buffer_shape_blob_;
   /// @brief The spatial dimensions of the output.
   vector<int> output_shape_;
   const vector<int>* bottom_shape_;
@@ -126,9 +180,33 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   int num_output_;
   bool bias_term_;
   bool is_1x1_;
+  /// @brief Whether the kernel is 1x1 without padding, at any stride.
+  bool is_pointwise_;
   bool force_nd_im2col_;
 
+  enum ActivationType {
+    ACTIVATION_NONE,
+    ACTIVATION_RELU,
+    ACTIVATION_ELU,
+    ACTIVATION_TANH,
+    ACTIVATION_SIGMOID,
+    ACTIVATION_PRELU
+  };
+  /// @brief The activation fused into the output, see FuseActivation.
+  ActivationType activation_;
+  /// @brief The ReLU negative slope or the ELU alpha.
+  float activation_alpha_;
+  /// @brief The PReLU slopes, shared with the PReLU layer.
+  shared_ptr<Blob<Dtype> > activation_slope_;
+  bool activation_channel_shared_;
+
+  /// @brief The output tile of the WINOGRAD engine, 2 or 4; 0 uses im2col.
+  int winograd_tile_;
+  /// @brief Whether every input channel is a group of its own, computed by
+  ///        the direct depthwise kernels instead of im2col and gemm.
+  bool use_depthwise_;
 
+  // Tile parameters of the generated kernels, see set_tile_config.
   int vwm_ = 4;
   int vwn_ = 4;
   int tsk_unroll_ = 8;
@@ -146,7 +224,11 @@ class BaseConvolutionLayer : public Layer<Dtype> {
  private:
   // wrap im2col/col2im so we don't have to remember the (long) argument lists
   inline void conv_im2col_cpu(const Dtype* data, Dtype* col_buff) {
-    if (!force_nd_im2col_ && num_spatial_axes_ == 2) {
+    if (is_pointwise_ && num_spatial_axes_ == 2) {
+      im2col_1x1_cpu(data, conv_in_channels_,
+          conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
+          stride_.cpu_data()[0], stride_.cpu_data()[1], col_buff);
+    } else if (!force_nd_im2col_ && num_spatial_axes_ == 2) {
       im2col_cpu(data, conv_in_channels_,
           conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
           kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
@@ -184,7 +266,7 @@ class BaseConvolutionLayer : public Layer<Dtype> {
           dilation_.cpu_data()[0], dilation_.cpu_data()[1], col_buff);
     } else {
       im2col_nd_gpu(data, num_spatial_axes_, num_kernels_im2col_,
-          conv_input_shape_.gpu_data(), col_buffer_.gpu_shape(),
+          conv_input_shape_.gpu_data(), col_buffer_shape_blob_.gpu_data(),
           kernel_shape_.gpu_data(), pad_.gpu_data(),
           stride_.gpu_data(), dilation_.gpu_data(), col_buff);
     }
@@ -199,23 +281,33 @@ class BaseConvolutionLayer : public Layer<Dtype> {
           dilation_.cpu_data()[0], dilation_.cpu_data()[1], data);
     } else {
       col2im_nd_gpu(col_buff, num_spatial_axes_, num_kernels_col2im_,
-          conv_input_shape_.gpu_data(), col_buffer_.gpu_shape(),
+          conv_input_shape_.gpu_data(), col_buffer_shape_blob_.gpu_data(),
           kernel_shape_.gpu_data(), pad_.gpu_data(), stride_.gpu_data(),
           dilation_.gpu_data(), data);
     }
   }
 #endif
 
+  // Computes one image with Winograd instead of im2col and gemm.
+  void forward_cpu_winograd(const Dtype* input, const Dtype* weights,
+      Dtype* output);
+  void transform_winograd_filters(const Dtype* weights);
+  // Computes one image with the direct depthwise convolution.
+  void forward_cpu_depthwise(const Dtype* input, const Dtype* weights,
+      Dtype* output);
+  // Computes one image with int8 weights and input, see int8_gemm.
+  void forward_cpu_int8(const Dtype* input, const Dtype* weights,
+      Dtype* output, bool skip_im2col);
+  // Quantizes the weights for forward_cpu_int8 and the int8 kernels.
+  void quantize_int8_weights(const Dtype* weights);
+  inline int int8_outputs_per_item() const {
+    const int outputs = num_output_ / group_;
+    return outputs % 4 == 0 ? 4 : (outputs % 2 == 0 ? 2 : 1);
+  }
+
   void Compile_OpenCL();
 
 
-#ifdef FORWARD_LESS_MEM
-  void Qiaoge_alloc(const vector<Blob<Dtype>*>& bottom,
-                      const vector<Blob<Dtype>*>& top);
-    
-  void Qiaoge_free(const vector<Blob<Dtype>*>& bottom,
-                     const vector<Blob<Dtype>*>& top);
-#endif
 
   bool inited;
 
@@ -228,8 +320,33 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   int col_offset_;
   int output_offset_;
 
-  Blob<Dtype> col_buffer_;
+  // im2col columns of one image; the net's shared workspace when run in a Net
+  shared_ptr<Blob<Dtype> > col_buffer_;
   Blob<Dtype> bias_multiplier_;
+
+  // Whether the engine is WINOGRAD and the convolution is one it handles.
+  bool use_winograd_;
+  // The filters transformed for winograd_tile_, one group after the other,
+  // and the scratch space of a group.
+  vector<float> winograd_filters_;
+  vector<float> winograd_buffer_;
+  bool winograd_filters_stale_;
+  // The scratch space of depthwise_conv_cpu.
+  vector<float> depthwise_buffer_;
+  // With a quantization_param, the weights quantized by
+  // int8_quantize_weights with their scales, and the quantized columns of
+  // a group.
+  vector<int8_t> int8_weights_;
+  vector<float> int8_weight_scales_;
+  vector<int8_t> int8_columns_;
+  bool int8_weights_stale_;
+  // The quantized weights and scales on the device, NULL until uploaded,
+  // the int8 columns of every image and group, and whether program has
+  // the int8 kernels.
+  shared_ptr<SyncedMemory> int8_weights_gpu_;
+  shared_ptr<SyncedMemory> int8_weight_scales_gpu_;
+  shared_ptr<SyncedMemory> int8_columns_gpu_;
+  bool int8_kernels_compiled_;
 };
 
 }  // namespace caffe
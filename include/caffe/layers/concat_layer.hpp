@@ -26,6 +26,10 @@ class ConcatLayer : public Layer<Dtype> {
   virtual inline const char* type() const { return "Concat"; }
   virtual inline int MinBottomBlobs() const { return 1; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
+  /// Along the outermost axis with more than one element, each bottom is
+  /// a contiguous part of the top.
+  virtual int BottomDataViewOffset(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top, const int bottom_id) const;
 
  protected:
   /**
@@ -74,6 +74,12 @@ class ConvolutionLayer : public BaseConvolutionLayer<Dtype> {
   
   virtual std::string generate_fw_defs();
   virtual std::string generate_fw_kernels(std::string name);
+  // One work-item per output pixel of depthwise_channels() channels.
+  std::string generate_depthwise_kernel(std::string name);
+  inline int depthwise_channels() const {
+    return this->num_output_ % 4 == 0 ? 4 :
+        (this->num_output_ % 2 == 0 ? 2 : 1);
+  }
 
   
   virtual inline bool reverse_dimensions() { return false; }
@@ -30,6 +30,10 @@ class CropLayer : public Layer<Dtype> {
   virtual inline const char* type() const { return "Crop"; }
   virtual inline int ExactNumBottomBlobs() const { return 2; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
+  /// The crop is contiguous when every axis before the first cropped one
+  /// has a single element and every axis after it is kept whole.
+  virtual int TopDataViewOffset(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top, const int top_id) const;
 
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
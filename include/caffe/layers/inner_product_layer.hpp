@@ -19,7 +19,8 @@ template <typename Dtype>
 class InnerProductLayer : public Layer<Dtype> {
  public:
   explicit InnerProductLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
+      : Layer<Dtype>(param), int8_weights_stale_(true) {}
+  virtual ~InnerProductLayer();
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
@@ -28,6 +29,8 @@ class InnerProductLayer : public Layer<Dtype> {
   virtual inline const char* type() const { return "InnerProduct"; }
   virtual inline int ExactNumBottomBlobs() const { return 1; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
+  /// @brief Quantizes the weights again for int8 inference.
+  virtual void ParamsChanged() { int8_weights_stale_ = true; }
 
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
@@ -41,6 +44,26 @@ class InnerProductLayer : public Layer<Dtype> {
   bool bias_term_;
   Blob<Dtype> bias_multiplier_;
   bool transpose_;  ///< if true, assume transposed weights
+
+ private:
+  // Quantizes blobs_[0] into int8_weights_ and int8_weight_scales_.
+  void quantize_int8_weights();
+  // The quantization_param path of Forward_gpu: the input quantized on
+  // the device, then int8 dot products with the quantized weights.
+  void forward_gpu_int8(const Dtype* bottom_data, Dtype* top_data);
+
+  // With a quantization_param, the weights quantized by
+  // int8_quantize_weights with their scales, and the quantized input.
+  vector<int8_t> int8_weights_;
+  vector<float> int8_weight_scales_;
+  vector<int8_t> int8_input_;
+  bool int8_weights_stale_;
+  // The OpenCL int8 path: int8_quantize_rows and int8_gemm_rows, built on
+  // first use, and the device copies of the int8 weights and input.
+  cl_program int8_program_ = NULL;
+  shared_ptr<SyncedMemory> int8_weights_gpu_;
+  shared_ptr<SyncedMemory> int8_weight_scales_gpu_;
+  shared_ptr<SyncedMemory> int8_input_gpu_;
 };
 
 }  // namespace caffe
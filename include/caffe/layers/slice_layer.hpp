@@ -28,6 +28,10 @@ class SliceLayer : public Layer<Dtype> {
   virtual inline const char* type() const { return "Slice"; }
   virtual inline int ExactNumBottomBlobs() const { return 1; }
   virtual inline int MinTopBlobs() const { return 1; }
+  /// Along the outermost axis with more than one element, each top is a
+  /// contiguous part of the bottom.
+  virtual int TopDataViewOffset(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top, const int top_id) const;
 
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
@@ -12,6 +12,12 @@ namespace caffe {
 /**
  * @brief Computes the softmax function.
  *
+ * Subtracts the max over the softmax axis before exponentiating, so large
+ * inputs do not overflow. On the CPU each block of the input is read once
+ * and stays in cache for the max, exp and normalization; on OpenCL each
+ * work item keeps a running max and sum over the axis, rescaling the sum
+ * when the max grows, then writes the normalized outputs.
+ *
  * TODO(dox): thorough documentation for Forward, Backward, and proto params.
  */
 template <typename Dtype>
@@ -35,10 +41,6 @@ class SoftmaxLayer : public Layer<Dtype> {
   int outer_num_;
   int inner_num_;
   int softmax_axis_;
-  /// sum_multiplier is used to carry out sum using BLAS
-  Blob<Dtype> sum_multiplier_;
-  /// scale is an intermediate Blob to hold temporary results.
-  Blob<Dtype> scale_;
 };
 
 }  // namespace caffe
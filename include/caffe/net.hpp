@@ -9,8 +9,10 @@
 
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
+#include "caffe/host_allocator.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/weight_file.hpp"
 
 namespace caffe {
 
@@ -26,7 +28,19 @@ class Net {
   explicit Net(const NetParameter& param);
   explicit Net(const string& param_file, Phase phase,
       const int level = 0, const vector<string>* stages = NULL);
-  virtual ~Net() {}
+  /**
+   * @brief Builds a replica of an initialized net, e.g. one per worker
+   *        thread, for inference.
+   *
+   * The replica has the layers source has now, after any folding, with
+   * private activations and workspace. Its parameter blobs share the
+   * SyncedMemory of those of source instead of allocating their own, so the
+   * weights are stored once however many replicas there are. source must
+   * outlive its replicas, must not change its weights while they run, and
+   * the replicas have to run in the Caffe::mode() they were built in.
+   */
+  explicit Net(const Net* source);
+  virtual ~Net();
 
   /// @brief Initialize a network with a NetParameter.
   void Init(const NetParameter& param);
@@ -91,16 +105,36 @@ class Net {
   /**
    * @brief For an already initialized net, copies the pre-trained layers from
    *        another Net.
+   *
+   * Returns false, leaving the parameters as they were, if the copy is
+   * refused, e.g. because it names a layer FoldBatchNorm has folded.
+   */
+  bool CopyTrainedLayersFrom(const NetParameter& param);
+  bool CopyTrainedLayersFrom(const string trained_filename);
+  bool CopyTrainedLayersFromBinaryProto(const string trained_filename);
+  bool CopyTrainedLayersFromHDF5(const string trained_filename);
+  /**
+   * @brief Points the parameters at a weight file mapped into memory,
+   *        written by ToWeightFile, rather than copying them.
+   *
+   * Parameters of the type the file holds are not copied at all and share
+   * the page cache with other processes mapping the file; the others are
+   * converted. CopyTrainedLayersFrom(string) recognizes weight files too.
+   * A file that is not a well-formed weight file, or whose blobs do not
+   * match the net, is refused before any parameter changes and false is
+   * returned.
    */
-  void CopyTrainedLayersFrom(const NetParameter& param);
-  void CopyTrainedLayersFrom(const string trained_filename);
-  void CopyTrainedLayersFromBinaryProto(const string trained_filename);
-  void CopyTrainedLayersFromHDF5(const string trained_filename);
+  bool CopyTrainedLayersFromWeightFile(const string trained_filename);
   /// @brief Writes the net to a proto.
   void ToProto(NetParameter* param, bool write_diff = false) const;
   void ToHalfProto(NetParameter* param, bool write_diff = false) const;
+  /// @brief Writes the net to a proto, with the weights of the layers
+  ///        having a quantization_param stored as int8 (see Blob).
+  void ToInt8Proto(NetParameter* param) const;
   /// @brief Writes the net to an HDF5 file.
   void ToHDF5(const string& filename, bool write_diff = false) const;
+  /// @brief Writes the parameters to a weight file, see util/weight_file.hpp.
+  void ToWeightFile(const string& filename, bool write_half = false) const;
 
   /// @brief returns the network name.
   inline const string& name() const { return name_; }
@@ -153,6 +187,10 @@ class Net {
   inline const vector<bool>& layer_need_backward() const {
     return layer_need_backward_;
   }
+  /// @brief returns whether each layer is run forward by the layer before it
+  inline const vector<bool>& layer_fused() const {
+    return layer_fused_;
+  }
   /// @brief returns the parameters
   inline const vector<shared_ptr<Blob<Dtype> > >& params() const {
     return params_;
@@ -199,6 +237,21 @@ class Net {
 
   void set_debug_info(const bool value) { debug_info_ = value; }
 
+  /**
+   * @brief returns the slab arena all host memory of this net is allocated
+   *        from while it is initialized, reshaped or run forward
+   */
+  inline const shared_ptr<SlabAllocator>& host_allocator() const {
+    return host_allocator_;
+  }
+  /// @brief returns the scratch blob shared by all layers, see
+  ///        Layer::set_shared_workspace
+  inline const shared_ptr<Blob<Dtype> >& workspace() const {
+    return workspace_;
+  }
+  /// @brief returns the bytes of the shared activation arena (0 if unplanned)
+  inline size_t activation_memory() const { return activation_memory_; }
+
   // Helpers for Init.
   /**
    * @brief Remove layers that the user specified should be excluded given the current
@@ -249,6 +302,58 @@ class Net {
   void AppendParam(const NetParameter& param, const int layer_id,
                    const int param_id);
 
+  /**
+   * @brief Assign the activation blobs offsets in one shared arena, so that
+   *        blobs which are never live at the same time reuse the same bytes.
+   *
+   * Lifetimes are computed from bottom_id_vecs_/top_id_vecs_ once, at Init.
+   * Blobs aliasing the same SyncedMemory (in-place layers, ShareData) are
+   * planned as one slot. Net inputs and blobs already written during SetUp
+   * keep their own storage.
+   */
+  void PlanActivationMemory();
+  /**
+   * @brief Make the blobs that layers report as contiguous parts of another
+   *        (Layer::TopDataViewOffset, Layer::BottomDataViewOffset) views of
+   *        it, so that Forward does not copy them. Called before
+   *        PlanActivationMemory, which then plans each view with its parent.
+   *
+   * CPU mode only. A blob is only made a view if no other blob shares its
+   * storage and it was not written during SetUp, and neither it nor the
+   * blob it is a part of is filled in by the user or a data layer. A top
+   * rewritten in place by a later layer is not made a view while another
+   * blob on the same data is still to be read.
+   */
+  void ShareDataViews();
+  /**
+   * @brief Fold BatchNorm layers using global statistics, and the Scale layer
+   *        following each of them, into the Convolution or Deconvolution they
+   *        post-process in place. Called after copying trained weights.
+   *
+   * The convolution gets a bias if it had none. Only in-place chains are
+   * folded, and only into convolutions whose weights are not shared. Later
+   * copies of trained layers that include a folded layer are rejected: the
+   * BatchNorm weights are gone, and the convolution's are already folded.
+   */
+  void FoldBatchNorm();
+  /// @brief Whether FoldBatchNorm has folded the named layer, so that its
+  ///        trained weights must no longer be copied; logs an error if so.
+  bool RejectFolded(const string& layer_name) const;
+  /// @brief Call Layer::ParamsChanged on every layer.
+  void ParamsChanged();
+  /**
+   * @brief Let layers absorb an activation layer that directly rewrites
+   *        their single top in place (see Layer::FuseActivation).
+   *
+   * Fused activations stay in the net, so Backward and ToProto are
+   * unchanged, but ForwardFromTo skips them unless the range starts after
+   * the layer they were fused into.
+   */
+  void FuseActivations();
+  /// @brief Drop the layers not marked in keep, along with their parameters.
+  void RemoveLayers(const vector<bool>& keep);
+  /// @brief Point the parameters of a replica layer at those of the source.
+  void ShareReplicaParams(const int layer_id);
   /// @brief Helper for displaying debug info in Forward.
   void ForwardDebugInfo(const int layer_id);
   /// @brief Helper for displaying debug info in Backward.
@@ -265,6 +370,10 @@ class Net {
   vector<string> layer_names_;
   map<string, int> layer_names_index_;
   vector<bool> layer_need_backward_;
+  /// Whether each layer's forward is done by the layer before it
+  vector<bool> layer_fused_;
+  /// The layer each fused activation was fused into, -1 for other layers
+  vector<int> fused_into_;
   /// @brief the blobs storing intermediate results between the layer.
   vector<shared_ptr<Blob<Dtype> > > blobs_;
   vector<string> blob_names_;
@@ -311,8 +420,33 @@ class Net {
   vector<bool> has_params_decay_;
   /// The bytes of memory used by this net
   size_t memory_used_;
+  /// The host memory arena of this net, see host_allocator()
+  shared_ptr<SlabAllocator> host_allocator_;
+  /// Scratch space lent to the layers while they run, sized to the largest
+  /// requirement among them
+  shared_ptr<Blob<Dtype> > workspace_;
+  /// The arena backing the planned activation blobs, see PlanActivationMemory
+  shared_ptr<SyncedMemory> activation_arena_;
+  size_t activation_memory_;
+#ifdef USE_OPENCL
+  /// Sub-buffers of the device arena handed out to the planned blobs
+  vector<cl_mem> activation_sub_buffers_;
+#endif
+  /// The weight files some parameters point into
+  vector<shared_ptr<MappedWeightFile> > mapped_weights_;
+  /// Whether to fold BatchNorm and Scale layers, see FoldBatchNorm
+  bool fold_batch_norm_;
+  /// The layers FoldBatchNorm folded or folded into, which later weight
+  /// copies must not touch
+  set<string> folded_layers_;
+  /// Whether the CPU layers use libm for transcendentals, see strict_math()
+  bool strict_math_;
+  /// Whether blobs were made views of others, see ShareDataViews
+  bool share_data_views_;
   /// Whether to compute and display debug info for the net.
   bool debug_info_;
+  /// The net whose parameters Init shares, set while building a replica
+  const Net* replica_source_;
   // Callbacks
   vector<Callback*> before_forward_;
   vector<Callback*> after_forward_;
@@ -3,20 +3,18 @@
  
 #include <cstdlib>
 
-#ifdef USE_MKL
-  #include "mkl.h"
-#endif
-
 #include "caffe/common.hpp"
+#include "caffe/host_allocator.hpp"
 
 namespace caffe {
 
-// If CUDA is available and in GPU mode, host memory will be allocated pinned,
-// using cudaMallocHost. It avoids dynamic pinning for transfers (DMA).
-// The improvement in performance seems negligible in the single GPU case,
-// but might be more significant for parallel training. Most importantly,
-// it improved stability for large models on many GPUs.
-inline void CaffeMallocHost(void** ptr, size_t size, bool* use_cuda, cl_mem *gpu_ptr) {
+// Host memory comes from HostAllocator::Current(): the malloc based default,
+// or the slab arena of the Net being set up or run. zeroed tells the caller
+// whether the chunk is known to be zero-filled already.
+// In GPU mode with ZERO_COPY the host pointer is a mapping of a device buffer
+// allocated with CL_MEM_ALLOC_HOST_PTR instead.
+inline void CaffeMallocHost(void** ptr, size_t size, bool* use_cuda,
+    cl_mem *gpu_ptr, HostAllocator* allocator, bool* zeroed) {
 #ifdef USE_OPENCL
 
   if (Caffe::mode() == Caffe::GPU) {
@@ -31,27 +29,19 @@ inline void CaffeMallocHost(void** ptr, size_t size, bool* use_cuda, cl_mem *gpu
     *ptr = clEnqueueMapBuffer(Caffe::Get().commandQueue, *gpu_ptr, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, size, 0, NULL, NULL, &ret);
     OPENCL_CHECK(ret);
     *use_cuda = true;
-#else
-    *ptr = malloc(size);
-    
-#endif
-
+    *zeroed = false;
     return;
+#endif
   }
 
 #endif
 
-
-#ifdef USE_MKL
-  *ptr = mkl_malloc(size ? size:1, 64);
-#else
-  *ptr = malloc(size);
-#endif
+  *ptr = allocator->Allocate(size, zeroed);
   *use_cuda = false;
   CHECK(*ptr) << "host allocation of size " << size << " failed";
 }
 
-inline void CaffeFreeHost(void* ptr, bool use_cuda) {
+inline void CaffeFreeHost(void* ptr, bool use_cuda, HostAllocator* allocator) {
 #ifdef USE_OPENCL
   if (use_cuda) {
     free(ptr);
@@ -60,11 +50,7 @@ inline void CaffeFreeHost(void* ptr, bool use_cuda) {
     return;
   }
 #endif
-#ifdef USE_MKL
-  mkl_free(ptr);
-#else
-  free(ptr);
-#endif
+  allocator->Free(ptr);
 }
 
 
@@ -89,22 +75,12 @@ class SyncedMemory {
   SyncedHead head() { return head_; }
   size_t size() { return size_; }
 
-#ifdef FORWARD_LESS_MEM
-  void default_reference();
-  void increase_reference();
-  void decrease_reference();
-  void zhihan_release();
-#endif
-
 // #ifndef CPU_ONLY
 //   void async_gpu_push(const cudaStream_t& stream);
 // #endif
 
  private:
   void check_device();
-#ifdef FORWARD_LESS_MEM
-  int refer_num;
-#endif
   void to_cpu();
   void to_gpu();
   void* cpu_ptr_;
@@ -115,6 +91,8 @@ class SyncedMemory {
   bool cpu_malloc_use_cuda_;
   bool own_gpu_data_;
   int device_;
+  // the allocator cpu_ptr_ came from, kept alive until it is freed
+  shared_ptr<HostAllocator> allocator_;
 
 #ifdef USE_OPENCL
   cl_int ret;
@@ -1,6 +1,9 @@
 #ifndef CAFFE_UTIL_BLOCKING_QUEUE_HPP_
 #define CAFFE_UTIL_BLOCKING_QUEUE_HPP_
 
+#include <chrono>  // NOLINT(build/c++11)
+#include <condition_variable>  // NOLINT(build/c++11)
+#include <mutex>  // NOLINT(build/c++11)
 #include <queue>
 #include <string>
 
@@ -19,6 +22,9 @@ class BlockingQueue {
   // useful for detecting e.g. when data feeding is too slow
   T pop(const string& log_on_wait = "");
 
+  // Waits up to timeout_us microseconds for an element
+  bool try_pop_for(T* t, int timeout_us);
+
   bool try_peek(T* t);
 
   // Return element without removing it
@@ -27,11 +33,7 @@ class BlockingQueue {
   size_t size() const;
 
  protected:
-  /**
-   Move synchronization fields out instead of including boost/thread.hpp
-   to avoid a boost/NVCC issues (#1009, #1010) on OSX. Also fails on
-   Linux CUDA 7.0.18.
-   */
+  // The mutex and condition variable guarding queue_.
   class sync;
 
   std::queue<T> queue_;
@@ -40,6 +42,99 @@ class BlockingQueue {
 DISABLE_COPY_AND_ASSIGN(BlockingQueue);
 };
 
+template<typename T>
+class BlockingQueue<T>::sync {
+ public:
+  mutable std::mutex mutex_;
+  std::condition_variable condition_;
+};
+
+template<typename T>
+BlockingQueue<T>::BlockingQueue()
+    : sync_(new sync()) {
+}
+
+template<typename T>
+void BlockingQueue<T>::push(const T& t) {
+  std::unique_lock<std::mutex> lock(sync_->mutex_);
+  queue_.push(t);
+  lock.unlock();
+  sync_->condition_.notify_one();
+}
+
+template<typename T>
+bool BlockingQueue<T>::try_pop(T* t) {
+  std::lock_guard<std::mutex> lock(sync_->mutex_);
+
+  if (queue_.empty()) {
+    return false;
+  }
+
+  *t = queue_.front();
+  queue_.pop();
+  return true;
+}
+
+template<typename T>
+T BlockingQueue<T>::pop(const string& log_on_wait) {
+  std::unique_lock<std::mutex> lock(sync_->mutex_);
+
+  while (queue_.empty()) {
+    if (!log_on_wait.empty()) {
+      LOG_EVERY_N(INFO, 1000)<< log_on_wait;
+    }
+    sync_->condition_.wait(lock);
+  }
+
+  T t = queue_.front();
+  queue_.pop();
+  return t;
+}
+
+template<typename T>
+bool BlockingQueue<T>::try_pop_for(T* t, int timeout_us) {
+  std::unique_lock<std::mutex> lock(sync_->mutex_);
+
+  if (!sync_->condition_.wait_for(lock,
+      std::chrono::microseconds(timeout_us),
+      [this] { return !queue_.empty(); })) {
+    return false;
+  }
+
+  *t = queue_.front();
+  queue_.pop();
+  return true;
+}
+
+template<typename T>
+bool BlockingQueue<T>::try_peek(T* t) {
+  std::lock_guard<std::mutex> lock(sync_->mutex_);
+
+  if (queue_.empty()) {
+    return false;
+  }
+
+  *t = queue_.front();
+  return true;
+}
+
+template<typename T>
+T BlockingQueue<T>::peek() {
+  std::unique_lock<std::mutex> lock(sync_->mutex_);
+
+  while (queue_.empty()) {
+    sync_->condition_.wait(lock);
+  }
+
+  return queue_.front();
+}
+
+template<typename T>
+size_t BlockingQueue<T>::size() const {
+  std::lock_guard<std::mutex> lock(sync_->mutex_);
+  return queue_.size();
+}
+
 }  // namespace caffe
 
 #endif
@@ -0,0 +1,91 @@
+#ifndef CAFFE_UTIL_CONV_TUNING_HPP_
+#define CAFFE_UTIL_CONV_TUNING_HPP_
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Tile parameters of the generated (libdnn style) convolution kernels.
+ *
+ * A work-group of RTSN x RTSM threads computes a TSM x TSN tile of the output
+ * (TSM = WPTM * RTSM, TSN = WPTN * RTSN), stepping through K by TSK.
+ * The default values are the ones the kernels always used before tuning.
+ */
+struct ConvTileConfig {
+  ConvTileConfig()
+    : vwm(4), vwn(4), tsk_unroll(8), wptm(4), wptn(8), rtsm(4), rtsn(16),
+      tsk(8) {}
+
+  int vwm;
+  int vwn;
+  int tsk_unroll;
+  int wptm;
+  int wptn;
+  int rtsm;
+  int rtsn;
+  int tsk;
+
+  inline int tsm() const { return wptm * rtsm; }
+  inline int tsn() const { return wptn * rtsn; }
+  /// @brief Whether the kernels can be generated with these parameters.
+  bool IsValid() const;
+  bool operator==(const ConvTileConfig& other) const;
+};
+
+/**
+ * @brief Returns the configurations worth benchmarking for an M x N x K
+ *        convolution gemm, the default one first.
+ *
+ * Configurations exceeding the work-group size or the local memory of the
+ * device are left out, and so are tiles mostly hanging over a small M or N.
+ */
+vector<ConvTileConfig> ConvTileCandidates(int M, int N, int K,
+    size_t max_work_group_size, size_t local_mem_size, size_t dtype_size);
+
+/**
+ * @brief The tuned tile configurations, kept in a text file with one
+ *        "<key> vwm vwn tsk_unroll wptm wptn rtsm rtsn tsk" line per entry.
+ *
+ * Keys are built by the layers from the device and the shape of the
+ * convolution and must not contain whitespace. The file is read on first use
+ * and rewritten as a whole, through a temporary file, by every Store().
+ */
+class ConvTuningDB {
+ public:
+  static ConvTuningDB& Get();
+
+  /// @brief The tuning file; empty disables lookups and tuning alike.
+  ///        Defaults to the CAFFE_CONV_TUNING_FILE environment variable.
+  string file();
+  void set_file(const string& file);
+  /// @brief Whether layers missing from the file benchmark the candidate
+  ///        configurations and store the fastest. Defaults to the
+  ///        CAFFE_CONV_TUNE environment variable being set to 1.
+  bool tuning();
+  void set_tuning(bool tuning);
+
+  bool Lookup(const string& key, ConvTileConfig* config);
+  void Store(const string& key, const ConvTileConfig& config);
+
+ private:
+  ConvTuningDB();
+  void Load();
+
+  std::mutex mutex_;
+  string file_;
+  bool tuning_;
+  bool loaded_;
+  std::map<string, ConvTileConfig> entries_;
+
+  DISABLE_COPY_AND_ASSIGN(ConvTuningDB);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_CONV_TUNING_HPP_
@@ -0,0 +1,38 @@
+#ifndef CAFFE_UTIL_CPU_FEATURES_HPP_
+#define CAFFE_UTIL_CPU_FEATURES_HPP_
+
+#include <string>
+
+namespace caffe {
+
+/**
+ * @brief The instruction set extensions the SIMD kernels can use, detected
+ *        once at startup: with cpuid on x86 and from the hwcaps on ARM
+ *        Linux. A feature only counts when the OS saves its registers too.
+ *
+ * The kernels for each extension are built into every binary, with target
+ * attributes where the compiler flags do not enable it, and picked at
+ * runtime, so one build runs at full speed on any CPU of its architecture.
+ */
+struct CpuFeatures {
+  // x86
+  bool sse2;
+  bool avx2;  ///< with FMA
+  bool f16c;  ///< with SSE4.1
+  bool avx512;  ///< F and VL
+  bool avx512_vnni;
+  // ARM
+  bool neon;
+  bool neon_fp16;  ///< half <-> float conversions
+  bool neon_dotprod;
+};
+
+/// @brief The features of the CPU this runs on.
+const CpuFeatures& cpu_features();
+
+/// @brief The features as a list of names, e.g. "sse2 avx2 f16c", for logs.
+std::string cpu_features_string();
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_CPU_FEATURES_HPP_
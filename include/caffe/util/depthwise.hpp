@@ -0,0 +1,31 @@
+#ifndef CAFFE_UTIL_DEPTHWISE_HPP_
+#define CAFFE_UTIL_DEPTHWISE_HPP_
+
+namespace caffe {
+
+// Direct 2D depthwise convolution: every input channel is convolved with
+// num_output / channels filters of its own, and output channel o reads
+// input channel o / (num_output / channels). It computes what im2col and
+// a gemm of K = kernel_h * kernel_w per group would, a row of the output
+// at a time, in float.
+
+/// @brief The number of floats of scratch space depthwise_conv_cpu needs.
+int depthwise_buffer_size(const int height, const int width,
+    const int output_w);
+
+/**
+ * @brief Convolves channels x height x width input with num_output x 1 x
+ *        kernel_h x kernel_w weights, writing num_output x output_h x
+ *        output_w output.
+ */
+template <typename Dtype>
+void depthwise_conv_cpu(const Dtype* input, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, const Dtype* weights,
+    const int num_output, const int output_h, const int output_w,
+    float* buffer, Dtype* output);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_DEPTHWISE_HPP_
@@ -1,17 +1,16 @@
 #ifndef CAFFE_UTIL_HALF_H_
 #define CAFFE_UTIL_HALF_H_
 
-typedef std::uint_least32_t float_b;
-typedef std::uint_least16_t half_b;
-typedef half_b half;
-
-
 #include <limits>
 #include <cstdint>
 #include <climits>
 #include <cmath>
 #include <cstring>
 
+typedef std::uint_least32_t float_b;
+typedef std::uint_least16_t half_b;
+typedef half_b half;
+
 inline half_b float2half_impl(float value)
 {
 	float_b bits;
@@ -227,16 +226,9 @@ inline float half2float_impl(half_b value)
 }
 
 
-inline void float2half(const int n, const float *in, half_b *out) {
-  for (int i = 0; i < n; ++i) {
-    out[i] = float2half_impl(in[i]);
-  }
-}
-
-inline void half2float(const int n, const half_b *in, float *out) {
-  for (int i = 0; i < n; ++i) {
-    out[i] = half2float_impl(in[i]);
-  }
-}
+// Bulk conversions, vectorized where the CPU supports it and bit identical
+// to float2half_impl and half2float_impl.
+void float2half(const int n, const float *in, half_b *out);
+void half2float(const int n, const half_b *in, float *out);
 
 #endif
\ No newline at end of file
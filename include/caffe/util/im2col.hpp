@@ -16,6 +16,13 @@ void im2col_cpu(const Dtype* data_im, const int channels,
     const int stride_w, const int dilation_h, const int dilation_w,
     Dtype* data_col);
 
+// im2col for a 1x1 kernel without padding: a strided gather of every
+// stride_h-th row and stride_w-th column of each channel.
+template <typename Dtype>
+void im2col_1x1_cpu(const Dtype* data_im, const int channels,
+    const int height, const int width, const int stride_h,
+    const int stride_w, Dtype* data_col);
+
 template <typename Dtype>
 void col2im_nd_cpu(const Dtype* data_col, const int num_spatial_axes,
     const int* im_shape, const int* col_shape,
@@ -0,0 +1,54 @@
+#ifndef CAFFE_UTIL_INT8_GEMM_HPP_
+#define CAFFE_UTIL_INT8_GEMM_HPP_
+
+#include <stdint.h>
+
+namespace caffe {
+
+// Symmetric int8 inference: a value x is stored as round(x / scale) clamped
+// to [-127, 127], with scale = range / 127. Weights get one scale per
+// output row, the input of a layer a single one from calibration (see
+// QuantizationParameter). Products are accumulated in int32 four input
+// positions at a time and scaled back to Dtype on the way out.
+
+/// @brief The int8 scale of values within [-range, range].
+inline float int8_scale(const float range) {
+  return range / 127.f;
+}
+
+/// @brief K rounded up to the four values a dot product step consumes.
+inline int int8_padded_size(const int K) {
+  return (K + 3) / 4 * 4;
+}
+
+/**
+ * @brief Quantizes M rows of K weights, stored M x K or, when transposed,
+ *        K x M, into M x int8_padded_size(K) int8 values and M scales.
+ */
+template <typename Dtype>
+void int8_quantize_weights(const int M, const int K, const Dtype* weights,
+    const bool transposed, int8_t* quantized, float* scales);
+
+/**
+ * @brief Quantizes a K x N matrix, element (k, n) at data[k * stride_k +
+ *        n * stride_n], with the given scale and packs it for int8_gemm:
+ *        int8_padded_size(K) / 4 blocks of N x 4 values.
+ */
+template <typename Dtype>
+void int8_quantize_columns(const int K, const int N, const Dtype* data,
+    const int stride_k, const int stride_n, const float scale,
+    int8_t* packed);
+
+/**
+ * @brief Multiplies the M x K weights of int8_quantize_weights with the
+ *        K x N columns of int8_quantize_columns, writing element (m, n) of
+ *        the product to output[m * stride_m + n * stride_n].
+ */
+template <typename Dtype>
+void int8_gemm(const int M, const int N, const int K, const int8_t* weights,
+    const float* weight_scales, const int8_t* packed, const float scale,
+    Dtype* output, const int stride_m, const int stride_n);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_INT8_GEMM_HPP_
@@ -122,6 +122,13 @@ void caffe_exp(const int n, const Dtype* a, Dtype* y);
 template <typename Dtype>
 void caffe_log(const int n, const Dtype* a, Dtype* y);
 
+template <typename Dtype>
+void caffe_tanh(const int n, const Dtype* a, Dtype* y);
+
+// y = 1 / (1 + exp(-a))
+template <typename Dtype>
+void caffe_sigmoid(const int n, const Dtype* a, Dtype* y);
+
 template <typename Dtype>
 void caffe_abs(const int n, const Dtype* a, Dtype* y);
 
@@ -136,6 +143,49 @@ Dtype caffe_cpu_strided_dot(const int n, const Dtype* x, const int incx,
 template <typename Dtype>
 Dtype caffe_cpu_asum(const int n, const Dtype* x);
 
+// Converts a single value to and from float. On the CPU half is a storage
+// type only, so scalar code on Dtype values goes through float.
+template <typename Dtype>
+inline float caffe_to_float(const Dtype x) { return x; }
+
+template <>
+inline float caffe_to_float<half>(const half x) { return half2float_impl(x); }
+
+template <typename Dtype>
+inline Dtype caffe_from_float(const float x) { return x; }
+
+template <>
+inline half caffe_from_float<half>(const float x) { return float2half_impl(x); }
+
+// The same for n values. caffe_float_data returns x itself when it is
+// float and otherwise converts it into buffer, for code that only reads it.
+inline void caffe_to_float(const int n, const float* x, float* y) {
+  caffe_copy(n, x, y);
+}
+
+inline void caffe_to_float(const int n, const half* x, float* y) {
+  half2float(n, x, y);
+}
+
+inline void caffe_from_float(const int n, const float* x, float* y) {
+  caffe_copy(n, x, y);
+}
+
+inline void caffe_from_float(const int n, const float* x, half* y) {
+  float2half(n, x, y);
+}
+
+inline const float* caffe_float_data(const int n, const float* x,
+    float* buffer) {
+  return x;
+}
+
+inline const float* caffe_float_data(const int n, const half* x,
+    float* buffer) {
+  half2float(n, x, buffer);
+  return buffer;
+}
+
 // the branchless, type-safe version from
 // http://stackoverflow.com/questions/1903954/is-there-a-standard-sign-function-signum-sgn-in-c-c
 template<typename Dtype>
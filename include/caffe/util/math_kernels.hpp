@@ -0,0 +1,87 @@
+#ifndef CAFFE_UTIL_MATH_KERNELS_HPP_
+#define CAFFE_UTIL_MATH_KERNELS_HPP_
+
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief The float kernels behind the elementwise and reduction routines of
+ *        math_functions.hpp, one set per instruction set (see CpuFeatures).
+ *
+ * Each has the semantics of the caffe_ routine of the same name on
+ * contiguous arrays, or the one documented below; y may alias an input.
+ *
+ * The portable and NEON sets compute exp, log, powx, tanh and sigmoid with
+ * libm. The x86 sets (SSE2, AVX2, AVX-512) share polynomial approximations
+ * with these maximum errors against the exact result, measured over all
+ * floats on x86:
+ *  - exp: 1.3 ulp; results below FLT_MIN flush to 0.
+ *  - log: 0.8 ulp.
+ *  - tanh: 1.3 ulp.
+ *  - sigmoid: 2.9 ulp.
+ *  - powx: |b| + 1 ulp for integral |b| <= 8, multiplied out, so exact for
+ *    b = 0, 1, 2; otherwise exp(b log(a)), 2 ulp per unit of 1 + |b log(a)|.
+ */
+struct MathKernels {
+  const char* name;
+  void (*set)(const int n, const float alpha, float* y);
+  void (*add_scalar)(const int n, const float alpha, float* y);
+  void (*scale)(const int n, const float alpha, const float* x, float* y);
+  void (*add)(const int n, const float* a, const float* b, float* y);
+  void (*sub)(const int n, const float* a, const float* b, float* y);
+  void (*mul)(const int n, const float* a, const float* b, float* y);
+  void (*div)(const int n, const float* a, const float* b, float* y);
+  void (*sqr)(const int n, const float* a, float* y);
+  void (*sqrt)(const int n, const float* a, float* y);
+  void (*abs)(const int n, const float* a, float* y);
+  float (*dot)(const int n, const float* x, const float* y);
+  float (*asum)(const int n, const float* x);
+  /// y = a > b ? a : b elementwise, so a NaN in a is skipped
+  void (*maximum)(const int n, const float* a, const float* b, float* y);
+  /// the sum of x
+  float (*sum)(const int n, const float* x);
+  /// the largest element of x, -FLT_MAX if none is larger; NaNs are skipped
+  float (*max)(const int n, const float* x);
+  void (*exp)(const int n, const float* a, float* y);
+  void (*log)(const int n, const float* a, float* y);
+  void (*powx)(const int n, const float* a, const float b, float* y);
+  void (*tanh)(const int n, const float* a, float* y);
+  void (*sigmoid)(const int n, const float* a, float* y);
+};
+
+/// @brief The best kernels for the CPU this runs on, picked on first use.
+const MathKernels& math_kernels();
+
+/// @brief Every kernel set this CPU can run, the portable one first; for
+///        testing them against each other.
+std::vector<const MathKernels*> supported_math_kernels();
+
+/// @brief Whether exp, log, powx, tanh and sigmoid use libm on the calling
+///        thread rather than the polynomial approximations.
+bool strict_math();
+
+/// @brief math_kernels(), or the portable kernels under strict_math().
+const MathKernels& transcendental_math_kernels();
+
+/**
+ * @brief Sets strict_math() on the calling thread for its lifetime. Net
+ *        installs one around its forward pass (NetParameter.strict_math),
+ *        and ThreadPool runs the chunks of a loop with the caller's setting.
+ */
+class StrictMathScope {
+ public:
+  explicit StrictMathScope(bool strict);
+  ~StrictMathScope();
+
+ private:
+  bool previous_;
+
+  DISABLE_COPY_AND_ASSIGN(StrictMathScope);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_MATH_KERNELS_HPP_
@@ -8,6 +8,13 @@
 namespace caffe {
   	std::string generate_opencl_defs(bool is_half);
   	std::string generate_opencl_math(bool is_half);
+  	// int8_dot4, the int32 dot product of two char4, and int8_quantize,
+  	// the symmetric int8 quantization of int8_gemm.hpp, for int8 kernels.
+  	std::string generate_opencl_int8_helpers();
+  	// int8_quantize_rows and int8_gemm_rows, the int8 inner product: rows
+  	// of K inputs quantized to rows of K4 (K padded to 4) chars, and their
+  	// dot products with rows of K4 int8 weights scaled back to Dtype.
+  	std::string generate_opencl_int8_gemm();
 }  // namespace caffe
 
 #endif   // CAFFE_UTIL_OPENCL_KERNEL_H_
@@ -0,0 +1,38 @@
+#ifndef CAFFE_UTIL_POOLING_HPP_
+#define CAFFE_UTIL_POOLING_HPP_
+
+namespace caffe {
+
+// Max and average pooling of one plane, in float, for when no argmax mask
+// is wanted. Both are separable: each row of the output first reduces the
+// kernel_h input rows under it elementwise over the whole width, then
+// pools that row horizontally, so the inner loops run over contiguous
+// rows with the SIMD math kernels. Stride 1 without padding is contiguous
+// horizontally too, and a window covering the whole plane is a single
+// reduction. Windows are clipped as in PoolingLayer; average pooling
+// divides by the window size including the padding.
+
+/// @brief The number of floats of scratch space the pooling needs.
+int pooling_buffer_size(const int height, const int width,
+    const int pooled_w);
+
+/**
+ * @brief Pools a height x width plane into pooled_h x pooled_w, taking the
+ *        max, or at least -FLT_MAX, of each window.
+ */
+template <typename Dtype>
+void max_pool_cpu(const Dtype* input, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int pooled_h,
+    const int pooled_w, float* buffer, Dtype* output);
+
+/// @brief As max_pool_cpu, taking the average of each window.
+template <typename Dtype>
+void ave_pool_cpu(const Dtype* input, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int pooled_h,
+    const int pooled_w, float* buffer, Dtype* output);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_POOLING_HPP_
@@ -0,0 +1,67 @@
+#ifndef CAFFE_UTIL_THREAD_POOL_HPP_
+#define CAFFE_UTIL_THREAD_POOL_HPP_
+
+#include <functional>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief The threads the CPU layers split their loops over, shared by the
+ *        whole process and sized independently of the BLAS threads.
+ *
+ * It starts with a single thread, so nothing runs in parallel until
+ * set_num_threads is called. Several threads may call Run at once, and a
+ * Run from inside a loop body is fine too: the caller always works on its
+ * own loop and only waits for the chunks other threads already started.
+ */
+class ThreadPool {
+ public:
+  static ThreadPool& Get();
+
+  /// @brief The number of threads a loop is split over, the caller
+  ///        included; 0 uses one per hardware thread. No loop may be
+  ///        running meanwhile.
+  void set_num_threads(int num_threads);
+  int num_threads() const { return num_threads_; }
+
+  /**
+   * @brief Calls f(begin, end) on contiguous chunks covering [0, n), of at
+   *        least grain iterations each unless n is smaller, and returns when
+   *        all of them are done. The chunks run with the caller's
+   *        strict_math().
+   */
+  void Run(const int n, const int grain,
+      const std::function<void(int, int)>& f);
+
+ private:
+  ThreadPool();
+  ~ThreadPool();
+  void Stop();
+  void Work();
+
+  class sync;
+  struct Loop;
+
+  int num_threads_;
+  vector<shared_ptr<std::thread> > threads_;
+  shared_ptr<sync> sync_;
+
+DISABLE_COPY_AND_ASSIGN(ThreadPool);
+};
+
+/// @brief The smallest elementwise chunk worth handing to another thread.
+const int kParallelGrain = 1 << 14;
+
+/// @brief ThreadPool::Get().Run, see there.
+inline void parallel_for(const int n, const int grain,
+    const std::function<void(int, int)>& f) {
+  ThreadPool::Get().Run(n, grain, f);
+}
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_THREAD_POOL_HPP_
@@ -0,0 +1,90 @@
+#ifndef CAFFE_UTIL_WEIGHT_FILE_HPP_
+#define CAFFE_UTIL_WEIGHT_FILE_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+// A flat weight file, mapped into memory instead of parsed: a header, an
+// index of the layers with the shapes and offsets of their blobs, then the
+// raw float or half values of every blob, each aligned to
+// kWeightFileAlignment bytes. Integers are in the byte order of the machine
+// that wrote the file.
+//
+//   char    magic[8]      "CAFFEWT1"
+//   uint32  dtype         0 for float, 1 for half
+//   uint32  num_layers
+//   uint64  index_size    the bytes of the index that follows
+//   for each layer:
+//     uint32  name_size, char name[name_size], uint32 num_blobs
+//     for each blob:
+//       uint32  num_axes, int32 shape[num_axes], uint64 offset
+const int kWeightFileAlignment = 64;
+
+/// @brief Whether filename starts with the magic of a weight file.
+bool IsWeightFile(const string& filename);
+
+/**
+ * @brief Writes the blobs of every named layer to a weight file, converted
+ *        to half if write_half.
+ */
+template <typename Dtype>
+void WriteWeightFile(const string& filename,
+    const vector<string>& layer_names,
+    const vector<vector<shared_ptr<Blob<Dtype> > > >& layer_blobs,
+    bool write_half);
+
+/**
+ * @brief A weight file mapped copy-on-write into memory.
+ *
+ * Blobs can point straight into the mapping: its pages come from the page
+ * cache, shared with every process that maps the same file, until a blob
+ * writes to them. Keep the MappedWeightFile alive as long as such blobs.
+ * Nothing is mapped until Open succeeds.
+ */
+class MappedWeightFile {
+ public:
+  struct BlobEntry {
+    vector<int> shape;
+    /// The values, float or half as the file says
+    void* data;
+  };
+  struct LayerEntry {
+    string name;
+    vector<BlobEntry> blobs;
+  };
+
+  MappedWeightFile();
+  ~MappedWeightFile();
+
+  /**
+   * @brief Maps filename and reads its index; returns false, logging why
+   *        and leaving nothing mapped, if the file cannot be mapped or is
+   *        not a well-formed weight file: a truncated index, a blob past
+   *        the end of the file or not aligned to its values.
+   */
+  bool Open(const string& filename);
+  /// @brief Unmaps the file, if any.
+  void Close();
+
+  inline bool is_half() const { return is_half_; }
+  inline const vector<LayerEntry>& layers() const { return layers_; }
+
+ private:
+  void* base_;
+  size_t size_;
+  bool is_half_;
+  vector<LayerEntry> layers_;
+
+  bool ReadIndex();
+
+  DISABLE_COPY_AND_ASSIGN(MappedWeightFile);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_WEIGHT_FILE_HPP_
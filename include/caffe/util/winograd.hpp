@@ -0,0 +1,42 @@
+#ifndef CAFFE_UTIL_WINOGRAD_HPP_
+#define CAFFE_UTIL_WINOGRAD_HPP_
+
+namespace caffe {
+
+// Winograd minimal filtering F(m x m, 3 x 3) for 3x3 convolutions with
+// stride and dilation 1 (Lavin and Gray, "Fast Algorithms for Convolutional
+// Neural Networks", 2015). tile is the output tile size m, 2 or 4: every
+// m x m block of the output is computed from an (m + 2) x (m + 2) block of
+// the input with (m + 2)^2 multiplies per channel pair instead of 9 m^2.
+// The transforms and products are computed in float.
+
+/**
+ * @brief Transforms num_output x channels 3x3 filters into (tile + 2)^2
+ *        matrices of num_output x channels, one per point of the transformed
+ *        tile, stored one after the other.
+ */
+void winograd_transform_filters(const int tile, const int num_output,
+    const int channels, const float* filters, float* transformed);
+
+/// @brief The number of floats of the transformed filters.
+int winograd_filters_size(const int tile, const int num_output,
+    const int channels);
+
+/// @brief The number of floats of scratch space winograd_conv_cpu needs.
+int winograd_buffer_size(const int tile, const int num_output,
+    const int channels);
+
+/**
+ * @brief Convolves channels x height x width input with the filters
+ *        transformed by winograd_transform_filters, writing num_output x
+ *        output_h x output_w output.
+ */
+template <typename Dtype>
+void winograd_conv_cpu(const Dtype* input, const int channels,
+    const int height, const int width, const int pad_h, const int pad_w,
+    const int tile, const float* transformed_filters, const int num_output,
+    const int output_h, const int output_w, float* buffer, Dtype* output);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_WINOGRAD_HPP_
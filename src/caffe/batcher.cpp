@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <chrono>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "caffe/batcher.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+ForwardBatcher<Dtype>::ForwardBatcher(const shared_ptr<Net<Dtype> >& net,
+    int max_batch_size, int max_wait_us)
+    : net_(net), max_batch_size_(max_batch_size), max_wait_us_(max_wait_us),
+      mode_(Caffe::mode()) {
+  CHECK_EQ(net_->num_inputs(), 1) << "ForwardBatcher needs a single input.";
+  CHECK_GE(net_->input_blobs()[0]->num_axes(), 1);
+  CHECK_GT(max_batch_size_, 0);
+  CHECK_GE(max_wait_us_, 0);
+  input_count_ = net_->input_blobs()[0]->count(1);
+  worker_ = std::thread(&ForwardBatcher::Run, this);
+}
+
+template <typename Dtype>
+ForwardBatcher<Dtype>::~ForwardBatcher() {
+  requests_.push(shared_ptr<BatchRequest<Dtype> >());
+  worker_.join();
+}
+
+template <typename Dtype>
+std::future<vector<shared_ptr<Blob<Dtype> > > >
+ForwardBatcher<Dtype>::Submit(const Dtype* input) {
+  shared_ptr<BatchRequest<Dtype> > request(new BatchRequest<Dtype>());
+  request->input.assign(input, input + input_count_);
+  std::future<vector<shared_ptr<Blob<Dtype> > > > outputs =
+      request->outputs.get_future();
+  requests_.push(request);
+  return outputs;
+}
+
+template <typename Dtype>
+void ForwardBatcher<Dtype>::Run() {
+  // The Caffe context is per thread.
+  Caffe::set_mode(mode_);
+  vector<shared_ptr<BatchRequest<Dtype> > > batch;
+  bool stop = false;
+  while (!stop) {
+    shared_ptr<BatchRequest<Dtype> > request = requests_.pop();
+    if (!request) {
+      break;
+    }
+    batch.clear();
+    batch.push_back(request);
+    const std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() +
+        std::chrono::microseconds(max_wait_us_);
+    while (batch.size() < max_batch_size_) {
+      const int wait_us = std::max<int64_t>(0,
+          std::chrono::duration_cast<std::chrono::microseconds>(
+          deadline - std::chrono::steady_clock::now()).count());
+      if (!requests_.try_pop_for(&request, wait_us)) {
+        break;
+      }
+      if (!request) {
+        stop = true;
+        break;
+      }
+      batch.push_back(request);
+    }
+    ForwardBatch(batch);
+  }
+}
+
+template <typename Dtype>
+void ForwardBatcher<Dtype>::ForwardBatch(
+    const vector<shared_ptr<BatchRequest<Dtype> > >& batch) {
+  Blob<Dtype>* input = net_->input_blobs()[0];
+  const int num = batch.size();
+  if (input->shape(0) != num) {
+    vector<int> shape = input->shape();
+    shape[0] = num;
+    input->Reshape(shape);
+    net_->Reshape();
+  }
+  Dtype* input_data = input->mutable_cpu_data();
+  for (int i = 0; i < num; ++i) {
+    caffe_copy(input_count_, &batch[i]->input[0],
+        input_data + i * input_count_);
+  }
+  const vector<Blob<Dtype>*>& outputs = net_->Forward();
+  vector<vector<shared_ptr<Blob<Dtype> > > > slices(num);
+  for (int j = 0; j < outputs.size(); ++j) {
+    const int count = outputs[j]->count(1);
+    vector<int> shape = outputs[j]->shape();
+    shape[0] = 1;
+    const Dtype* output_data = outputs[j]->cpu_data();
+    for (int i = 0; i < num; ++i) {
+      shared_ptr<Blob<Dtype> > slice(new Blob<Dtype>(shape));
+      caffe_copy(count, output_data + i * count, slice->mutable_cpu_data());
+      slices[i].push_back(slice);
+    }
+  }
+  for (int i = 0; i < num; ++i) {
+    batch[i]->outputs.set_value(slices[i]);
+  }
+}
+
+INSTANTIATE_CLASS(ForwardBatcher);
+
+}  // namespace caffe
@@ -1,9 +1,11 @@
+#include <algorithm>
 #include <climits>
 #include <vector>
 
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/syncedmem.hpp"
+#include "caffe/util/int8_gemm.hpp"
 #include "caffe/util/math_functions.hpp"
 
 
@@ -38,10 +40,13 @@ void Blob<Dtype>::Reshape(const vector<int>& shape) {
     shape_[i] = shape[i];
     shape_data[i] = shape[i];
   }
-  if (count_ > capacity_) {
+  // A view covers exactly its elements, any other count needs new storage.
+  if (count_ > capacity_ || (data_view_ && count_ != capacity_)) {
     capacity_ = count_;
     data_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
     diff_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+    data_offset_ = 0;
+    data_view_ = false;
   }
 }
 
@@ -64,14 +69,14 @@ template <typename Dtype>
 Blob<Dtype>::Blob(const int num, const int channels, const int height,
     const int width)
   // capacity_ must be initialized before calling Reshape
-  : capacity_(0) {
+  : capacity_(0), data_offset_(0), data_view_(false) {
   Reshape(num, channels, height, width);
 }
 
 template <typename Dtype>
 Blob<Dtype>::Blob(const vector<int>& shape)
   // capacity_ must be initialized before calling Reshape
-  : capacity_(0) {
+  : capacity_(0), data_offset_(0), data_view_(false) {
   Reshape(shape);
 }
 
@@ -84,7 +89,7 @@ const int* Blob<Dtype>::gpu_shape() const {
 template <typename Dtype>
 const Dtype* Blob<Dtype>::cpu_data() const {
   CHECK(data_);
-  return (const Dtype*)data_->cpu_data();
+  return (const Dtype*)data_->cpu_data() + data_offset_;
 }
 
 template <typename Dtype>
@@ -92,9 +97,11 @@ void Blob<Dtype>::set_cpu_data(Dtype* data) {
   CHECK(data);
   // Make sure CPU and GPU sizes remain equal
   size_t size = count_ * sizeof(Dtype);
-  if (data_->size() != size) {
+  if (data_view_ || data_->size() != size) {
     data_.reset(new SyncedMemory(size));
     diff_.reset(new SyncedMemory(size));
+    data_offset_ = 0;
+    data_view_ = false;
   }
   data_->set_cpu_data(data);
 }
@@ -102,6 +109,7 @@ void Blob<Dtype>::set_cpu_data(Dtype* data) {
 template <typename Dtype>
 const Dtype* Blob<Dtype>::gpu_data() const {
   CHECK(data_);
+  CHECK_EQ(data_offset_, 0) << "Data views are CPU only";
   return (const Dtype*)data_->gpu_data();
 }
 
@@ -110,9 +118,11 @@ void Blob<Dtype>::set_gpu_data(Dtype* data) {
   CHECK(data);
   // Make sure CPU and GPU sizes remain equal
   size_t size = count_ * sizeof(Dtype);
-  if (data_->size() != size) {
+  if (data_view_ || data_->size() != size) {
     data_.reset(new SyncedMemory(size));
     diff_.reset(new SyncedMemory(size));
+    data_offset_ = 0;
+    data_view_ = false;
   }
   data_->set_gpu_data(data);
 }
@@ -132,12 +142,13 @@ const Dtype* Blob<Dtype>::gpu_diff() const {
 template <typename Dtype>
 Dtype* Blob<Dtype>::mutable_cpu_data() {
   CHECK(data_);
-  return static_cast<Dtype*>(data_->mutable_cpu_data());
+  return static_cast<Dtype*>(data_->mutable_cpu_data()) + data_offset_;
 }
 
 template <typename Dtype>
 Dtype* Blob<Dtype>::mutable_gpu_data() {
   CHECK(data_);
+  CHECK_EQ(data_offset_, 0) << "Data views are CPU only";
   return static_cast<Dtype*>(data_->mutable_gpu_data());
 }
 
@@ -157,6 +168,11 @@ template <typename Dtype>
 void Blob<Dtype>::ShareData(const Blob& other) {
   CHECK_EQ(count_, other.count());
   data_ = other.data();
+  data_offset_ = other.data_offset_;
+  data_view_ = other.data_view_;
+  if (data_view_) {
+    capacity_ = count_;
+  }
 }
 
 template <typename Dtype>
@@ -165,6 +181,38 @@ void Blob<Dtype>::ShareDiff(const Blob& other) {
   diff_ = other.diff();
 }
 
+template <typename Dtype>
+void Blob<Dtype>::ShareDataView(const Blob& other, const int offset) {
+  CHECK_GE(offset, 0);
+  const int start = other.data_offset_ + offset;
+  CHECK_LE((start + count_) * sizeof(Dtype), other.data()->size())
+      << "View of " << count_ << " elements at " << offset
+      << " is out of range";
+  data_ = other.data();
+  data_offset_ = start;
+  data_view_ = true;
+  capacity_ = count_;
+}
+
+template <typename Dtype>
+bool Blob<Dtype>::IsDataViewOf(const Blob& other, const int offset) const {
+  return data_ && data_ == other.data_ &&
+      data_offset_ == other.data_offset_ + offset;
+}
+
+template <typename Dtype>
+void Blob<Dtype>::DetachDataView() {
+  if (!data_view_) { return; }
+  shared_ptr<SyncedMemory> data(new SyncedMemory(count_ * sizeof(Dtype)));
+  if (data_->head() != SyncedMemory::UNINITIALIZED) {
+    std::copy(cpu_data(), cpu_data() + count_,
+        static_cast<Dtype*>(data->mutable_cpu_data()));
+  }
+  data_ = data;
+  data_offset_ = 0;
+  data_view_ = false;
+}
+
 // The "update" method is used for parameter blobs in a Net, which are stored
 // as Blob<float> or Blob<double> -- hence we do not define it for
 // Blob<int> or Blob<unsigned int>.
@@ -178,16 +226,14 @@ void Blob<Dtype>::Update() {
   case SyncedMemory::HEAD_AT_CPU:
     // perform computation on CPU
     caffe_axpy<Dtype>(count_, Dtype(-1),
-        static_cast<const Dtype*>(diff_->cpu_data()),
-        static_cast<Dtype*>(data_->mutable_cpu_data()));
+        static_cast<const Dtype*>(diff_->cpu_data()), mutable_cpu_data());
     break;
   case SyncedMemory::HEAD_AT_GPU:
   case SyncedMemory::SYNCED:
 #ifndef CPU_ONLY
     // perform computation on GPU
     caffe_gpu_axpy<Dtype>(count_, Dtype(-1),
-        static_cast<const Dtype*>(diff_->gpu_data()),
-        static_cast<Dtype*>(data_->mutable_gpu_data()));
+        static_cast<const Dtype*>(diff_->gpu_data()), mutable_gpu_data());
 #else
     NO_GPU;
 #endif
@@ -232,35 +278,6 @@ Dtype Blob<Dtype>::asum_data() const {
   return 0;
 }
 
-#ifdef FORWARD_LESS_MEM
-
-template <typename Dtype>
-void Blob<Dtype>::decrease_reference() {
-    data_->decrease_reference();
-    diff_->decrease_reference();
-}
-
-template <typename Dtype>
-void Blob<Dtype>::default_reference() {
-    data_->default_reference();
-    diff_->default_reference();
-}
-
-template <typename Dtype>
-void Blob<Dtype>::increase_reference() {
-    data_->increase_reference();
-    diff_->increase_reference();
-}
-
-template <typename Dtype>
-void Blob<Dtype>::force_delete() {
-    
-    data_->zhihan_release();
-    diff_->zhihan_release();
-    
-}
-
-#endif
 
 
 template <> unsigned int Blob<unsigned int>::asum_diff() const {
@@ -476,8 +493,7 @@ void Blob<Dtype>::CopyFrom(const Blob& source, bool copy_diff, bool reshape) {
       caffe_cl_copy(count_, source.gpu_diff(),
           static_cast<Dtype*>(diff_->mutable_gpu_data()));
     } else {
-      caffe_cl_copy(count_, source.gpu_data(),
-          static_cast<Dtype*>(data_->mutable_gpu_data()));
+      caffe_cl_copy(count_, source.gpu_data(), mutable_gpu_data());
     }
     break;
   case Caffe::CPU:
@@ -485,8 +501,7 @@ void Blob<Dtype>::CopyFrom(const Blob& source, bool copy_diff, bool reshape) {
       caffe_copy(count_, source.cpu_diff(),
           static_cast<Dtype*>(diff_->mutable_cpu_data()));
     } else {
-      caffe_copy(count_, source.cpu_data(),
-          static_cast<Dtype*>(data_->mutable_cpu_data()));
+      caffe_copy(count_, source.cpu_data(), mutable_cpu_data());
     }
     break;
   default:
@@ -494,6 +509,33 @@ void Blob<Dtype>::CopyFrom(const Blob& source, bool copy_diff, bool reshape) {
   }
 }
 
+namespace {
+
+// Raw half bytes of a proto, converted to the type of the blob.
+template <typename Dtype>
+void copy_half_bytes(const int count, const string& bytes, Dtype* data) {
+  CHECK_EQ(count * sizeof(half), bytes.size());
+  const half* values = reinterpret_cast<const half*>(bytes.data());
+  for (int i = 0; i < count; ++i) {
+    data[i] = half2float_impl(values[i]);
+  }
+}
+
+template <>
+void copy_half_bytes<half>(const int count, const string& bytes, half* data) {
+  CHECK_EQ(count * sizeof(half), bytes.size());
+  memcpy(data, bytes.data(), count * sizeof(half));
+}
+
+template <>
+void copy_half_bytes<float>(const int count, const string& bytes,
+    float* data) {
+  CHECK_EQ(count * sizeof(half), bytes.size());
+  half2float(count, reinterpret_cast<const half*>(bytes.data()), data);
+}
+
+}  // namespace
+
 template <typename Dtype>
 void Blob<Dtype>::FromProto(const BlobProto& proto, bool reshape) {
   if (reshape) {
@@ -520,34 +562,44 @@ void Blob<Dtype>::FromProto(const BlobProto& proto, bool reshape) {
 
   Dtype* data_vec = mutable_cpu_data();
 
-  if (proto.has_half_data()) {
-    memcpy(data_vec, proto.half_data().c_str(), count_ * sizeof(half));
+  if (proto.has_int8_data()) {
+    CHECK_EQ(count_, proto.int8_data().size());
+    CHECK_EQ(shape(0), proto.int8_scale_size());
+    const int8_t* values =
+        reinterpret_cast<const int8_t*>(proto.int8_data().data());
+    const int inner = count(1);
+    for (int i = 0; i < count_; ++i) {
+      data_vec[i] = caffe_from_float<Dtype>(
+          values[i] * proto.int8_scale(i / inner));
+    }
+  } else if (proto.has_half_data()) {
+    copy_half_bytes(count_, proto.half_data(), data_vec);
   } else if (proto.double_data_size() > 0) {
     CHECK_EQ(count_, proto.double_data_size());
     for (int i = 0; i < count_; ++i) {
-      data_vec[i] = proto.double_data(i);
+      data_vec[i] = caffe_from_float<Dtype>(proto.double_data(i));
     }
   } else {
     CHECK_EQ(count_, proto.data_size());
     for (int i = 0; i < count_; ++i) {
-      data_vec[i] = proto.data(i);
+      data_vec[i] = caffe_from_float<Dtype>(proto.data(i));
     }
   }
   
   if (proto.has_half_diff()) {
     Dtype* diff_vec = mutable_cpu_diff();
-    memcpy(diff_vec, proto.half_diff().c_str(), count_ * sizeof(half));    
+    copy_half_bytes(count_, proto.half_diff(), diff_vec);
   } else if (proto.double_diff_size() > 0) {
     CHECK_EQ(count_, proto.double_diff_size());
     Dtype* diff_vec = mutable_cpu_diff();
     for (int i = 0; i < count_; ++i) {
-      diff_vec[i] = proto.double_diff(i);
+      diff_vec[i] = caffe_from_float<Dtype>(proto.double_diff(i));
     }
   } else if (proto.diff_size() > 0) {
     CHECK_EQ(count_, proto.diff_size());
     Dtype* diff_vec = mutable_cpu_diff();
     for (int i = 0; i < count_; ++i) {
-      diff_vec[i] = proto.diff(i);
+      diff_vec[i] = caffe_from_float<Dtype>(proto.diff(i));
     }
   }
 // #endif
@@ -620,6 +672,41 @@ void Blob<half>::ToHalfProto(BlobProto* proto, bool write_diff) const {
 }
 
 
+namespace {
+
+template <typename Dtype>
+void to_int8_proto(const Blob<Dtype>& blob, BlobProto* proto) {
+  CHECK_GE(blob.num_axes(), 1) << "int8 data needs a first axis";
+  proto->Clear();
+  for (int i = 0; i < blob.num_axes(); ++i) {
+    proto->mutable_shape()->add_dim(blob.shape(i));
+  }
+  const int rows = blob.shape(0);
+  const int cols = blob.count(1);
+  const int padded_cols = int8_padded_size(cols);
+  vector<int8_t> quantized(rows * padded_cols);
+  vector<float> scales(rows);
+  int8_quantize_weights(rows, cols, blob.cpu_data(), false, &quantized[0],
+      &scales[0]);
+  string* bytes = proto->mutable_int8_data();
+  bytes->resize(blob.count());
+  for (int r = 0; r < rows; ++r) {
+    memcpy(&(*bytes)[r * cols], &quantized[r * padded_cols], cols);
+    proto->add_int8_scale(scales[r]);
+  }
+}
+
+}  // namespace
+
+template <>
+void Blob<float>::ToInt8Proto(BlobProto* proto) const {
+  to_int8_proto(*this, proto);
+}
+
+template <>
+void Blob<half>::ToInt8Proto(BlobProto* proto) const {
+  to_int8_proto(*this, proto);
+}
 
 INSTANTIATE_CLASS(Blob);
 template class Blob<int>;
@@ -6,7 +6,12 @@
 #endif
 #include <cmath>
 #include <cstdio>
+#include <cstdlib>
 #include <ctime>
+#include <fstream>  // NOLINT(readability/streams)
+#include <iomanip>
+#include <iterator>
+#include <mutex>
 
 #include "caffe/common.hpp"
 #include "caffe/util/rng.hpp"
@@ -29,7 +34,8 @@ namespace caffe {
 // Make sure each thread can have different values.
 static boost::thread_specific_ptr<Caffe> thread_instance_;
 #else
-static Caffe *thread_instance_ = NULL;
+// Make sure each thread can have different values.
+static thread_local shared_ptr<Caffe> thread_instance_;
 #endif
 
 Caffe& Caffe::Get() {
@@ -39,8 +45,8 @@ Caffe& Caffe::Get() {
   }
   return *(thread_instance_.get());
 #else
-  if (thread_instance_ == NULL) {
-      thread_instance_ = new Caffe();
+  if (!thread_instance_) {
+    thread_instance_.reset(new Caffe());
   }
   return *thread_instance_;
 #endif
@@ -137,47 +143,223 @@ void* Caffe::RNG::generator() {
 
 #elif USE_OPENCL  // Normal GPU + CPU Caffe.
 
-Caffe::Caffe()
-    : random_generator_(),
-    mode_(Caffe::CPU),
-    solver_count_(1), solver_rank_(0), multiprocess_(false) {
-  // Try to create a cublas handler, and report an error if failed (but we will
-  // keep the program running as one might just want to run CPU code).
-  
-  OPENCL_CHECK(clGetPlatformIDs(1, &platformId, &retNumPlatforms));
-  OPENCL_CHECK(clGetDeviceIDs(platformId, CL_DEVICE_TYPE_DEFAULT, 1, &deviceID, &retNumDevices));
+namespace {
+
+// The OpenCL objects shared by the Caffe instances of all threads, created
+// by the first one. Never released: other threads may still use them while
+// static objects are destroyed.
+struct SharedOpenCL {
+  cl_platform_id platform_id;
+  cl_device_id device_id;
+  cl_uint num_platforms;
+  cl_uint num_devices;
+  cl_context context;
+  cl_program math_program;
+};
 
+SharedOpenCL shared_opencl;
+std::once_flag shared_context_once;
+std::once_flag shared_math_program_once;
 
-  cl_int ret;
+// The Caffe of every thread, whose kernels release_program drops.
+std::mutex instances_mutex;
+std::set<Caffe*> instances;
 
-  context = clCreateContext(NULL, 1, &deviceID, NULL, NULL,  &ret);
+void create_shared_context() {
+  OPENCL_CHECK(clGetPlatformIDs(1, &shared_opencl.platform_id,
+      &shared_opencl.num_platforms));
+  OPENCL_CHECK(clGetDeviceIDs(shared_opencl.platform_id,
+      CL_DEVICE_TYPE_DEFAULT, 1, &shared_opencl.device_id,
+      &shared_opencl.num_devices));
+  cl_int ret;
+  shared_opencl.context = clCreateContext(NULL, 1, &shared_opencl.device_id,
+      NULL, NULL, &ret);
   OPENCL_CHECK(ret);
+}
 
+}  // namespace
+
+Caffe::Caffe()
+    : random_generator_(),
+    mode_(Caffe::CPU),
+    solver_count_(1), solver_rank_(0), multiprocess_(false) {
+  std::call_once(shared_context_once, create_shared_context);
+  platformId = shared_opencl.platform_id;
+  deviceID = shared_opencl.device_id;
+  retNumPlatforms = shared_opencl.num_platforms;
+  retNumDevices = shared_opencl.num_devices;
+  context = shared_opencl.context;
+
+  // An in-order queue per thread, so that threads do not wait on each other.
+  cl_int ret;
   commandQueue = clCreateCommandQueue(context, deviceID, CL_QUEUE_PROFILING_ENABLE, &ret);
   OPENCL_CHECK(ret);
 
+  const char* cache_dir = getenv("CAFFE_OPENCL_CACHE_DIR");
+  if (cache_dir) {
+    opencl_cache_dir_ = cache_dir;
+  }
+  const cl_device_info signature_info[] = {
+    CL_DEVICE_NAME, CL_DEVICE_VERSION, CL_DRIVER_VERSION
+  };
+  for (int i = 0; i < 3; ++i) {
+    size_t size = 0;
+    OPENCL_CHECK(clGetDeviceInfo(deviceID, signature_info[i], 0, NULL, &size));
+    std::vector<char> value(size + 1, 0);
+    OPENCL_CHECK(clGetDeviceInfo(deviceID, signature_info[i], size,
+        value.data(), NULL));
+    device_signature_ += value.data();
+    device_signature_ += '\n';
+  }
   
 
-  std::stringstream ss;
-
-  ss << generate_opencl_defs(false);
-  ss << generate_opencl_math(false);
-
-  build_opencl_program(ss.str(), math_program);
-
+  std::call_once(shared_math_program_once, [this]() {
+    std::stringstream ss;
+    ss << generate_opencl_defs(false);
+    ss << generate_opencl_math(false);
+    build_opencl_program(ss.str(), shared_opencl.math_program);
+  });
+  math_program = shared_opencl.math_program;
 
+  std::lock_guard<std::mutex> lock(instances_mutex);
+  instances.insert(this);
 }
 
 Caffe::~Caffe() {
+  {
+    std::lock_guard<std::mutex> lock(instances_mutex);
+    instances.erase(this);
+  }
   // if (cublas_handle_) CUBLAS_CHECK(cublasDestroy(cublas_handle_));
   // if (curand_generator_) {
   //   CURAND_CHECK(curandDestroyGenerator(curand_generator_));
   // }
+  for (std::map<std::pair<cl_program, std::string>, cl_kernel>::iterator it =
+       kernels_.begin(); it != kernels_.end(); ++it) {
+    clReleaseKernel(it->second);
+  }
+  clReleaseCommandQueue(commandQueue);
+}
+
+cl_kernel Caffe::get_kernel(cl_program program, const std::string& name) {
+  std::lock_guard<std::mutex> lock(kernels_mutex_);
+  const std::pair<cl_program, std::string> key(program, name);
+  std::map<std::pair<cl_program, std::string>, cl_kernel>::iterator it =
+      kernels_.find(key);
+  if (it != kernels_.end()) {
+    return it->second;
+  }
+  cl_int ret;
+  cl_kernel kernel = clCreateKernel(program, name.c_str(), &ret);
+  OPENCL_CHECK(ret);
+  kernels_[key] = kernel;
+  return kernel;
+}
+
+void Caffe::release_program(cl_program program) {
+  std::lock_guard<std::mutex> instances_lock(instances_mutex);
+  for (std::set<Caffe*>::iterator instance = instances.begin();
+       instance != instances.end(); ++instance) {
+    std::map<std::pair<cl_program, std::string>, cl_kernel>& kernels =
+        (*instance)->kernels_;
+    std::lock_guard<std::mutex> lock((*instance)->kernels_mutex_);
+    std::map<std::pair<cl_program, std::string>, cl_kernel>::iterator it =
+        kernels.lower_bound(std::make_pair(program, std::string()));
+    while (it != kernels.end() && it->first.first == program) {
+      OPENCL_CHECK(clReleaseKernel(it->second));
+      kernels.erase(it++);
+    }
+  }
+  OPENCL_CHECK(clReleaseProgram(program));
+}
+
+
+namespace {
+
+// 64 bit FNV-1a, stable across runs and platforms unlike std::hash.
+uint64_t fnv1a_hash(const std::string& data, uint64_t hash) {
+  for (size_t i = 0; i < data.size(); ++i) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
 }
 
+}  // namespace
+
+bool Caffe::load_program_binary(const std::string& path,
+    cl_program* program) {
+  std::ifstream file(path.c_str(), std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  std::vector<unsigned char> binary((std::istreambuf_iterator<char>(file)),
+      std::istreambuf_iterator<char>());
+  if (binary.empty()) {
+    return false;
+  }
+  const unsigned char* data = binary.data();
+  const size_t size = binary.size();
+  cl_int status = CL_SUCCESS;
+  cl_int ret = CL_SUCCESS;
+  *program = clCreateProgramWithBinary(context, 1, &deviceID, &size, &data,
+      &status, &ret);
+  if (ret != CL_SUCCESS || status != CL_SUCCESS) {
+    if (*program) {
+      clReleaseProgram(*program);
+    }
+    return false;
+  }
+  if (clBuildProgram(*program, 1, &deviceID, NULL, NULL, NULL)
+      != CL_SUCCESS) {
+    clReleaseProgram(*program);
+    return false;
+  }
+  return true;
+}
+
+void Caffe::save_program_binary(const std::string& path,
+    cl_program program) {
+  size_t size = 0;
+  OPENCL_CHECK(clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES,
+      sizeof(size), &size, NULL));
+  if (size == 0) {
+    return;
+  }
+  std::vector<unsigned char> binary(size);
+  unsigned char* data = binary.data();
+  OPENCL_CHECK(clGetProgramInfo(program, CL_PROGRAM_BINARIES,
+      sizeof(data), &data, NULL));
+  // Write to a private name first, so that a concurrent reader never sees
+  // a partial binary.
+  std::stringstream tmp_path;
+  tmp_path << path << "." << getpid() << ".tmp";
+  std::ofstream file(tmp_path.str().c_str(), std::ios::binary);
+  file.write(reinterpret_cast<const char*>(data), size);
+  file.close();
+  if (!file || rename(tmp_path.str().c_str(), path.c_str()) != 0) {
+    LOG(WARNING) << "Cannot write OpenCL program cache " << path;
+    remove(tmp_path.str().c_str());
+  }
+}
 
 void Caffe::build_opencl_program(std::string kernel_code, cl_program &program) {
 
+  // Programs are keyed by their source and build options (none for now)
+  // together with the device and driver that compiled them.
+  std::string cache_path;
+  if (!opencl_cache_dir_.empty()) {
+    const uint64_t hash = fnv1a_hash(kernel_code,
+        fnv1a_hash(device_signature_, 14695981039346656037ULL));
+    std::stringstream ss;
+    ss << opencl_cache_dir_ << "/" << std::hex << std::setw(16)
+       << std::setfill('0') << hash << ".clbin";
+    cache_path = ss.str();
+    if (load_program_binary(cache_path, &program)) {
+      return;
+    }
+  }
+
   cl_int ret = -1;
 
   size_t kernel_size = kernel_code.size() + 1;
@@ -220,6 +402,10 @@ void Caffe::build_opencl_program(std::string kernel_code, cl_program &program) {
 
     exit(EXIT_FAILURE);
   }
+
+  if (!cache_path.empty()) {
+    save_program_binary(cache_path, program);
+  }
 }
 
 /*
@@ -2,6 +2,7 @@
 #include <opencv2/core/core.hpp>
 #endif  // USE_OPENCV
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -9,6 +10,7 @@
 #include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -93,17 +95,22 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
     }
   }
 
-  Dtype datum_element;
-  int top_index, data_index;
-  for (int c = 0; c < datum_channels; ++c) {
-    for (int h = 0; h < height; ++h) {
+  // The rows are independent and transformed in parallel.
+  parallel_for(datum_channels * height, std::max(1, kParallelGrain / width),
+      [&](int begin, int end) {
+    for (int row = begin; row < end; ++row) {
+      const int c = row / height;
+      const int h = row % height;
       for (int w = 0; w < width; ++w) {
-        data_index = (c * datum_height + h_off + h) * datum_width + w_off + w;
+        const int data_index =
+            (c * datum_height + h_off + h) * datum_width + w_off + w;
+        int top_index;
         if (do_mirror) {
           top_index = (c * height + h) * width + (width - 1 - w);
         } else {
           top_index = (c * height + h) * width + w;
         }
+        Dtype datum_element;
         if (has_uint8) {
           datum_element =
             static_cast<Dtype>(static_cast<uint8_t>(data[data_index]));
@@ -123,7 +130,7 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
         }
       }
     }
-  }
+  });
 }
 
 
@@ -294,34 +301,38 @@ void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
   CHECK(cv_cropped_img.data);
 
   Dtype* transformed_data = transformed_blob->mutable_cpu_data();
-  int top_index;
-  for (int h = 0; h < height; ++h) {
-    const uchar* ptr = cv_cropped_img.ptr<uchar>(h);
-    int img_index = 0;
-    for (int w = 0; w < width; ++w) {
-      for (int c = 0; c < img_channels; ++c) {
-        if (do_mirror) {
-          top_index = (c * height + h) * width + (width - 1 - w);
-        } else {
-          top_index = (c * height + h) * width + w;
-        }
-        // int top_index = (c * height + h) * width + w;
-        Dtype pixel = static_cast<Dtype>(ptr[img_index++]);
-        if (has_mean_file) {
-          int mean_index = (c * img_height + h_off + h) * img_width + w_off + w;
-          transformed_data[top_index] =
-            (pixel - mean[mean_index]) * scale;
-        } else {
-          if (has_mean_values) {
+  parallel_for(height, std::max(1, kParallelGrain / (width * img_channels)),
+      [&](int begin, int end) {
+    for (int h = begin; h < end; ++h) {
+      const uchar* ptr = cv_cropped_img.ptr<uchar>(h);
+      int img_index = 0;
+      for (int w = 0; w < width; ++w) {
+        for (int c = 0; c < img_channels; ++c) {
+          int top_index;
+          if (do_mirror) {
+            top_index = (c * height + h) * width + (width - 1 - w);
+          } else {
+            top_index = (c * height + h) * width + w;
+          }
+          // int top_index = (c * height + h) * width + w;
+          Dtype pixel = static_cast<Dtype>(ptr[img_index++]);
+          if (has_mean_file) {
+            int mean_index =
+                (c * img_height + h_off + h) * img_width + w_off + w;
             transformed_data[top_index] =
-              (pixel - mean_values_[c]) * scale;
+              (pixel - mean[mean_index]) * scale;
           } else {
-            transformed_data[top_index] = pixel * scale;
+            if (has_mean_values) {
+              transformed_data[top_index] =
+                (pixel - mean_values_[c]) * scale;
+            } else {
+              transformed_data[top_index] = pixel * scale;
+            }
           }
         }
       }
     }
-  }
+  });
 }
 #endif  // USE_OPENCV
 
@@ -410,28 +421,26 @@ void DataTransformer<Dtype>::Transform(Blob<Dtype>* input_blob,
 
   Dtype* transformed_data = transformed_blob->mutable_cpu_data();
 
-  for (int n = 0; n < input_num; ++n) {
-    int top_index_n = n * channels;
-    int data_index_n = n * channels;
-    for (int c = 0; c < channels; ++c) {
-      int top_index_c = (top_index_n + c) * height;
-      int data_index_c = (data_index_n + c) * input_height + h_off;
-      for (int h = 0; h < height; ++h) {
-        int top_index_h = (top_index_c + h) * width;
-        int data_index_h = (data_index_c + h) * input_width + w_off;
-        if (do_mirror) {
-          int top_index_w = top_index_h + width - 1;
-          for (int w = 0; w < width; ++w) {
-            transformed_data[top_index_w-w] = input_data[data_index_h + w];
-          }
-        } else {
-          for (int w = 0; w < width; ++w) {
-            transformed_data[top_index_h + w] = input_data[data_index_h + w];
-          }
+  // Every row of every channel is cropped and mirrored in parallel.
+  parallel_for(input_num * channels * height,
+      std::max(1, kParallelGrain / width), [&](int begin, int end) {
+    for (int row = begin; row < end; ++row) {
+      const int h = row % height;
+      const int nc = row / height;
+      int top_index_h = row * width;
+      int data_index_h = (nc * input_height + h_off + h) * input_width + w_off;
+      if (do_mirror) {
+        int top_index_w = top_index_h + width - 1;
+        for (int w = 0; w < width; ++w) {
+          transformed_data[top_index_w-w] = input_data[data_index_h + w];
+        }
+      } else {
+        for (int w = 0; w < width; ++w) {
+          transformed_data[top_index_h + w] = input_data[data_index_h + w];
         }
       }
     }
-  }
+  });
   if (scale != Dtype(1)) {
     DLOG(INFO) << "Scale: " << scale;
     caffe_scal(size, scale, transformed_data);
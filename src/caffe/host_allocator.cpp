@@ -0,0 +1,218 @@
+#include <stdint.h>
+
+#include <algorithm>
+
+#ifdef USE_MKL
+  #include "mkl.h"
+#endif
+
+#include "caffe/host_allocator.hpp"
+
+namespace caffe {
+
+namespace {
+
+const unsigned int kChunkMagic = 0xCAFFE64u;
+
+// Every chunk is preceded by one alignment unit holding its header, so the
+// user pointer keeps the alignment of the chunk itself.
+struct ChunkHeader {
+  size_t size;
+  unsigned int magic;
+};
+
+inline ChunkHeader* header_of(void* ptr) {
+  return reinterpret_cast<ChunkHeader*>(
+      static_cast<char*>(ptr) - HostAllocator::kAlignment);
+}
+
+inline void* payload_of(char* chunk, size_t size) {
+  ChunkHeader* header = reinterpret_cast<ChunkHeader*>(chunk);
+  header->size = size;
+  header->magic = kChunkMagic;
+  return chunk + HostAllocator::kAlignment;
+}
+
+inline void count_alloc(HostAllocatorStats* stats, size_t size) {
+  stats->bytes_live += size;
+  stats->high_water_mark = std::max(stats->high_water_mark, stats->bytes_live);
+}
+
+thread_local shared_ptr<HostAllocator> current_allocator;
+
+}  // namespace
+
+const size_t HostAllocator::kAlignment;
+
+const shared_ptr<HostAllocator>& HostAllocator::Default() {
+  // Never destroyed: SyncedMemory in static objects may outlive main().
+  static shared_ptr<HostAllocator>* allocator =
+      new shared_ptr<HostAllocator>(new MallocHostAllocator());
+  return *allocator;
+}
+
+const shared_ptr<HostAllocator>& HostAllocator::Current() {
+  return current_allocator ? current_allocator : Default();
+}
+
+void HostAllocator::set_current(const shared_ptr<HostAllocator>& allocator) {
+  current_allocator = allocator;
+}
+
+HostAllocatorScope::HostAllocatorScope(
+    const shared_ptr<HostAllocator>& allocator)
+  : previous_(current_allocator) {
+  HostAllocator::set_current(allocator);
+}
+
+HostAllocatorScope::~HostAllocatorScope() {
+  HostAllocator::set_current(previous_);
+}
+
+MallocHostAllocator::MallocHostAllocator() {
+  stats_.bytes_live = 0;
+  stats_.high_water_mark = 0;
+  stats_.slab_count = 0;
+  stats_.bytes_reserved = 0;
+}
+
+void* MallocHostAllocator::Allocate(size_t size, bool* zeroed) {
+  const size_t total = size + kAlignment;
+#ifdef USE_MKL
+  void* chunk = mkl_malloc(total, kAlignment);
+#else
+  void* chunk = NULL;
+  if (posix_memalign(&chunk, kAlignment, total) != 0) {
+    chunk = NULL;
+  }
+#endif
+  CHECK(chunk) << "host allocation of size " << size << " failed";
+  *zeroed = false;
+  std::lock_guard<std::mutex> lock(mutex_);
+  count_alloc(&stats_, size);
+  stats_.bytes_reserved += total;
+  return payload_of(static_cast<char*>(chunk), size);
+}
+
+void MallocHostAllocator::Free(void* ptr) {
+  ChunkHeader* header = header_of(ptr);
+  CHECK_EQ(header->magic, kChunkMagic) << "freeing a foreign host pointer";
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.bytes_live -= header->size;
+    stats_.bytes_reserved -= header->size + kAlignment;
+  }
+  header->magic = 0;
+#ifdef USE_MKL
+  mkl_free(header);
+#else
+  free(header);
+#endif
+}
+
+HostAllocatorStats MallocHostAllocator::stats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+SlabAllocator::SlabAllocator(size_t slab_size)
+  : slab_size_(slab_size) {
+  stats_.bytes_live = 0;
+  stats_.high_water_mark = 0;
+  stats_.slab_count = 0;
+  stats_.bytes_reserved = 0;
+}
+
+SlabAllocator::~SlabAllocator() {
+  for (int i = 0; i < slabs_.size(); ++i) {
+    free(slabs_[i].raw);
+  }
+}
+
+size_t SlabAllocator::ClassSize(size_t size) {
+  if (size <= kAlignment) {
+    return kAlignment;
+  }
+  // Four classes between consecutive powers of two: waste stays below 25%.
+  size_t pow2 = kAlignment;
+  while (pow2 < size) {
+    pow2 <<= 1;
+  }
+  const size_t step = std::max(pow2 / 8, kAlignment);
+  return (size + step - 1) / step * step;
+}
+
+void* SlabAllocator::Allocate(size_t size, bool* zeroed) {
+  const size_t class_size = ClassSize(size);
+  const size_t total = class_size + kAlignment;
+  std::lock_guard<std::mutex> lock(mutex_);
+  count_alloc(&stats_, class_size);
+  std::vector<char*>& free_list = free_lists_[class_size];
+  if (!free_list.empty()) {
+    char* chunk = free_list.back();
+    free_list.pop_back();
+    *zeroed = false;
+    return payload_of(chunk, class_size);
+  }
+  Slab* slab = NULL;
+  for (int i = 0; i < slabs_.size(); ++i) {
+    if (slabs_[i].size - slabs_[i].used >= total) {
+      slab = &slabs_[i];
+      break;
+    }
+  }
+  if (slab == NULL) {
+    Slab fresh;
+    fresh.size = std::max(slab_size_, total);
+    // calloc hands out lazily zeroed pages for large sizes, which lets the
+    // first use of every byte skip the memset in SyncedMemory::to_cpu.
+    fresh.raw = static_cast<char*>(calloc(1, fresh.size + kAlignment));
+    CHECK(fresh.raw) << "host slab allocation of size " << fresh.size
+        << " failed";
+    fresh.base = reinterpret_cast<char*>(
+        (reinterpret_cast<uintptr_t>(fresh.raw) + kAlignment - 1) /
+        kAlignment * kAlignment);
+    fresh.used = 0;
+    fresh.dirty = 0;
+    slabs_.push_back(fresh);
+    slab = &slabs_.back();
+    stats_.slab_count += 1;
+    stats_.bytes_reserved += fresh.size;
+  }
+  char* chunk = slab->base + slab->used;
+  *zeroed = slab->used >= slab->dirty;
+  slab->used += total;
+  slab->dirty = std::max(slab->dirty, slab->used);
+  return payload_of(chunk, class_size);
+}
+
+void SlabAllocator::Free(void* ptr) {
+  ChunkHeader* header = header_of(ptr);
+  CHECK_EQ(header->magic, kChunkMagic) << "freeing a foreign host pointer";
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.bytes_live -= header->size;
+  free_lists_[header->size].push_back(reinterpret_cast<char*>(header));
+}
+
+HostAllocatorStats SlabAllocator::stats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+bool SlabAllocator::Reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // Rewinding under a live chunk would hand its bytes out again.
+  if (stats_.bytes_live != 0) {
+    LOG(ERROR) << "Not resetting the host allocator: "
+        << stats_.bytes_live << " bytes are still in use";
+    return false;
+  }
+  free_lists_.clear();
+  for (int i = 0; i < slabs_.size(); ++i) {
+    slabs_[i].used = 0;
+  }
+  stats_.high_water_mark = 0;
+  return true;
+}
+
+}  // namespace caffe
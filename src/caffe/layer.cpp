@@ -2,14 +2,6 @@
 
 namespace caffe {
 
-#ifdef FORWARD_LESS_MEM
-	template <typename Dtype> 
-	void Layer<Dtype>::Qiaoge_alloc(const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) { }
-	
-	template <typename Dtype> 
-	void Layer<Dtype>::Qiaoge_free(const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) { }
-#endif
-
 	template <typename Dtype> 
 	void Layer<Dtype>::Compile_OpenCL() { }
 
@@ -55,7 +55,8 @@ shared_ptr<Layer<Dtype> > GetConvolutionLayer(
     }
 #endif
   }
-  if (engine == ConvolutionParameter_Engine_CAFFE) {
+  if (engine == ConvolutionParameter_Engine_CAFFE ||
+      engine == ConvolutionParameter_Engine_WINOGRAD) {
     return shared_ptr<Layer<Dtype> >(new ConvolutionLayer<Dtype>(param));
 #ifdef USE_CUDNN
   } else if (engine == ConvolutionParameter_Engine_CUDNN) {
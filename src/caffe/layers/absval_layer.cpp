@@ -2,6 +2,7 @@
 
 #include "caffe/layers/absval_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -19,7 +20,10 @@ void AbsValLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
   const int count = top[0]->count();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  caffe_abs(count, bottom[0]->cpu_data(), top_data);
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  parallel_for(count, kParallelGrain, [&](int begin, int end) {
+    caffe_abs(end - begin, bottom_data + begin, top_data + begin);
+  });
 }
 
 #ifdef CPU_ONLY
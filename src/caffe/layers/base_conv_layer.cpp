@@ -1,10 +1,18 @@
 #include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <cmath>
 #include <vector>
 
 #include "caffe/filler.hpp"
 #include "caffe/layers/base_conv_layer.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/depthwise.hpp"
 #include "caffe/util/im2col.hpp"
+#include "caffe/util/int8_gemm.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/opencl_kernel.hpp"
+#include "caffe/util/winograd.hpp"
 
 namespace caffe {
 
@@ -114,6 +122,12 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
         kernel_shape_data[i] == 1 && stride_data[i] == 1 && pad_data[i] == 0;
     if (!is_1x1_) { break; }
   }
+  // A 1x1 kernel without padding at any stride only gathers the input, see
+  // im2col_1x1_cpu and the pointwise load of the generated kernels.
+  is_pointwise_ = true;
+  for (int i = 0; i < num_spatial_axes_; ++i) {
+    is_pointwise_ &= kernel_shape_data[i] == 1 && pad_data[i] == 0;
+  }
   // Configure output channels and groups.
   channels_ = bottom[0]->shape(channel_axis_);
   num_output_ = this->layer_param_.convolution_param().num_output();
@@ -180,7 +194,29 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   weight_offset_ = conv_out_channels_ * kernel_dim_ / group_;
   // Propagate gradients to the parameters (as directed by backward pass).
   this->param_propagate_down_.resize(this->blobs_.size(), true);
-
+  // The WINOGRAD engine computes 2D 3x3 convolutions with stride and
+  // dilation 1 and leaves the rest to im2col.
+  use_winograd_ = false;
+  if (conv_param.engine() == ConvolutionParameter_Engine_WINOGRAD) {
+    use_winograd_ = !reverse_dimensions() && num_spatial_axes_ == 2 &&
+        !force_nd_im2col_;
+    for (int i = 0; use_winograd_ && i < num_spatial_axes_; ++i) {
+      use_winograd_ = kernel_shape_data[i] == 3 && stride_data[i] == 1 &&
+          dilation_data[i] == 1;
+    }
+    if (!use_winograd_) {
+      LOG(INFO) << "Layer " << this->layer_param_.name() << " is not a 3x3 "
+          << "convolution with stride and dilation 1; using im2col instead "
+          << "of Winograd";
+    }
+  }
+  winograd_filters_stale_ = true;
+  // A 2D convolution with a group per input channel, as in MobileNet, runs
+  // the direct depthwise kernels rather than a tiny gemm per channel, unless
+  // the WINOGRAD engine is asked for.
+  use_depthwise_ = !use_winograd_ && !reverse_dimensions() &&
+      num_spatial_axes_ == 2 && !force_nd_im2col_ && group_ > 1 &&
+      group_ == channels_;
 }
 
 
@@ -230,7 +266,7 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
   // The im2col result buffer will only hold one image at a time to avoid
   // overly large memory usage. In the special case of 1x1 convolution
-  // it goes lazily unused to save memory.
+  // it is unused, so it is not reshaped to keep a shared workspace small.
   col_buffer_shape_.clear();
   col_buffer_shape_.push_back(kernel_dim_ * group_);
   for (int i = 0; i < num_spatial_axes_; ++i) {
@@ -240,7 +276,28 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       col_buffer_shape_.push_back(output_shape_[i]);
     }
   }
-  col_buffer_.Reshape(col_buffer_shape_);
+  if (!is_1x1_) {
+    col_buffer_->Reshape(col_buffer_shape_);
+  }
+  col_buffer_shape_blob_.Reshape(
+      vector<int>(1, static_cast<int>(col_buffer_shape_.size())));
+  std::copy(col_buffer_shape_.begin(), col_buffer_shape_.end(),
+      col_buffer_shape_blob_.mutable_cpu_data());
+  if (use_winograd_) {
+    // F(4x4, 3x3) saves 4x the multiplies of im2col and F(2x2, 3x3) 2.25x,
+    // but the larger tiles waste more of a small output on the border.
+    const int tile = (output_shape_[0] >= 8 && output_shape_[1] >= 8) ? 4 : 2;
+    if (tile != winograd_tile_) {
+      winograd_tile_ = tile;
+      winograd_filters_stale_ = true;
+      winograd_buffer_.resize(winograd_buffer_size(tile, num_output_ / group_,
+          channels_ / group_));
+    }
+  }
+  if (use_depthwise_) {
+    depthwise_buffer_.resize(depthwise_buffer_size(input_shape(1),
+        input_shape(2), output_shape_[1]));
+  }
   bottom_dim_ = bottom[0]->count(channel_axis_);
   top_dim_ = top[0]->count(channel_axis_);
   num_kernels_im2col_ = conv_in_channels_ * conv_out_spatial_dim_;
@@ -455,6 +512,13 @@ std::string BaseConvolutionLayer<Dtype>::generate_accreg_init(bool dterm, bool l
 
 
 
+template <typename Dtype>
+BaseConvolutionLayer<Dtype>::~BaseConvolutionLayer() {
+  if (program) {
+    Caffe::Get().release_program(program);
+  }
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::Compile_OpenCL() {
 
@@ -463,27 +527,517 @@ void BaseConvolutionLayer<Dtype>::Compile_OpenCL() {
     return;
   }
 
+  // Shapes missing from the tuning file keep the default tiles, unless
+  // tuning is on and there is a device to run the candidates on. The
+  // depthwise and int8 kernels have no tiles.
+  ConvTuningDB& db = ConvTuningDB::Get();
+  ConvTileConfig config;
+  int8_kernels_compiled_ = use_int8_gpu();
+  if (!db.file().empty() && !use_depthwise_ && !int8_kernels_compiled_) {
+    const std::string key = tuning_key();
+    if (!db.Lookup(key, &config) && db.tuning() &&
+        Caffe::mode() == Caffe::GPU) {
+      config = TuneTileConfig();
+      db.Store(key, config);
+    }
+  }
+  set_tile_config(config);
+
   std::stringstream ss;
 
   ss << this->generate_header(); 
   ss << this->generate_fw_defs();
   ss << this->generate_fw_kernels(this->layer_param_.name() + "_forward");
 
+  if (program) {
+    Caffe::Get().release_program(program);
+  }
   Caffe::Get().build_opencl_program(ss.str(), this->program);
 
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::set_tile_config(
+    const ConvTileConfig& config) {
+  CHECK(config.IsValid()) << "Invalid tile configuration for layer "
+      << this->layer_param_.name();
+  vwm_ = config.vwm;
+  vwn_ = config.vwn;
+  tsk_unroll_ = config.tsk_unroll;
+  wptm_ = config.wptm;
+  wptn_ = config.wptn;
+  rtsm_ = config.rtsm;
+  rtsn_ = config.rtsn;
+  tsk_ = config.tsk;
+  tsm_ = config.tsm();
+  tsn_ = config.tsn();
+  lpta_ = (tsm_ * tsk_) / (rtsm_ * rtsn_);
+  lptb_ = (tsn_ * tsk_) / (rtsm_ * rtsn_);
+}
+
+template <typename Dtype>
+std::string BaseConvolutionLayer<Dtype>::tuning_key() {
+  char device_name[256] = { 0 };
+  OPENCL_CHECK(clGetDeviceInfo(Caffe::Get().deviceID, CL_DEVICE_NAME,
+      sizeof(device_name) - 1, device_name, NULL));
+  std::stringstream ss;
+  for (const char* c = device_name; *c; ++c) {
+    ss << (isspace(*c) ? '_' : *c);
+  }
+  int N = 1;
+  for (int i = 0; i < num_spatial_axes_; ++i) {
+    N *= output_shape_[i];
+  }
+  ss << "/" << this->type() << "/" << (sizeof(Dtype) == 2 ? "half" : "float")
+     << "/M" << num_output_ / group_ << "_N" << N
+     << "_K" << channels_ / group_ * kernel_shape_.count() << "_k";
+  for (int i = 0; i < num_spatial_axes_; ++i) {
+    ss << (i ? "x" : "") << kernel_shape_.cpu_data()[i];
+  }
+  ss << "_s";
+  for (int i = 0; i < num_spatial_axes_; ++i) {
+    ss << (i ? "x" : "") << stride_.cpu_data()[i];
+  }
+  ss << "_g" << group_;
+  return ss.str();
+}
+
+template <typename Dtype>
+ConvTileConfig BaseConvolutionLayer<Dtype>::TuneTileConfig() {
+  const cl_device_id device = Caffe::Get().deviceID;
+  size_t max_work_group_size = 0;
+  cl_ulong local_mem_size = 0;
+  OPENCL_CHECK(clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE,
+      sizeof(max_work_group_size), &max_work_group_size, NULL));
+  OPENCL_CHECK(clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE,
+      sizeof(local_mem_size), &local_mem_size, NULL));
+  int N = 1;
+  for (int i = 0; i < num_spatial_axes_; ++i) {
+    N *= output_shape_[i];
+  }
+  const vector<ConvTileConfig> candidates = ConvTileCandidates(
+      num_output_ / group_, N, channels_ / group_ * kernel_shape_.count(),
+      max_work_group_size, local_mem_size, sizeof(Dtype));
+
+  // Scratch blobs of the layer's shapes: only the timing matters.
+  vector<int> top_shape(bottom_shape_->begin(),
+      bottom_shape_->begin() + channel_axis_);
+  top_shape.push_back(num_output_);
+  top_shape.insert(top_shape.end(), output_shape_.begin(),
+      output_shape_.end());
+  Blob<Dtype> bottom_blob(*bottom_shape_);
+  Blob<Dtype> top_blob(top_shape);
+  const vector<Blob<Dtype>*> bottom(1, &bottom_blob);
+  const vector<Blob<Dtype>*> top(1, &top_blob);
+
+  const std::string name = this->layer_param_.name() + "_forward";
+  const int kRuns = 5;
+  ConvTileConfig best = candidates[0];
+  float best_time = FLT_MAX;
+  Timer timer;
+  for (int i = 0; i < candidates.size(); ++i) {
+    set_tile_config(candidates[i]);
+    std::stringstream ss;
+    ss << this->generate_header();
+    ss << this->generate_fw_defs();
+    ss << this->generate_fw_kernels(name);
+    cl_program candidate_program;
+    Caffe::Get().build_opencl_program(ss.str(), candidate_program);
+    std::swap(program, candidate_program);
+    // The compiler may need more registers than a full work-group has.
+    size_t kernel_work_group_size = 0;
+    OPENCL_CHECK(clGetKernelWorkGroupInfo(
+        Caffe::Get().get_kernel(program, name), device,
+        CL_KERNEL_WORK_GROUP_SIZE, sizeof(kernel_work_group_size),
+        &kernel_work_group_size, NULL));
+    if (kernel_work_group_size >= rtsm_ * rtsn_) {
+      this->Forward_gpu(bottom, top);  // Warm up.
+      timer.Start();
+      for (int r = 0; r < kRuns; ++r) {
+        this->Forward_gpu(bottom, top);
+      }
+      timer.Stop();
+      const float time = timer.MilliSeconds() / kRuns;
+      if (time < best_time) {
+        best_time = time;
+        best = candidates[i];
+      }
+    }
+    std::swap(program, candidate_program);
+    Caffe::Get().release_program(candidate_program);
+  }
+  LOG(INFO) << "Tuned " << this->layer_param_.name() << " over "
+      << candidates.size() << " configurations: " << best_time << " ms with"
+      << " WPTM " << best.wptm << " WPTN " << best.wptn
+      << " RTSM " << best.rtsm << " RTSN " << best.rtsn << " TSK " << best.tsk;
+  return best;
+}
+
+template <typename Dtype>
+bool BaseConvolutionLayer<Dtype>::FuseActivation(
+    const shared_ptr<Layer<Dtype> >& activation) {
+  if (activation_ != ACTIVATION_NONE) {
+    return false;
+  }
+  const LayerParameter& param = activation->layer_param();
+  const string type = activation->type();
+  if (type == "ReLU") {
+    activation_ = ACTIVATION_RELU;
+    activation_alpha_ = param.relu_param().negative_slope();
+  } else if (type == "ELU") {
+    activation_ = ACTIVATION_ELU;
+    activation_alpha_ = param.elu_param().alpha();
+  } else if (type == "TanH") {
+    activation_ = ACTIVATION_TANH;
+  } else if (type == "Sigmoid") {
+    activation_ = ACTIVATION_SIGMOID;
+  } else if (type == "PReLU") {
+    activation_ = ACTIVATION_PRELU;
+    activation_slope_ = activation->blobs()[0];
+    activation_channel_shared_ = param.prelu_param().channel_shared();
+  } else {
+    return false;
+  }
+  // The forward kernel has the activation baked in.
+  Compile_OpenCL();
+  return true;
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::ParamsChanged() {
+  winograd_filters_stale_ = true;
+  int8_weights_stale_ = true;
+  if (winograd_tile_) {
+    transform_winograd_filters(this->blobs_[0]->cpu_data());
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_activation(Dtype* output) {
+  if (activation_ == ACTIVATION_NONE) {
+    return;
+  }
+  const Dtype* slope = activation_ == ACTIVATION_PRELU ?
+      activation_slope_->cpu_data() : NULL;
+  // Channel by channel, so that each one is still in cache from the gemm.
+  for (int c = 0; c < num_output_; ++c) {
+    Dtype* data = output + c * out_spatial_dim_;
+    float alpha = activation_alpha_;
+    if (slope) {
+      alpha = caffe_to_float(slope[activation_channel_shared_ ? 0 : c]);
+    }
+    for (int i = 0; i < out_spatial_dim_; ++i) {
+      const float x = caffe_to_float(data[i]);
+      float y;
+      switch (activation_) {
+      case ACTIVATION_RELU:
+      case ACTIVATION_PRELU:
+        y = x > 0 ? x : alpha * x;
+        break;
+      case ACTIVATION_ELU:
+        y = x > 0 ? x : alpha * (exp(x) - 1);
+        break;
+      case ACTIVATION_TANH:
+        y = tanh(x);
+        break;
+      default:  // ACTIVATION_SIGMOID
+        y = 0.5 * tanh(0.5 * x) + 0.5;
+        break;
+      }
+      data[i] = caffe_from_float<Dtype>(y);
+    }
+  }
+}
+
+template <typename Dtype>
+std::string BaseConvolutionLayer<Dtype>::generate_activation_args() {
+  if (activation_ == ACTIVATION_PRELU) {
+    return ", __global const Dtype* __restrict slope";
+  }
+  return "";
+}
+
+template <typename Dtype>
+std::string BaseConvolutionLayer<Dtype>::generate_activation_ptr(
+    bool grouped) {
+  std::stringstream ss;
+  if (activation_ == ACTIVATION_PRELU) {
+    if (activation_channel_shared_) {
+      ss << "const Dtype slopeval = slope[0];" << std::endl;
+    } else if (grouped) {
+      ss << "__global const Dtype* Sptr = slope + group * (v_fout / v_g);"
+         << std::endl;
+    } else {
+      ss << "__global const Dtype* Sptr = slope;" << std::endl;
+    }
+  }
+  return ss.str();
+}
+
+template <typename Dtype>
+std::string BaseConvolutionLayer<Dtype>::generate_activation() {
+  std::stringstream ss;
+  ss << std::setprecision(32);
+  switch (activation_) {
+  case ACTIVATION_RELU:
+    if (activation_alpha_ == 0) {
+      ss << "outval = fmax(outval, (Dtype)0);" << std::endl;
+    } else {
+      ss << "outval = outval > (Dtype)0 ? outval : "
+         << "outval * (Dtype)" << activation_alpha_ << ";" << std::endl;
+    }
+    break;
+  case ACTIVATION_ELU:
+    ss << "outval = outval > (Dtype)0 ? outval : "
+       << "(Dtype)" << activation_alpha_ << " * (exp(outval) - (Dtype)1);"
+       << std::endl;
+    break;
+  case ACTIVATION_TANH:
+    ss << "outval = tanh(outval);" << std::endl;
+    break;
+  case ACTIVATION_SIGMOID:
+    ss << "outval = (Dtype)0.5 * tanh((Dtype)0.5 * outval) + (Dtype)0.5;"
+       << std::endl;
+    break;
+  case ACTIVATION_PRELU:
+    ss << "outval = outval > (Dtype)0 ? outval : outval * "
+       << (activation_channel_shared_ ? "slopeval" : "Sptr[globalRow]") << ";"
+       << std::endl;
+    break;
+  default:
+    break;
+  }
+  return ss.str();
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::set_activation_kernel_arg(cl_kernel kernel,
+    int arg_index) {
+  if (activation_ == ACTIVATION_PRELU) {
+    const Dtype* slope = activation_slope_->gpu_data();
+    OPENCL_CHECK(clSetKernelArg(kernel, arg_index, sizeof(cl_mem),
+        (void *)&slope));
+  }
+}
+
+template <typename Dtype>
+std::string BaseConvolutionLayer<Dtype>::generate_int8_kernels(
+    std::string name) {
+  std::stringstream ss;
+  const int K = kernel_dim_;
+  this->add_def(ss, "v_int8_K", K);
+  this->add_def(ss, "v_int8_K4", int8_padded_size(K));
+  this->add_def(ss, "v_int8_M", num_output_ / group_);
+  this->add_def(ss, "v_int8_WPT", int8_outputs_per_item());
+  ss << generate_opencl_int8_helpers();
+
+  // Element k of the im2col column of output pixel (oy, ox), quantized.
+  ss << "inline char int8_column(__global const Dtype* im, const int k,"
+     << " const int oy, const int ox, const float inverse) {" << std::endl;
+  ss << "if (k >= v_int8_K) {" << std::endl;
+  ss << "return 0;" << std::endl;
+  ss << "}" << std::endl;
+  ss << "const int c = k / (v_k_0 * v_k_1);" << std::endl;
+  ss << "const int iy = oy * v_s_0 - v_p_0 + (k / v_k_1 % v_k_0) * v_d_0;"
+     << std::endl;
+  ss << "const int ix = ox * v_s_1 - v_p_1 + (k % v_k_1) * v_d_1;"
+     << std::endl;
+  ss << "if (iy < 0 || iy >= v_imsi_0 || ix < 0 || ix >= v_imsi_1) {"
+     << std::endl;
+  ss << "return 0;" << std::endl;
+  ss << "}" << std::endl;
+  ss << "return int8_quantize((float)im[c * v_imsi + iy * v_imsi_1 + ix],"
+     << " inverse);" << std::endl;
+  ss << "}" << std::endl;
+
+  // Four elements of the quantized columns per work-item: one image and
+  // group after the other, v_imso columns of v_int8_K4 chars each.
+  ss << "__kernel void " << name << "_columns("
+     << "__global const Dtype* __restrict im_in, "
+     << "__global char* __restrict cols, const float inverse) {" << std::endl;
+  ss << "const int pix = get_global_id(0);" << std::endl;
+  ss << "if (pix >= v_imso) {" << std::endl;
+  ss << "return;" << std::endl;
+  ss << "}" << std::endl;
+  ss << "const int group = get_global_id(1) / (v_int8_K4 / 4);" << std::endl;
+  ss << "const int k = get_global_id(1) % (v_int8_K4 / 4) * 4;" << std::endl;
+  ss << "const int batch = get_global_id(2);" << std::endl;
+  ss << "const int oy = pix / v_imso_1;" << std::endl;
+  ss << "const int ox = pix % v_imso_1;" << std::endl;
+  ss << "__global const Dtype* im = im_in + v_B_off * batch"
+     << " + group * (v_fin / v_g) * v_imsi;" << std::endl;
+  ss << "char4 q;" << std::endl;
+  for (int i = 0; i < 4; ++i) {
+    ss << "VEC_4_" << i << "(q) = int8_column(im, k + " << i
+       << ", oy, ox, inverse);" << std::endl;
+  }
+  ss << "vstore4(q, 0, cols + ((batch * v_g + group) * v_imso + pix)"
+     << " * v_int8_K4 + k);" << std::endl;
+  ss << "}" << std::endl;
+
+  // v_int8_WPT output channels of one pixel per work-item, accumulated in
+  // int32 and scaled back to Dtype with the scale of their own filter.
+  ss << "__kernel void " << name << "("
+     << "__global const char* __restrict cols, "
+     << "__global const char* __restrict wq, "
+     << "__global const float* __restrict w_scales, "
+     << "__global Dtype* __restrict im_out";
+  if (bias_term_) {
+    ss << ", __global const Dtype* __restrict bias";
+  }
+  ss << generate_activation_args();
+  ss << ", const float scale) {" << std::endl;
+  ss << "const int pix = get_global_id(0);" << std::endl;
+  ss << "if (pix >= v_imso) {" << std::endl;
+  ss << "return;" << std::endl;
+  ss << "}" << std::endl;
+  ss << "const int fout = get_global_id(1) * v_int8_WPT;" << std::endl;
+  ss << "const int batch = get_global_id(2);" << std::endl;
+  ss << "__global const char* Bptr = cols + ((batch * v_g + fout / v_int8_M)"
+     << " * v_imso + pix) * v_int8_K4;" << std::endl;
+  ss << "__global const char* Aptr = wq + fout * v_int8_K4;" << std::endl;
+  ss << generate_activation_ptr(false);
+  ss << "int acc[v_int8_WPT];" << std::endl;
+  ss << "#pragma unroll" << std::endl;
+  ss << "for (int w = 0; w < v_int8_WPT; ++w) {" << std::endl;
+  ss << "acc[w] = 0;" << std::endl;
+  ss << "}" << std::endl;
+  ss << "for (int k = 0; k < v_int8_K4; k += 4) {" << std::endl;
+  ss << "const char4 b = vload4(0, Bptr + k);" << std::endl;
+  ss << "#pragma unroll" << std::endl;
+  ss << "for (int w = 0; w < v_int8_WPT; ++w) {" << std::endl;
+  ss << "acc[w] += int8_dot4(vload4(0, Aptr + w * v_int8_K4 + k), b);"
+     << std::endl;
+  ss << "}" << std::endl;
+  ss << "}" << std::endl;
+  ss << "#pragma unroll" << std::endl;
+  ss << "for (int w = 0; w < v_int8_WPT; ++w) {" << std::endl;
+  ss << "const int globalRow = fout + w;" << std::endl;
+  ss << "Dtype outval = (Dtype)(acc[w] * (w_scales[globalRow] * scale));"
+     << std::endl;
+  if (bias_term_) {
+    ss << "outval += bias[globalRow];" << std::endl;
+  }
+  ss << generate_activation();
+  ss << "im_out[v_C_off * batch + globalRow * v_imso + pix] = outval;"
+     << std::endl;
+  ss << "}" << std::endl;
+  ss << "}" << std::endl;
+
+  return ss.str();
+}
+
+template <typename Dtype>
+bool BaseConvolutionLayer<Dtype>::forward_gpu_int8(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (use_int8_gpu() != int8_kernels_compiled_) {
+    // The quantization_param came with the trained weights.
+    Compile_OpenCL();
+  }
+  if (!int8_kernels_compiled_) {
+    return false;
+  }
+  if (int8_weights_stale_) {
+    quantize_int8_weights(this->blobs_[0]->cpu_data());
+  }
+  // Only the int8 weights go to the device, not the float ones.
+  if (!int8_weights_gpu_) {
+    int8_weights_gpu_.reset(new SyncedMemory(int8_weights_.size()));
+    memcpy(int8_weights_gpu_->mutable_cpu_data(), &int8_weights_[0],
+        int8_weights_.size());
+    int8_weight_scales_gpu_.reset(
+        new SyncedMemory(int8_weight_scales_.size() * sizeof(float)));
+    memcpy(int8_weight_scales_gpu_->mutable_cpu_data(),
+        &int8_weight_scales_[0], int8_weight_scales_.size() * sizeof(float));
+  }
+  const int K4 = int8_padded_size(kernel_dim_);
+  const size_t columns_size =
+      static_cast<size_t>(num_) * group_ * conv_out_spatial_dim_ * K4;
+  if (!int8_columns_gpu_ || int8_columns_gpu_->size() != columns_size) {
+    int8_columns_gpu_.reset(new SyncedMemory(columns_size));
+  }
+  const float scale =
+      int8_scale(this->layer_param_.quantization_param().input_range());
+  const float inverse = scale > 0 ? 1.f / scale : 0.f;
+
+  const string& name = this->layer_param_.name();
+  cl_kernel columns_kernel =
+      Caffe::Get().get_kernel(program, name + "_forward_int8_columns");
+  cl_kernel kernel = Caffe::Get().get_kernel(program, name + "_forward_int8");
+  const void* weights = int8_weights_gpu_->gpu_data();
+  const void* weight_scales = int8_weight_scales_gpu_->gpu_data();
+  void* columns = int8_columns_gpu_->mutable_gpu_data();
+  const int kPixelsPerGroup = 64;
+  size_t local_size[3] = { kPixelsPerGroup, 1, 1 };
+  size_t global_size[3];
+  global_size[0] = static_cast<size_t>(
+      ((conv_out_spatial_dim_ - 1) / kPixelsPerGroup + 1) * kPixelsPerGroup);
+  global_size[2] = static_cast<size_t>(num_);
+  for (int i = 0; i < bottom.size(); ++i) {
+    const Dtype* bottom_data = bottom[i]->gpu_data();
+    Dtype* top_data = top[i]->mutable_gpu_data();
+
+    OPENCL_CHECK(clSetKernelArg(columns_kernel, 0, sizeof(cl_mem),
+        (void *)&bottom_data));
+    OPENCL_CHECK(clSetKernelArg(columns_kernel, 1, sizeof(cl_mem),
+        (void *)&columns));
+    OPENCL_CHECK(clSetKernelArg(columns_kernel, 2, sizeof(float),
+        (void *)&inverse));
+    global_size[1] = static_cast<size_t>(group_ * K4 / 4);
+    OPENCL_CHECK(clEnqueueNDRangeKernel(Caffe::Get().commandQueue,
+        columns_kernel, 3, NULL, global_size, local_size, 0, NULL, NULL));
+
+    int arg = 0;
+    OPENCL_CHECK(clSetKernelArg(kernel, arg++, sizeof(cl_mem),
+        (void *)&columns));
+    OPENCL_CHECK(clSetKernelArg(kernel, arg++, sizeof(cl_mem),
+        (void *)&weights));
+    OPENCL_CHECK(clSetKernelArg(kernel, arg++, sizeof(cl_mem),
+        (void *)&weight_scales));
+    OPENCL_CHECK(clSetKernelArg(kernel, arg++, sizeof(cl_mem),
+        (void *)&top_data));
+    if (bias_term_) {
+      const Dtype* bias = this->blobs_[1]->gpu_data();
+      OPENCL_CHECK(clSetKernelArg(kernel, arg++, sizeof(cl_mem),
+          (void *)&bias));
+    }
+    if (activation_ == ACTIVATION_PRELU) {
+      set_activation_kernel_arg(kernel, arg++);
+    }
+    OPENCL_CHECK(clSetKernelArg(kernel, arg++, sizeof(float),
+        (void *)&scale));
+    global_size[1] =
+        static_cast<size_t>(num_output_ / int8_outputs_per_item());
+    OPENCL_CHECK(clEnqueueNDRangeKernel(Caffe::Get().commandQueue, kernel, 3,
+        NULL, global_size, local_size, 0, NULL, NULL));
+  }
+  return true;
+}
+
 
 
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
     const Dtype* weights, Dtype* output, bool skip_im2col) {
+  // Depthwise filters are too short for the int8 dot products to pay off.
+  if (this->layer_param_.has_quantization_param() && !use_depthwise_) {
+    forward_cpu_int8(input, weights, output, skip_im2col);
+    return;
+  }
+  if (winograd_tile_) {
+    forward_cpu_winograd(input, weights, output);
+    return;
+  }
+  if (use_depthwise_) {
+    forward_cpu_depthwise(input, weights, output);
+    return;
+  }
   const Dtype* col_buff = input;
   if (!is_1x1_) {
     if (!skip_im2col) {
-      conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
+      conv_im2col_cpu(input, col_buffer_->mutable_cpu_data());
     }
-    col_buff = col_buffer_.cpu_data();
+    col_buff = col_buffer_->cpu_data();
   }
   for (int g = 0; g < group_; ++g) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
@@ -493,6 +1047,97 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
   }
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_int8(const Dtype* input,
+    const Dtype* weights, Dtype* output, bool skip_im2col) {
+  const int out_channels = conv_out_channels_ / group_;
+  const int padded_dim = int8_padded_size(kernel_dim_);
+  if (int8_weights_stale_) {
+    quantize_int8_weights(weights);
+  }
+  const Dtype* col_buff = input;
+  if (!is_1x1_) {
+    if (!skip_im2col) {
+      conv_im2col_cpu(input, col_buffer_->mutable_cpu_data());
+    }
+    col_buff = col_buffer_->cpu_data();
+  }
+  const float scale =
+      int8_scale(this->layer_param_.quantization_param().input_range());
+  int8_columns_.resize(padded_dim * conv_out_spatial_dim_);
+  for (int g = 0; g < group_; ++g) {
+    int8_quantize_columns(kernel_dim_, conv_out_spatial_dim_,
+        col_buff + col_offset_ * g, conv_out_spatial_dim_, 1, scale,
+        &int8_columns_[0]);
+    int8_gemm(out_channels, conv_out_spatial_dim_, kernel_dim_,
+        &int8_weights_[out_channels * padded_dim * g],
+        &int8_weight_scales_[out_channels * g], &int8_columns_[0], scale,
+        output + output_offset_ * g, conv_out_spatial_dim_, 1);
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::quantize_int8_weights(const Dtype* weights) {
+  // The filters of the groups are consecutive rows of kernel_dim_.
+  int8_weights_.resize(conv_out_channels_ * int8_padded_size(kernel_dim_));
+  int8_weight_scales_.resize(conv_out_channels_);
+  int8_quantize_weights(conv_out_channels_, kernel_dim_, weights, false,
+      &int8_weights_[0], &int8_weight_scales_[0]);
+  int8_weights_stale_ = false;
+  int8_weights_gpu_.reset();
+  int8_weight_scales_gpu_.reset();
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::transform_winograd_filters(
+    const Dtype* weights) {
+  const int out_channels = num_output_ / group_;
+  const int in_channels = channels_ / group_;
+  const int group_size = winograd_filters_size(winograd_tile_, out_channels,
+      in_channels);
+  winograd_filters_.resize(group_size * group_);
+  vector<float> filters(weight_offset_);
+  for (int g = 0; g < group_; ++g) {
+    for (int i = 0; i < weight_offset_; ++i) {
+      filters[i] = caffe_to_float(weights[weight_offset_ * g + i]);
+    }
+    winograd_transform_filters(winograd_tile_, out_channels, in_channels,
+        &filters[0], &winograd_filters_[group_size * g]);
+  }
+  winograd_filters_stale_ = false;
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_winograd(const Dtype* input,
+    const Dtype* weights, Dtype* output) {
+  if (winograd_filters_stale_) {
+    transform_winograd_filters(weights);
+  }
+  const int out_channels = num_output_ / group_;
+  const int in_channels = channels_ / group_;
+  const int height = conv_input_shape_.cpu_data()[1];
+  const int width = conv_input_shape_.cpu_data()[2];
+  const int group_size = winograd_filters_.size() / group_;
+  for (int g = 0; g < group_; ++g) {
+    winograd_conv_cpu(input + in_channels * height * width * g, in_channels,
+        height, width, pad_.cpu_data()[0], pad_.cpu_data()[1], winograd_tile_,
+        &winograd_filters_[group_size * g], out_channels, output_shape_[0],
+        output_shape_[1], &winograd_buffer_[0], output + output_offset_ * g);
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_depthwise(const Dtype* input,
+    const Dtype* weights, Dtype* output) {
+  depthwise_conv_cpu(input, channels_, conv_input_shape_.cpu_data()[1],
+      conv_input_shape_.cpu_data()[2],
+      kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+      pad_.cpu_data()[0], pad_.cpu_data()[1],
+      stride_.cpu_data()[0], stride_.cpu_data()[1],
+      dilation_.cpu_data()[0], dilation_.cpu_data()[1], weights, num_output_,
+      output_shape_[0], output_shape_[1], &depthwise_buffer_[0], output);
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_bias(Dtype* output,
     const Dtype* bias) {
@@ -504,9 +1149,9 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_bias(Dtype* output,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output,
     const Dtype* weights, Dtype* input) {
-  Dtype* col_buff = col_buffer_.mutable_cpu_data();
-  if (is_1x1_) {
-    col_buff = input;
+  Dtype* col_buff = input;
+  if (!is_1x1_) {
+    col_buff = col_buffer_->mutable_cpu_data();
   }
   for (int g = 0; g < group_; ++g) {
     caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, kernel_dim_,
@@ -522,10 +1167,12 @@ void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::weight_cpu_gemm(const Dtype* input,
     const Dtype* output, Dtype* weights) {
+  // The solver updates the weights from this gradient before the next Forward.
+  winograd_filters_stale_ = true;
   const Dtype* col_buff = input;
   if (!is_1x1_) {
-    conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
-    col_buff = col_buffer_.cpu_data();
+    conv_im2col_cpu(input, col_buffer_->mutable_cpu_data());
+    col_buff = col_buffer_->cpu_data();
   }
   for (int g = 0; g < group_; ++g) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, conv_out_channels_ / group_,
@@ -550,9 +1197,9 @@ void BaseConvolutionLayer<Dtype>::forward_gpu_gemm(const Dtype* input,
   const Dtype* col_buff = input;
   if (!is_1x1_) {
     if (!skip_im2col) {
-      conv_im2col_gpu(input, col_buffer_.mutable_gpu_data());
+      conv_im2col_gpu(input, col_buffer_->mutable_gpu_data());
     }
-    col_buff = col_buffer_.gpu_data();
+    col_buff = col_buffer_->gpu_data();
   }
   for (int g = 0; g < group_; ++g) {
     caffe_gpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
@@ -573,9 +1220,9 @@ void BaseConvolutionLayer<Dtype>::forward_gpu_bias(Dtype* output,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::backward_gpu_gemm(const Dtype* output,
     const Dtype* weights, Dtype* input) {
-  Dtype* col_buff = col_buffer_.mutable_gpu_data();
-  if (is_1x1_) {
-    col_buff = input;
+  Dtype* col_buff = input;
+  if (!is_1x1_) {
+    col_buff = col_buffer_->mutable_gpu_data();
   }
   for (int g = 0; g < group_; ++g) {
     caffe_gpu_gemm<Dtype>(CblasTrans, CblasNoTrans, kernel_dim_,
@@ -591,10 +1238,12 @@ void BaseConvolutionLayer<Dtype>::backward_gpu_gemm(const Dtype* output,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::weight_gpu_gemm(const Dtype* input,
     const Dtype* output, Dtype* weights) {
+  // The solver updates the weights from this gradient before the next Forward.
+  winograd_filters_stale_ = true;
   const Dtype* col_buff = input;
   if (!is_1x1_) {
-    conv_im2col_gpu(input, col_buffer_.mutable_gpu_data());
-    col_buff = col_buffer_.gpu_data();
+    conv_im2col_gpu(input, col_buffer_->mutable_gpu_data());
+    col_buff = col_buffer_->gpu_data();
   }
   for (int g = 0; g < group_; ++g) {
     caffe_gpu_gemm<Dtype>(CblasNoTrans, CblasTrans, conv_out_channels_ / group_,
@@ -615,24 +1264,6 @@ void BaseConvolutionLayer<Dtype>::backward_gpu_bias(Dtype* bias,
 
 
 
-#ifdef FORWARD_LESS_MEM
-template <typename Dtype>
-void BaseConvolutionLayer<Dtype>::Qiaoge_alloc(const vector<Blob<Dtype>*>& bottom,
-                                               const vector<Blob<Dtype>*>& top) {
-    if (bias_term_) {
-        caffe_set(bias_multiplier_.count(), Dtype(1), bias_multiplier_.mutable_cpu_data());
-    }
-}
-
-template <typename Dtype>
-void BaseConvolutionLayer<Dtype>::Qiaoge_free(const vector<Blob<Dtype>*>& bottom,
-                                              const vector<Blob<Dtype>*>& top) {
-    if (bias_term_) {
-        bias_multiplier_.force_delete();
-    }
-    col_buffer_.force_delete();
-}
-#endif
 
 INSTANTIATE_CLASS(BaseConvolutionLayer);
 
@@ -73,10 +73,7 @@ void BatchReindexLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
 
 
   
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "BRForward", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "BRForward");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&bottom_data));  
@@ -104,10 +104,7 @@ void BiasLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
   
   Dtype* top_data = top[0]->mutable_gpu_data();
   
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "BiasForward", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "BiasForward");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&bottom_data));  
@@ -2,6 +2,7 @@
 #include <vector>
 
 #include "caffe/layers/bnll_layer.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -13,11 +14,13 @@ void BNLLLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = bottom_data[i] > 0 ?
-        bottom_data[i] + log(1. + exp(-bottom_data[i])) :
-        log(1. + exp(bottom_data[i]));
-  }
+  parallel_for(count, kParallelGrain, [&](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      top_data[i] = bottom_data[i] > 0 ?
+          bottom_data[i] + log(1. + exp(-bottom_data[i])) :
+          log(1. + exp(bottom_data[i]));
+    }
+  });
 }
 
 
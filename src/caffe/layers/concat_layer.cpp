@@ -53,16 +53,44 @@ void ConcatLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+template <typename Dtype>
+int ConcatLayer<Dtype>::BottomDataViewOffset(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top,
+    const int bottom_id) const {
+  if (bottom.size() == 1 || num_concats_ != 1) { return -1; }
+  int offset = 0;
+  for (int i = 0; i < bottom_id; ++i) {
+    offset += bottom[i]->count();
+  }
+  return offset;
+}
+
 template <typename Dtype>
 void ConcatLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   if (bottom.size() == 1) { return; }
+  // Bottoms the net made views of their part of top are written there by
+  // the layers producing them. A view a reshape left at another offset is
+  // moved out before top is written over it.
+  vector<bool> in_place(bottom.size());
+  for (int i = 0; i < bottom.size(); ++i) {
+    const int view_offset = BottomDataViewOffset(bottom, top, i);
+    in_place[i] = view_offset >= 0 &&
+        bottom[i]->IsDataViewOf(*top[0], view_offset);
+    if (!in_place[i] && bottom[i]->data() == top[0]->data()) {
+      bottom[i]->DetachDataView();
+    }
+  }
   Dtype* top_data = top[0]->mutable_cpu_data();
   int offset_concat_axis = 0;
   const int top_concat_axis = top[0]->shape(concat_axis_);
   for (int i = 0; i < bottom.size(); ++i) {
-    const Dtype* bottom_data = bottom[i]->cpu_data();
     const int bottom_concat_axis = bottom[i]->shape(concat_axis_);
+    if (in_place[i]) {
+      offset_concat_axis += bottom_concat_axis;
+      continue;
+    }
+    const Dtype* bottom_data = bottom[i]->cpu_data();
     for (int n = 0; n < num_concats_; ++n) {
       caffe_copy(bottom_concat_axis * concat_input_size_,
           bottom_data + n * bottom_concat_axis * concat_input_size_,
@@ -90,10 +118,7 @@ void ConcatLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
   const int top_concat_axis = top[0]->shape(concat_axis_);
 
 
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "Concat", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "Concat");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *)&top_data)); 
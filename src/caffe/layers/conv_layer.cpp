@@ -36,6 +36,7 @@ void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
         const Dtype* bias = this->blobs_[1]->cpu_data();
         this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
       }
+      this->forward_cpu_activation(top_data + n * this->top_dim_);
     }
   }
 }
@@ -45,10 +46,12 @@ void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void ConvolutionLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+  if (this->forward_gpu_int8(bottom, top)) {
+    return;
+  }
 
-  cl_int ret = -1;
-
-  cl_kernel kernel = clCreateKernel(this->program, (this->layer_param_.name() + "_forward").c_str(), &ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(this->program,
+      this->layer_param_.name() + "_forward");
 
   for (int i = 0; i < bottom.size(); ++i) {
 
@@ -65,16 +68,26 @@ void ConvolutionLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
       const Dtype* bias = this->blobs_[1]->gpu_data();
       OPENCL_CHECK(clSetKernelArg(kernel, 3, sizeof(cl_mem), (void *)&bias));
     }
-
-    size_t* local_size = new size_t[3];
-    local_size[0] = static_cast<size_t>(this->rtsn_);
-    local_size[1] = static_cast<size_t>(this->rtsm_);
-    local_size[2] = static_cast<size_t>(1);
-
-    size_t* global_size = new size_t[3];
-    global_size[0] = static_cast<size_t>((((top[i]->shape(2) * top[i]->shape(3)) - 1) / this->tsn_ + 1)*this->rtsn_);
-    global_size[1] = static_cast<size_t>((((top[i]->shape(1) / this->group_) - 1) / this->tsm_ + 1)*this->rtsm_);
-    global_size[2] = static_cast<size_t>(bottom[i]->shape()[0] * this->group_);
+    this->set_activation_kernel_arg(kernel, 3 + this->bias_term_);
+
+    size_t local_size[3];
+    size_t global_size[3];
+    if (this->use_depthwise_) {
+      const int kPixelsPerGroup = 64;
+      local_size[0] = static_cast<size_t>(kPixelsPerGroup);
+      local_size[1] = static_cast<size_t>(1);
+      local_size[2] = static_cast<size_t>(1);
+      global_size[0] = static_cast<size_t>((((top[i]->shape(2) * top[i]->shape(3)) - 1) / kPixelsPerGroup + 1) * kPixelsPerGroup);
+      global_size[1] = static_cast<size_t>(this->num_output_ / depthwise_channels());
+      global_size[2] = static_cast<size_t>(bottom[i]->shape()[0]);
+    } else {
+      local_size[0] = static_cast<size_t>(this->rtsn_);
+      local_size[1] = static_cast<size_t>(this->rtsm_);
+      local_size[2] = static_cast<size_t>(1);
+      global_size[0] = static_cast<size_t>((((top[i]->shape(2) * top[i]->shape(3)) - 1) / this->tsn_ + 1)*this->rtsn_);
+      global_size[1] = static_cast<size_t>((((top[i]->shape(1) / this->group_) - 1) / this->tsm_ + 1)*this->rtsm_);
+      global_size[2] = static_cast<size_t>(bottom[i]->shape()[0] * this->group_);
+    }
 
     OPENCL_CHECK(clEnqueueNDRangeKernel(Caffe::Get().commandQueue, kernel, 3, NULL, global_size, local_size, 0, NULL, NULL));  
 
@@ -222,8 +235,89 @@ std::string ConvolutionLayer<Dtype>::generate_fw_defs() {
 
 
 
+template <typename Dtype>
+std::string ConvolutionLayer<Dtype>::generate_depthwise_kernel(
+    std::string name) {
+  std::stringstream ss;
+  const int vwc = depthwise_channels();
+  // Output channels per input channel
+  this->add_def(ss, "v_mult", this->num_output_ / this->channels_);
+  this->add_def(ss, "VWC", vwc);
+
+  ss << "__kernel" << std::endl;
+  ss << "__attribute__((vec_type_hint(Dtype" << vwc << ")))" << std::endl;
+  ss << "void " + name + "(";
+  ss << "__global const Dtype* __restrict im_in, ";
+  ss << "__global const Dtype* __restrict wg, ";
+  ss << "__global Dtype* __restrict im_out";
+  if (this->bias_term_) {
+    ss << ", __global const Dtype* __restrict bias";
+  }
+  ss << this->generate_activation_args();
+  ss << ") {" << std::endl;
+
+  // Output pixel, first of the VWC output channels, and image
+  ss << "const int pix = get_global_id(0);" << std::endl;
+  ss << "if (pix >= v_imso) {" << std::endl;
+  ss << "return;" << std::endl;
+  ss << "}" << std::endl;
+  ss << "const int fout = get_global_id(1) * VWC;" << std::endl;
+  ss << "const int batch = get_global_id(2);" << std::endl;
+  ss << "const int oy = pix / v_imso_1;" << std::endl;
+  ss << "const int ox = pix % v_imso_1;" << std::endl;
+  ss << "__global const Dtype* Bptr = im_in + v_B_off * batch;" << std::endl;
+  ss << "__global const Dtype* Aptr = wg + fout * (v_k_0 * v_k_1);"
+     << std::endl;
+  ss << this->generate_activation_ptr(false);
+
+  ss << "Dtype" << vwc << " Creg = 0.0;" << std::endl;
+  ss << "for (int kh = 0; kh < v_k_0; ++kh) {" << std::endl;
+  ss << "const int iy = oy * v_s_0 - v_p_0 + kh * v_d_0;" << std::endl;
+  ss << "if (iy >= 0 && iy < v_imsi_0) {" << std::endl;
+  ss << "for (int kw = 0; kw < v_k_1; ++kw) {" << std::endl;
+  ss << "const int ix = ox * v_s_1 - v_p_1 + kw * v_d_1;" << std::endl;
+  ss << "if (ix >= 0 && ix < v_imsi_1) {" << std::endl;
+  ss << "const int idx = iy * v_imsi_1 + ix;" << std::endl;
+  ss << "const int k = kh * v_k_1 + kw;" << std::endl;
+  ss << "Dtype" << vwc << " Breg;" << std::endl;
+  ss << "Dtype" << vwc << " Areg;" << std::endl;
+  for (int i = 0; i < vwc; ++i) {
+    ss << "VEC_" << vwc << "_" << i << "(Breg) = Bptr[((fout + " << i
+       << ") / v_mult) * v_imsi + idx];" << std::endl;
+    ss << "VEC_" << vwc << "_" << i << "(Areg) = Aptr[" << i
+       << " * (v_k_0 * v_k_1) + k];" << std::endl;
+  }
+  ss << "Creg += Breg * Areg;" << std::endl;
+  ss << "}" << std::endl;  // ix in range
+  ss << "}" << std::endl;  // For (kw)
+  ss << "}" << std::endl;  // iy in range
+  ss << "}" << std::endl;  // For (kh)
+
+  // Store the VWC results
+  for (int i = 0; i < vwc; ++i) {
+    ss << "{" << std::endl;
+    ss << "const int globalRow = fout + " << i << ";" << std::endl;
+    ss << "Dtype outval = VEC_" << vwc << "_" << i << "(Creg);" << std::endl;
+    if (this->bias_term_) {
+      ss << "outval += bias[globalRow];" << std::endl;
+    }
+    ss << this->generate_activation();
+    ss << "im_out[v_C_off * batch + globalRow * v_imso + pix] = outval;"
+       << std::endl;
+    ss << "}" << std::endl;
+  }
+
+  // Kernel
+  ss << "}" << std::endl;
+
+  return ss.str();
+}
+
 template <typename Dtype>
 std::string ConvolutionLayer<Dtype>::generate_fw_kernels(std::string name) {
+  if (this->use_depthwise_) {
+    return generate_depthwise_kernel(name);
+  }
   std::stringstream ss;
 
   bool skip_range_check_ = true;
@@ -247,6 +341,7 @@ std::string ConvolutionLayer<Dtype>::generate_fw_kernels(std::string name) {
   if (this->bias_term_) {
     ss << ", __global const Dtype* __restrict bias";
   }
+  ss << this->generate_activation_args();
   ss << ") {" << std::endl;
 
   // Thread identifiers
@@ -294,6 +389,8 @@ std::string ConvolutionLayer<Dtype>::generate_fw_kernels(std::string name) {
     }
   }
 
+  ss << this->generate_activation_ptr(this->group_ > 1);
+
   // Initialize the accumulation registers
   ss << "{" << std::endl;  // Scoping for C registers
   ss << this->generate_accreg_init(false, false);
@@ -348,53 +445,77 @@ std::string ConvolutionLayer<Dtype>::generate_fw_kernels(std::string name) {
   ss << "int tiledIndex = TSK * t + row;" << std::endl;
 
   ss << "if ((offN + col) < N && tiledIndex < K) {" << std::endl;
-  // Define temporary registers
-  for (int i = 0; i < this->num_spatial_axes_; ++i) {
-    ss << "int d_iter_" << i << ";" << std::endl;
-    ss << "int d_temp_" << i << ";" << std::endl;
-  }
+  if (this->is_pointwise_) {
+    // A 1x1 kernel without padding reads input channel tiledIndex at the
+    // output pixel scaled by the stride, which is always in range.
+    if (this->is_1x1_) {
+      ss << "Bsub[row][col] = Bptr[tiledIndex * v_imsi + offN + col];"
+         << std::endl;
+    } else {
+      ss << "int imageIndex = offN + col;" << std::endl;
+      for (int i = this->num_spatial_axes_ - 1; i >= 0; --i) {
+        ss << "const int d_temp_" << i << " = (imageIndex % v_imso_" << i
+           << ") * v_s_" << i << ";" << std::endl;
+        ss << "imageIndex = imageIndex / v_imso_" << i << ";" << std::endl;
+      }
+      ss << "int pixel = d_temp_0;" << std::endl;
+      for (int i = 1; i < this->num_spatial_axes_; ++i) {
+        ss << "pixel = pixel * v_imsi_" << i << " + d_temp_" << i << ";"
+           << std::endl;
+      }
+      ss << "Bsub[row][col] = Bptr[tiledIndex * v_imsi + pixel];"
+         << std::endl;
+    }
+  } else {
+    // Define temporary registers
+    for (int i = 0; i < this->num_spatial_axes_; ++i) {
+      ss << "int d_iter_" << i << ";" << std::endl;
+      ss << "int d_temp_" << i << ";" << std::endl;
+    }
 
-  ss << "int imageIndex = offN + col;" << std::endl;
-  for (int i = this->num_spatial_axes_ - 1; i >= 0; --i) {
-    // Compute d_iter, final tiledIndex becomes input feature map ID
-    // Scale d_iter by the dilation factor
-    ss << "d_iter_" << i << " = (tiledIndex % v_k_" << i << ") * v_d_" << i
-       << ";" << std::endl;
-    ss << "tiledIndex = tiledIndex / v_k_" << i << ";" << std::endl;
-
-    // Compute d_temp
-    // Scale d_temp by the stride and subtract the padding
-    ss << "d_temp_" << i << " = (imageIndex % v_imso_" << i << ") * v_s_" << i
-       << " - v_p_" << i << ";" << std::endl;
-    ss << "imageIndex = imageIndex / v_imso_" << i << ";" << std::endl;
-  }
+    ss << "int imageIndex = offN + col;" << std::endl;
+    for (int i = this->num_spatial_axes_ - 1; i >= 0; --i) {
+      // Compute d_iter, final tiledIndex becomes input feature map ID
+      // Scale d_iter by the dilation factor
+      ss << "d_iter_" << i << " = (tiledIndex % v_k_" << i << ") * v_d_" << i
+         << ";" << std::endl;
+      ss << "tiledIndex = tiledIndex / v_k_" << i << ";" << std::endl;
+
+      // Compute d_temp
+      // Scale d_temp by the stride and subtract the padding
+      ss << "d_temp_" << i << " = (imageIndex % v_imso_" << i << ") * v_s_"
+         << i << " - v_p_" << i << ";" << std::endl;
+      ss << "imageIndex = imageIndex / v_imso_" << i << ";" << std::endl;
+    }
 
-  // Recombine final index, compute in-range
-  if (!skip_range_check_) {
-    ss << "bool in_range = true;" << std::endl;
-  }
-  ss << "int d_iter_im;" << std::endl;
-  for (int i = 0; i < this->num_spatial_axes_; ++i) {
-    // Here, d_temp_ represents the column shift,
-    // while d_iter_ is the kernel shift
-    ss << "d_iter_im = d_temp_" << i << " + d_iter_" << i << ";" << std::endl;
-    ss << "tiledIndex = tiledIndex * v_imsi_" << i << " + d_iter_im;"
-       << std::endl;
+    // Recombine final index, compute in-range
     if (!skip_range_check_) {
-      ss << "in_range &= d_iter_im >= 0 && d_iter_im < v_imsi_" << i << ";"
+      ss << "bool in_range = true;" << std::endl;
+    }
+    ss << "int d_iter_im;" << std::endl;
+    for (int i = 0; i < this->num_spatial_axes_; ++i) {
+      // Here, d_temp_ represents the column shift,
+      // while d_iter_ is the kernel shift
+      ss << "d_iter_im = d_temp_" << i << " + d_iter_" << i << ";"
          << std::endl;
+      ss << "tiledIndex = tiledIndex * v_imsi_" << i << " + d_iter_im;"
+         << std::endl;
+      if (!skip_range_check_) {
+        ss << "in_range &= d_iter_im >= 0 && d_iter_im < v_imsi_" << i << ";"
+           << std::endl;
+      }
     }
-  }
 
-  if (!skip_range_check_) {
-    ss << "if (in_range) {" << std::endl;
-  }
-  // tiledIndex now holds the memory offset for the input image
-  ss << "Bsub[row][col] = Bptr[tiledIndex];" << std::endl;
-  if (!skip_range_check_) {
-    ss << "} else {" << std::endl;
-    ss << "Bsub[row][col] = 0.0;" << std::endl;
-    ss << "}" << std::endl;
+    if (!skip_range_check_) {
+      ss << "if (in_range) {" << std::endl;
+    }
+    // tiledIndex now holds the memory offset for the input image
+    ss << "Bsub[row][col] = Bptr[tiledIndex];" << std::endl;
+    if (!skip_range_check_) {
+      ss << "} else {" << std::endl;
+      ss << "Bsub[row][col] = 0.0;" << std::endl;
+      ss << "}" << std::endl;
+    }
   }
   ss << "} else {" << std::endl;
   ss << "Bsub[row][col] = 0.0;" << std::endl;
@@ -427,14 +548,13 @@ std::string ConvolutionLayer<Dtype>::generate_fw_kernels(std::string name) {
   ss << "int globalCol = offN + tidn + wn * RTSN;"
      << std::endl;
   ss << "if (globalRow < M && globalCol < N) {" << std::endl;
+  ss << "Dtype outval = ((Dtype*)(&(Creg[wm][wn/VWN])))[wn%VWN];"
+     << std::endl;
   if (this->bias_term_) {
-    ss << "Cptr[globalRow * N + globalCol] = "
-       << "((Dtype*)(&(Creg[wm][wn/VWN])))[wn%VWN] + biasval;"
-       << std::endl;
-  } else {
-    ss << "Cptr[globalRow * N + globalCol] = "
-       << "((Dtype*)(&(Creg[wm][wn/VWN])))[wn%VWN];" << std::endl;
+    ss << "outval += biasval;" << std::endl;
   }
+  ss << this->generate_activation();
+  ss << "Cptr[globalRow * N + globalCol] = outval;" << std::endl;
   ss << "}" << std::endl;   // M-N-Guard
   ss << "}" << std::endl;   // For (N)
   ss << "}" << std::endl;   // For (M)
@@ -443,6 +563,9 @@ std::string ConvolutionLayer<Dtype>::generate_fw_kernels(std::string name) {
   // Kernel
   ss << "}" << std::endl;
 
+  if (this->use_int8_gpu()) {
+    ss << this->generate_int8_kernels(name + "_int8");
+  }
   return ss.str();
 }
 
@@ -118,9 +118,33 @@ void CropLayer<Dtype>::crop_copy(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+template <typename Dtype>
+int CropLayer<Dtype>::TopDataViewOffset(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top, const int top_id) const {
+  const int num_axes = bottom[0]->num_axes();
+  int axis = 0;
+  while (axis < num_axes && top[0]->shape(axis) == bottom[0]->shape(axis)) {
+    ++axis;
+  }
+  if (axis == num_axes) { return 0; }
+  if (bottom[0]->count(0, axis) != 1) { return -1; }
+  for (int i = axis + 1; i < num_axes; ++i) {
+    if (top[0]->shape(i) != bottom[0]->shape(i)) { return -1; }
+  }
+  return offsets.cpu_data()[axis] * bottom[0]->count(axis + 1);
+}
+
 template <typename Dtype>
 void CropLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
+  // A top the net made a view of the crop needs no copy.
+  const int view_offset = TopDataViewOffset(bottom, top, 0);
+  if (view_offset >= 0 && top[0]->IsDataViewOf(*bottom[0], view_offset)) {
+    return;
+  }
+  if (top[0]->data() == bottom[0]->data()) {
+    top[0]->DetachDataView();
+  }
   std::vector<int> indices(top[0]->num_axes(), 0);
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
@@ -158,10 +182,7 @@ void CropLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
   //     offsets.gpu_data(),
   //     bottom_data, top_data);
 
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "crop_kernel_forward", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "crop_kernel_forward");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&bottom_data));  
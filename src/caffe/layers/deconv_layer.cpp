@@ -35,6 +35,7 @@ void DeconvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
         const Dtype* bias = this->blobs_[1]->cpu_data();
         this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
       }
+      this->forward_cpu_activation(top_data + n * this->top_dim_);
     }
   }
 }
@@ -46,9 +47,8 @@ template <typename Dtype>
 void DeconvolutionLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
 
-  cl_int ret = -1;
-
-  cl_kernel kernel = clCreateKernel(this->program, (this->layer_param_.name() + "_forward").c_str(), &ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(this->program,
+      this->layer_param_.name() + "_forward");
 
   for (int i = 0; i < bottom.size(); ++i) {
 
@@ -65,13 +65,14 @@ void DeconvolutionLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
       const Dtype* bias = this->blobs_[1]->gpu_data();
       OPENCL_CHECK(clSetKernelArg(kernel, 3, sizeof(cl_mem), (void *)&bias));
     }
+    this->set_activation_kernel_arg(kernel, 3 + this->bias_term_);
 
-    size_t* local_size = new size_t[3];
+    size_t local_size[3];
     local_size[0] = static_cast<size_t>(this->rtsn_);
     local_size[1] = static_cast<size_t>(this->rtsm_);
     local_size[2] = static_cast<size_t>(1);
 
-    size_t* global_size = new size_t[3];
+    size_t global_size[3];
     global_size[0] = static_cast<size_t>((((top[i]->shape(2) * top[i]->shape(3)) - 1) / this->tsn_ + 1)*this->rtsn_);
     global_size[1] = static_cast<size_t>((((top[i]->shape(1) / this->group_) - 1) / this->tsm_ + 1)*this->rtsm_);
     global_size[2] = static_cast<size_t>(bottom[i]->shape()[0] * 1);
@@ -253,6 +254,7 @@ std::string DeconvolutionLayer<Dtype>::generate_fw_kernels(std::string name) {
     if (this->bias_term_) {
     ss << ", __global const Dtype* __restrict bias";
   }
+  ss << this->generate_activation_args();
   ss << ") {" << std::endl;
 
   // Thread identifiers
@@ -302,6 +304,8 @@ std::string DeconvolutionLayer<Dtype>::generate_fw_kernels(std::string name) {
   }
 
 
+  ss << this->generate_activation_ptr(this->group_ > 1);
+
   // Initialize the accumulation registers
   ss << "{" << std::endl;  // Scoping for C registers
   ss << this->generate_accreg_init(false, false);
@@ -429,13 +433,13 @@ std::string DeconvolutionLayer<Dtype>::generate_fw_kernels(std::string name) {
   ss << "for (int wn=0; wn<WPTN; ++wn) {" << std::endl;
   ss << "int globalCol = offN + tidn + wn * RTSN;" << std::endl;
   ss << "if (globalRow < M && globalCol < N) {" << std::endl;
-  ss << "Cptr[globalRow * N + globalCol] = ";
+  ss << "Dtype outval = ((Dtype*)(&(Creg[wm][wn/VWN])))[wn%VWN];"
+     << std::endl;
   if (this->bias_term_) {
-    ss << "((Dtype*)(&(Creg[wm][wn/VWN])))[wn%VWN]"
-       << " + biasval;" << std::endl;
-  } else {
-    ss << "((Dtype*)(&(Creg[wm][wn/VWN])))[wn%VWN];" << std::endl;
+    ss << "outval += biasval;" << std::endl;
   }
+  ss << this->generate_activation();
+  ss << "Cptr[globalRow * N + globalCol] = outval;" << std::endl;
   ss << "}" << std::endl;
 
 
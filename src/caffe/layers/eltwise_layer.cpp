@@ -3,6 +3,7 @@
 
 #include "caffe/layers/eltwise_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -46,56 +47,60 @@ void EltwiseLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void EltwiseLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  int* mask = NULL;
-  const Dtype* bottom_data_a = NULL;
-  const Dtype* bottom_data_b = NULL;
   const int count = top[0]->count();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  switch (op_) {
-  case EltwiseParameter_EltwiseOp_PROD:
-    caffe_mul(count, bottom[0]->cpu_data(), bottom[1]->cpu_data(), top_data);
-    for (int i = 2; i < bottom.size(); ++i) {
-      caffe_mul(count, top_data, bottom[i]->cpu_data(), top_data);
-    }
-    break;
-  case EltwiseParameter_EltwiseOp_SUM:
-    caffe_set(count, Dtype(0), top_data);
-    // TODO(shelhamer) does BLAS optimize to sum for coeff = 1?
-    for (int i = 0; i < bottom.size(); ++i) {
-      caffe_axpy(count, coeffs_[i], bottom[i]->cpu_data(), top_data);
-    }
-    break;
-  case EltwiseParameter_EltwiseOp_MAX:
-    // Initialize
-    mask = max_idx_.mutable_cpu_data();
-    caffe_set(count, -1, mask);
-    caffe_set(count, Dtype(-FLT_MAX), top_data);
-    // bottom 0 & 1
-    bottom_data_a = bottom[0]->cpu_data();
-    bottom_data_b = bottom[1]->cpu_data();
-    for (int idx = 0; idx < count; ++idx) {
-      if (bottom_data_a[idx] > bottom_data_b[idx]) {
-        top_data[idx] = bottom_data_a[idx];  // maxval
-        mask[idx] = 0;  // maxid
-      } else {
-        top_data[idx] = bottom_data_b[idx];  // maxval
-        mask[idx] = 1;  // maxid
+  vector<const Dtype*> bottom_data(bottom.size());
+  for (int i = 0; i < bottom.size(); ++i) {
+    bottom_data[i] = bottom[i]->cpu_data();
+  }
+  int* mask = op_ == EltwiseParameter_EltwiseOp_MAX ?
+      max_idx_.mutable_cpu_data() : NULL;
+  // Every element is independent, so the blobs are split into runs.
+  parallel_for(count, kParallelGrain, [&](int begin, int end) {
+    const int len = end - begin;
+    Dtype* top_run = top_data + begin;
+    switch (op_) {
+    case EltwiseParameter_EltwiseOp_PROD:
+      caffe_mul(len, bottom_data[0] + begin, bottom_data[1] + begin, top_run);
+      for (int i = 2; i < bottom.size(); ++i) {
+        caffe_mul(len, top_run, bottom_data[i] + begin, top_run);
       }
-    }
-    // bottom 2++
-    for (int blob_idx = 2; blob_idx < bottom.size(); ++blob_idx) {
-      bottom_data_b = bottom[blob_idx]->cpu_data();
-      for (int idx = 0; idx < count; ++idx) {
-        if (bottom_data_b[idx] > top_data[idx]) {
-          top_data[idx] = bottom_data_b[idx];  // maxval
-          mask[idx] = blob_idx;  // maxid
+      break;
+    case EltwiseParameter_EltwiseOp_SUM:
+      caffe_set(len, Dtype(0), top_run);
+      // TODO(shelhamer) does BLAS optimize to sum for coeff = 1?
+      for (int i = 0; i < bottom.size(); ++i) {
+        caffe_axpy(len, coeffs_[i], bottom_data[i] + begin, top_run);
+      }
+      break;
+    case EltwiseParameter_EltwiseOp_MAX:
+      // bottom 0 & 1
+      for (int idx = begin; idx < end; ++idx) {
+        if (caffe_to_float(bottom_data[0][idx]) >
+            caffe_to_float(bottom_data[1][idx])) {
+          top_data[idx] = bottom_data[0][idx];  // maxval
+          mask[idx] = 0;  // maxid
+        } else {
+          top_data[idx] = bottom_data[1][idx];  // maxval
+          mask[idx] = 1;  // maxid
         }
       }
+      // bottom 2++
+      for (int blob_idx = 2; blob_idx < bottom.size(); ++blob_idx) {
+        const Dtype* bottom_data_b = bottom_data[blob_idx];
+        for (int idx = begin; idx < end; ++idx) {
+          if (caffe_to_float(bottom_data_b[idx]) >
+              caffe_to_float(top_data[idx])) {
+            top_data[idx] = bottom_data_b[idx];  // maxval
+            mask[idx] = blob_idx;  // maxid
+          }
+        }
+      }
+      break;
+    default:
+      LOG(FATAL) << "Unknown elementwise operation.";
     }
-    break;
-  default:
-    LOG(FATAL) << "Unknown elementwise operation.";
-  }
+  });
 }
 
 
@@ -113,7 +118,6 @@ void EltwiseLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_data_b = NULL;
   int blob_idx = 0;
   size_t global_size = 0;
-  cl_int ret;
   cl_kernel kernel;
 
   const int count = top[0]->count();
@@ -141,8 +145,7 @@ void EltwiseLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
     bottom_data_b = bottom[1]->gpu_data();
     blob_idx = 0;
 
-    kernel = clCreateKernel(Caffe::Get().math_program, "MaxForward", &ret);
-    OPENCL_CHECK(ret);
+    kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "MaxForward");
 
     // Set arguments for kernel
     OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&bottom_data_a));  
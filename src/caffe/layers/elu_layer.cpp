@@ -2,6 +2,8 @@
 #include <vector>
 
 #include "caffe/layers/elu_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -11,11 +13,26 @@ void ELULayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
-  Dtype alpha = this->layer_param_.elu_param().alpha();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = std::max(bottom_data[i], Dtype(0))
-        + alpha * (exp(std::min(bottom_data[i], Dtype(0))) - Dtype(1));
-  }
+  float alpha = this->layer_param_.elu_param().alpha();
+  // A block at a time: the negative parts through caffe_exp, then the rest.
+  // The layer may run in place, so the inputs are kept aside.
+  const int kBlock = 1024;
+  parallel_for(count, kParallelGrain, [&](int begin, int end) {
+    float x[kBlock];
+    float y[kBlock];
+    for (int i = begin; i < end; i += kBlock) {
+      const int len = std::min(kBlock, end - i);
+      for (int j = 0; j < len; ++j) {
+        x[j] = caffe_to_float(bottom_data[i + j]);
+        y[j] = std::min(x[j], 0.f);
+      }
+      caffe_exp(len, y, y);
+      for (int j = 0; j < len; ++j) {
+        top_data[i + j] = caffe_from_float<Dtype>(std::max(x[j], 0.f)
+            + alpha * (y[j] - 1.f));
+      }
+    }
+  });
 }
 
 #ifdef CPU_ONLY
@@ -31,10 +48,7 @@ void ELULayer<half>::Forward_gpu(const vector<Blob<half>*>& bottom,
   const int count = bottom[0]->count();
   half alpha = this->layer_param_.elu_param().alpha();
 
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "ELUForward", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "ELUForward");
 
   // Set arguments for kernel
   half_b alpha_half = float2half_impl(alpha);
@@ -59,10 +73,7 @@ void ELULayer<float>::Forward_gpu(const vector<Blob<float>*>& bottom,
   const int count = bottom[0]->count();
   float alpha = this->layer_param_.elu_param().alpha();
 
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "ELUForward", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "ELUForward");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&bottom_data));  
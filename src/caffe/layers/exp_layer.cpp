@@ -2,6 +2,7 @@
 
 #include "caffe/layers/exp_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -33,15 +34,19 @@ void ExpLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const int count = bottom[0]->count();
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  if (inner_scale_ == Dtype(1)) {
-    caffe_exp(count, bottom_data, top_data);
-  } else {
-    caffe_cpu_scale(count, inner_scale_, bottom_data, top_data);
-    caffe_exp(count, top_data, top_data);
-  }
-  if (outer_scale_ != Dtype(1)) {
-    caffe_scal(count, outer_scale_, top_data);
-  }
+  parallel_for(count, kParallelGrain, [&](int begin, int end) {
+    const int len = end - begin;
+    Dtype* top_run = top_data + begin;
+    if (inner_scale_ == Dtype(1)) {
+      caffe_exp(len, bottom_data + begin, top_run);
+    } else {
+      caffe_cpu_scale(len, inner_scale_, bottom_data + begin, top_run);
+      caffe_exp(len, top_run, top_run);
+    }
+    if (outer_scale_ != Dtype(1)) {
+      caffe_scal(len, outer_scale_, top_run);
+    }
+  });
 }
 
 
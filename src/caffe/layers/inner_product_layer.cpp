@@ -2,7 +2,9 @@
 
 #include "caffe/filler.hpp"
 #include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/util/int8_gemm.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/opencl_kernel.hpp"
 
 namespace caffe {
 
@@ -80,15 +82,47 @@ void InnerProductLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+template <typename Dtype>
+InnerProductLayer<Dtype>::~InnerProductLayer() {
+  if (int8_program_) {
+    Caffe::Get().release_program(int8_program_);
+  }
+}
+
+template <typename Dtype>
+void InnerProductLayer<Dtype>::quantize_int8_weights() {
+  int8_weights_.resize(N_ * int8_padded_size(K_));
+  int8_weight_scales_.resize(N_);
+  int8_quantize_weights(N_, K_, this->blobs_[0]->cpu_data(), transpose_,
+      &int8_weights_[0], &int8_weight_scales_[0]);
+  int8_weights_stale_ = false;
+  int8_weights_gpu_.reset();
+  int8_weight_scales_gpu_.reset();
+}
+
 template <typename Dtype>
 void InnerProductLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const Dtype* weight = this->blobs_[0]->cpu_data();
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, transpose_ ? CblasNoTrans : CblasTrans,
-      M_, N_, K_, (Dtype)1.,
-      bottom_data, weight, (Dtype)0., top_data);
+  if (this->layer_param_.has_quantization_param()) {
+    if (int8_weights_stale_) {
+      quantize_int8_weights();
+    }
+    // The M_ inputs are the columns of the int8 product, which computes
+    // top transposed.
+    const float scale =
+        int8_scale(this->layer_param_.quantization_param().input_range());
+    int8_input_.resize(int8_padded_size(K_) * M_);
+    int8_quantize_columns(K_, M_, bottom_data, 1, K_, scale, &int8_input_[0]);
+    int8_gemm(N_, M_, K_, &int8_weights_[0], &int8_weight_scales_[0],
+        &int8_input_[0], scale, top_data, 1, N_);
+  } else {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans,
+        transpose_ ? CblasNoTrans : CblasTrans, M_, N_, K_, (Dtype)1.,
+        bottom_data, weight, (Dtype)0., top_data);
+  }
   if (bias_term_) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, N_, 1, (Dtype)1.,
         bias_multiplier_.cpu_data(),
@@ -109,6 +143,10 @@ void InnerProductLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
  
   const Dtype* bottom_data = bottom[0]->gpu_data();
   Dtype* top_data = top[0]->mutable_gpu_data();
+  if (this->layer_param_.has_quantization_param()) {
+    forward_gpu_int8(bottom_data, top_data);
+    return;
+  }
   const Dtype* weight = this->blobs_[0]->gpu_data();
   if (M_ == 1) {
     caffe_gpu_gemv<Dtype>(CblasNoTrans, N_, K_, (float)1.,
@@ -130,6 +168,82 @@ void InnerProductLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
 
 }
 
+template <typename Dtype>
+void InnerProductLayer<Dtype>::forward_gpu_int8(const Dtype* bottom_data,
+    Dtype* top_data) {
+  if (!int8_program_) {
+    std::stringstream ss;
+    ss << generate_opencl_defs(!std::is_same<Dtype, float>::value);
+    ss << generate_opencl_int8_helpers();
+    ss << generate_opencl_int8_gemm();
+    Caffe::Get().build_opencl_program(ss.str(), int8_program_);
+  }
+  if (int8_weights_stale_) {
+    quantize_int8_weights();
+  }
+  // Only the int8 weights go to the device, not the float ones.
+  if (!int8_weights_gpu_) {
+    int8_weights_gpu_.reset(new SyncedMemory(int8_weights_.size()));
+    memcpy(int8_weights_gpu_->mutable_cpu_data(), &int8_weights_[0],
+        int8_weights_.size());
+    int8_weight_scales_gpu_.reset(new SyncedMemory(N_ * sizeof(float)));
+    memcpy(int8_weight_scales_gpu_->mutable_cpu_data(),
+        &int8_weight_scales_[0], N_ * sizeof(float));
+  }
+  const int K4 = int8_padded_size(K_);
+  const size_t input_size = static_cast<size_t>(M_) * K4;
+  if (!int8_input_gpu_ || int8_input_gpu_->size() != input_size) {
+    int8_input_gpu_.reset(new SyncedMemory(input_size));
+  }
+  const float scale =
+      int8_scale(this->layer_param_.quantization_param().input_range());
+  const float inverse = scale > 0 ? 1.f / scale : 0.f;
+
+  cl_kernel quantize_kernel =
+      Caffe::Get().get_kernel(int8_program_, "int8_quantize_rows");
+  cl_kernel gemm_kernel =
+      Caffe::Get().get_kernel(int8_program_, "int8_gemm_rows");
+  void* input = int8_input_gpu_->mutable_gpu_data();
+  const void* weights = int8_weights_gpu_->gpu_data();
+  const void* weight_scales = int8_weight_scales_gpu_->gpu_data();
+  const void* bias = bias_term_ ? this->blobs_[1]->gpu_data() : NULL;
+  const int kItemsPerGroup = 64;
+  size_t local_size[2] = { kItemsPerGroup, 1 };
+  size_t global_size[2];
+  global_size[1] = static_cast<size_t>(M_);
+
+  OPENCL_CHECK(clSetKernelArg(quantize_kernel, 0, sizeof(cl_mem),
+      (void *)&bottom_data));
+  OPENCL_CHECK(clSetKernelArg(quantize_kernel, 1, sizeof(cl_mem),
+      (void *)&input));
+  OPENCL_CHECK(clSetKernelArg(quantize_kernel, 2, sizeof(int), (void *)&M_));
+  OPENCL_CHECK(clSetKernelArg(quantize_kernel, 3, sizeof(int), (void *)&K_));
+  OPENCL_CHECK(clSetKernelArg(quantize_kernel, 4, sizeof(int), (void *)&K4));
+  OPENCL_CHECK(clSetKernelArg(quantize_kernel, 5, sizeof(float),
+      (void *)&inverse));
+  global_size[0] = static_cast<size_t>(
+      ((K4 - 1) / kItemsPerGroup + 1) * kItemsPerGroup);
+  OPENCL_CHECK(clEnqueueNDRangeKernel(Caffe::Get().commandQueue,
+      quantize_kernel, 2, NULL, global_size, local_size, 0, NULL, NULL));
+
+  OPENCL_CHECK(clSetKernelArg(gemm_kernel, 0, sizeof(cl_mem),
+      (void *)&input));
+  OPENCL_CHECK(clSetKernelArg(gemm_kernel, 1, sizeof(cl_mem),
+      (void *)&weights));
+  OPENCL_CHECK(clSetKernelArg(gemm_kernel, 2, sizeof(cl_mem),
+      (void *)&weight_scales));
+  OPENCL_CHECK(clSetKernelArg(gemm_kernel, 3, sizeof(cl_mem),
+      (void *)&top_data));
+  OPENCL_CHECK(clSetKernelArg(gemm_kernel, 4, sizeof(cl_mem), (void *)&bias));
+  OPENCL_CHECK(clSetKernelArg(gemm_kernel, 5, sizeof(int), (void *)&N_));
+  OPENCL_CHECK(clSetKernelArg(gemm_kernel, 6, sizeof(int), (void *)&K4));
+  OPENCL_CHECK(clSetKernelArg(gemm_kernel, 7, sizeof(float), (void *)&scale));
+  global_size[0] = static_cast<size_t>(
+      ((N_ - 1) / kItemsPerGroup + 1) * kItemsPerGroup);
+  OPENCL_CHECK(clEnqueueNDRangeKernel(Caffe::Get().commandQueue, gemm_kernel,
+      2, NULL, global_size, local_size, 0, NULL, NULL));
+}
+
 
 
 
@@ -2,6 +2,7 @@
 
 #include "caffe/layers/log_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -36,21 +37,25 @@ void LogLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const int count = bottom[0]->count();
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  if (input_scale_ == Dtype(1) && input_shift_ == Dtype(0)) {
-    caffe_log(count, bottom_data, top_data);
-  } else {
-    caffe_copy(count, bottom_data, top_data);
-    if (input_scale_ != Dtype(1)) {
-      caffe_scal(count, input_scale_, top_data);
+  parallel_for(count, kParallelGrain, [&](int begin, int end) {
+    const int len = end - begin;
+    Dtype* top_run = top_data + begin;
+    if (input_scale_ == Dtype(1) && input_shift_ == Dtype(0)) {
+      caffe_log(len, bottom_data + begin, top_run);
+    } else {
+      caffe_copy(len, bottom_data + begin, top_run);
+      if (input_scale_ != Dtype(1)) {
+        caffe_scal(len, input_scale_, top_run);
+      }
+      if (input_shift_ != Dtype(0)) {
+        caffe_add_scalar(len, input_shift_, top_run);
+      }
+      caffe_log(len, top_run, top_run);
     }
-    if (input_shift_ != Dtype(0)) {
-      caffe_add_scalar(count, input_shift_, top_data);
+    if (base_scale_ != Dtype(1)) {
+      caffe_scal(len, base_scale_, top_run);
     }
-    caffe_log(count, top_data, top_data);
-  }
-  if (base_scale_ != Dtype(1)) {
-    caffe_scal(count, base_scale_, top_data);
-  }
+  });
 }
 
 
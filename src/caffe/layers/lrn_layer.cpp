@@ -1,7 +1,9 @@
+#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/lrn_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -111,44 +113,54 @@ void LRNLayer<Dtype>::CrossChannelForward_cpu(
   Dtype* top_data = top[0]->mutable_cpu_data();
   Dtype* scale_data = scale_.mutable_cpu_data();
   // start with the constant value
-  for (int i = 0; i < scale_.count(); ++i) {
-    scale_data[i] = k_;
-  }
+  caffe_set(scale_.count(), k_, scale_data);
   Blob<Dtype> padded_square(1, channels_ + size_ - 1, height_, width_);
   Dtype* padded_square_data = padded_square.mutable_cpu_data();
   caffe_set(padded_square.count(), Dtype(0), padded_square_data);
-  Dtype alpha_over_size = alpha_ / size_;
-  // go through the images
+  float alpha_over_size = alpha_ / size_;
+  const int spatial_dim = height_ * width_;
+  const int grain = std::max(1, kParallelGrain / channels_);
+  // go through the images, each split into independent runs of pixels
   for (int n = 0; n < num_; ++n) {
-    // compute the padded square
-    caffe_sqr(channels_ * height_ * width_,
-        bottom_data + bottom[0]->offset(n),
-        padded_square_data + padded_square.offset(0, pre_pad_));
-    // Create the first channel scale
-    for (int c = 0; c < size_; ++c) {
-      caffe_axpy<Dtype>(height_ * width_, alpha_over_size,
-          padded_square_data + padded_square.offset(0, c),
-          scale_data + scale_.offset(n, 0));
-    }
-    for (int c = 1; c < channels_; ++c) {
-      // copy previous scale
-      caffe_copy<Dtype>(height_ * width_,
-          scale_data + scale_.offset(n, c - 1),
-          scale_data + scale_.offset(n, c));
-      // add head
-      caffe_axpy<Dtype>(height_ * width_, alpha_over_size,
-          padded_square_data + padded_square.offset(0, c + size_ - 1),
-          scale_data + scale_.offset(n, c));
-      // subtract tail
-      caffe_axpy<Dtype>(height_ * width_, -alpha_over_size,
-          padded_square_data + padded_square.offset(0, c - 1),
-          scale_data + scale_.offset(n, c));
-    }
+    const Dtype* bottom_n = bottom_data + bottom[0]->offset(n);
+    Dtype* scale_n = scale_data + scale_.offset(n);
+    Dtype* top_n = top_data + top[0]->offset(n);
+    parallel_for(spatial_dim, grain, [&](int begin, int end) {
+      const int len = end - begin;
+      // compute the padded square
+      for (int c = 0; c < channels_; ++c) {
+        caffe_sqr(len, bottom_n + c * spatial_dim + begin,
+            padded_square_data + padded_square.offset(0, pre_pad_ + c) +
+            begin);
+      }
+      // Create the first channel scale
+      for (int c = 0; c < size_; ++c) {
+        caffe_axpy<Dtype>(len, alpha_over_size,
+            padded_square_data + padded_square.offset(0, c) + begin,
+            scale_n + begin);
+      }
+      for (int c = 1; c < channels_; ++c) {
+        Dtype* scale_c = scale_n + c * spatial_dim + begin;
+        // copy previous scale
+        caffe_copy<Dtype>(len, scale_c - spatial_dim, scale_c);
+        // add head
+        caffe_axpy<Dtype>(len, alpha_over_size,
+            padded_square_data + padded_square.offset(0, c + size_ - 1) +
+            begin, scale_c);
+        // subtract tail
+        caffe_axpy<Dtype>(len, -alpha_over_size,
+            padded_square_data + padded_square.offset(0, c - 1) + begin,
+            scale_c);
+      }
+      // In the end, compute output
+      for (int c = 0; c < channels_; ++c) {
+        const int offset = c * spatial_dim + begin;
+        caffe_powx<Dtype>(len, scale_n + offset, -beta_, top_n + offset);
+        caffe_mul<Dtype>(len, top_n + offset, bottom_n + offset,
+            top_n + offset);
+      }
+    });
   }
-
-  // In the end, compute output
-  caffe_powx<Dtype>(scale_.count(), scale_data, -beta_, top_data);
-  caffe_mul<Dtype>(scale_.count(), top_data, bottom_data, top_data);
 }
 
 template <typename Dtype>
@@ -196,10 +208,7 @@ void LRNLayer<float>::CrossChannelForward_gpu(
   int n_threads = num_ * height_ * width_;
   // NOLINT_NEXT_LINE(whitespace/operators)
 
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "LRNFillScale", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "LRNFillScale");
 
   // Set arguments for kernel
 
@@ -222,8 +231,7 @@ void LRNLayer<float>::CrossChannelForward_gpu(
 
   n_threads = bottom[0]->count();
 
-  kernel = clCreateKernel(Caffe::Get().math_program, "LRNComputeOutput", &ret);
-  OPENCL_CHECK(ret);
+  kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "LRNComputeOutput");
 
   float negative_beta = -beta_;
 
@@ -252,10 +260,7 @@ void LRNLayer<half>::CrossChannelForward_gpu(
   int n_threads = num_ * height_ * width_;
   // NOLINT_NEXT_LINE(whitespace/operators)
 
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "LRNFillScale", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "LRNFillScale");
 
   // Set arguments for kernel
 
@@ -279,8 +284,7 @@ void LRNLayer<half>::CrossChannelForward_gpu(
 
   n_threads = bottom[0]->count();
 
-  kernel = clCreateKernel(Caffe::Get().math_program, "LRNComputeOutput", &ret);
-  OPENCL_CHECK(ret);
+  kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "LRNComputeOutput");
 
   half negative_beta = float2half_impl(-beta_);
 
@@ -4,6 +4,8 @@
 
 #include "caffe/layers/pooling_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/pooling.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -122,34 +124,45 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
-// TODO(Yangqing): Is there a faster way to do pooling in the channel-first
-// case?
 template <typename Dtype>
 void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  const int top_count = top[0]->count();
   // We'll output the mask to top[1] if it's of size >1.
   const bool use_top_mask = top.size() > 1;
-  int* mask = NULL;  // suppress warnings about uninitalized variables
   Dtype* top_mask = NULL;
+  const int num_planes = bottom[0]->num() * channels_;
+  const int bottom_plane_size = height_ * width_;
+  const int top_plane_size = pooled_height_ * pooled_width_;
+  const int grain = max(1, kParallelGrain / bottom_plane_size);
+  const int buffer_size = pooling_buffer_size(height_, width_,
+      pooled_width_);
   // Different pooling methods. We explicitly do the switch outside the for
-  // loop to save time, although this results in more code.
+  // loop to save time, although this results in more code. The planes are
+  // pooled in parallel, with the separable kernels of pooling.hpp unless
+  // the argmax is asked for; nothing reads max_idx_ on the CPU.
   switch (this->layer_param_.pooling_param().pool()) {
   case PoolingParameter_PoolMethod_MAX:
-    // Initialize
-    if (use_top_mask) {
-      top_mask = top[1]->mutable_cpu_data();
-      caffe_set(top_count, Dtype(-1), top_mask);
-    } else {
-      mask = max_idx_.mutable_cpu_data();
-      caffe_set(top_count, -1, mask);
+    if (!use_top_mask) {
+      parallel_for(num_planes, grain, [&](int begin, int end) {
+        vector<float> buffer(buffer_size);
+        for (int plane = begin; plane < end; ++plane) {
+          max_pool_cpu(bottom_data + plane * bottom_plane_size, height_,
+              width_, kernel_h_, kernel_w_, pad_h_, pad_w_, stride_h_,
+              stride_w_, pooled_height_, pooled_width_, &buffer[0],
+              top_data + plane * top_plane_size);
+        }
+      });
+      break;
     }
-    caffe_set(top_count, Dtype(-FLT_MAX), top_data);
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
+    // Every output and mask element is written below; values are compared
+    // in float whatever the storage type.
+    top_mask = top[1]->mutable_cpu_data();
+    parallel_for(num_planes, grain, [&](int begin, int end) {
+      for (int plane = begin; plane < end; ++plane) {
+        const Dtype* bottom_plane = bottom_data + plane * bottom_plane_size;
+        const int top_offset = plane * top_plane_size;
         for (int ph = 0; ph < pooled_height_; ++ph) {
           for (int pw = 0; pw < pooled_width_; ++pw) {
             int hstart = ph * stride_h_ - pad_h_;
@@ -158,65 +171,36 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
             int wend = min(wstart + kernel_w_, width_);
             hstart = max(hstart, 0);
             wstart = max(wstart, 0);
-            const int pool_index = ph * pooled_width_ + pw;
+            const int pool_index = top_offset + ph * pooled_width_ + pw;
+            float maxval = -FLT_MAX;
+            int maxidx = -1;
             for (int h = hstart; h < hend; ++h) {
               for (int w = wstart; w < wend; ++w) {
                 const int index = h * width_ + w;
-                if (bottom_data[index] > top_data[pool_index]) {
-                  top_data[pool_index] = bottom_data[index];
-                  if (use_top_mask) {
-                    top_mask[pool_index] = static_cast<Dtype>(index);
-                  } else {
-                    mask[pool_index] = index;
-                  }
+                const float value = caffe_to_float(bottom_plane[index]);
+                if (value > maxval) {
+                  maxval = value;
+                  maxidx = index;
                 }
               }
             }
+            top_data[pool_index] = caffe_from_float<Dtype>(maxval);
+            top_mask[pool_index] = caffe_from_float<Dtype>(maxidx);
           }
         }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
-        if (use_top_mask) {
-          top_mask += top[0]->offset(0, 1);
-        } else {
-          mask += top[0]->offset(0, 1);
-        }
       }
-    }
+    });
     break;
   case PoolingParameter_PoolMethod_AVE:
-    for (int i = 0; i < top_count; ++i) {
-      top_data[i] = 0;
-    }
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_ + pad_h_);
-            int wend = min(wstart + kernel_w_, width_ + pad_w_);
-            int pool_size = (hend - hstart) * (wend - wstart);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            hend = min(hend, height_);
-            wend = min(wend, width_);
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                top_data[ph * pooled_width_ + pw] +=
-                    bottom_data[h * width_ + w];
-              }
-            }
-            top_data[ph * pooled_width_ + pw] /= pool_size;
-          }
-        }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
+    parallel_for(num_planes, grain, [&](int begin, int end) {
+      vector<float> buffer(buffer_size);
+      for (int plane = begin; plane < end; ++plane) {
+        ave_pool_cpu(bottom_data + plane * bottom_plane_size, height_,
+            width_, kernel_h_, kernel_w_, pad_h_, pad_w_, stride_h_,
+            stride_w_, pooled_height_, pooled_width_, &buffer[0],
+            top_data + plane * top_plane_size);
       }
-    }
+    });
     break;
   case PoolingParameter_PoolMethod_STOCHASTIC:
     NOT_IMPLEMENTED;
@@ -262,9 +246,7 @@ const Dtype* bottom_data = bottom[0]->gpu_data();
     LOG(FATAL) << "Unknown pooling method.";
   }
 
-  cl_int ret;
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, kernel_string.c_str(), &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, kernel_string);
 
   int bottom_num = bottom[0]->num();
 
@@ -2,6 +2,7 @@
 
 #include "caffe/layers/power_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -28,16 +29,20 @@ void PowerLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     return;
   }
   const Dtype* bottom_data = bottom[0]->cpu_data();
-  caffe_copy(count, bottom_data, top_data);
-  if (scale_ != float(1)) {
-    caffe_scal(count, scale_, top_data);
-  }
-  if (shift_ != float(0)) {
-    caffe_add_scalar(count, shift_, top_data);
-  }
-  if (power_ != float(1)) {
-    caffe_powx(count, top_data, power_, top_data);
-  }
+  parallel_for(count, kParallelGrain, [&](int begin, int end) {
+    const int len = end - begin;
+    Dtype* top_run = top_data + begin;
+    caffe_copy(len, bottom_data + begin, top_run);
+    if (scale_ != float(1)) {
+      caffe_scal(len, scale_, top_run);
+    }
+    if (shift_ != float(0)) {
+      caffe_add_scalar(len, shift_, top_run);
+    }
+    if (power_ != float(1)) {
+      caffe_powx(len, top_run, power_, top_run);
+    }
+  });
 }
 
 #ifdef CPU_ONLY
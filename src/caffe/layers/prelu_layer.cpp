@@ -5,6 +5,7 @@
 
 #include "caffe/layers/neuron_layer.hpp"
 #include "caffe/layers/prelu_layer.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -81,11 +82,14 @@ void PReLULayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   // if channel_shared, channel index in the following computation becomes
   // always zero.
   const int div_factor = channel_shared_ ? channels : 1;
-  for (int i = 0; i < count; ++i) {
-    int c = (i / dim) % channels / div_factor;
-    top_data[i] = std::max(bottom_data[i], Dtype(0))
-        + slope_data[c] * std::min(bottom_data[i], Dtype(0));
-  }
+  parallel_for(count, kParallelGrain, [&](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      int c = (i / dim) % channels / div_factor;
+      const float x = caffe_to_float(bottom_data[i]);
+      top_data[i] = caffe_from_float<Dtype>(std::max(x, 0.f)
+          + caffe_to_float(slope_data[c]) * std::min(x, 0.f));
+    }
+  });
 }
 
 
@@ -116,10 +120,7 @@ void PReLULayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
 #endif
 
 
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "PReLUForward", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "PReLUForward");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&bottom_data));  
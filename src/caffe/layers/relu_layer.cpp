@@ -2,6 +2,7 @@
 #include <vector>
 
 #include "caffe/layers/relu_layer.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -11,11 +12,14 @@ void ReLULayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
-  Dtype negative_slope = this->layer_param_.relu_param().negative_slope();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = std::max(bottom_data[i], Dtype(0))
-        + negative_slope * std::min(bottom_data[i], Dtype(0));
-  }
+  float negative_slope = this->layer_param_.relu_param().negative_slope();
+  parallel_for(count, kParallelGrain, [&](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      const float x = caffe_to_float(bottom_data[i]);
+      top_data[i] = caffe_from_float<Dtype>(std::max(x, 0.f)
+          + negative_slope * std::min(x, 0.f));
+    }
+  });
 }
 
 
@@ -29,10 +33,7 @@ void ReLULayer<float>::Forward_gpu(const vector<Blob<float>*>& bottom,
   const int count = bottom[0]->count();
   float negative_slope = this->layer_param_.relu_param().negative_slope();
 
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "ReLUForward", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "ReLUForward");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&bottom_data));  
@@ -55,10 +56,7 @@ void ReLULayer<half>::Forward_gpu(const vector<Blob<half>*>& bottom,
   const int count = bottom[0]->count();
   half negative_slope = this->layer_param_.relu_param().negative_slope();
 
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "ReLUForward", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "ReLUForward");
 
   // Set arguments for kernel
   half_b negative_slope_half = float2half_impl(negative_slope);
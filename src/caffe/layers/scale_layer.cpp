@@ -130,7 +130,7 @@ void ScaleLayer<Dtype>::Forward_cpu(
   Dtype* top_data = top[0]->mutable_cpu_data();
   for (int n = 0; n < outer_dim_; ++n) {
     for (int d = 0; d < scale_dim_; ++d) {
-      const Dtype factor = scale_data[d];
+      const float factor = caffe_to_float(scale_data[d]);
       caffe_cpu_scale(inner_dim_, factor, bottom_data, top_data);
       bottom_data += inner_dim_;
       top_data += inner_dim_;
@@ -174,11 +174,8 @@ void ScaleLayer<Dtype>::Forward_gpu(
   Dtype* top_data = top[0]->mutable_gpu_data();
   if (bias_layer_) {
     const Dtype* bias_data = this->blobs_[bias_param_id_]->gpu_data();
-    
-    cl_int ret;
 
-    cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "ScaleBiasForward", &ret);
-    OPENCL_CHECK(ret);
+    cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "ScaleBiasForward");
 
     // Set arguments for kernel
     OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&bottom_data));  
@@ -197,10 +194,7 @@ void ScaleLayer<Dtype>::Forward_gpu(
   } else {
 
 
-    cl_int ret;
-
-    cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "ScaleForward", &ret);
-    OPENCL_CHECK(ret);
+    cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "ScaleForward");
 
     // Set arguments for kernel
     OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&bottom_data));  
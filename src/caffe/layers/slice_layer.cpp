@@ -72,16 +72,43 @@ void SliceLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+template <typename Dtype>
+int SliceLayer<Dtype>::TopDataViewOffset(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top, const int top_id) const {
+  if (top.size() == 1 || num_slices_ != 1) { return -1; }
+  int offset = 0;
+  for (int i = 0; i < top_id; ++i) {
+    offset += top[i]->count();
+  }
+  return offset;
+}
+
 template <typename Dtype>
 void SliceLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   if (top.size() == 1) { return; }
+  // Tops the net made views of their part of bottom need no copy. A view a
+  // reshape left at another offset gets storage of its own before anything
+  // is written to it.
+  vector<bool> in_place(top.size());
+  for (int i = 0; i < top.size(); ++i) {
+    const int view_offset = TopDataViewOffset(bottom, top, i);
+    in_place[i] = view_offset >= 0 &&
+        top[i]->IsDataViewOf(*bottom[0], view_offset);
+    if (!in_place[i] && top[i]->data() == bottom[0]->data()) {
+      top[i]->DetachDataView();
+    }
+  }
   int offset_slice_axis = 0;
   const Dtype* bottom_data = bottom[0]->cpu_data();
   const int bottom_slice_axis = bottom[0]->shape(slice_axis_);
   for (int i = 0; i < top.size(); ++i) {
-    Dtype* top_data = top[i]->mutable_cpu_data();
     const int top_slice_axis = top[i]->shape(slice_axis_);
+    if (in_place[i]) {
+      offset_slice_axis += top_slice_axis;
+      continue;
+    }
+    Dtype* top_data = top[i]->mutable_cpu_data();
     for (int n = 0; n < num_slices_; ++n) {
       const int top_offset = n * top_slice_axis * slice_size_;
       const int bottom_offset =
@@ -112,10 +139,7 @@ void SliceLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
   const int bottom_slice_axis = bottom[0]->shape(slice_axis_);
 
 
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "Slice", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "Slice");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&bottom_data)); 
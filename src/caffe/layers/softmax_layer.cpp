@@ -1,26 +1,73 @@
 #include <algorithm>
+#include <cfloat>
 #include <vector>
 
 #include "caffe/layers/softmax_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/math_kernels.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+namespace {
+
+// The number of floats a block of the softmax works on, sized to stay in
+// the L2 cache between its passes.
+const int kSoftmaxBlock = 1 << 14;
+
+// The softmax of a contiguous row of channels.
+template <typename Dtype>
+void softmax_row(const Dtype* input, const int channels, float* buffer,
+    Dtype* output) {
+  const MathKernels& kernels = math_kernels();
+  caffe_to_float(channels, input, buffer);
+  kernels.add_scalar(channels, -kernels.max(channels, buffer), buffer);
+  transcendental_math_kernels().exp(channels, buffer, buffer);
+  kernels.scale(channels, 1 / kernels.sum(channels, buffer), buffer, buffer);
+  caffe_from_float(channels, buffer, output);
+}
+
+// The softmax over the channels of columns [begin, end) of a channels x
+// inner plane. The block is read once into the buffer, its elementwise
+// max taken over the channels, exp(x - max) summed, and each channel
+// divided by the sum on the way out.
+template <typename Dtype>
+void softmax_columns(const Dtype* input, const int channels, const int inner,
+    const int begin, const int end, float* buffer, Dtype* output) {
+  const MathKernels& kernels = math_kernels();
+  const int n = end - begin;
+  float* max = buffer + channels * n;
+  float* sum = max + n;
+  kernels.set(n, -FLT_MAX, max);
+  for (int c = 0; c < channels; ++c) {
+    float* row = buffer + c * n;
+    caffe_to_float(n, input + c * inner + begin, row);
+    kernels.maximum(n, row, max, max);
+  }
+  kernels.set(n, 0, sum);
+  for (int c = 0; c < channels; ++c) {
+    float* row = buffer + c * n;
+    kernels.sub(n, row, max, row);
+    transcendental_math_kernels().exp(n, row, row);
+    kernels.add(n, row, sum, sum);
+  }
+  for (int c = 0; c < channels; ++c) {
+    float* row = buffer + c * n;
+    kernels.div(n, row, sum, row);
+    caffe_from_float(n, row, output + c * inner + begin);
+  }
+}
+
+}  // namespace
+
 template <typename Dtype>
 void SoftmaxLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   softmax_axis_ =
       bottom[0]->CanonicalAxisIndex(this->layer_param_.softmax_param().axis());
   top[0]->ReshapeLike(*bottom[0]);
-  vector<int> mult_dims(1, bottom[0]->shape(softmax_axis_));
-  sum_multiplier_.Reshape(mult_dims);
-  Dtype* multiplier_data = sum_multiplier_.mutable_cpu_data();
-  caffe_set(sum_multiplier_.count(), Dtype(1), multiplier_data);
   outer_num_ = bottom[0]->count(0, softmax_axis_);
   inner_num_ = bottom[0]->count(softmax_axis_ + 1);
-  vector<int> scale_dims = bottom[0]->shape();
-  scale_dims[softmax_axis_] = 1;
-  scale_.Reshape(scale_dims);
 }
 
 template <typename Dtype>
@@ -28,35 +75,35 @@ void SoftmaxLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  Dtype* scale_data = scale_.mutable_cpu_data();
-  int channels = bottom[0]->shape(softmax_axis_);
-  int dim = bottom[0]->count() / outer_num_;
-  caffe_copy(bottom[0]->count(), bottom_data, top_data);
-  // We need to subtract the max to avoid numerical issues, compute the exp,
-  // and then normalize.
-  for (int i = 0; i < outer_num_; ++i) {
-    // initialize scale_data to the first plane
-    caffe_copy(inner_num_, bottom_data + i * dim, scale_data);
-    for (int j = 0; j < channels; j++) {
-      for (int k = 0; k < inner_num_; k++) {
-        scale_data[k] = std::max(scale_data[k],
-            bottom_data[i * dim + j * inner_num_ + k]);
+  const int channels = bottom[0]->shape(softmax_axis_);
+  const int dim = channels * inner_num_;
+  if (inner_num_ == 1) {
+    parallel_for(outer_num_, std::max(kParallelGrain / channels, 1),
+        [&](int begin, int end) {
+      vector<float> buffer(channels);
+      for (int i = begin; i < end; ++i) {
+        softmax_row(bottom_data + i * dim, channels, &buffer[0],
+            top_data + i * dim);
       }
-    }
-    // subtraction
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels, inner_num_,
-        1, -1., sum_multiplier_.cpu_data(), scale_data, 1., top_data);
-    // exponentiation
-    caffe_exp<Dtype>(dim, top_data, top_data);
-    // sum after exp
-    caffe_cpu_gemv<Dtype>(CblasTrans, channels, inner_num_, 1.,
-        top_data, sum_multiplier_.cpu_data(), 0., scale_data);
-    // division
-    for (int j = 0; j < channels; j++) {
-      caffe_div(inner_num_, top_data, scale_data, top_data);
-      top_data += inner_num_;
-    }
+    });
+    return;
   }
+  // Each task is a block of columns of one outer index; blocks read all of
+  // their input before writing, so the softmax may run in place.
+  const int block = std::min(inner_num_,
+      std::max(kSoftmaxBlock / channels, 1));
+  const int num_blocks = (inner_num_ + block - 1) / block;
+  parallel_for(outer_num_ * num_blocks,
+      std::max(kParallelGrain / (channels * block), 1),
+      [&](int begin, int end) {
+    vector<float> buffer((channels + 2) * block);
+    for (int task = begin; task < end; ++task) {
+      const int i = task / num_blocks;
+      const int start = task % num_blocks * block;
+      softmax_columns(bottom_data + i * dim, channels, inner_num_, start,
+          std::min(start + block, inner_num_), &buffer[0], top_data + i * dim);
+    }
+  });
 }
 
 
@@ -70,124 +117,21 @@ void SoftmaxLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->gpu_data();
   Dtype* top_data = top[0]->mutable_gpu_data();
-  Dtype* scale_data = scale_.mutable_gpu_data();
-  int count = bottom[0]->count();
   int channels = top[0]->shape(softmax_axis_);
-  caffe_cl_copy(count, bottom_data, top_data);
-
-
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "kernel_channel_max", &ret);
-  OPENCL_CHECK(ret);
-
-  // Set arguments for kernel
-  OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&top_data));  
-  OPENCL_CHECK(clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *)&scale_data));  
-  OPENCL_CHECK(clSetKernelArg(kernel, 2, sizeof(cl_int), (void *)&outer_num_));  
-  OPENCL_CHECK(clSetKernelArg(kernel, 3, sizeof(cl_int), (void *)&inner_num_));  
-  OPENCL_CHECK(clSetKernelArg(kernel, 4, sizeof(cl_int), (void *)&count));  
-
-  size_t global_size = CAFFE_GET_BLOCKS(outer_num_ * inner_num_);
-  
-  OPENCL_CHECK(clEnqueueNDRangeKernel(Caffe::Get().commandQueue, kernel, 1, NULL, &global_size, &CAFFE_CUDA_NUM_THREADS, 0, NULL, NULL));  
-  
-
-
-  // We need to subtract the max to avoid numerical issues, compute the exp,
-  // and then normalize.
-  // compute max
-  // NOLINT_NEXT_LINE(whitespace/operators)
-
-  // kernel_channel_max<Dtype><<<CAFFE_GET_BLOCKS(outer_num_ * inner_num_),
-  //     CAFFE_CUDA_NUM_THREADS>>>(outer_num_, channels, inner_num_, top_data,
-  //     scale_data);
-  // subtract
-  // NOLINT_NEXT_LINE(whitespace/operators)
-
 
-
-  kernel = clCreateKernel(Caffe::Get().math_program, "kernel_channel_subtract", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "kernel_channel_softmax");
 
   // Set arguments for kernel
-  OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&scale_data));  
+  OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&bottom_data));  
   OPENCL_CHECK(clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *)&top_data));  
-  OPENCL_CHECK(clSetKernelArg(kernel, 2, sizeof(cl_int), (void *)&count));  
-  OPENCL_CHECK(clSetKernelArg(kernel, 3, sizeof(cl_int), (void *)&outer_num_));  
-  OPENCL_CHECK(clSetKernelArg(kernel, 4, sizeof(cl_int), (void *)&channels));  
-  OPENCL_CHECK(clSetKernelArg(kernel, 5, sizeof(cl_int), (void *)&inner_num_));  
-
-  global_size = CAFFE_GET_BLOCKS(count);
-  
-  OPENCL_CHECK(clEnqueueNDRangeKernel(Caffe::Get().commandQueue, kernel, 1, NULL, &global_size, &CAFFE_CUDA_NUM_THREADS, 0, NULL, NULL));  
-  
-  // kernel_channel_subtract<Dtype><<<CAFFE_GET_BLOCKS(count),
-  //     CAFFE_CUDA_NUM_THREADS>>>(count, outer_num_, channels, inner_num_,
-  //     scale_data, top_data);
-  // exponentiate
-  // NOLINT_NEXT_LINE(whitespace/operators)
-
-  kernel = clCreateKernel(Caffe::Get().math_program, "exp_kernel", &ret);
-  OPENCL_CHECK(ret);
-
-  // Set arguments for kernel
-  OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&top_data));  
-  OPENCL_CHECK(clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *)&top_data));  
-  OPENCL_CHECK(clSetKernelArg(kernel, 2, sizeof(cl_int), (void *)&count));  
-
-  global_size = CAFFE_GET_BLOCKS(count);
-  
-  OPENCL_CHECK(clEnqueueNDRangeKernel(Caffe::Get().commandQueue, kernel, 1, NULL, &global_size, &CAFFE_CUDA_NUM_THREADS, 0, NULL, NULL));  
-  
-
-
-  // kernel_exp<Dtype><<<CAFFE_GET_BLOCKS(count), CAFFE_CUDA_NUM_THREADS>>>(
-  //     count, top_data, top_data);
-  // sum after exp
-  // NOLINT_NEXT_LINE(whitespace/operators)
-
-
-  kernel = clCreateKernel(Caffe::Get().math_program, "kernel_channel_sum", &ret);
-  OPENCL_CHECK(ret);
-
-  // Set arguments for kernel
-  OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&top_data));  
-  OPENCL_CHECK(clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *)&scale_data));  
   OPENCL_CHECK(clSetKernelArg(kernel, 2, sizeof(cl_int), (void *)&outer_num_));  
   OPENCL_CHECK(clSetKernelArg(kernel, 3, sizeof(cl_int), (void *)&channels));  
   OPENCL_CHECK(clSetKernelArg(kernel, 4, sizeof(cl_int), (void *)&inner_num_));  
 
-  global_size = CAFFE_GET_BLOCKS(outer_num_ * inner_num_);
-  
-  OPENCL_CHECK(clEnqueueNDRangeKernel(Caffe::Get().commandQueue, kernel, 1, NULL, &global_size, &CAFFE_CUDA_NUM_THREADS, 0, NULL, NULL));  
-  
-
-  // kernel_channel_sum<Dtype><<<CAFFE_GET_BLOCKS(outer_num_ * inner_num_),
-  //     CAFFE_CUDA_NUM_THREADS>>>(outer_num_, channels, inner_num_, top_data,
-  //     scale_data);
-  // divide
-  // NOLINT_NEXT_LINE(whitespace/operators)
-
-
-  kernel = clCreateKernel(Caffe::Get().math_program, "kernel_channel_div", &ret);
-  OPENCL_CHECK(ret);
-
-  // Set arguments for kernel
-  OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&scale_data));  
-  OPENCL_CHECK(clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *)&top_data));  
-  OPENCL_CHECK(clSetKernelArg(kernel, 2, sizeof(cl_int), (void *)&count));  
-  OPENCL_CHECK(clSetKernelArg(kernel, 3, sizeof(cl_int), (void *)&outer_num_));  
-  OPENCL_CHECK(clSetKernelArg(kernel, 4, sizeof(cl_int), (void *)&channels));  
-  OPENCL_CHECK(clSetKernelArg(kernel, 5, sizeof(cl_int), (void *)&inner_num_));  
-
-  global_size = CAFFE_GET_BLOCKS(count);
+  size_t global_size = CAFFE_GET_BLOCKS(outer_num_ * inner_num_);
   
   OPENCL_CHECK(clEnqueueNDRangeKernel(Caffe::Get().commandQueue, kernel, 1, NULL, &global_size, &CAFFE_CUDA_NUM_THREADS, 0, NULL, NULL));  
   
-  // kernel_channel_div<Dtype><<<CAFFE_GET_BLOCKS(count),
-  //     CAFFE_CUDA_NUM_THREADS>>>(count, outer_num_, channels, inner_num_,
-  //     scale_data, top_data);
 }
 
 
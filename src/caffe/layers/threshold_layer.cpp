@@ -1,6 +1,7 @@
 #include <vector>
 
 #include "caffe/layers/threshold_layer.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -17,9 +18,11 @@ void ThresholdLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = (bottom_data[i] > threshold_) ? Dtype(1) : Dtype(0);
-  }
+  parallel_for(count, kParallelGrain, [&](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      top_data[i] = (bottom_data[i] > threshold_) ? Dtype(1) : Dtype(0);
+    }
+  });
 }
 
 #ifdef CPU_ONLY
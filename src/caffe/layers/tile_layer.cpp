@@ -51,10 +51,7 @@ void TileLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
   const int nthreads = top[0]->count();
 
 
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "Tile", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "Tile");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&bottom_data));  
@@ -1,7 +1,9 @@
 #include <algorithm>
+#include <cmath>
 #include <map>
 #include <set>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 #include <ctime>
@@ -22,6 +24,7 @@
 #endif
 #include "caffe/util/insert_splits.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/math_kernels.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 
 
@@ -31,13 +34,13 @@
 namespace caffe {
 
 template <typename Dtype>
-Net<Dtype>::Net(const NetParameter& param) {
+Net<Dtype>::Net(const NetParameter& param) : replica_source_(NULL) {
   Init(param);
 }
 
 template <typename Dtype>
 Net<Dtype>::Net(const string& param_file, Phase phase,
-    const int level, const vector<string>* stages) {
+    const int level, const vector<string>* stages) : replica_source_(NULL) {
   NetParameter param;
 #ifdef USE_PROTOBUF_FULL
   ReadNetParamsFromTextFileOrDie(param_file, &param);
@@ -56,10 +59,55 @@ Net<Dtype>::Net(const string& param_file, Phase phase,
   Init(param);
 }
 
+template <typename Dtype>
+Net<Dtype>::Net(const Net* source) : replica_source_(source) {
+  // The layers of source have already been filtered, split and folded; the
+  // replica only has to connect them again.
+  NetParameter param;
+  param.set_name(source->name_);
+  param.mutable_state()->set_phase(source->phase_);
+  param.set_debug_info(source->debug_info_);
+  param.set_optimize_memory(source->activation_arena_ != NULL);
+  param.set_strict_math(source->strict_math_);
+  param.set_share_data_views(source->share_data_views_);
+  for (int i = 0; i < source->layers_.size(); ++i) {
+    LayerParameter* layer_param = param.add_layer();
+    layer_param->CopyFrom(source->layers_[i]->layer_param());
+    layer_param->clear_blobs();
+    layer_param->clear_include();
+    layer_param->clear_exclude();
+  }
+  // Bring the weights to the device the replicas run on now, so that their
+  // concurrent reads never have to synchronize the shared memory.
+  for (int i = 0; i < source->params_.size(); ++i) {
+    if (Caffe::mode() == Caffe::GPU) {
+      source->params_[i]->gpu_data();
+    } else {
+      source->params_[i]->cpu_data();
+    }
+  }
+  Init(param);
+  replica_source_ = NULL;
+}
+
+template <typename Dtype>
+Net<Dtype>::~Net() {
+#ifdef USE_OPENCL
+  for (int i = 0; i < activation_sub_buffers_.size(); ++i) {
+    OPENCL_CHECK(clReleaseMemObject(activation_sub_buffers_[i]));
+  }
+#endif
+}
+
 template <typename Dtype>
 void Net<Dtype>::Init(const NetParameter& in_param) {
   // Set phase from the state.
   phase_ = in_param.state().phase();
+  activation_memory_ = 0;
+  if (!host_allocator_) {
+    host_allocator_.reset(new SlabAllocator());
+  }
+  HostAllocatorScope allocator_scope(host_allocator_);
   // Filter layers based on their include/exclude rules and
   // the current NetState.
   NetParameter filtered_param;
@@ -82,6 +130,7 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   map<string, int> blob_name_to_idx;
   set<string> available_blobs;
   memory_used_ = 0;
+  workspace_.reset(new Blob<Dtype>());
   // For each layer, set up its input and output
   bottom_vecs_.resize(param.layer_size());
   top_vecs_.resize(param.layer_size());
@@ -105,7 +154,7 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
 
 
     layers_.push_back(LayerRegistry<Dtype>::CreateLayer(layer_param));
-    
+    layers_.back()->set_shared_workspace(workspace_);
 
     layer_names_.push_back(layer_param.name());
     LOG_IF(INFO, Caffe::root_solver())
@@ -144,8 +193,18 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
         AppendTop(param, layer_id, num_top, NULL, NULL);
       }
     }
+    // A replica sets its layers up on the parameters of the source layers,
+    // so that they neither allocate nor fill their own.
+    if (replica_source_) {
+      ShareReplicaParams(layer_id);
+    }
     // After this layer is connected, set it up.
     layers_[layer_id]->SetUp(bottom_vecs_[layer_id], top_vecs_[layer_id]);
+    // Layers that build their parameters anyway (e.g. Recurrent) get them
+    // replaced.
+    if (replica_source_) {
+      ShareReplicaParams(layer_id);
+    }
     
     LOG_IF(INFO, Caffe::root_solver())
         << "Setting up " << layer_names_[layer_id];
@@ -279,10 +338,321 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     layer_names_index_[layer_names_[layer_id]] = layer_id;
   }
   ShareWeights();
+  LOG_IF(INFO, Caffe::root_solver())
+      << "Memory required for shared workspace: "
+      << (workspace_->data() ? workspace_->data()->size() : 0);
   debug_info_ = param.debug_info();
+  fold_batch_norm_ = param.fold_batch_norm();
+  strict_math_ = param.strict_math();
+  share_data_views_ = param.share_data_views();
+  layer_fused_.assign(layers_.size(), false);
+  fused_into_.assign(layers_.size(), -1);
+  FuseActivations();
+  if (share_data_views_) {
+    ShareDataViews();
+  }
+  if (param.optimize_memory()) {
+    PlanActivationMemory();
+  }
+  if (replica_source_) {
+    ParamsChanged();
+  }
   LOG_IF(INFO, Caffe::root_solver()) << "Network initialization done.";
 }
 
+template <typename Dtype>
+void Net<Dtype>::ShareReplicaParams(const int layer_id) {
+  Layer<Dtype>& source = *replica_source_->layers_[layer_id];
+  CHECK_EQ(replica_source_->layer_names_[layer_id], layer_names_[layer_id]);
+  vector<shared_ptr<Blob<Dtype> > >& blobs = layers_[layer_id]->blobs();
+  if (blobs.empty()) {
+    blobs.resize(source.blobs().size());
+  }
+  CHECK_EQ(blobs.size(), source.blobs().size())
+      << "Incompatible number of blobs for layer " << layer_names_[layer_id];
+  for (int i = 0; i < blobs.size(); ++i) {
+    const Blob<Dtype>& source_blob = *source.blobs()[i];
+    if (!blobs[i]) {
+      blobs[i].reset(new Blob<Dtype>());
+    } else if (blobs[i]->data() == source_blob.data()) {
+      continue;
+    }
+    blobs[i]->ReshapeLike(source_blob);
+    blobs[i]->ShareData(source_blob);
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::PlanActivationMemory() {
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    if (layer_need_backward_[layer_id]) {
+      LOG(WARNING) << "Layer " << layer_names_[layer_id] << " needs backward, "
+          << "activations must outlive Forward; skip memory planning.";
+      return;
+    }
+  }
+#ifdef ZERO_COPY
+  if (Caffe::mode() == Caffe::GPU) {
+    LOG(WARNING) << "Zero-copy blobs map their own buffers; "
+        << "skip memory planning.";
+    return;
+  }
+#endif
+  // One slot per distinct SyncedMemory: in-place tops and ShareData aliases
+  // (Split, Reshape, Flatten...) live in the same storage as their bottom.
+  struct Slot {
+    SyncedMemory* mem;
+    size_t size;
+    int first;
+    int last;
+    bool pinned;
+    size_t offset;
+  };
+  vector<Slot> slots;
+  map<SyncedMemory*, int> slot_index;
+  vector<int> blob_slot(blobs_.size(), -1);
+  const int last_layer = layers_.size() - 1;
+  for (int layer_id = 0; layer_id <= last_layer; ++layer_id) {
+    for (int k = 0; k < 2; ++k) {
+      const vector<int>& ids =
+          (k == 0) ? bottom_id_vecs_[layer_id] : top_id_vecs_[layer_id];
+      for (int i = 0; i < ids.size(); ++i) {
+        SyncedMemory* mem = blobs_[ids[i]]->data().get();
+        map<SyncedMemory*, int>::iterator it = slot_index.find(mem);
+        if (it == slot_index.end()) {
+          Slot slot = { mem, mem->size(), layer_id, layer_id,
+              mem->head() != SyncedMemory::UNINITIALIZED, 0 };
+          it = slot_index.insert(std::make_pair(mem, slots.size())).first;
+          slots.push_back(slot);
+        }
+        Slot& slot = slots[it->second];
+        slot.first = std::min(slot.first, layer_id);
+        slot.last = std::max(slot.last, layer_id);
+        blob_slot[ids[i]] = it->second;
+      }
+    }
+  }
+  for (int i = 0; i < net_input_blob_indices_.size(); ++i) {
+    slots[blob_slot[net_input_blob_indices_[i]]].pinned = true;
+  }
+  for (int i = 0; i < net_output_blob_indices_.size(); ++i) {
+    slots[blob_slot[net_output_blob_indices_[i]]].last = last_layer;
+  }
+
+  size_t alignment = 64;
+#ifdef USE_OPENCL
+  if (Caffe::mode() == Caffe::GPU) {
+    cl_uint base_addr_align;
+    OPENCL_CHECK(clGetDeviceInfo(Caffe::Get().deviceID,
+        CL_DEVICE_MEM_BASE_ADDR_ALIGN, sizeof(cl_uint), &base_addr_align,
+        NULL));
+    alignment = std::max(alignment, static_cast<size_t>(base_addr_align / 8));
+  }
+#endif
+
+  // Greedy placement, largest slot first: each slot takes the lowest offset
+  // that does not collide with an already placed slot it is live alongside.
+  vector<pair<size_t, int> > by_size;
+  size_t unplanned_bytes = 0;
+  for (int i = 0; i < slots.size(); ++i) {
+    if (!slots[i].pinned && slots[i].size > 0) {
+      by_size.push_back(std::make_pair(slots[i].size, i));
+      unplanned_bytes += slots[i].size;
+    }
+  }
+  std::sort(by_size.rbegin(), by_size.rend());
+  vector<int> order;
+  for (int i = 0; i < by_size.size(); ++i) {
+    order.push_back(by_size[i].second);
+  }
+  size_t arena_size = 0;
+  for (int i = 0; i < order.size(); ++i) {
+    Slot& slot = slots[order[i]];
+    vector<pair<size_t, size_t> > taken;
+    for (int j = 0; j < i; ++j) {
+      const Slot& other = slots[order[j]];
+      if (other.first <= slot.last && slot.first <= other.last) {
+        taken.push_back(std::make_pair(other.offset, other.offset + other.size));
+      }
+    }
+    std::sort(taken.begin(), taken.end());
+    size_t offset = 0;
+    for (int j = 0; j < taken.size(); ++j) {
+      if (offset + slot.size <= taken[j].first) {
+        break;
+      }
+      offset = std::max(offset,
+          (taken[j].second + alignment - 1) / alignment * alignment);
+    }
+    slot.offset = offset;
+    arena_size = std::max(arena_size, offset + slot.size);
+  }
+  if (order.empty()) {
+    return;
+  }
+
+  activation_arena_.reset(new SyncedMemory(arena_size));
+  if (Caffe::mode() == Caffe::CPU) {
+    char* base = static_cast<char*>(activation_arena_->mutable_cpu_data());
+    for (int i = 0; i < order.size(); ++i) {
+      const Slot& slot = slots[order[i]];
+      slot.mem->set_cpu_data(base + slot.offset);
+    }
+  } else {
+#ifdef USE_OPENCL
+    cl_mem base = (cl_mem) activation_arena_->mutable_gpu_data();
+    for (int i = 0; i < order.size(); ++i) {
+      const Slot& slot = slots[order[i]];
+      cl_buffer_region region = { slot.offset, slot.size };
+      cl_int ret;
+      cl_mem sub_buffer = clCreateSubBuffer(base, CL_MEM_READ_WRITE,
+          CL_BUFFER_CREATE_TYPE_REGION, &region, &ret);
+      OPENCL_CHECK(ret);
+      activation_sub_buffers_.push_back(sub_buffer);
+      slot.mem->set_gpu_data(sub_buffer);
+    }
+#else
+    NO_GPU;
+#endif
+  }
+  activation_memory_ = arena_size;
+  LOG_IF(INFO, Caffe::root_solver())
+      << "Planned " << order.size() << " activation buffers into "
+      << arena_size << " bytes (" << unplanned_bytes << " without sharing)";
+}
+
+namespace {
+
+// Whether blob can become a view without losing anything: no other blob
+// shares its storage, and nothing was written to it during SetUp.
+template <typename Dtype>
+bool OwnsUnwrittenData(const Blob<Dtype>& blob,
+    const map<SyncedMemory*, int>& sharers) {
+  if (blob.count() == 0) {
+    return false;
+  }
+  SyncedMemory* mem = blob.data().get();
+  return sharers.find(mem)->second == 1 &&
+      mem->head() == SyncedMemory::UNINITIALIZED;
+}
+
+// Whether a layer after layer_id rewrites blob_id in place while another
+// blob on the storage of parent, overlapping the part of it blob_id would
+// be a view of, is still to be read.
+template <typename Dtype>
+bool RewritesLiveData(const vector<shared_ptr<Blob<Dtype> > >& blobs,
+    const vector<vector<int> >& top_id_vecs, const vector<int>& last_reader,
+    int layer_id, int blob_id, const Blob<Dtype>& parent, int offset) {
+  int writer = layer_id + 1;
+  while (writer < top_id_vecs.size() &&
+      std::find(top_id_vecs[writer].begin(), top_id_vecs[writer].end(),
+          blob_id) == top_id_vecs[writer].end()) {
+    ++writer;
+  }
+  if (writer == top_id_vecs.size()) {
+    return false;
+  }
+  const int begin = parent.data_offset() + offset;
+  const int end = begin + blobs[blob_id]->count();
+  for (int i = 0; i < blobs.size(); ++i) {
+    const Blob<Dtype>& other = *blobs[i];
+    if (i != blob_id && last_reader[i] >= writer && other.count() > 0 &&
+        other.data() == parent.data() && other.data_offset() < end &&
+        begin < other.data_offset() + other.count()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+template <typename Dtype>
+void Net<Dtype>::ShareDataViews() {
+  if (Caffe::mode() != Caffe::CPU) {
+    LOG(WARNING) << "Data views are CPU only; skip sharing them.";
+    return;
+  }
+  // The number of blobs on each storage; in-place tops are the same blob.
+  map<SyncedMemory*, int> sharers;
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    if (blobs_[blob_id]->count() > 0) {
+      ++sharers[blobs_[blob_id]->data().get()];
+    }
+  }
+  // Blobs the user or a data layer fills in keep their own storage.
+  vector<bool> filled_in(blobs_.size(), false);
+  for (int i = 0; i < net_input_blob_indices_.size(); ++i) {
+    filled_in[net_input_blob_indices_[i]] = true;
+  }
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    if (bottom_id_vecs_[layer_id].empty()) {
+      for (int i = 0; i < top_id_vecs_[layer_id].size(); ++i) {
+        filled_in[top_id_vecs_[layer_id][i]] = true;
+      }
+    }
+  }
+  // The last layer reading each blob. The blobs filled in or handed out
+  // by the net stay live after the last layer.
+  vector<int> last_reader(blobs_.size(), -1);
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    for (int i = 0; i < bottom_id_vecs_[layer_id].size(); ++i) {
+      last_reader[bottom_id_vecs_[layer_id][i]] = layer_id;
+    }
+  }
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    if (filled_in[blob_id]) {
+      last_reader[blob_id] = layers_.size();
+    }
+  }
+  for (int i = 0; i < net_output_blob_indices_.size(); ++i) {
+    last_reader[net_output_blob_indices_[i]] = layers_.size();
+  }
+  // Bottoms become parts of their top last layer first, so that a Concat
+  // feeding another is a view before its own bottoms are made views of it;
+  // tops become parts of their bottom first layer first, for the same
+  // reason. Whichever comes first keeps a blob wanted by both.
+  int num_views = 0;
+  for (int layer_id = layers_.size() - 1; layer_id >= 0; --layer_id) {
+    const vector<Blob<Dtype>*>& bottom = bottom_vecs_[layer_id];
+    const vector<Blob<Dtype>*>& top = top_vecs_[layer_id];
+    for (int bottom_id = 0; bottom_id < bottom.size(); ++bottom_id) {
+      const int offset =
+          layers_[layer_id]->BottomDataViewOffset(bottom, top, bottom_id);
+      if (offset < 0 || filled_in[bottom_id_vecs_[layer_id][bottom_id]] ||
+          !OwnsUnwrittenData(*bottom[bottom_id], sharers)) {
+        continue;
+      }
+      --sharers[bottom[bottom_id]->data().get()];
+      bottom[bottom_id]->ShareDataView(*top[0], offset);
+      ++sharers[bottom[bottom_id]->data().get()];
+      ++num_views;
+    }
+  }
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    const vector<Blob<Dtype>*>& bottom = bottom_vecs_[layer_id];
+    const vector<Blob<Dtype>*>& top = top_vecs_[layer_id];
+    for (int top_id = 0; top_id < top.size(); ++top_id) {
+      const int offset =
+          layers_[layer_id]->TopDataViewOffset(bottom, top, top_id);
+      // A view rewritten in place must not clobber data another blob,
+      // such as the other branch of a Split, still has to provide.
+      if (offset < 0 || filled_in[bottom_id_vecs_[layer_id][0]] ||
+          !OwnsUnwrittenData(*top[top_id], sharers) ||
+          RewritesLiveData(blobs_, top_id_vecs_, last_reader, layer_id,
+              top_id_vecs_[layer_id][top_id], *bottom[0], offset)) {
+        continue;
+      }
+      --sharers[top[top_id]->data().get()];
+      top[top_id]->ShareDataView(*bottom[0], offset);
+      ++sharers[top[top_id]->data().get()];
+      ++num_views;
+    }
+  }
+  LOG_IF(INFO, Caffe::root_solver())
+      << "Made " << num_views << " blobs views of others";
+}
+
 template <typename Dtype>
 void Net<Dtype>::FilterNet(const NetParameter& param,
     NetParameter* param_filtered) {
@@ -544,38 +914,20 @@ template <>
 float Net<float>::ForwardFromTo(int start, int end) {
   CHECK_GE(start, 0);
   CHECK_LT(end, layers_.size());
+  HostAllocatorScope allocator_scope(host_allocator_);
+  StrictMathScope strict_math_scope(strict_math_);
   float loss = 0;
 
-#ifdef FORWARD_LESS_MEM
-  int layer_num = layers_.size();
-  
-  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
-      blobs_[blob_id]->default_reference();
-  }
-  
-  for (int layer_id = 0; layer_id < layer_num; ++layer_id) {
-      
-      const LayerParameter& layer_param = layers_[layer_id]->layer_param();
-      for (int bottom_id = 0; bottom_id < layer_param.bottom_size();
-           ++bottom_id) {
-          bottom_vecs_[layer_id][bottom_id]->increase_reference();
-      }
-      
-      
-  }
-  const LayerParameter& layer_param = layers_[layer_num - 1]->layer_param();
-  for (int bottom_id = 0; bottom_id < layer_param.bottom_size();
-       ++bottom_id) {
-      bottom_vecs_[layer_num - 1][bottom_id]->increase_reference();
-  }
-
-#endif
 
 #ifdef PROFILE
   Timer timer;
 #endif
 
   for (int i = start; i <= end; ++i) {
+    if (layer_fused_[i] && fused_into_[i] >= start) {
+      // Computed by the layer it was fused into, see FuseActivations.
+      continue;
+    }
 
 #ifdef PROFILE
     timer.Start();
@@ -583,9 +935,6 @@ float Net<float>::ForwardFromTo(int start, int end) {
 
     // clock_t begin = std::clock();
     
-#ifdef FORWARD_LESS_MEM
-    layers_[i]->Qiaoge_alloc(bottom_vecs_[i], top_vecs_[i]);
-#endif
 
     for (int c = 0; c < before_forward_.size(); ++c) {
       before_forward_[c]->run(i);
@@ -615,12 +964,6 @@ float Net<float>::ForwardFromTo(int start, int end) {
 
 
 
-#ifdef FORWARD_LESS_MEM
-    layers_[i]->Qiaoge_free(bottom_vecs_[i], top_vecs_[i]);
-    for (int bottom_id = 0; bottom_id < bottom_vecs_[i].size(); ++bottom_id) {
-        bottom_vecs_[i][bottom_id]->decrease_reference();
-    }
-#endif
     
   }
 
@@ -635,47 +978,26 @@ template <>
 half Net<half>::ForwardFromTo(int start, int end) {
   CHECK_GE(start, 0);
   CHECK_LT(end, layers_.size());
+  HostAllocatorScope allocator_scope(host_allocator_);
+  StrictMathScope strict_math_scope(strict_math_);
   half loss = 0;
 
-#ifdef FORWARD_LESS_MEM
-  int layer_num = layers_.size();
-  
-  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
-      blobs_[blob_id]->default_reference();
-  }
-  
-  for (int layer_id = 0; layer_id < layer_num; ++layer_id) {
-      
-      const LayerParameter& layer_param = layers_[layer_id]->layer_param();
-      for (int bottom_id = 0; bottom_id < layer_param.bottom_size();
-           ++bottom_id) {
-          bottom_vecs_[layer_id][bottom_id]->increase_reference();
-      }
-      
-      
-  }
-  const LayerParameter& layer_param = layers_[layer_num - 1]->layer_param();
-  for (int bottom_id = 0; bottom_id < layer_param.bottom_size();
-       ++bottom_id) {
-      bottom_vecs_[layer_num - 1][bottom_id]->increase_reference();
-  }
-
-#endif
 
 #ifdef PROFILE
   Timer timer;
 #endif
 
   for (int i = start; i <= end; ++i) {
+    if (layer_fused_[i] && fused_into_[i] >= start) {
+      // Computed by the layer it was fused into, see FuseActivations.
+      continue;
+    }
 
 #ifdef PROFILE
     timer.Start();
 #endif
     // clock_t begin = std::clock();
     
-#ifdef FORWARD_LESS_MEM
-    layers_[i]->Qiaoge_alloc(bottom_vecs_[i], top_vecs_[i]);
-#endif
 
     for (int c = 0; c < before_forward_.size(); ++c) {
       before_forward_[c]->run(i);
@@ -715,12 +1037,6 @@ half Net<half>::ForwardFromTo(int start, int end) {
     LOG(INFO) << "Finish " << layers_[i]->type() << " layer: " << i;
 #endif
 
-#ifdef FORWARD_LESS_MEM
-    layers_[i]->Qiaoge_free(bottom_vecs_[i], top_vecs_[i]);
-    for (int bottom_id = 0; bottom_id < bottom_vecs_[i].size(); ++bottom_id) {
-        bottom_vecs_[i][bottom_id]->decrease_reference();
-    }
-#endif
     
   }
 
@@ -894,6 +1210,14 @@ void Net<Dtype>::ShareTrainedLayersWith(const Net* other) {
       target_blobs[j]->ShareData(*source_blob);
     }
   }
+  ParamsChanged();
+}
+
+template <typename Dtype>
+void Net<Dtype>::ParamsChanged() {
+  for (int i = 0; i < layers_.size(); ++i) {
+    layers_[i]->ParamsChanged();
+  }
 }
 
 #ifdef ENABLE_BACKWARD
@@ -929,14 +1253,32 @@ void Net<Dtype>::Backward() {
 
 template <typename Dtype>
 void Net<Dtype>::Reshape() {
+  HostAllocatorScope allocator_scope(host_allocator_);
   for (int i = 0; i < layers_.size(); ++i) {
     layers_[i]->Reshape(bottom_vecs_[i], top_vecs_[i]);
   }
 }
 
 template <typename Dtype>
-void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
+bool Net<Dtype>::RejectFolded(const string& layer_name) const {
+  if (!folded_layers_.count(layer_name)) {
+    return false;
+  }
+  LOG(ERROR) << "Not copying trained layers into net " << name_ << ": "
+      << "layer " << layer_name << " was folded by an earlier copy "
+      << "(fold_batch_norm), so all trained layers must be copied at once";
+  return true;
+}
+
+template <typename Dtype>
+bool Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
+  HostAllocatorScope allocator_scope(host_allocator_);
   int num_source_layers = param.layer_size();
+  for (int i = 0; i < num_source_layers; ++i) {
+    if (RejectFolded(param.layer(i).name())) {
+      return false;
+    }
+  }
   for (int i = 0; i < num_source_layers; ++i) {
     const LayerParameter& source_layer = param.layer(i);
     const string& source_layer_name = source_layer.name();
@@ -969,33 +1311,120 @@ void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
       const bool kReshape = false;
       target_blobs[j]->FromProto(source_layer.blobs(j), kReshape);
     }
+    if (source_layer.has_quantization_param()) {
+      layers_[target_layer_id]->set_quantization_param(
+          source_layer.quantization_param());
+    }
   }
+  if (fold_batch_norm_) {
+    FoldBatchNorm();
+  }
+  ParamsChanged();
+  return true;
 }
 
 template <typename Dtype>
-void Net<Dtype>::CopyTrainedLayersFrom(const string trained_filename) {
+bool Net<Dtype>::CopyTrainedLayersFrom(const string trained_filename) {
+  if (IsWeightFile(trained_filename)) {
+    return CopyTrainedLayersFromWeightFile(trained_filename);
+  }
 #ifdef USE_HDF5
   if (H5Fis_hdf5(trained_filename.c_str())) {
-    CopyTrainedLayersFromHDF5(trained_filename);
-  } else {
-#else
-  {
-#endif
-    CopyTrainedLayersFromBinaryProto(trained_filename);
+    return CopyTrainedLayersFromHDF5(trained_filename);
   }
+#endif
+  return CopyTrainedLayersFromBinaryProto(trained_filename);
 }
 
 template <typename Dtype>
-void Net<Dtype>::CopyTrainedLayersFromBinaryProto(
+bool Net<Dtype>::CopyTrainedLayersFromBinaryProto(
     const string trained_filename) {
   NetParameter param;
   ReadNetParamsFromBinaryFileOrDie(trained_filename, &param);
-  CopyTrainedLayersFrom(param);
+  return CopyTrainedLayersFrom(param);
+}
+
+template <typename Dtype>
+bool Net<Dtype>::CopyTrainedLayersFromWeightFile(
+    const string trained_filename) {
+  HostAllocatorScope allocator_scope(host_allocator_);
+  shared_ptr<MappedWeightFile> weights(new MappedWeightFile());
+  if (!weights->Open(trained_filename)) {
+    LOG(ERROR) << "Not copying trained layers from " << trained_filename;
+    return false;
+  }
+  const bool is_half = std::is_same<Dtype, half>::value;
+  const bool map = weights->is_half() == is_half;
+  // Everything is checked before any parameter changes: a blob of the
+  // wrong size would point the parameter at too little of the mapping.
+  for (int i = 0; i < weights->layers().size(); ++i) {
+    const MappedWeightFile::LayerEntry& source_layer = weights->layers()[i];
+    if (RejectFolded(source_layer.name)) {
+      return false;
+    }
+    if (!layer_names_index_.count(source_layer.name)) {
+      continue;
+    }
+    const int target_layer_id = layer_names_index_[source_layer.name];
+    const vector<shared_ptr<Blob<Dtype> > >& target_blobs =
+        layers_[target_layer_id]->blobs();
+    if (target_blobs.size() != source_layer.blobs.size()) {
+      LOG(ERROR) << "Incompatible number of blobs for layer "
+          << source_layer.name << " in " << trained_filename;
+      return false;
+    }
+    for (int j = 0; j < target_blobs.size(); ++j) {
+      const MappedWeightFile::BlobEntry& source_blob = source_layer.blobs[j];
+      if (param_owners_[param_id_vecs_[target_layer_id][j]] == -1 &&
+          target_blobs[j]->shape() != source_blob.shape) {
+        LOG(ERROR) << "Cannot copy param " << j << " weights from layer '"
+            << source_layer.name << "'; shape mismatch.  Source param shape "
+            << "is " << Blob<Dtype>(source_blob.shape).shape_string()
+            << "; target param shape is " << target_blobs[j]->shape_string()
+            << ".";
+        return false;
+      }
+    }
+  }
+  for (int i = 0; i < weights->layers().size(); ++i) {
+    const MappedWeightFile::LayerEntry& source_layer = weights->layers()[i];
+    if (!layer_names_index_.count(source_layer.name)) {
+      LOG(INFO) << "Ignoring source layer " << source_layer.name;
+      continue;
+    }
+    const int target_layer_id = layer_names_index_[source_layer.name];
+    DLOG(INFO) << "Mapping source layer " << source_layer.name;
+    vector<shared_ptr<Blob<Dtype> > >& target_blobs =
+        layers_[target_layer_id]->blobs();
+    for (int j = 0; j < target_blobs.size(); ++j) {
+      // A shared param already has the memory of its owner.
+      if (param_owners_[param_id_vecs_[target_layer_id][j]] != -1) {
+        continue;
+      }
+      const MappedWeightFile::BlobEntry& source_blob = source_layer.blobs[j];
+      const int count = target_blobs[j]->count();
+      if (map) {
+        target_blobs[j]->set_cpu_data(static_cast<Dtype*>(source_blob.data));
+      } else if (weights->is_half()) {
+        half2float(count, static_cast<const half*>(source_blob.data),
+            reinterpret_cast<float*>(target_blobs[j]->mutable_cpu_data()));
+      } else {
+        float2half(count, static_cast<const float*>(source_blob.data),
+            reinterpret_cast<half*>(target_blobs[j]->mutable_cpu_data()));
+      }
+    }
+  }
+  mapped_weights_.push_back(weights);
+  if (fold_batch_norm_) {
+    FoldBatchNorm();
+  }
+  ParamsChanged();
+  return true;
 }
 
 
 template <typename Dtype>
-void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
+bool Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
 #ifdef USE_HDF5
   hid_t file_hid = H5Fopen(trained_filename.c_str(), H5F_ACC_RDONLY,
                            H5P_DEFAULT);
@@ -1003,6 +1432,13 @@ void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
   hid_t data_hid = H5Gopen2(file_hid, "data", H5P_DEFAULT);
   CHECK_GE(data_hid, 0) << "Error reading weights from " << trained_filename;
   int num_layers = hdf5_get_num_links(data_hid);
+  for (int i = 0; i < num_layers; ++i) {
+    if (RejectFolded(hdf5_get_name_by_idx(data_hid, i))) {
+      H5Gclose(data_hid);
+      H5Fclose(file_hid);
+      return false;
+    }
+  }
   for (int i = 0; i < num_layers; ++i) {
     string source_layer_name = hdf5_get_name_by_idx(data_hid, i);
     if (!layer_names_index_.count(source_layer_name)) {
@@ -1043,9 +1479,331 @@ void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
   }
   H5Gclose(data_hid);
   H5Fclose(file_hid);
+  if (fold_batch_norm_) {
+    FoldBatchNorm();
+  }
+  ParamsChanged();
+  return true;
+#else
+  LOG(ERROR) << "Not copying trained layers from " << trained_filename
+      << ": built without HDF5";
+  return false;
 #endif
 }
 
+namespace {
+
+// The folding arithmetic is done in float whatever the storage type.
+template <typename Dtype>
+void BlobToFloat(const Blob<Dtype>& blob, vector<float>* values) {
+  values->assign(blob.cpu_data(), blob.cpu_data() + blob.count());
+}
+
+template <>
+void BlobToFloat(const Blob<half>& blob, vector<float>* values) {
+  values->resize(blob.count());
+  half2float(blob.count(), blob.cpu_data(), values->data());
+}
+
+template <typename Dtype>
+void FloatToBlob(const vector<float>& values, Blob<Dtype>* blob) {
+  CHECK_EQ(values.size(), blob->count());
+  std::copy(values.begin(), values.end(), blob->mutable_cpu_data());
+}
+
+template <>
+void FloatToBlob(const vector<float>& values, Blob<half>* blob) {
+  CHECK_EQ(values.size(), blob->count());
+  float2half(blob->count(), values.data(), blob->mutable_cpu_data());
+}
+
+// Index of the first layer after start reading blob_id, -1 if none.
+int NextReader(const vector<vector<int> >& bottom_id_vecs, int blob_id,
+    int start) {
+  for (int i = start + 1; i < bottom_id_vecs.size(); ++i) {
+    if (std::find(bottom_id_vecs[i].begin(), bottom_id_vecs[i].end(),
+        blob_id) != bottom_id_vecs[i].end()) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+}  // namespace
+
+template <typename Dtype>
+void Net<Dtype>::FoldBatchNorm() {
+  HostAllocatorScope allocator_scope(host_allocator_);
+  vector<bool> keep(layers_.size(), true);
+  for (int conv_id = 0; conv_id < layers_.size(); ++conv_id) {
+    const string conv_type = layers_[conv_id]->type();
+    if ((conv_type != "Convolution" && conv_type != "Deconvolution") ||
+        top_id_vecs_[conv_id].size() != 1) {
+      continue;
+    }
+    const LayerParameter& conv_param = layers_[conv_id]->layer_param();
+    bool shared = false;
+    for (int i = 0; i < conv_param.param_size(); ++i) {
+      shared = shared || !conv_param.param(i).name().empty();
+    }
+    if (shared) {
+      continue;
+    }
+    // The chain must rewrite the convolution output in place, so that no
+    // other layer ever sees the unnormalized values.
+    const int blob_id = top_id_vecs_[conv_id][0];
+    const int bn_id = NextReader(bottom_id_vecs_, blob_id, conv_id);
+    if (bn_id < 0 || string(layers_[bn_id]->type()) != "BatchNorm" ||
+        top_id_vecs_[bn_id][0] != blob_id) {
+      continue;
+    }
+    const LayerParameter& bn_param = layers_[bn_id]->layer_param();
+    const bool use_global_stats =
+        bn_param.batch_norm_param().has_use_global_stats() ?
+        bn_param.batch_norm_param().use_global_stats() :
+        bn_param.phase() == TEST;
+    if (!use_global_stats) {
+      continue;
+    }
+    int scale_id = NextReader(bottom_id_vecs_, blob_id, bn_id);
+    if (scale_id >= 0) {
+      Layer<Dtype>& scale = *layers_[scale_id];
+      const Blob<Dtype>& top = *top_vecs_[scale_id][0];
+      if (string(scale.type()) != "Scale" ||
+          bottom_id_vecs_[scale_id].size() != 1 ||
+          top_id_vecs_[scale_id][0] != blob_id ||
+          top.CanonicalAxisIndex(scale.layer_param().scale_param().axis())
+              != 1 ||
+          scale.blobs()[0]->count() != top.shape(1)) {
+        scale_id = -1;
+      }
+    }
+
+    const int num_output = conv_param.convolution_param().num_output();
+    const int group = conv_param.convolution_param().group();
+    // Per output channel, BatchNorm and Scale reduce to out = a * in + b.
+    vector<float> mean, variance, factor;
+    BlobToFloat(*layers_[bn_id]->blobs()[0], &mean);
+    BlobToFloat(*layers_[bn_id]->blobs()[1], &variance);
+    BlobToFloat(*layers_[bn_id]->blobs()[2], &factor);
+    CHECK_EQ(mean.size(), num_output);
+    const float eps = bn_param.batch_norm_param().eps();
+    const float stats_scale = factor[0] == 0 ? 0 : 1 / factor[0];
+    vector<float> a(num_output), b(num_output);
+    for (int c = 0; c < num_output; ++c) {
+      a[c] = 1 / std::sqrt(variance[c] * stats_scale + eps);
+      b[c] = -mean[c] * stats_scale * a[c];
+    }
+    if (scale_id >= 0) {
+      const vector<shared_ptr<Blob<Dtype> > >& scale_blobs =
+          layers_[scale_id]->blobs();
+      vector<float> gamma, beta(num_output, 0);
+      BlobToFloat(*scale_blobs[0], &gamma);
+      if (scale_blobs.size() > 1) {
+        BlobToFloat(*scale_blobs[1], &beta);
+      }
+      for (int c = 0; c < num_output; ++c) {
+        a[c] *= gamma[c];
+        b[c] = b[c] * gamma[c] + beta[c];
+      }
+    }
+
+    // A convolution without bias is rebuilt with one, so that its forward
+    // (including the generated OpenCL kernel) adds it.
+    if (!conv_param.convolution_param().bias_term()) {
+      LayerParameter biased_param(conv_param);
+      biased_param.mutable_convolution_param()->set_bias_term(true);
+      biased_param.clear_blobs();
+      shared_ptr<Layer<Dtype> > biased =
+          LayerRegistry<Dtype>::CreateLayer(biased_param);
+      biased->blobs().push_back(layers_[conv_id]->blobs()[0]);
+      biased->blobs().push_back(shared_ptr<Blob<Dtype> >(
+          new Blob<Dtype>(vector<int>(1, num_output))));
+      caffe_set(num_output, Dtype(0), biased->blobs()[1]->mutable_cpu_data());
+      biased->set_shared_workspace(workspace_);
+      biased->SetUp(bottom_vecs_[conv_id], top_vecs_[conv_id]);
+      layers_[conv_id] = biased;
+      AppendParam(NetParameter(), conv_id, 1);
+    }
+
+    Blob<Dtype>* weight_blob = layers_[conv_id]->blobs()[0].get();
+    Blob<Dtype>* bias_blob = layers_[conv_id]->blobs()[1].get();
+    vector<float> weight, bias;
+    BlobToFloat(*weight_blob, &weight);
+    BlobToFloat(*bias_blob, &bias);
+    // Convolution weights are (out, in / group, k...), deconvolution weights
+    // are (in, out / group, k...).
+    const int kernel_dim = weight_blob->count(2);
+    const int rows = weight_blob->shape(0);
+    const int cols = weight_blob->shape(1);
+    const bool deconv = conv_type == "Deconvolution";
+    for (int i = 0; i < rows; ++i) {
+      for (int j = 0; j < cols; ++j) {
+        const int c = deconv ? i / (rows / group) * cols + j : i;
+        float* w = &weight[(i * cols + j) * kernel_dim];
+        for (int k = 0; k < kernel_dim; ++k) {
+          w[k] *= a[c];
+        }
+      }
+    }
+    for (int c = 0; c < num_output; ++c) {
+      bias[c] = a[c] * bias[c] + b[c];
+    }
+    FloatToBlob(weight, weight_blob);
+    FloatToBlob(bias, bias_blob);
+
+    LOG_IF(INFO, Caffe::root_solver()) << "Folding " << layer_names_[bn_id]
+        << (scale_id >= 0 ? " and " + layer_names_[scale_id] : string())
+        << " into " << layer_names_[conv_id];
+    folded_layers_.insert(layer_names_[conv_id]);
+    folded_layers_.insert(layer_names_[bn_id]);
+    keep[bn_id] = false;
+    if (scale_id >= 0) {
+      folded_layers_.insert(layer_names_[scale_id]);
+      keep[scale_id] = false;
+    }
+  }
+  RemoveLayers(keep);
+  // Folding may have put activations right after the convolutions.
+  FuseActivations();
+}
+
+template <typename Dtype>
+void Net<Dtype>::FuseActivations() {
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    if (layer_fused_[layer_id] || top_id_vecs_[layer_id].size() != 1) {
+      continue;
+    }
+    const int blob_id = top_id_vecs_[layer_id][0];
+    const int act_id = NextReader(bottom_id_vecs_, blob_id, layer_id);
+    if (act_id < 0 || layer_fused_[act_id] ||
+        bottom_id_vecs_[act_id].size() != 1 ||
+        top_id_vecs_[act_id].size() != 1 ||
+        top_id_vecs_[act_id][0] != blob_id ||
+        layers_[act_id]->loss(0) != Dtype(0)) {
+      continue;
+    }
+    // PReLU keeps a copy of its in-place input for Backward, which it only
+    // makes when it runs forward itself.
+    if (string(layers_[act_id]->type()) == "PReLU" &&
+        layer_need_backward_[act_id]) {
+      continue;
+    }
+    if (layers_[layer_id]->FuseActivation(layers_[act_id])) {
+      layer_fused_[act_id] = true;
+      fused_into_[act_id] = layer_id;
+      LOG_IF(INFO, Caffe::root_solver()) << "Fusing " << layer_names_[act_id]
+          << " into " << layer_names_[layer_id];
+    }
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::RemoveLayers(const vector<bool>& keep) {
+  CHECK_EQ(keep.size(), layers_.size());
+  vector<int> layer_map(layers_.size(), -1);
+  int num_layers = 0;
+  for (int i = 0; i < layers_.size(); ++i) {
+    if (!keep[i]) {
+      continue;
+    }
+    layer_map[i] = num_layers;
+    layers_[num_layers] = layers_[i];
+    layer_names_[num_layers] = layer_names_[i];
+    layer_need_backward_[num_layers] = layer_need_backward_[i];
+    layer_fused_[num_layers] = layer_fused_[i];
+    fused_into_[num_layers] =
+        fused_into_[i] < 0 ? -1 : layer_map[fused_into_[i]];
+    bottom_vecs_[num_layers] = bottom_vecs_[i];
+    bottom_id_vecs_[num_layers] = bottom_id_vecs_[i];
+    bottom_need_backward_[num_layers] = bottom_need_backward_[i];
+    top_vecs_[num_layers] = top_vecs_[i];
+    top_id_vecs_[num_layers] = top_id_vecs_[i];
+    param_id_vecs_[num_layers] = param_id_vecs_[i];
+    ++num_layers;
+  }
+  if (num_layers == layers_.size()) {
+    return;
+  }
+  layers_.resize(num_layers);
+  layer_names_.resize(num_layers);
+  layer_need_backward_.resize(num_layers);
+  layer_fused_.resize(num_layers);
+  fused_into_.resize(num_layers);
+  bottom_vecs_.resize(num_layers);
+  bottom_id_vecs_.resize(num_layers);
+  bottom_need_backward_.resize(num_layers);
+  top_vecs_.resize(num_layers);
+  top_id_vecs_.resize(num_layers);
+  param_id_vecs_.resize(num_layers);
+  layer_names_index_.clear();
+  for (int i = 0; i < num_layers; ++i) {
+    layer_names_index_[layer_names_[i]] = i;
+  }
+
+  // Renumber the remaining params. Owners always precede their sharers, and
+  // learnable ids are assigned in order of their owners, so both tables can
+  // be compacted in place.
+  vector<int> param_map(params_.size(), -1);
+  vector<int> learnable_map(learnable_params_.size(), -1);
+  int num_params = 0;
+  int num_learnable = 0;
+  for (int i = 0; i < params_.size(); ++i) {
+    const int layer_id = layer_map[param_layer_indices_[i].first];
+    if (layer_id < 0) {
+      continue;
+    }
+    param_map[i] = num_params;
+    params_[num_params] = params_[i];
+    param_display_names_[num_params] = param_display_names_[i];
+    param_layer_indices_[num_params] =
+        make_pair(layer_id, param_layer_indices_[i].second);
+    if (param_owners_[i] < 0) {
+      param_owners_[num_params] = -1;
+    } else {
+      param_owners_[num_params] = param_map[param_owners_[i]];
+      CHECK_GE(param_owners_[num_params], 0)
+          << "Cannot remove a layer owning params shared by others";
+    }
+    const int learnable_id = learnable_param_ids_[i];
+    if (learnable_map[learnable_id] < 0) {
+      learnable_map[learnable_id] = num_learnable;
+      learnable_params_[num_learnable] = learnable_params_[learnable_id];
+      params_lr_[num_learnable] = params_lr_[learnable_id];
+      has_params_lr_[num_learnable] = has_params_lr_[learnable_id];
+      params_weight_decay_[num_learnable] = params_weight_decay_[learnable_id];
+      has_params_decay_[num_learnable] = has_params_decay_[learnable_id];
+      ++num_learnable;
+    }
+    learnable_param_ids_[num_params] = learnable_map[learnable_id];
+    ++num_params;
+  }
+  params_.resize(num_params);
+  param_display_names_.resize(num_params);
+  param_layer_indices_.resize(num_params);
+  param_owners_.resize(num_params);
+  learnable_param_ids_.resize(num_params);
+  learnable_params_.resize(num_learnable);
+  params_lr_.resize(num_learnable);
+  has_params_lr_.resize(num_learnable);
+  params_weight_decay_.resize(num_learnable);
+  has_params_decay_.resize(num_learnable);
+  for (int i = 0; i < num_layers; ++i) {
+    for (int j = 0; j < param_id_vecs_[i].size(); ++j) {
+      param_id_vecs_[i][j] = param_map[param_id_vecs_[i][j]];
+    }
+  }
+  for (map<string, int>::iterator it = param_names_index_.begin();
+       it != param_names_index_.end();) {
+    if (param_map[it->second] < 0) {
+      param_names_index_.erase(it++);
+    } else {
+      it->second = param_map[it->second];
+      ++it;
+    }
+  }
+}
+
 template <typename Dtype>
 void Net<Dtype>::ToProto(NetParameter* param, bool write_diff) const {
   param->Clear();
@@ -1071,10 +1829,37 @@ void Net<Dtype>::ToHalfProto(NetParameter* param, bool write_diff) const {
   }
 }
 
+template <typename Dtype>
+void Net<Dtype>::ToInt8Proto(NetParameter* param) const {
+  param->Clear();
+  param->set_name(name_);
+  for (int i = 0; i < layers_.size(); ++i) {
+    LayerParameter* layer_param = param->add_layer();
+    layers_[i]->ToProto(layer_param);
+    if (layer_param->has_quantization_param() &&
+        layer_param->blobs_size() > 0) {
+      layers_[i]->blobs()[0]->ToInt8Proto(layer_param->mutable_blobs(0));
+    }
+  }
+}
+
 
 
 
 
+template <typename Dtype>
+void Net<Dtype>::ToWeightFile(const string& filename, bool write_half) const {
+  vector<string> layer_names;
+  vector<vector<shared_ptr<Blob<Dtype> > > > layer_blobs;
+  for (int i = 0; i < layers_.size(); ++i) {
+    if (layers_[i]->blobs().size()) {
+      layer_names.push_back(layer_names_[i]);
+      layer_blobs.push_back(layers_[i]->blobs());
+    }
+  }
+  WriteWeightFile(filename, layer_names, layer_blobs, write_half);
+}
+
 template <typename Dtype>
 void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
 #ifdef USE_HDF5
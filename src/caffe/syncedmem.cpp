@@ -27,7 +27,7 @@ SyncedMemory::SyncedMemory(size_t size)
 SyncedMemory::~SyncedMemory() {
   check_device();
   if (cpu_ptr_ && own_cpu_data_) {
-    CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
+    CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_, allocator_.get());
   }
 
 #ifdef USE_OPENCL
@@ -37,43 +37,20 @@ SyncedMemory::~SyncedMemory() {
 #endif  // CPU_ONLY
 }
 
-#ifdef FORWARD_LESS_MEM
-void SyncedMemory::default_reference() {
-    refer_num = 0;
-}
-
-void SyncedMemory::increase_reference() {
-    refer_num++;
-}
-
-void SyncedMemory::decrease_reference() {
-    refer_num--;
-    if (refer_num == 0) {
-        zhihan_release();
-    }
-}
-
-void SyncedMemory::zhihan_release() {
-    if (cpu_ptr_ && own_cpu_data_) {
-        CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
-    }
-    
-    cpu_ptr_ = NULL;
-    own_cpu_data_ = false;
-    
-    head_ = UNINITIALIZED;
-}
-
-#endif
 
 
 inline void SyncedMemory::to_cpu() {
   check_device();
+  bool zeroed;
 
   switch (head_) {
   case UNINITIALIZED:
-    CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_, &gpu_ptr_);
-    caffe_memset(size_, 0, cpu_ptr_);
+    allocator_ = HostAllocator::Current();
+    CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_, &gpu_ptr_,
+        allocator_.get(), &zeroed);
+    if (!zeroed) {
+      caffe_memset(size_, 0, cpu_ptr_);
+    }
     head_ = HEAD_AT_CPU;
     own_cpu_data_ = true;
     break;
@@ -89,7 +66,9 @@ inline void SyncedMemory::to_cpu() {
     head_ = HEAD_AT_CPU;
 #else  
     if (cpu_ptr_ == NULL) {
-      CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_, &gpu_ptr_);
+      allocator_ = HostAllocator::Current();
+      CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_, &gpu_ptr_,
+          allocator_.get(), &zeroed);
       own_cpu_data_ = true;
     }
     
@@ -174,7 +153,7 @@ void SyncedMemory::set_cpu_data(void* data) {
   check_device();
   CHECK(data);
   if (own_cpu_data_) {
-    CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
+    CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_, allocator_.get());
   }
   cpu_ptr_ = data;
   head_ = HEAD_AT_CPU;
@@ -195,28 +174,21 @@ const void* SyncedMemory::gpu_data() {
 void SyncedMemory::set_gpu_data(void* data) {
   check_device();
 #ifdef USE_OPENCL
-  // CHECK(data);
-
-
-
-  LOG(ERROR) << "Better not use this";
-  LOG(ERROR) << "Better not use this";
-  LOG(ERROR) << "Better not use this";
-  LOG(ERROR) << "Better not use this";
-  LOG(ERROR) << "Better not use this";
-  exit(0);
-
-  
+  CHECK(data);
+#ifdef ZERO_COPY
+  // The host pointer of a zero-copy buffer is a mapping of gpu_ptr_ itself,
+  // swapping the buffer underneath it would leave that mapping dangling.
+  // The buffer stays as it is since LOG(FATAL) does not abort.
+  LOG(FATAL) << "set_gpu_data is not supported with ZERO_COPY";
+  return;
+#else
   if (own_gpu_data_) {
     OPENCL_CHECK(clReleaseMemObject(gpu_ptr_));
   }
-
-
-
-
   gpu_ptr_ = (cl_mem) data;
   head_ = HEAD_AT_GPU;
   own_gpu_data_ = false;
+#endif  // ZERO_COPY
 #else
   NO_GPU;
 #endif
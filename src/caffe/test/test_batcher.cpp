@@ -0,0 +1,148 @@
+#include <future>  // NOLINT(build/c++11)
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/batcher.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class BatcherTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  BatcherTest() : num_inputs_(12) {}
+
+  virtual void SetUp() {
+    const string& proto =
+        "name: 'BatchedNetwork' "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  input_param { "
+        "  shape: { dim: 4 dim: 2 dim: 5 dim: 5 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'conv1' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv1' "
+        "  convolution_param { "
+        "    num_output: 3 "
+        "    kernel_size: 3 "
+        "    weight_filler { type: 'gaussian' std: 1 } "
+        "    bias_filler { type: 'gaussian' std: 1 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'ip2' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'conv1' "
+        "  top: 'ip2' "
+        "  inner_product_param { "
+        "    num_output: 4 "
+        "    weight_filler { type: 'gaussian' std: 1 } "
+        "    bias_filler { type: 'gaussian' std: 1 } "
+        "  } "
+        "} ";
+    Caffe::set_random_seed(1701);
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    source_.reset(new Net<Dtype>(param));
+    Blob<Dtype> inputs(num_inputs_, 2, 5, 5);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(&inputs);
+    inputs_.assign(inputs.cpu_data(), inputs.cpu_data() + inputs.count());
+    // The expected outputs, one input at a time.
+    const int count = inputs.count(1);
+    Blob<Dtype>* input = source_->input_blobs()[0];
+    input->Reshape(1, 2, 5, 5);
+    source_->Reshape();
+    for (int i = 0; i < num_inputs_; ++i) {
+      caffe_copy(count, &inputs_[i * count], input->mutable_cpu_data());
+      const Blob<Dtype>* output = source_->Forward()[0];
+      expected_.push_back(vector<Dtype>(output->cpu_data(),
+          output->cpu_data() + output->count()));
+    }
+  }
+
+  void CheckOutputs(int i, const vector<shared_ptr<Blob<Dtype> > >& outputs) {
+    ASSERT_EQ(outputs.size(), 1);
+    ASSERT_EQ(outputs[0]->num(), 1);
+    ASSERT_EQ(outputs[0]->count(), expected_[i].size());
+    for (int j = 0; j < outputs[0]->count(); ++j) {
+      EXPECT_NEAR(expected_[i][j], outputs[0]->cpu_data()[j], 1e-4)
+          << "input " << i;
+    }
+  }
+
+  const int num_inputs_;
+  shared_ptr<Net<Dtype> > source_;
+  vector<Dtype> inputs_;
+  vector<vector<Dtype> > expected_;
+};
+
+TYPED_TEST_CASE(BatcherTest, TestDtypesAndDevices);
+
+TYPED_TEST(BatcherTest, TestBatchesQueuedInputs) {
+  typedef typename TypeParam::Dtype Dtype;
+  typedef vector<shared_ptr<Blob<Dtype> > > Outputs;
+  ForwardBatcher<Dtype> batcher(shared_ptr<Net<Dtype> >(
+      new Net<Dtype>(this->source_.get())), 4, 1000000);
+  const int count = batcher.input_count();
+  EXPECT_EQ(count, 2 * 5 * 5);
+  vector<std::future<Outputs> > futures;
+  for (int i = 0; i < 4; ++i) {
+    futures.push_back(batcher.Submit(&this->inputs_[i * count]));
+  }
+  for (int i = 0; i < 4; ++i) {
+    this->CheckOutputs(i, futures[i].get());
+  }
+  // The four inputs went through in a single batch.
+  EXPECT_EQ(batcher.net()->input_blobs()[0]->num(), 4);
+  // A lone input runs once the wait is over.
+  ForwardBatcher<Dtype> impatient(shared_ptr<Net<Dtype> >(
+      new Net<Dtype>(this->source_.get())), 4, 0);
+  this->CheckOutputs(5, impatient.Submit(&this->inputs_[5 * count]).get());
+  EXPECT_EQ(impatient.net()->input_blobs()[0]->num(), 1);
+}
+
+TYPED_TEST(BatcherTest, TestConcurrentSubmit) {
+  typedef typename TypeParam::Dtype Dtype;
+  typedef vector<shared_ptr<Blob<Dtype> > > Outputs;
+  ForwardBatcher<Dtype> batcher(shared_ptr<Net<Dtype> >(
+      new Net<Dtype>(this->source_.get())), 4, 1000);
+  const int count = batcher.input_count();
+  const int num_threads = 3;
+  vector<Outputs> outputs(this->num_inputs_);
+  vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.push_back(std::thread([&, t] {
+      for (int i = t; i < this->num_inputs_; i += num_threads) {
+        outputs[i] = batcher.Submit(&this->inputs_[i * count]).get();
+      }
+    }));
+  }
+  for (int t = 0; t < num_threads; ++t) {
+    threads[t].join();
+  }
+  for (int i = 0; i < this->num_inputs_; ++i) {
+    this->CheckOutputs(i, outputs[i]);
+  }
+}
+
+}  // namespace caffe
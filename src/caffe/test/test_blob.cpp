@@ -112,6 +112,42 @@ TYPED_TEST(BlobSimpleTest, TestLegacyBlobProtoShapeEquals) {
   EXPECT_FALSE(this->blob_->ShapeEquals(blob_proto));
 }
 
+TYPED_TEST(BlobSimpleTest, TestShareDataView) {
+  Blob<TypeParam>* parent = this->blob_preshaped_;
+  for (int i = 0; i < parent->count(); ++i) {
+    parent->mutable_cpu_data()[i] = i;
+  }
+  // The second 3 x 4 x 5 image of the parent, then its rows 1 and 2.
+  Blob<TypeParam> view(1, 3, 4, 5);
+  view.ShareDataView(*parent, 60);
+  EXPECT_TRUE(view.data_view());
+  EXPECT_TRUE(view.IsDataViewOf(*parent, 60));
+  EXPECT_EQ(60, view.cpu_data()[0]);
+  view.mutable_cpu_data()[1] = -1;
+  EXPECT_EQ(-1, parent->cpu_data()[61]);
+  Blob<TypeParam> nested(1, 1, 2, 5);
+  nested.ShareDataView(view, 5);
+  EXPECT_TRUE(nested.IsDataViewOf(*parent, 65));
+  EXPECT_EQ(65, nested.cpu_data()[0]);
+  // Sharing a view shares the same elements.
+  Blob<TypeParam> shared(1, 1, 2, 5);
+  shared.ShareData(nested);
+  EXPECT_TRUE(shared.IsDataViewOf(*parent, 65));
+  // Reshaping to the same count keeps the view, to another count leaves it.
+  nested.Reshape(1, 1, 5, 2);
+  EXPECT_TRUE(nested.IsDataViewOf(*parent, 65));
+  nested.Reshape(1, 1, 1, 5);
+  EXPECT_FALSE(nested.data_view());
+  EXPECT_FALSE(nested.data() == parent->data());
+  // Detaching copies the elements into storage of its own.
+  view.DetachDataView();
+  EXPECT_FALSE(view.data_view());
+  EXPECT_EQ(60, view.cpu_data()[0]);
+  EXPECT_EQ(-1, view.cpu_data()[1]);
+  view.mutable_cpu_data()[0] = -2;
+  EXPECT_EQ(60, parent->cpu_data()[60]);
+}
+
 template <typename TypeParam>
 class BlobMathTest : public MultiDeviceTest<TypeParam> {
   typedef typename TypeParam::Dtype Dtype;
@@ -1,3 +1,12 @@
+#include <dirent.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 #include "caffe/common.hpp"
@@ -27,6 +36,48 @@ TEST_F(CommonTest, TestBrewMode) {
   EXPECT_EQ(Caffe::mode(), Caffe::GPU);
 }
 
+TEST_F(CommonTest, TestKernelCacheGPU) {
+  cl_program program = Caffe::Get().math_program;
+  cl_kernel kernel = Caffe::Get().get_kernel(program, "axpy_kernel");
+  EXPECT_TRUE(kernel);
+  EXPECT_EQ(kernel, Caffe::Get().get_kernel(program, "axpy_kernel"));
+  EXPECT_NE(kernel, Caffe::Get().get_kernel(program, "scal_kernel"));
+}
+
+TEST_F(CommonTest, TestProgramCacheGPU) {
+  char dir_template[] = "/tmp/caffe_test.XXXXXX";
+  ASSERT_TRUE(mkdtemp(dir_template));
+  const string cache_dir = dir_template;
+  const string saved_cache_dir = Caffe::opencl_cache_dir();
+  Caffe::set_opencl_cache_dir(cache_dir);
+  const string source =
+      "__kernel void fill_one(__global float* x) {\n"
+      "  x[get_global_id(0)] = 1;\n"
+      "}\n";
+  // The first build stores one binary, the second one loads it.
+  vector<string> binaries;
+  for (int i = 0; i < 2; ++i) {
+    cl_program program;
+    Caffe::Get().build_opencl_program(source, program);
+    EXPECT_TRUE(Caffe::Get().get_kernel(program, "fill_one"));
+    Caffe::Get().release_program(program);
+    binaries.clear();
+    DIR* dir = opendir(cache_dir.c_str());
+    ASSERT_TRUE(dir);
+    while (struct dirent* entry = readdir(dir)) {
+      if (entry->d_name[0] != '.') {
+        binaries.push_back(cache_dir + "/" + entry->d_name);
+      }
+    }
+    closedir(dir);
+    ASSERT_EQ(1, binaries.size());
+    EXPECT_EQ(".clbin", binaries[0].substr(binaries[0].size() - 6));
+  }
+  Caffe::set_opencl_cache_dir(saved_cache_dir);
+  remove(binaries[0].c_str());
+  rmdir(cache_dir.c_str());
+}
+
 TEST_F(CommonTest, TestRandSeedCPU) {
   SyncedMemory data_a(10 * sizeof(int));
   SyncedMemory data_b(10 * sizeof(int));
@@ -42,6 +93,46 @@ TEST_F(CommonTest, TestRandSeedCPU) {
   }
 }
 
+TEST_F(CommonTest, TestThreadLocalContext) {
+  Caffe::set_mode(Caffe::GPU);
+  Caffe::set_random_seed(1701);
+  Caffe* thread_caffe = NULL;
+  Caffe::Brew thread_mode = Caffe::GPU;
+  vector<int> thread_draws(10);
+  std::thread thread([&]() {
+    thread_caffe = &Caffe::Get();
+    thread_mode = Caffe::mode();
+    Caffe::set_mode(Caffe::CPU);
+    Caffe::set_random_seed(1701);
+    caffe_rng_bernoulli(10, float(0.5), &thread_draws[0]);
+  });
+  thread.join();
+  EXPECT_NE(&Caffe::Get(), thread_caffe);
+  EXPECT_EQ(Caffe::CPU, thread_mode);
+  // Nothing the thread did touched the mode or the generator of this one.
+  EXPECT_EQ(Caffe::GPU, Caffe::mode());
+  vector<int> draws(10);
+  caffe_rng_bernoulli(10, float(0.5), &draws[0]);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(thread_draws[i], draws[i]);
+  }
+  Caffe::set_mode(Caffe::CPU);
+}
+
+TEST_F(CommonTest, TestSharedContextGPU) {
+  cl_context context = NULL;
+  cl_command_queue queue = NULL;
+  cl_program math_program = NULL;
+  std::thread thread([&]() {
+    context = Caffe::Get().context;
+    queue = Caffe::Get().commandQueue;
+    math_program = Caffe::Get().math_program;
+  });
+  thread.join();
+  EXPECT_EQ(Caffe::Get().context, context);
+  EXPECT_EQ(Caffe::Get().math_program, math_program);
+  EXPECT_NE(Caffe::Get().commandQueue, queue);
+}
 
 #ifdef USE_CUDNN // GPU Caffe singleton test.
 
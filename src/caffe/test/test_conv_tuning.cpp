@@ -0,0 +1,70 @@
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/conv_tuning.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ConvTuningTest : public ::testing::Test {};
+
+TEST_F(ConvTuningTest, TestDefaultConfig) {
+  ConvTileConfig config;
+  EXPECT_TRUE(config.IsValid());
+  EXPECT_EQ(config.tsm(), 16);
+  EXPECT_EQ(config.tsn(), 128);
+  config.vwm = 3;
+  EXPECT_FALSE(config.IsValid());
+  config.vwm = 8;
+  EXPECT_FALSE(config.IsValid());  // WPTM is not a multiple of VWM
+}
+
+TEST_F(ConvTuningTest, TestCandidates) {
+  const vector<ConvTileConfig> candidates =
+      ConvTileCandidates(64, 56 * 56, 576, 256, 32 << 10, sizeof(float));
+  ASSERT_GT(candidates.size(), 1);
+  EXPECT_TRUE(candidates[0] == ConvTileConfig());
+  for (int i = 1; i < candidates.size(); ++i) {
+    EXPECT_TRUE(candidates[i].IsValid());
+    EXPECT_FALSE(candidates[i] == ConvTileConfig());
+    EXPECT_LE(candidates[i].rtsm * candidates[i].rtsn, 256);
+    EXPECT_LT(candidates[i].tsm(), 2 * 64);
+  }
+  // Nothing fits a one channel output but the default.
+  EXPECT_EQ(ConvTileCandidates(1, 56 * 56, 576, 256, 32 << 10,
+      sizeof(float)).size(), 1);
+}
+
+TEST_F(ConvTuningTest, TestStoreAndLookup) {
+  char file_template[] = "/tmp/caffe_test.XXXXXX";
+  const int fd = mkstemp(file_template);
+  ASSERT_GE(fd, 0);
+  close(fd);
+  const string file = file_template;
+  ConvTuningDB& db = ConvTuningDB::Get();
+  const string saved_file = db.file();
+  db.set_file(file);
+  ConvTileConfig config;
+  EXPECT_FALSE(db.Lookup("device/Convolution/float/M64", &config));
+  config.wptm = 8;
+  config.rtsn = 8;
+  db.Store("device/Convolution/float/M64", config);
+  // A fresh load reads the entry back from the file.
+  db.set_file(file);
+  ConvTileConfig loaded;
+  EXPECT_TRUE(db.Lookup("device/Convolution/float/M64", &loaded));
+  EXPECT_TRUE(loaded == config);
+  EXPECT_FALSE(db.Lookup("device/Convolution/float/M32", &loaded));
+  db.set_file(saved_file);
+  remove(file.c_str());
+}
+
+}  // namespace caffe
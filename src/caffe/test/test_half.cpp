@@ -0,0 +1,55 @@
+#include <cstring>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class HalfTest : public ::testing::Test {};
+
+TEST_F(HalfTest, TestFloat2HalfMatchesScalar) {
+  // A sweep over the bit patterns plus the rounding, overflow and NaN edges.
+  vector<float_b> bits;
+  for (uint64_t b = 0; b < (1ull << 32); b += 65521) {
+    bits.push_back(static_cast<float_b>(b));
+  }
+  const float_b edges[] = {
+    0x00000000, 0x00000001, 0x007FFFFF, 0x00800000, 0x32FFFFFF, 0x33000000,
+    0x33000001, 0x337FFFFF, 0x33800000, 0x387FE000, 0x387FF000, 0x38800000,
+    0x38801000, 0x38802000, 0x38803000, 0x3F800FFF, 0x3F801000, 0x477FE000,
+    0x477FEFFF, 0x477FF000, 0x47800000, 0x7F7FFFFF, 0x7F800000, 0x7F800001,
+    0x7F801FFF, 0x7F802000, 0x7FC00000, 0x7FFFFFFF
+  };
+  for (int i = 0; i < sizeof(edges) / sizeof(edges[0]); ++i) {
+    bits.push_back(edges[i]);
+    bits.push_back(edges[i] | 0x80000000);
+  }
+  vector<float> in(bits.size());
+  std::memcpy(&in[0], &bits[0], bits.size() * sizeof(float));
+  vector<half> out(in.size());
+  float2half(in.size(), &in[0], &out[0]);
+  for (int i = 0; i < in.size(); ++i) {
+    EXPECT_EQ(float2half_impl(in[i]), out[i]) << std::hex << bits[i];
+  }
+}
+
+TEST_F(HalfTest, TestHalf2FloatMatchesScalar) {
+  vector<half> in(1 << 16);
+  for (int i = 0; i < in.size(); ++i) {
+    in[i] = i;
+  }
+  // An odd count leaves a tail for the scalar loop.
+  vector<float> out(in.size() - 1);
+  half2float(out.size(), &in[0], &out[0]);
+  for (int i = 0; i < out.size(); ++i) {
+    const float expected = half2float_impl(in[i]);
+    EXPECT_EQ(0, std::memcmp(&expected, &out[i], sizeof(float)))
+        << std::hex << in[i];
+  }
+}
+
+}  // namespace caffe
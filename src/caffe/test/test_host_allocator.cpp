@@ -0,0 +1,105 @@
+#include <stdint.h>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/host_allocator.hpp"
+#include "caffe/syncedmem.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class HostAllocatorTest : public ::testing::Test {};
+
+TEST_F(HostAllocatorTest, TestClassSize) {
+  EXPECT_EQ(SlabAllocator::ClassSize(1), 64);
+  EXPECT_EQ(SlabAllocator::ClassSize(64), 64);
+  EXPECT_EQ(SlabAllocator::ClassSize(65), 128);
+  EXPECT_EQ(SlabAllocator::ClassSize(1000), 1024);
+  EXPECT_EQ(SlabAllocator::ClassSize(1025), 1280);
+  EXPECT_EQ(SlabAllocator::ClassSize(3 << 20), 3 << 20);
+  for (size_t size = 1; size < (1 << 20); size = size * 3 + 7) {
+    const size_t class_size = SlabAllocator::ClassSize(size);
+    EXPECT_GE(class_size, size);
+    EXPECT_EQ(class_size % HostAllocator::kAlignment, 0);
+    EXPECT_LE(class_size, size + size / 4 + HostAllocator::kAlignment);
+  }
+}
+
+TEST_F(HostAllocatorTest, TestSlabAlignmentAndReuse) {
+  SlabAllocator allocator(1 << 16);
+  bool zeroed;
+  void* a = allocator.Allocate(1000, &zeroed);
+  EXPECT_TRUE(zeroed);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(a) % HostAllocator::kAlignment, 0);
+  void* b = allocator.Allocate(10, &zeroed);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(b) % HostAllocator::kAlignment, 0);
+  EXPECT_NE(a, b);
+  static_cast<char*>(a)[0] = 1;
+  allocator.Free(a);
+  // Same size class: the freed chunk comes back, no longer known zero.
+  void* c = allocator.Allocate(1020, &zeroed);
+  EXPECT_EQ(a, c);
+  EXPECT_FALSE(zeroed);
+  allocator.Free(b);
+  allocator.Free(c);
+}
+
+TEST_F(HostAllocatorTest, TestSlabStatsAndReset) {
+  SlabAllocator allocator(1 << 16);
+  bool zeroed;
+  void* a = allocator.Allocate(1 << 12, &zeroed);
+  void* b = allocator.Allocate(1 << 12, &zeroed);
+  HostAllocatorStats stats = allocator.stats();
+  EXPECT_EQ(stats.bytes_live, 2 << 12);
+  EXPECT_EQ(stats.high_water_mark, 2 << 12);
+  EXPECT_EQ(stats.slab_count, 1);
+  // Larger than a slab: gets a slab of its own.
+  void* big = allocator.Allocate(1 << 20, &zeroed);
+  EXPECT_EQ(allocator.stats().slab_count, 2);
+  allocator.Free(a);
+  allocator.Free(big);
+  stats = allocator.stats();
+  EXPECT_EQ(stats.bytes_live, 1 << 12);
+  EXPECT_EQ(stats.high_water_mark, (2 << 12) + (1 << 20));
+  // A live chunk keeps the allocator from rewinding under it.
+  EXPECT_FALSE(allocator.Reset());
+  EXPECT_EQ(allocator.stats().bytes_live, 1 << 12);
+  void* other = allocator.Allocate(1 << 12, &zeroed);
+  EXPECT_EQ(other, a);
+  EXPECT_NE(other, b);
+  allocator.Free(other);
+  allocator.Free(b);
+  EXPECT_TRUE(allocator.Reset());
+  stats = allocator.stats();
+  EXPECT_EQ(stats.bytes_live, 0);
+  EXPECT_EQ(stats.high_water_mark, 0);
+  EXPECT_EQ(stats.slab_count, 2);
+  // The rewound slab hands out the same bytes again, dirty this time.
+  void* again = allocator.Allocate(1 << 12, &zeroed);
+  EXPECT_EQ(again, a);
+  EXPECT_FALSE(zeroed);
+  allocator.Free(again);
+}
+
+TEST_F(HostAllocatorTest, TestScopeRoutesSyncedMemory) {
+  shared_ptr<SlabAllocator> allocator(new SlabAllocator(1 << 16));
+  SyncedMemory* mem;
+  {
+    HostAllocatorScope scope(allocator);
+    EXPECT_EQ(HostAllocator::Current().get(), allocator.get());
+    mem = new SyncedMemory(100);
+    mem->mutable_cpu_data();
+  }
+  EXPECT_EQ(HostAllocator::Current(), HostAllocator::Default());
+  EXPECT_EQ(allocator->stats().bytes_live, SlabAllocator::ClassSize(100));
+  const char* data = static_cast<const char*>(mem->cpu_data());
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(data[i], 0);
+  }
+  delete mem;
+  EXPECT_EQ(allocator->stats().bytes_live, 0);
+}
+
+}  // namespace caffe
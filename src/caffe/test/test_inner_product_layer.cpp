@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -135,6 +137,48 @@ TYPED_TEST(InnerProductLayerTest, TestForward) {
   }
 }
 
+/**
+ * @brief Runs an IP layer with transposed weights in float and, with the
+ * same weights, in int8, and checks that they agree within the quantization
+ * error.
+ */
+TYPED_TEST(InnerProductLayerTest, TestForwardInt8) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  LayerParameter layer_param;
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  inner_product_param->set_num_output(11);
+  inner_product_param->set_transpose(true);
+  inner_product_param->mutable_weight_filler()->set_type("gaussian");
+  inner_product_param->mutable_bias_filler()->set_type("uniform");
+  shared_ptr<InnerProductLayer<Dtype> > layer(
+      new InnerProductLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype> ref_top;
+  ref_top.CopyFrom(*this->blob_top_, false, true);
+  // The uniform input lies within [0, 1].
+  layer_param.mutable_quantization_param()->set_input_range(1);
+  shared_ptr<InnerProductLayer<Dtype> > int8_layer(
+      new InnerProductLayer<Dtype>(layer_param));
+  int8_layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < layer->blobs().size(); ++i) {
+    int8_layer->blobs()[i]->CopyFrom(*layer->blobs()[i]);
+  }
+  int8_layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const Dtype* data = this->blob_top_->cpu_data();
+  const Dtype* ref_data = ref_top.cpu_data();
+  const int count = this->blob_top_->count();
+  float ref_range = 0;
+  for (int i = 0; i < count; ++i) {
+    ref_range = std::max(ref_range, std::fabs(ref_data[i]));
+  }
+  for (int i = 0; i < count; ++i) {
+    EXPECT_NEAR(data[i], ref_data[i], 0.03 * ref_range);
+  }
+}
+
 /**
  * @brief Init. an IP layer without transpose + random weights,
  * run Forward, save the result.
@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/util/int8_gemm.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class Int8GemmTest : public ::testing::Test {
+ protected:
+  // Integer values with a magnitude of 127 in every row of the weights and
+  // somewhere in the columns, so that every scale is 1 and the product is
+  // exact.
+  void FillIntegers(const int count, const int row, vector<float>* values) {
+    values->resize(count);
+    for (int i = 0; i < count; ++i) {
+      (*values)[i] = (i * 7919 + 13) % 255 - 127;
+    }
+    for (int i = 0; i < count; i += row) {
+      (*values)[i] = (i / row) % 2 ? 127 : -127;
+    }
+  }
+
+  void TestExact(const int M, const int N, const int K) {
+    vector<float> weights, columns;
+    FillIntegers(M * K, K, &weights);
+    FillIntegers(K * N, K * N, &columns);
+    const int K4 = int8_padded_size(K);
+    vector<int8_t> quantized(M * K4);
+    vector<float> scales(M);
+    int8_quantize_weights(M, K, &weights[0], false, &quantized[0],
+        &scales[0]);
+    vector<int8_t> packed(K4 * N);
+    int8_quantize_columns(K, N, &columns[0], N, 1, 1.f, &packed[0]);
+    // Write the product transposed to check the strides too.
+    vector<float> output(M * N);
+    int8_gemm(M, N, K, &quantized[0], &scales[0], &packed[0], 1.f,
+        &output[0], 1, M);
+    for (int m = 0; m < M; ++m) {
+      EXPECT_FLOAT_EQ(scales[m], 1.f);
+      for (int n = 0; n < N; ++n) {
+        float expected = 0;
+        for (int k = 0; k < K; ++k) {
+          expected += weights[m * K + k] * columns[k * N + n];
+        }
+        EXPECT_EQ(output[n * M + m], expected) << m << ", " << n;
+      }
+    }
+  }
+};
+
+TEST_F(Int8GemmTest, TestExact) {
+  TestExact(1, 1, 1);
+  TestExact(3, 8, 4);
+  TestExact(19, 67, 37);
+  TestExact(33, 130, 150);
+}
+
+TEST_F(Int8GemmTest, TestExactMultithreaded) {
+  const int num_threads = ThreadPool::Get().num_threads();
+  ThreadPool::Get().set_num_threads(4);
+  TestExact(40, 300, 300);
+  ThreadPool::Get().set_num_threads(num_threads);
+}
+
+TEST_F(Int8GemmTest, TestTransposedWeights) {
+  const int M = 5, K = 9;
+  vector<float> weights(M * K), transposed(K * M);
+  for (int m = 0; m < M; ++m) {
+    for (int k = 0; k < K; ++k) {
+      weights[m * K + k] = transposed[k * M + m] = std::sin(m * K + k);
+    }
+  }
+  const int K4 = int8_padded_size(K);
+  vector<int8_t> quantized(M * K4), quantized_transposed(M * K4);
+  vector<float> scales(M), scales_transposed(M);
+  int8_quantize_weights(M, K, &weights[0], false, &quantized[0], &scales[0]);
+  int8_quantize_weights(M, K, &transposed[0], true, &quantized_transposed[0],
+      &scales_transposed[0]);
+  EXPECT_TRUE(quantized == quantized_transposed);
+  EXPECT_TRUE(scales == scales_transposed);
+  for (int m = 0; m < M; ++m) {
+    for (int k = K; k < K4; ++k) {
+      EXPECT_EQ(quantized[m * K4 + k], 0);
+    }
+  }
+}
+
+TEST_F(Int8GemmTest, TestBlobProtoRoundTrip) {
+  Blob<float> blob(4, 3, 2, 5);
+  FillerParameter filler_param;
+  GaussianFiller<float> filler(filler_param);
+  filler.Fill(&blob);
+  BlobProto proto;
+  blob.ToInt8Proto(&proto);
+  EXPECT_EQ(proto.data_size(), 0);
+  EXPECT_EQ(proto.int8_data().size(), blob.count());
+  EXPECT_EQ(proto.int8_scale_size(), blob.num());
+  Blob<float> restored;
+  restored.FromProto(proto);
+  EXPECT_TRUE(restored.shape() == blob.shape());
+  const int row = blob.count(1);
+  for (int i = 0; i < blob.count(); ++i) {
+    EXPECT_NEAR(restored.cpu_data()[i], blob.cpu_data()[i],
+        proto.int8_scale(i / row) / 2 + 1e-6);
+  }
+}
+
+}  // namespace caffe
@@ -1,6 +1,9 @@
 #include <stdint.h>  // for uint32_t & uint64_t
 #include <time.h>
+#include <algorithm>
+#include <cfloat>
 #include <cmath>  // for std::fabs
+#include <limits>
 
 #include "gtest/gtest.h"
 
@@ -8,6 +11,8 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/math_kernels.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
@@ -119,6 +124,243 @@ TYPED_TEST(CPUMathFunctionsTest, TestCopy) {
   }
 }
 
+// half is storage only on the CPU: the routines compute in float, so the
+// results match the float path up to the rounding of the output.
+class CPUHalfMathFunctionsTest : public ::testing::Test {
+ protected:
+  CPUHalfMathFunctionsTest() : M_(37), N_(131), K_(70) {}
+
+  virtual void SetUp() {
+    Caffe::set_random_seed(1701);
+    A_.resize(M_ * K_);
+    B_.resize(K_ * N_);
+    caffe_rng_uniform<float>(A_.size(), -1, 1, &A_[0]);
+    caffe_rng_uniform<float>(B_.size(), -1, 1, &B_[0]);
+    // Round the inputs to half first, so that both paths see the same values.
+    for (int i = 0; i < A_.size(); ++i) {
+      A_[i] = half2float_impl(float2half_impl(A_[i]));
+    }
+    for (int i = 0; i < B_.size(); ++i) {
+      B_[i] = half2float_impl(float2half_impl(B_[i]));
+    }
+  }
+
+  vector<half> ToHalf(const vector<float>& x) {
+    vector<half> y(x.size());
+    float2half(x.size(), &x[0], &y[0]);
+    return y;
+  }
+
+  const int M_;
+  const int N_;
+  const int K_;
+  vector<float> A_;
+  vector<float> B_;
+};
+
+TEST_F(CPUHalfMathFunctionsTest, TestGemm) {
+  const vector<half> A = ToHalf(A_);
+  const vector<half> B = ToHalf(B_);
+  for (int trans_b = 0; trans_b < 2; ++trans_b) {
+    const CBLAS_TRANSPOSE TransB = trans_b ? CblasTrans : CblasNoTrans;
+    vector<float> C(M_ * N_, 0.5);
+    vector<half> C_half = ToHalf(C);
+    // B is read as N x K when transposed, the same buffer either way.
+    caffe_cpu_gemm<float>(CblasNoTrans, TransB, M_, N_, K_, 1., &A_[0],
+        &B_[0], 2., &C[0]);
+    caffe_cpu_gemm<half>(CblasNoTrans, TransB, M_, N_, K_, 1., &A[0], &B[0],
+        2., &C_half[0]);
+    for (int i = 0; i < C.size(); ++i) {
+      EXPECT_NEAR(C[i], half2float_impl(C_half[i]),
+          std::fabs(C[i]) * 1e-3 + 1e-3);
+    }
+  }
+}
+
+TEST_F(CPUHalfMathFunctionsTest, TestGemv) {
+  const vector<half> A = ToHalf(A_);
+  const vector<half> x = ToHalf(B_);
+  vector<float> y(M_ + K_, 0);
+  vector<half> y_half = ToHalf(y);
+  caffe_cpu_gemv<float>(CblasNoTrans, M_, K_, 1., &A_[0], &B_[0], 0., &y[0]);
+  caffe_cpu_gemv<half>(CblasNoTrans, M_, K_, 1., &A[0], &x[0], 0.,
+      &y_half[0]);
+  caffe_cpu_gemv<float>(CblasTrans, M_, K_, 1., &A_[0], &B_[0], 0.,
+      &y[M_]);
+  caffe_cpu_gemv<half>(CblasTrans, M_, K_, 1., &A[0], &x[0], 0.,
+      &y_half[M_]);
+  for (int i = 0; i < y.size(); ++i) {
+    EXPECT_NEAR(y[i], half2float_impl(y_half[i]),
+        std::fabs(y[i]) * 1e-3 + 1e-3);
+  }
+}
+
+TEST_F(CPUHalfMathFunctionsTest, TestElementwise) {
+  const vector<half> a = ToHalf(A_);
+  vector<half> y(a.size());
+  caffe_add<half>(a.size(), &a[0], &a[0], &y[0]);
+  for (int i = 0; i < a.size(); ++i) {
+    EXPECT_EQ(y[i], float2half_impl(A_[i] + A_[i]));
+  }
+  caffe_abs<half>(a.size(), &a[0], &y[0]);
+  for (int i = 0; i < a.size(); ++i) {
+    EXPECT_EQ(y[i], float2half_impl(std::fabs(A_[i])));
+  }
+  const float asum = half2float_impl(caffe_cpu_asum<half>(a.size(), &a[0]));
+  const float std_asum = caffe_cpu_asum<float>(A_.size(), &A_[0]);
+  EXPECT_NEAR(asum, std_asum, std_asum * 1e-3);
+}
+
+// Every kernel set this CPU runs has to agree with the portable one:
+// exactly for the elementwise kernels, which round each result once, and
+// up to the order of the additions for the reductions.
+class MathKernelsTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    Caffe::set_random_seed(1701);
+    // Odd offsets and lengths leave every kernel unaligned remainders.
+    a_.resize(kSize + 1);
+    b_.resize(kSize + 1);
+    caffe_rng_uniform<float>(a_.size(), -2, 2, &a_[0]);
+    caffe_rng_uniform<float>(b_.size(), 0.5, 2, &b_[0]);
+  }
+
+  static const int kSize = 1000;
+  vector<float> a_;
+  vector<float> b_;
+};
+
+TEST_F(MathKernelsTest, TestAgainstScalar) {
+  const vector<const MathKernels*> kernels = supported_math_kernels();
+  ASSERT_GE(kernels.size(), 1);
+  EXPECT_EQ(&math_kernels(), kernels.back());
+  const MathKernels& ref = *kernels[0];
+  const int sizes[] = {0, 1, 7, 33, kSize};
+  for (int k = 1; k < kernels.size(); ++k) {
+    const MathKernels& test = *kernels[k];
+    for (int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+      const int n = sizes[s];
+      const float* a = &a_[1];
+      const float* b = &b_[0];
+      vector<float> y_ref(n + 1, 3), y(n + 1, 3);
+      // The kernels write their output, the last argument, to y_ref and y.
+#define EXPECT_SAME_OUTPUT(kernel, ...) \
+      ref.kernel(__VA_ARGS__, &y_ref[0]); \
+      test.kernel(__VA_ARGS__, &y[0]); \
+      for (int i = 0; i <= n; ++i) { \
+        EXPECT_EQ(y_ref[i], y[i]) << test.name << " " #kernel " " << i; \
+      }
+      EXPECT_SAME_OUTPUT(set, n, 0.5f);
+      EXPECT_SAME_OUTPUT(set, n, 0.f);
+      EXPECT_SAME_OUTPUT(add_scalar, n, 1.5f);
+      EXPECT_SAME_OUTPUT(scale, n, -0.75f, a);
+      EXPECT_SAME_OUTPUT(add, n, a, b);
+      EXPECT_SAME_OUTPUT(sub, n, a, b);
+      EXPECT_SAME_OUTPUT(mul, n, a, b);
+      EXPECT_SAME_OUTPUT(div, n, a, b);
+      EXPECT_SAME_OUTPUT(sqr, n, a);
+      EXPECT_SAME_OUTPUT(sqrt, n, b);
+      EXPECT_SAME_OUTPUT(abs, n, a);
+      EXPECT_SAME_OUTPUT(maximum, n, a, b);
+#undef EXPECT_SAME_OUTPUT
+      EXPECT_NEAR(ref.dot(n, a, b), test.dot(n, a, b), 1e-5 * n)
+          << test.name;
+      EXPECT_NEAR(ref.asum(n, a), test.asum(n, a), 1e-5 * n) << test.name;
+      EXPECT_NEAR(ref.sum(n, a), test.sum(n, a), 1e-5 * n) << test.name;
+      EXPECT_EQ(ref.max(n, a), test.max(n, a)) << test.name;
+    }
+  }
+}
+
+TEST_F(MathKernelsTest, TestTranscendentals) {
+  const vector<const MathKernels*> kernels = supported_math_kernels();
+  const MathKernels& ref = *kernels[0];
+  // Spread the inputs over most of the range of exp.
+  const int n = kSize;
+  vector<float> wide(n), positive(n);
+  for (int i = 0; i < n; ++i) {
+    wide[i] = a_[i] * 40;
+    positive[i] = std::exp(wide[i]);
+  }
+  for (int k = 1; k < kernels.size(); ++k) {
+    const MathKernels& test = *kernels[k];
+    vector<float> y_ref(n), y(n);
+    // Both are a few ulp from the exact result, libm included.
+#define EXPECT_CLOSE_OUTPUT(kernel, ...) \
+    ref.kernel(__VA_ARGS__, &y_ref[0]); \
+    test.kernel(__VA_ARGS__, &y[0]); \
+    for (int i = 0; i < n; ++i) { \
+      EXPECT_NEAR(y_ref[i], y[i], 4 * FLT_EPSILON * std::fabs(y_ref[i]) + \
+          FLT_MIN) << test.name << " " #kernel " " << i; \
+    }
+    EXPECT_CLOSE_OUTPUT(exp, n, &wide[0]);
+    EXPECT_CLOSE_OUTPUT(log, n, &positive[0]);
+    EXPECT_CLOSE_OUTPUT(tanh, n, &wide[0]);
+    EXPECT_CLOSE_OUTPUT(sigmoid, n, &wide[0]);
+    EXPECT_CLOSE_OUTPUT(powx, n, &b_[0], -0.75f);
+    EXPECT_CLOSE_OUTPUT(powx, n, &a_[0], 3.f);
+#undef EXPECT_CLOSE_OUTPUT
+    const float inf = std::numeric_limits<float>::infinity();
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const float special[] = {0, -0.f, inf, -inf, nan, 100, -100, FLT_MIN / 4};
+    const int m = sizeof(special) / sizeof(special[0]);
+    float out[m];
+    test.exp(m, special, out);
+    EXPECT_EQ(out[0], 1);
+    EXPECT_EQ(out[1], 1);
+    EXPECT_EQ(out[2], inf);
+    EXPECT_EQ(out[3], 0);
+    EXPECT_TRUE(std::isnan(out[4]));
+    EXPECT_EQ(out[5], inf);
+    EXPECT_EQ(out[6], 0);
+    test.log(m, special, out);
+    EXPECT_EQ(out[0], -inf);
+    EXPECT_EQ(out[1], -inf);
+    EXPECT_EQ(out[2], inf);
+    EXPECT_TRUE(std::isnan(out[3]));
+    EXPECT_TRUE(std::isnan(out[4]));
+    EXPECT_TRUE(std::isnan(out[6]));
+    EXPECT_NEAR(out[7], std::log(FLT_MIN / 4), 1e-5);
+    test.tanh(m, special, out);
+    EXPECT_EQ(out[2], 1);
+    EXPECT_EQ(out[3], -1);
+    EXPECT_TRUE(std::isnan(out[4]));
+    test.powx(m, special, -0.5f, out);
+    EXPECT_EQ(out[0], inf);
+    EXPECT_EQ(out[2], 0);
+    EXPECT_TRUE(std::isnan(out[6]));
+  }
+}
+
+TEST_F(MathKernelsTest, TestStrictMath) {
+  EXPECT_FALSE(strict_math());
+  EXPECT_EQ(&transcendental_math_kernels(), &math_kernels());
+  vector<float> y(kSize);
+  {
+    StrictMathScope scope(true);
+    EXPECT_TRUE(strict_math());
+    EXPECT_EQ(&transcendental_math_kernels(),
+        supported_math_kernels().front());
+    caffe_exp(kSize, &a_[0], &y[0]);
+    for (int i = 0; i < kSize; ++i) {
+      EXPECT_EQ(y[i], std::exp(a_[i]));
+    }
+    // The chunks of a parallel loop inherit the setting.
+    const int num_threads = ThreadPool::Get().num_threads();
+    ThreadPool::Get().set_num_threads(4);
+    vector<int> chunk_strict(kSize, 0);
+    parallel_for(kSize, 1, [&](int begin, int end) {
+      for (int i = begin; i < end; ++i) {
+        chunk_strict[i] = strict_math();
+      }
+    });
+    ThreadPool::Get().set_num_threads(num_threads);
+    EXPECT_TRUE(std::find(chunk_strict.begin(), chunk_strict.end(), 0) ==
+        chunk_strict.end());
+  }
+  EXPECT_FALSE(strict_math());
+}
+
 #ifdef USE_CUDNN
 
 template <typename Dtype>
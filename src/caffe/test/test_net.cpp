@@ -1,4 +1,10 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -11,6 +17,7 @@
 #include "caffe/net.hpp"
 #include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/weight_file.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -2447,6 +2454,601 @@ TYPED_TEST(NetTest, TestReshape) {
   EXPECT_FALSE(same_spatial_shape);
 }
 
+TYPED_TEST(NetTest, TestSharedWorkspace) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'TwoConvNetwork' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { "
+      "  shape: { dim: 1 dim: 3 dim: 10 dim: 10 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'conv1' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv1' "
+      "  convolution_param { "
+      "    num_output: 4 "
+      "    kernel_size: 3 "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'conv2' "
+      "  type: 'Convolution' "
+      "  bottom: 'conv1' "
+      "  top: 'conv2' "
+      "  convolution_param { "
+      "    num_output: 2 "
+      "    kernel_size: 3 "
+      "  } "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  // One buffer, sized for the larger im2col of the two layers:
+  // conv1 needs 3 * 3 * 3 x 8 * 8, conv2 needs 4 * 3 * 3 x 6 * 6.
+  const shared_ptr<Blob<Dtype> >& workspace = this->net_->workspace();
+  ASSERT_TRUE(workspace->data().get());
+  EXPECT_EQ(27 * 64 * sizeof(Dtype), workspace->data()->size());
+}
+
+TYPED_TEST(NetTest, TestOptimizeMemory) {
+  typedef typename TypeParam::Dtype Dtype;
+  // The planned net must compute the same output as the unplanned one while
+  // its activations take fewer bytes than one buffer per blob.
+  Caffe::set_mode(Caffe::CPU);
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype> input(1, 3, 100, 100);
+  filler.Fill(&input);
+
+  Caffe::set_random_seed(this->seed_);
+  this->InitReshapableNet();
+  EXPECT_EQ(0, this->net_->activation_memory());
+  caffe_copy(input.count(), input.cpu_data(),
+      this->net_->input_blobs()[0]->mutable_cpu_data());
+  this->net_->Forward();
+  const Blob<Dtype>* output_blob = this->net_->output_blobs()[0];
+  Blob<Dtype> expected;
+  expected.CopyFrom(*output_blob, false, true);
+  size_t blob_bytes = 0;
+  for (int i = 1; i < this->net_->blobs().size(); ++i) {
+    blob_bytes += this->net_->blobs()[i]->count() * sizeof(Dtype);
+  }
+
+  // Rebuild from ToProto so that the planned net carries the same weights.
+  NetParameter param;
+  this->net_->ToProto(&param);
+  param.set_optimize_memory(true);
+  this->net_.reset(new Net<Dtype>(param));
+  EXPECT_GT(this->net_->activation_memory(), 0);
+  EXPECT_LT(this->net_->activation_memory(), blob_bytes);
+  caffe_copy(input.count(), input.cpu_data(),
+      this->net_->input_blobs()[0]->mutable_cpu_data());
+  // Run twice: the second pass starts from memory the first pass reused.
+  this->net_->Forward();
+  this->net_->Forward();
+  output_blob = this->net_->output_blobs()[0];
+  ASSERT_EQ(expected.count(), output_blob->count());
+  for (int i = 0; i < expected.count(); ++i) {
+    EXPECT_FLOAT_EQ(expected.cpu_data()[i], output_blob->cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(NetTest, TestFoldBatchNorm) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'BatchNormNetwork' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { "
+      "  shape: { dim: 2 dim: 3 dim: 6 dim: 6 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'conv1' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv1' "
+      "  convolution_param { "
+      "    num_output: 4 "
+      "    kernel_size: 3 "
+      "    bias_term: false "
+      "    weight_filler { type: 'gaussian' std: 1 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'bn1' "
+      "  type: 'BatchNorm' "
+      "  bottom: 'conv1' "
+      "  top: 'conv1' "
+      "  batch_norm_param { use_global_stats: true } "
+      "} "
+      "layer { "
+      "  name: 'scale1' "
+      "  type: 'Scale' "
+      "  bottom: 'conv1' "
+      "  top: 'conv1' "
+      "  scale_param { bias_term: true } "
+      "} "
+      "layer { "
+      "  name: 'deconv2' "
+      "  type: 'Deconvolution' "
+      "  bottom: 'conv1' "
+      "  top: 'deconv2' "
+      "  convolution_param { "
+      "    num_output: 6 "
+      "    group: 2 "
+      "    kernel_size: 2 "
+      "    weight_filler { type: 'gaussian' std: 1 } "
+      "    bias_filler { type: 'gaussian' std: 1 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'bn2' "
+      "  type: 'BatchNorm' "
+      "  bottom: 'deconv2' "
+      "  top: 'deconv2' "
+      "  batch_norm_param { use_global_stats: true } "
+      "} ";
+  Caffe::set_mode(Caffe::CPU);
+  Caffe::set_random_seed(this->seed_);
+  this->InitNetFromProtoString(proto);
+  // Give the statistics and the scale non-trivial values.
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> gaussian(filler_param);
+  filler_param.set_min(0.5);
+  filler_param.set_max(2);
+  UniformFiller<Dtype> uniform(filler_param);
+  const char* bn_names[] = {"bn1", "bn2"};
+  for (int i = 0; i < 2; ++i) {
+    const shared_ptr<Layer<Dtype> > bn = this->net_->layer_by_name(bn_names[i]);
+    gaussian.Fill(bn->blobs()[0].get());
+    uniform.Fill(bn->blobs()[1].get());
+    uniform.Fill(bn->blobs()[2].get());
+  }
+  const shared_ptr<Layer<Dtype> > scale = this->net_->layer_by_name("scale1");
+  gaussian.Fill(scale->blobs()[0].get());
+  gaussian.Fill(scale->blobs()[1].get());
+  gaussian.Fill(this->net_->input_blobs()[0]);
+  Blob<Dtype> input;
+  input.CopyFrom(*this->net_->input_blobs()[0], false, true);
+  this->net_->Forward();
+  Blob<Dtype> expected;
+  expected.CopyFrom(*this->net_->output_blobs()[0], false, true);
+
+  NetParameter trained_param;
+  this->net_->ToProto(&trained_param);
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  param.set_fold_batch_norm(true);
+  this->net_.reset(new Net<Dtype>(param));
+  EXPECT_EQ(6, this->net_->layers().size());
+  EXPECT_TRUE(this->net_->CopyTrainedLayersFrom(trained_param));
+  ASSERT_EQ(3, this->net_->layers().size());
+  EXPECT_FALSE(this->net_->has_layer("bn1"));
+  EXPECT_FALSE(this->net_->has_layer("scale1"));
+  EXPECT_FALSE(this->net_->has_layer("bn2"));
+  EXPECT_EQ(2, this->net_->layer_by_name("conv1")->blobs().size());
+  EXPECT_EQ(4, this->net_->params().size());
+  caffe_copy(input.count(), input.cpu_data(),
+      this->net_->input_blobs()[0]->mutable_cpu_data());
+  this->net_->Forward();
+  const Blob<Dtype>* output = this->net_->output_blobs()[0];
+  ASSERT_EQ(expected.count(), output->count());
+  for (int i = 0; i < expected.count(); ++i) {
+    EXPECT_NEAR(expected.cpu_data()[i], output->cpu_data()[i],
+        1e-4 * std::max(Dtype(1), std::fabs(expected.cpu_data()[i])));
+  }
+  // Copying again would put unfolded weights into the folded convolution,
+  // so it is rejected and the net computes the same output.
+  EXPECT_FALSE(this->net_->CopyTrainedLayersFrom(trained_param));
+  EXPECT_EQ(3, this->net_->layers().size());
+  EXPECT_EQ(2, this->net_->layer_by_name("conv1")->blobs().size());
+  this->net_->Forward();
+  for (int i = 0; i < expected.count(); ++i) {
+    EXPECT_NEAR(expected.cpu_data()[i], output->cpu_data()[i],
+        1e-4 * std::max(Dtype(1), std::fabs(expected.cpu_data()[i])));
+  }
+}
+
+TYPED_TEST(NetTest, TestFuseActivations) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Each convolution is followed by one activation, in place or not. Only
+  // the in-place ones get fused; both nets must compute the same output.
+  const char* activations[][2] = {
+    {"ReLU", "relu_param { negative_slope: 0.1 }"},
+    {"PReLU", "prelu_param { filler { type: 'gaussian' std: 0.5 } }"},
+    {"ELU", "elu_param { alpha: 0.5 }"},
+    {"TanH", ""},
+    {"Sigmoid", ""},
+  };
+  const int kNumActivations = 5;
+  NetParameter params[2];
+  for (int in_place = 0; in_place < 2; ++in_place) {
+    std::ostringstream proto;
+    proto << "name: 'FusedNetwork' "
+          << "layer { name: 'data' type: 'Input' top: 'act-1' "
+          << "  input_param { shape: { dim: 2 dim: 3 dim: 5 dim: 5 } } } ";
+    for (int i = 0; i < kNumActivations; ++i) {
+      proto << "layer { name: 'conv" << i << "' "
+            << "  type: '" << (i == 2 ? "Deconvolution" : "Convolution") << "' "
+            << "  bottom: 'act" << i - 1 << "' top: 'conv" << i << "' "
+            << "  convolution_param { num_output: 4 kernel_size: 3 pad: 1 "
+            << "    weight_filler { type: 'gaussian' std: 0.5 } "
+            << "    bias_filler { type: 'gaussian' std: 0.5 } } } "
+            << "layer { name: 'act" << i << "' type: '" << activations[i][0]
+            << "' bottom: 'conv" << i << "' "
+            << "  top: '" << (in_place ? "conv" : "act") << i << "' "
+            << activations[i][1] << " } ";
+      if (in_place) {
+        proto << "layer { name: 'rename" << i << "' type: 'Split' "
+              << "  bottom: 'conv" << i << "' top: 'act" << i << "' } ";
+      }
+    }
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto.str(),
+        &params[in_place]));
+  }
+  Caffe::set_mode(Caffe::CPU);
+  Caffe::set_random_seed(this->seed_);
+  Net<Dtype> reference(params[0]);
+  NetParameter trained_param;
+  reference.ToProto(&trained_param);
+  Net<Dtype> fused(params[1]);
+  fused.CopyTrainedLayersFrom(trained_param);
+  for (int i = 0; i < fused.layers().size(); ++i) {
+    const bool is_activation = fused.layer_names()[i].compare(0, 3, "act") == 0;
+    EXPECT_EQ(is_activation, fused.layer_fused()[i]);
+  }
+  for (int i = 0; i < reference.layers().size(); ++i) {
+    EXPECT_FALSE(reference.layer_fused()[i]);
+  }
+
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(reference.input_blobs()[0]);
+  caffe_copy(reference.input_blobs()[0]->count(),
+      reference.input_blobs()[0]->cpu_data(),
+      fused.input_blobs()[0]->mutable_cpu_data());
+  reference.Forward();
+  fused.Forward();
+  for (int i = 0; i < kNumActivations; ++i) {
+    std::ostringstream name;
+    name << "act" << i;
+    const shared_ptr<Blob<Dtype> > expected = reference.blob_by_name(name.str());
+    const shared_ptr<Blob<Dtype> > output = fused.blob_by_name(name.str());
+    ASSERT_EQ(expected->count(), output->count());
+    for (int j = 0; j < expected->count(); ++j) {
+      EXPECT_NEAR(expected->cpu_data()[j], output->cpu_data()[j], 1e-5)
+          << activations[i][0];
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestForwardFromFusedActivation) {
+  typedef typename TypeParam::Dtype Dtype;
+  // sig1 is fused into conv1 across the unrelated conv2. A range starting
+  // after conv1 must still apply it, one starting at conv1 only once.
+  const string& proto =
+      "name: 'FusedNetwork' "
+      "layer { name: 'data' type: 'Input' top: 'data' "
+      "  input_param { shape: { dim: 2 dim: 3 dim: 5 dim: 5 } } } "
+      "layer { name: 'conv1' type: 'Convolution' bottom: 'data' top: 'conv1' "
+      "  convolution_param { num_output: 4 kernel_size: 3 pad: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.5 } "
+      "    bias_filler { type: 'gaussian' std: 0.5 } } } "
+      "layer { name: 'conv2' type: 'Convolution' bottom: 'data' top: 'conv2' "
+      "  convolution_param { num_output: 4 kernel_size: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.5 } } } "
+      "layer { name: 'sig1' type: 'Sigmoid' bottom: 'conv1' top: 'conv1' } ";
+  Caffe::set_mode(Caffe::CPU);
+  Caffe::set_random_seed(this->seed_);
+  this->InitNetFromProtoString(proto);
+  const vector<string>& names = this->net_->layer_names();
+  const int conv1_id = std::find(names.begin(), names.end(), "conv1") -
+      names.begin();
+  const int sig1_id = std::find(names.begin(), names.end(), "sig1") -
+      names.begin();
+  ASSERT_TRUE(this->net_->layer_fused()[sig1_id]);
+  FillerParameter filler_param;
+  filler_param.set_std(2);
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->net_->input_blobs()[0]);
+  Blob<Dtype>* conv1 = this->net_->blob_by_name("conv1").get();
+  this->net_->ForwardTo(conv1_id);
+  Blob<Dtype> activated;
+  activated.CopyFrom(*conv1, false, true);
+  Blob<Dtype> input;
+  input.ReshapeLike(*conv1);
+  filler.Fill(&input);
+  for (int start = conv1_id + 1; start <= sig1_id; ++start) {
+    conv1->CopyFrom(input);
+    this->net_->ForwardFromTo(start, sig1_id);
+    for (int i = 0; i < input.count(); ++i) {
+      EXPECT_NEAR(1 / (1 + std::exp(-input.cpu_data()[i])),
+          conv1->cpu_data()[i], 1e-5) << "start " << start;
+    }
+  }
+  this->net_->ForwardFromTo(conv1_id, sig1_id);
+  for (int i = 0; i < activated.count(); ++i) {
+    EXPECT_NEAR(activated.cpu_data()[i], conv1->cpu_data()[i], 1e-6);
+  }
+}
+
+TYPED_TEST(NetTest, TestShareDataViews) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Both Concats along the channels of a single image, a Slice of the
+  // first one and a Crop of the channels of a slice: every copy becomes a
+  // view, until a reshape makes the layers copy again.
+  const string& proto =
+      "name: 'ViewNetwork' "
+      "layer { name: 'data' type: 'Input' top: 'data' top: 'ref' "
+      "  input_param { shape: { dim: 1 dim: 3 dim: 6 dim: 6 } "
+      "    shape: { dim: 1 dim: 2 dim: 6 dim: 6 } } } "
+      "layer { name: 'conv1' type: 'Convolution' bottom: 'data' "
+      "  top: 'conv1' convolution_param { num_output: 4 kernel_size: 3 "
+      "    pad: 1 weight_filler { type: 'gaussian' std: 0.5 } } } "
+      "layer { name: 'relu1' type: 'ReLU' bottom: 'conv1' top: 'conv1' } "
+      "layer { name: 'conv2' type: 'Convolution' bottom: 'data' "
+      "  top: 'conv2' convolution_param { num_output: 4 kernel_size: 3 "
+      "    pad: 1 weight_filler { type: 'gaussian' std: 0.5 } } } "
+      "layer { name: 'concat1' type: 'Concat' bottom: 'conv1' "
+      "  bottom: 'conv2' top: 'concat1' } "
+      "layer { name: 'slice1' type: 'Slice' bottom: 'concat1' top: 'a' "
+      "  top: 'b' slice_param { slice_point: 3 } } "
+      "layer { name: 'crop1' type: 'Crop' bottom: 'a' bottom: 'ref' "
+      "  top: 'crop1' crop_param { axis: 1 offset: 1 offset: 0 offset: 0 } } "
+      "layer { name: 'relu2' type: 'ReLU' bottom: 'b' top: 'b' } "
+      "layer { name: 'conv3' type: 'Convolution' bottom: 'crop1' "
+      "  top: 'conv3' convolution_param { num_output: 2 kernel_size: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.5 } } } "
+      "layer { name: 'conv4' type: 'Convolution' bottom: 'b' "
+      "  top: 'conv4' convolution_param { num_output: 2 kernel_size: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.5 } } } "
+      "layer { name: 'concat2' type: 'Concat' bottom: 'conv3' "
+      "  bottom: 'conv4' top: 'out' } ";
+  Caffe::set_mode(Caffe::CPU);
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  Caffe::set_random_seed(this->seed_);
+  Net<Dtype> reference(param);
+  param.set_share_data_views(true);
+  param.set_optimize_memory(true);
+  Caffe::set_random_seed(this->seed_);
+  Net<Dtype> viewed(param);
+
+  const struct {
+    const char* name;
+    const char* parent;
+    int offset;
+  } views[] = {
+    {"conv1", "concat1", 0}, {"conv2", "concat1", 144},
+    {"a", "concat1", 0}, {"b", "concat1", 108}, {"crop1", "a", 36},
+    {"conv3", "out", 0}, {"conv4", "out", 72},
+  };
+  for (int i = 0; i < sizeof(views) / sizeof(views[0]); ++i) {
+    EXPECT_TRUE(viewed.blob_by_name(views[i].name)->IsDataViewOf(
+        *viewed.blob_by_name(views[i].parent), views[i].offset))
+        << views[i].name;
+    EXPECT_FALSE(reference.blob_by_name(views[i].name)->data_view());
+  }
+  EXPECT_FALSE(viewed.blob_by_name("data")->data_view());
+
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  for (int pass = 0; pass < 2; ++pass) {
+    if (pass == 1) {
+      // Different counts: the views are dropped and the layers copy.
+      for (int j = 0; j < 2; ++j) {
+        vector<int> shape = reference.input_blobs()[j]->shape();
+        shape[2] = shape[3] = 8;
+        reference.input_blobs()[j]->Reshape(shape);
+        viewed.input_blobs()[j]->Reshape(shape);
+      }
+      reference.Reshape();
+      viewed.Reshape();
+    }
+    Blob<Dtype>* input = reference.input_blobs()[0];
+    filler.Fill(input);
+    caffe_copy(input->count(), input->cpu_data(),
+        viewed.input_blobs()[0]->mutable_cpu_data());
+    reference.Forward();
+    // Twice: the second pass runs over what the first left in the views.
+    viewed.Forward();
+    viewed.Forward();
+    const Blob<Dtype>* expected = reference.output_blobs()[0];
+    const Blob<Dtype>* output = viewed.output_blobs()[0];
+    ASSERT_EQ(expected->count(), output->count());
+    for (int j = 0; j < expected->count(); ++j) {
+      EXPECT_FLOAT_EQ(expected->cpu_data()[j], output->cpu_data()[j])
+          << "pass " << pass;
+    }
+  }
+  EXPECT_FALSE(viewed.blob_by_name("conv1")->data_view());
+}
+
+TYPED_TEST(NetTest, TestShareDataViewsRewrittenInPlace) {
+  typedef typename TypeParam::Dtype Dtype;
+  // A Slice of one branch of a Split whose first output is rewritten in
+  // place: as a view the ReLU would clobber what the other branch still
+  // has to provide to 'tail', so only the untouched output is a view.
+  const string& proto =
+      "name: 'ViewNetwork' "
+      "layer { name: 'data' type: 'Input' top: 'data' "
+      "  input_param { shape: { dim: 1 dim: 3 dim: 4 dim: 4 } } } "
+      "layer { name: 'conv0' type: 'Convolution' bottom: 'data' "
+      "  top: 'conv0' convolution_param { num_output: 4 kernel_size: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.5 } } } "
+      "layer { name: 'slice1' type: 'Slice' bottom: 'conv0' top: 'a' "
+      "  top: 'b' slice_param { slice_point: 2 } } "
+      "layer { name: 'relu1' type: 'ReLU' bottom: 'a' top: 'a' } "
+      "layer { name: 'tail' type: 'Convolution' bottom: 'conv0' "
+      "  top: 'tail' convolution_param { num_output: 2 kernel_size: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.5 } } } ";
+  Caffe::set_mode(Caffe::CPU);
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  Caffe::set_random_seed(this->seed_);
+  Net<Dtype> reference(param);
+  param.set_share_data_views(true);
+  Caffe::set_random_seed(this->seed_);
+  Net<Dtype> viewed(param);
+
+  EXPECT_FALSE(viewed.blob_by_name("a")->data_view());
+  EXPECT_TRUE(viewed.blob_by_name("b")->IsDataViewOf(
+      *viewed.blob_by_name("conv0"), 32));
+
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype>* input = reference.input_blobs()[0];
+  filler.Fill(input);
+  caffe_copy(input->count(), input->cpu_data(),
+      viewed.input_blobs()[0]->mutable_cpu_data());
+  reference.Forward();
+  viewed.Forward();
+  const char* outputs[] = {"a", "b", "tail"};
+  for (int i = 0; i < 3; ++i) {
+    const Blob<Dtype>* expected = reference.blob_by_name(outputs[i]).get();
+    const Blob<Dtype>* output = viewed.blob_by_name(outputs[i]).get();
+    ASSERT_EQ(expected->count(), output->count());
+    for (int j = 0; j < expected->count(); ++j) {
+      EXPECT_FLOAT_EQ(expected->cpu_data()[j], output->cpu_data()[j])
+          << outputs[i];
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestReplicas) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'ReplicatedNetwork' "
+      "fold_batch_norm: true "
+      "optimize_memory: true "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { "
+      "  shape: { dim: 2 dim: 3 dim: 6 dim: 6 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'conv1' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv1' "
+      "  convolution_param { "
+      "    num_output: 4 "
+      "    kernel_size: 3 "
+      "    pad: 1 "
+      "    bias_term: false "
+      "    weight_filler { type: 'gaussian' std: 1 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'bn1' "
+      "  type: 'BatchNorm' "
+      "  bottom: 'conv1' "
+      "  top: 'conv1' "
+      "  batch_norm_param { use_global_stats: true } "
+      "} "
+      "layer { "
+      "  name: 'relu1' "
+      "  type: 'ReLU' "
+      "  bottom: 'conv1' "
+      "  top: 'conv1' "
+      "} "
+      "layer { "
+      "  name: 'ip2' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'conv1' "
+      "  top: 'ip2' "
+      "  inner_product_param { "
+      "    num_output: 5 "
+      "    weight_filler { type: 'gaussian' std: 1 } "
+      "    bias_filler { type: 'gaussian' std: 1 } "
+      "  } "
+      "} ";
+  Caffe::set_mode(Caffe::CPU);
+  Caffe::set_random_seed(this->seed_);
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  Net<Dtype> trained(param);
+  FillerParameter filler_param;
+  filler_param.set_min(0.5);
+  filler_param.set_max(2);
+  UniformFiller<Dtype> uniform(filler_param);
+  const shared_ptr<Layer<Dtype> > bn = trained.layer_by_name("bn1");
+  for (int i = 0; i < 3; ++i) {
+    uniform.Fill(bn->blobs()[i].get());
+  }
+  NetParameter trained_param;
+  trained.ToProto(&trained_param);
+  // The source is folded: its convolution has gained a bias.
+  Net<Dtype> source(param);
+  source.CopyTrainedLayersFrom(trained_param);
+  ASSERT_FALSE(source.has_layer("bn1"));
+
+  const int kNumReplicas = 2;
+  vector<shared_ptr<Net<Dtype> > > replicas;
+  for (int i = 0; i < kNumReplicas; ++i) {
+    replicas.push_back(shared_ptr<Net<Dtype> >(new Net<Dtype>(&source)));
+    const Net<Dtype>& replica = *replicas.back();
+    ASSERT_EQ(source.layers().size(), replica.layers().size());
+    for (int j = 0; j < source.layers().size(); ++j) {
+      const vector<shared_ptr<Blob<Dtype> > >& source_blobs =
+          source.layers()[j]->blobs();
+      const vector<shared_ptr<Blob<Dtype> > >& blobs =
+          replica.layers()[j]->blobs();
+      ASSERT_EQ(source_blobs.size(), blobs.size());
+      for (int k = 0; k < blobs.size(); ++k) {
+        EXPECT_EQ(source_blobs[k]->data(), blobs[k]->data());
+      }
+    }
+    EXPECT_NE(source.output_blobs()[0]->data(),
+        replica.output_blobs()[0]->data());
+    EXPECT_GT(replica.activation_memory(), 0);
+  }
+
+  // The replicas run concurrently, each on its own input.
+  GaussianFiller<Dtype> gaussian(filler_param);
+  vector<shared_ptr<Blob<Dtype> > > expected(kNumReplicas);
+  for (int i = 0; i < kNumReplicas; ++i) {
+    gaussian.Fill(source.input_blobs()[0]);
+    caffe_copy(source.input_blobs()[0]->count(),
+        source.input_blobs()[0]->cpu_data(),
+        replicas[i]->input_blobs()[0]->mutable_cpu_data());
+    source.Forward();
+    expected[i].reset(new Blob<Dtype>());
+    expected[i]->CopyFrom(*source.output_blobs()[0], false, true);
+  }
+  vector<std::thread> threads;
+  for (int i = 0; i < kNumReplicas; ++i) {
+    threads.push_back(std::thread([&replicas, i]() {
+      replicas[i]->Forward();
+    }));
+  }
+  for (int i = 0; i < kNumReplicas; ++i) {
+    threads[i].join();
+  }
+  for (int i = 0; i < kNumReplicas; ++i) {
+    const Blob<Dtype>* output = replicas[i]->output_blobs()[0];
+    ASSERT_EQ(expected[i]->count(), output->count());
+    for (int j = 0; j < output->count(); ++j) {
+      EXPECT_FLOAT_EQ(expected[i]->cpu_data()[j], output->cpu_data()[j]);
+    }
+  }
+}
+
 // TYPED_TEST(NetTest, TestSkipPropagateDown) {
 //   // check bottom_need_backward if propagate_down is true
 //   this->InitSkipPropNet(false);
@@ -2602,4 +3204,64 @@ TYPED_TEST(NetTest, TestReshape) {
 //   ASSERT_TRUE(found_data);
 // }
 
+TYPED_TEST(NetTest, TestWeightFile) {
+  typedef typename TypeParam::Dtype Dtype;
+  char file_template[] = "/tmp/caffe_test.XXXXXX";
+  const int fd = mkstemp(file_template);
+  ASSERT_GE(fd, 0);
+  close(fd);
+  const string file = file_template;
+  Caffe::set_random_seed(this->seed_);
+  this->InitSharedWeightsNet();
+  const shared_ptr<Net<Dtype> > source = this->net_;
+  source->ToWeightFile(file);
+  EXPECT_TRUE(IsWeightFile(file));
+  const Blob<Dtype>& weights =
+      *source->layer_by_name("innerproduct1")->blobs()[0];
+  // Both layers of the net loading the file see its weights.
+  this->InitSharedWeightsNet();
+  caffe_set(this->net_->params()[0]->count(), Dtype(0),
+      this->net_->params()[0]->mutable_cpu_data());
+  EXPECT_TRUE(this->net_->CopyTrainedLayersFrom(file));
+  for (int i = 1; i <= 2; ++i) {
+    ostringstream name;
+    name << "innerproduct" << i;
+    const Blob<Dtype>& loaded =
+        *this->net_->layer_by_name(name.str())->blobs()[0];
+    ASSERT_TRUE(loaded.shape() == weights.shape());
+    for (int j = 0; j < weights.count(); ++j) {
+      EXPECT_EQ(weights.cpu_data()[j], loaded.cpu_data()[j]);
+    }
+  }
+  // Writing to the mapped weights leaves the file alone.
+  this->net_->params()[0]->mutable_cpu_data()[0] = Dtype(42);
+  this->InitSharedWeightsNet();
+  this->net_->CopyTrainedLayersFrom(file);
+  EXPECT_EQ(weights.cpu_data()[0], this->net_->params()[0]->cpu_data()[0]);
+  // Half weights are converted.
+  source->ToWeightFile(file, true);
+  this->InitSharedWeightsNet();
+  this->net_->CopyTrainedLayersFrom(file);
+  const Blob<Dtype>& converted = *this->net_->params()[0];
+  for (int j = 0; j < weights.count(); ++j) {
+    EXPECT_NEAR(weights.cpu_data()[j], converted.cpu_data()[j],
+        1e-3 * std::fabs(weights.cpu_data()[j]));
+  }
+  // A truncated file is refused and leaves the weights alone.
+  source->ToWeightFile(file);
+  ASSERT_EQ(truncate(file.c_str(), 64), 0);
+  this->InitSharedWeightsNet();
+  caffe_set(this->net_->params()[0]->count(), Dtype(0),
+      this->net_->params()[0]->mutable_cpu_data());
+  EXPECT_FALSE(this->net_->CopyTrainedLayersFrom(file));
+  for (int j = 0; j < weights.count(); ++j) {
+    EXPECT_EQ(Dtype(0), this->net_->params()[0]->cpu_data()[j]);
+  }
+  MappedWeightFile mapped;
+  EXPECT_FALSE(mapped.Open(file));
+  EXPECT_TRUE(mapped.layers().empty());
+  remove(file.c_str());
+  EXPECT_FALSE(mapped.Open(file));
+}
+
 }  // namespace caffe
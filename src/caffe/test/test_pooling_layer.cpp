@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cfloat>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -572,6 +574,90 @@ TYPED_TEST(PoolingLayerTest, TestForwardAve) {
   EXPECT_NEAR(this->blob_top_->cpu_data()[8], 8.0 / 9, epsilon);
 }
 
+// Checks the separable kernels, and max pooling with the mask, against
+// pooling written out window by window, for the common configurations and
+// some with clipped windows.
+TYPED_TEST(PoolingLayerTest, TestForwardConfigurations) {
+  typedef typename TypeParam::Dtype Dtype;
+  const struct {
+    int kernel, stride, pad;
+    bool global;
+  } configs[] = {
+    {2, 2, 0, false}, {3, 2, 0, false}, {3, 1, 0, false}, {3, 1, 1, false},
+    {3, 2, 1, false}, {4, 3, 2, false}, {0, 1, 0, true},
+  };
+  this->blob_bottom_->Reshape(2, 3, 9, 11);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  const int height = 9, width = 11;
+  for (int c = 0; c < sizeof(configs) / sizeof(configs[0]); ++c) {
+    for (int max = 0; max < 2; ++max) {
+      LayerParameter layer_param;
+      PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+      if (configs[c].global) {
+        pooling_param->set_global_pooling(true);
+      } else {
+        pooling_param->set_kernel_size(configs[c].kernel);
+        pooling_param->set_stride(configs[c].stride);
+        pooling_param->set_pad(configs[c].pad);
+      }
+      pooling_param->set_pool(max ? PoolingParameter_PoolMethod_MAX :
+          PoolingParameter_PoolMethod_AVE);
+      const int kernel_h = configs[c].global ? height : configs[c].kernel;
+      const int kernel_w = configs[c].global ? width : configs[c].kernel;
+      const int stride = configs[c].stride;
+      const int pad = configs[c].pad;
+      PoolingLayer<Dtype> layer(layer_param);
+      layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      const int pooled_h = this->blob_top_->height();
+      const int pooled_w = this->blob_top_->width();
+      const Dtype* bottom_data = this->blob_bottom_->cpu_data();
+      const Dtype* top_data = this->blob_top_->cpu_data();
+      for (int plane = 0; plane < this->blob_bottom_->count(0, 2); ++plane) {
+        for (int ph = 0; ph < pooled_h; ++ph) {
+          for (int pw = 0; pw < pooled_w; ++pw) {
+            const int hstart = ph * stride - pad;
+            const int wstart = pw * stride - pad;
+            const int hend = std::min(hstart + kernel_h, height + pad);
+            const int wend = std::min(wstart + kernel_w, width + pad);
+            const int pool_size = (hend - hstart) * (wend - wstart);
+            float expected = max ? -FLT_MAX : 0;
+            for (int h = std::max(hstart, 0); h < std::min(hend, height);
+                ++h) {
+              for (int w = std::max(wstart, 0); w < std::min(wend, width);
+                  ++w) {
+                const float value =
+                    bottom_data[(plane * height + h) * width + w];
+                expected = max ? std::max(expected, value) :
+                    expected + value;
+              }
+            }
+            if (!max) {
+              expected /= pool_size;
+            }
+            EXPECT_NEAR(top_data[(plane * pooled_h + ph) * pooled_w + pw],
+                expected, 1e-5) << c << " " << max;
+          }
+        }
+      }
+      if (max) {
+        Blob<Dtype> top(this->blob_top_->shape());
+        top.CopyFrom(*this->blob_top_);
+        this->blob_top_vec_.push_back(this->blob_top_mask_);
+        PoolingLayer<Dtype> mask_layer(layer_param);
+        mask_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+        mask_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+        this->blob_top_vec_.pop_back();
+        for (int i = 0; i < top.count(); ++i) {
+          EXPECT_EQ(top.cpu_data()[i], this->blob_top_->cpu_data()[i]);
+        }
+      }
+    }
+  }
+}
+
 // TYPED_TEST(PoolingLayerTest, TestGradientAve) {
 //   typedef typename TypeParam::Dtype Dtype;
 //   for (int kernel_h = 3; kernel_h <= 4; kernel_h++) {
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cmath>
 #include <vector>
 
@@ -74,6 +75,58 @@ TYPED_TEST(SoftmaxLayerTest, TestForward) {
   }
 }
 
+TYPED_TEST(SoftmaxLayerTest, TestForwardAxesLargeInputs) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Inputs far beyond the range of exp, a shape spanning several blocks of
+  // columns, and every axis in turn, in place and not.
+  vector<int> shape(3);
+  shape[0] = 3;
+  shape[1] = 21;
+  shape[2] = 1000;
+  this->blob_bottom_->Reshape(shape);
+  FillerParameter filler_param;
+  filler_param.set_std(1000);
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  Blob<Dtype> input;
+  input.CopyFrom(*this->blob_bottom_, false, true);
+  for (int axis = 0; axis < 3; ++axis) {
+    for (int in_place = 0; in_place < 2; ++in_place) {
+      this->blob_bottom_->CopyFrom(input);
+      vector<Blob<Dtype>*> top_vec(1,
+          in_place ? this->blob_bottom_ : this->blob_top_);
+      LayerParameter layer_param;
+      layer_param.mutable_softmax_param()->set_axis(axis);
+      SoftmaxLayer<Dtype> layer(layer_param);
+      layer.SetUp(this->blob_bottom_vec_, top_vec);
+      layer.Forward(this->blob_bottom_vec_, top_vec);
+      const int outer = input.count(0, axis);
+      const int channels = input.shape(axis);
+      const int inner = input.count(axis + 1);
+      const Dtype* x = input.cpu_data();
+      const Dtype* y = top_vec[0]->cpu_data();
+      for (int i = 0; i < outer; ++i) {
+        for (int k = 0; k < inner; ++k) {
+          const int offset = i * channels * inner + k;
+          double max = x[offset];
+          for (int c = 1; c < channels; ++c) {
+            max = std::max<double>(max, x[offset + c * inner]);
+          }
+          double sum = 0;
+          for (int c = 0; c < channels; ++c) {
+            sum += std::exp(x[offset + c * inner] - max);
+          }
+          for (int c = 0; c < channels; ++c) {
+            EXPECT_NEAR(y[offset + c * inner],
+                std::exp(x[offset + c * inner] - max) / sum, 1e-5)
+                << "axis " << axis << " " << i << " " << c << " " << k;
+          }
+        }
+      }
+    }
+  }
+}
+
 // TYPED_TEST(SoftmaxLayerTest, TestGradient) {
 //   typedef typename TypeParam::Dtype Dtype;
 //   LayerParameter layer_param;
@@ -0,0 +1,88 @@
+#include <atomic>  // NOLINT(build/c++11)
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ThreadPoolTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    num_threads_ = ThreadPool::Get().num_threads();
+    ThreadPool::Get().set_num_threads(4);
+  }
+  virtual void TearDown() {
+    ThreadPool::Get().set_num_threads(num_threads_);
+  }
+
+  int num_threads_;
+};
+
+TEST_F(ThreadPoolTest, TestCoversRange) {
+  EXPECT_EQ(ThreadPool::Get().num_threads(), 4);
+  const int sizes[] = {0, 1, 3, 4, 7, 1000, 4099};
+  for (int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+    const int n = sizes[s];
+    vector<int> visits(n, 0);
+    std::atomic<int> chunks(0);
+    parallel_for(n, 1, [&](int begin, int end) {
+      EXPECT_LT(begin, end);
+      ++chunks;
+      for (int i = begin; i < end; ++i) {
+        ++visits[i];
+      }
+    });
+    for (int i = 0; i < n; ++i) {
+      EXPECT_EQ(visits[i], 1) << i << " of " << n;
+    }
+    EXPECT_LE(chunks, 4);
+  }
+}
+
+TEST_F(ThreadPoolTest, TestGrain) {
+  std::atomic<int> chunks(0);
+  parallel_for(100, 40, [&](int begin, int end) {
+    EXPECT_GE(end - begin, 40);
+    ++chunks;
+  });
+  EXPECT_EQ(chunks, 2);
+  chunks = 0;
+  parallel_for(100, 1000, [&](int begin, int end) {
+    EXPECT_EQ(begin, 0);
+    EXPECT_EQ(end, 100);
+    ++chunks;
+  });
+  EXPECT_EQ(chunks, 1);
+}
+
+TEST_F(ThreadPoolTest, TestNestedAndConcurrent) {
+  const int n = 64;
+  vector<std::atomic<int> > sums(4);
+  vector<std::thread> callers;
+  for (int t = 0; t < sums.size(); ++t) {
+    sums[t] = 0;
+    callers.push_back(std::thread([&sums, t] {
+      parallel_for(n, 1, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+          parallel_for(n, 1, [&](int inner_begin, int inner_end) {
+            sums[t] += inner_end - inner_begin;
+          });
+        }
+      });
+    }));
+  }
+  for (int t = 0; t < callers.size(); ++t) {
+    callers[t].join();
+  }
+  for (int t = 0; t < sums.size(); ++t) {
+    EXPECT_EQ(sums[t], n * n);
+  }
+}
+
+}  // namespace caffe
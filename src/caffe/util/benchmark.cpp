@@ -33,10 +33,7 @@ void Timer::Start() {
       clReleaseEvent(start_gpu_cl_);
 
 
-      cl_int ret;
-
-      cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "null_kernel_float", &ret);
-      OPENCL_CHECK(ret);
+      cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "null_kernel_float");
 
       int arg = 0;
       OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_int), (void *)&arg));  
@@ -73,10 +70,7 @@ void Timer::Stop() {
       clReleaseEvent(stop_gpu_cl_);
 
 
-      cl_int ret;
-
-      cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "null_kernel_float", &ret);
-      OPENCL_CHECK(ret);
+      cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "null_kernel_float");
 
       int arg = 0;
       OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_int), (void *)&arg));  
@@ -0,0 +1,198 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>  // NOLINT(readability/streams)
+#include <sstream>
+
+#include "caffe/util/conv_tuning.hpp"
+
+namespace caffe {
+
+namespace {
+
+inline bool is_vector_width(int width) {
+  return width == 1 || width == 2 || width == 4 || width == 8 || width == 16;
+}
+
+}  // namespace
+
+bool ConvTileConfig::IsValid() const {
+  if (!is_vector_width(vwm) || !is_vector_width(vwn)) {
+    return false;
+  }
+  if (wptm <= 0 || wptn <= 0 || rtsm <= 0 || rtsn <= 0 || tsk <= 0 ||
+      tsk_unroll <= 0) {
+    return false;
+  }
+  // The register blocks are walked vector by vector, and the K tile
+  // in steps of tsk_unroll.
+  if (wptm % vwm != 0 || wptn % vwn != 0 || tsk % tsk_unroll != 0) {
+    return false;
+  }
+  // Every thread loads the same number of elements of both local tiles.
+  const int threads = rtsm * rtsn;
+  return (tsm() * tsk) % threads == 0 && (tsn() * tsk) % threads == 0;
+}
+
+bool ConvTileConfig::operator==(const ConvTileConfig& other) const {
+  return vwm == other.vwm && vwn == other.vwn &&
+      tsk_unroll == other.tsk_unroll && wptm == other.wptm &&
+      wptn == other.wptn && rtsm == other.rtsm && rtsn == other.rtsn &&
+      tsk == other.tsk;
+}
+
+vector<ConvTileConfig> ConvTileCandidates(int M, int N, int K,
+    size_t max_work_group_size, size_t local_mem_size, size_t dtype_size) {
+  const ConvTileConfig default_config;
+  vector<ConvTileConfig> candidates(1, default_config);
+  const int rtsms[] = { 4, 8, 16 };
+  const int rtsns[] = { 8, 16, 32 };
+  const int wpts[] = { 2, 4, 8 };
+  const int tsks[] = { 8, 16 };
+  for (int a = 0; a < 3; ++a) {
+    for (int b = 0; b < 3; ++b) {
+      for (int c = 0; c < 3; ++c) {
+        for (int d = 0; d < 3; ++d) {
+          for (int e = 0; e < 2; ++e) {
+            ConvTileConfig config;
+            config.rtsm = rtsms[a];
+            config.rtsn = rtsns[b];
+            config.wptm = wpts[c];
+            config.wptn = wpts[d];
+            config.vwm = std::min(config.wptm, 4);
+            config.vwn = std::min(config.wptn, 4);
+            config.tsk = tsks[e];
+            config.tsk_unroll = 8;
+            if (config == default_config || !config.IsValid()) {
+              continue;
+            }
+            if (static_cast<size_t>(config.rtsm * config.rtsn) >
+                max_work_group_size) {
+              continue;
+            }
+            // Asub and Bsub, both padded by one element per row.
+            const size_t local_mem = dtype_size *
+                (config.tsm() * (config.tsk + 1) +
+                 config.tsk * (config.tsn() + 1));
+            if (local_mem > local_mem_size) {
+              continue;
+            }
+            // A tile twice as large as the matrix only computes padding.
+            if (config.tsm() >= 2 * M || config.tsn() >= 2 * N ||
+                config.tsk >= 2 * K) {
+              continue;
+            }
+            candidates.push_back(config);
+          }
+        }
+      }
+    }
+  }
+  return candidates;
+}
+
+ConvTuningDB& ConvTuningDB::Get() {
+  static ConvTuningDB db;
+  return db;
+}
+
+ConvTuningDB::ConvTuningDB() : tuning_(false), loaded_(false) {
+  const char* file = getenv("CAFFE_CONV_TUNING_FILE");
+  if (file) {
+    file_ = file;
+  }
+  const char* tuning = getenv("CAFFE_CONV_TUNE");
+  tuning_ = tuning && string(tuning) == "1";
+}
+
+string ConvTuningDB::file() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return file_;
+}
+
+void ConvTuningDB::set_file(const string& file) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  file_ = file;
+  loaded_ = false;
+  entries_.clear();
+}
+
+bool ConvTuningDB::tuning() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return tuning_;
+}
+
+void ConvTuningDB::set_tuning(bool tuning) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  tuning_ = tuning;
+}
+
+void ConvTuningDB::Load() {
+  loaded_ = true;
+  std::ifstream file(file_.c_str());
+  string line;
+  while (std::getline(file, line)) {
+    std::istringstream fields(line);
+    string key;
+    ConvTileConfig config;
+    if (!(fields >> key >> config.vwm >> config.vwn >> config.tsk_unroll
+          >> config.wptm >> config.wptn >> config.rtsm >> config.rtsn
+          >> config.tsk)) {
+      continue;
+    }
+    if (!config.IsValid()) {
+      LOG(WARNING) << "Ignoring invalid tuning entry for " << key << " in "
+          << file_;
+      continue;
+    }
+    entries_[key] = config;
+  }
+}
+
+bool ConvTuningDB::Lookup(const string& key, ConvTileConfig* config) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (file_.empty()) {
+    return false;
+  }
+  if (!loaded_) {
+    Load();
+  }
+  std::map<string, ConvTileConfig>::const_iterator it = entries_.find(key);
+  if (it == entries_.end()) {
+    return false;
+  }
+  *config = it->second;
+  return true;
+}
+
+void ConvTuningDB::Store(const string& key, const ConvTileConfig& config) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (file_.empty()) {
+    return;
+  }
+  if (!loaded_) {
+    Load();
+  }
+  entries_[key] = config;
+  // Write to a private name first, so that a concurrent reader never sees
+  // a partial file.
+  std::stringstream tmp_path;
+  tmp_path << file_ << "." << getpid() << ".tmp";
+  std::ofstream file(tmp_path.str().c_str());
+  for (std::map<string, ConvTileConfig>::const_iterator it = entries_.begin();
+       it != entries_.end(); ++it) {
+    const ConvTileConfig& c = it->second;
+    file << it->first << " " << c.vwm << " " << c.vwn << " " << c.tsk_unroll
+         << " " << c.wptm << " " << c.wptn << " " << c.rtsm << " " << c.rtsn
+         << " " << c.tsk << std::endl;
+  }
+  file.close();
+  if (!file || rename(tmp_path.str().c_str(), file_.c_str()) != 0) {
+    LOG(WARNING) << "Cannot write convolution tuning file " << file_;
+    remove(tmp_path.str().c_str());
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,131 @@
+#include <string>
+
+#include "caffe/util/cpu_features.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__GNUC__)
+#include <cpuid.h>
+#define CAFFE_CPU_X86
+#endif
+#elif defined(__arm__) || defined(__aarch64__)
+#if defined(__linux__)
+#include <sys/auxv.h>
+#define CAFFE_CPU_HWCAP
+#endif
+#endif
+
+namespace caffe {
+
+namespace {
+
+#ifdef CAFFE_CPU_X86
+
+void detect_x86(CpuFeatures* features) {
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    return;
+  }
+  features->sse2 = (edx & bit_SSE2) != 0;
+  const unsigned int avx = bit_OSXSAVE | bit_AVX;
+  if ((ecx & avx) != avx) {
+    return;
+  }
+  // The OS has to save the YMM state for anything VEX encoded.
+  unsigned int xcr0_low, xcr0_high;
+  __asm__("xgetbv" : "=a"(xcr0_low), "=d"(xcr0_high) : "c"(0));
+  if ((xcr0_low & 0x6) != 0x6) {
+    return;
+  }
+  features->f16c = (ecx & (bit_F16C | bit_SSE4_1)) == (bit_F16C | bit_SSE4_1);
+  const bool fma = (ecx & bit_FMA) != 0;
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+    return;
+  }
+  features->avx2 = fma && (ebx & bit_AVX2);
+  // And the opmask and upper ZMM state for AVX-512.
+  const bool zmm_state = (xcr0_low & 0xE0) == 0xE0;
+  features->avx512 = features->avx2 && zmm_state &&
+      (ebx & (bit_AVX512F | bit_AVX512VL)) == (bit_AVX512F | bit_AVX512VL);
+  features->avx512_vnni = features->avx512 && (ecx & bit_AVX512VNNI);
+}
+
+#endif  // CAFFE_CPU_X86
+
+#ifdef CAFFE_CPU_HWCAP
+
+// The bits of AT_HWCAP, spelled out for older kernel headers.
+#ifdef __aarch64__
+const unsigned long kHwcapAsimd = 1 << 1;  // NOLINT(runtime/int)
+const unsigned long kHwcapAsimdDp = 1 << 20;  // NOLINT(runtime/int)
+#else
+const unsigned long kHwcapHalf = 1 << 1;  // NOLINT(runtime/int)
+const unsigned long kHwcapNeon = 1 << 12;  // NOLINT(runtime/int)
+#endif
+
+void detect_hwcap(CpuFeatures* features) {
+  const unsigned long hwcap = getauxval(AT_HWCAP);  // NOLINT(runtime/int)
+#ifdef __aarch64__
+  features->neon = (hwcap & kHwcapAsimd) != 0;
+  // The conversions are part of ARMv8 itself.
+  features->neon_fp16 = features->neon;
+  features->neon_dotprod = features->neon && (hwcap & kHwcapAsimdDp);
+#else
+  features->neon = (hwcap & kHwcapNeon) != 0;
+  features->neon_fp16 = features->neon && (hwcap & kHwcapHalf);
+#endif
+}
+
+#endif  // CAFFE_CPU_HWCAP
+
+CpuFeatures detect() {
+  CpuFeatures features = CpuFeatures();
+#if defined(CAFFE_CPU_X86)
+  detect_x86(&features);
+#elif defined(CAFFE_CPU_HWCAP)
+  detect_hwcap(&features);
+#elif defined(__ARM_NEON)
+  // Without hwcaps, trust what the compiler was told.
+  features.neon = true;
+#if defined(__aarch64__) || (__ARM_FP & 2)
+  features.neon_fp16 = true;
+#endif
+#ifdef __ARM_FEATURE_DOTPROD
+  features.neon_dotprod = true;
+#endif
+#endif
+  return features;
+}
+
+}  // namespace
+
+const CpuFeatures& cpu_features() {
+  static const CpuFeatures features = detect();
+  return features;
+}
+
+std::string cpu_features_string() {
+  const CpuFeatures& features = cpu_features();
+  const struct {
+    bool present;
+    const char* name;
+  } names[] = {
+    {features.sse2, "sse2"},
+    {features.avx2, "avx2"},
+    {features.f16c, "f16c"},
+    {features.avx512, "avx512"},
+    {features.avx512_vnni, "avx512_vnni"},
+    {features.neon, "neon"},
+    {features.neon_fp16, "neon_fp16"},
+    {features.neon_dotprod, "neon_dotprod"},
+  };
+  std::string result;
+  for (int i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+    if (names[i].present) {
+      result += result.empty() ? "" : " ";
+      result += names[i].name;
+    }
+  }
+  return result.empty() ? "none" : result;
+}
+
+}  // namespace caffe
@@ -0,0 +1,89 @@
+#include <algorithm>
+
+#include "caffe/common.hpp"
+#include "caffe/util/depthwise.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+namespace {
+
+// The first and one past the last output column whose input column
+// x * stride + offset lies in [0, width).
+inline void valid_columns(const int offset, const int stride,
+    const int width, const int output_w, int* begin, int* end) {
+  *begin = offset >= 0 ? 0 : (-offset + stride - 1) / stride;
+  *end = width - offset <= 0 ? 0 :
+      std::min(output_w, (width - offset - 1) / stride + 1);
+}
+
+}  // namespace
+
+int depthwise_buffer_size(const int height, const int width,
+    const int output_w) {
+  return height * width + output_w;
+}
+
+template <typename Dtype>
+void depthwise_conv_cpu(const Dtype* input, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, const Dtype* weights,
+    const int num_output, const int output_h, const int output_w,
+    float* buffer, Dtype* output) {
+  const int multiplier = num_output / channels;
+  float* acc = buffer + height * width;
+  const float* plane = NULL;
+  for (int o = 0; o < num_output; ++o) {
+    if (o % multiplier == 0) {
+      plane = caffe_float_data(height * width,
+          input + (o / multiplier) * height * width, buffer);
+    }
+    const Dtype* weights_o = weights + o * kernel_h * kernel_w;
+    Dtype* output_o = output + o * output_h * output_w;
+    for (int y = 0; y < output_h; ++y) {
+      std::fill(acc, acc + output_w, 0.f);
+      for (int kh = 0; kh < kernel_h; ++kh) {
+        const int iy = y * stride_h - pad_h + kh * dilation_h;
+        if (iy < 0 || iy >= height) {
+          continue;
+        }
+        const float* row = plane + iy * width;
+        for (int kw = 0; kw < kernel_w; ++kw) {
+          const float w = caffe_to_float(weights_o[kh * kernel_w + kw]);
+          const int offset = kw * dilation_w - pad_w;
+          int begin, end;
+          valid_columns(offset, stride_w, width, output_w, &begin, &end);
+          // The row is contiguous with stride 1, so the loop vectorizes
+          // over the output width.
+          if (stride_w == 1) {
+            const float* src = row + offset;
+            for (int x = begin; x < end; ++x) {
+              acc[x] += w * src[x];
+            }
+          } else {
+            for (int x = begin; x < end; ++x) {
+              acc[x] += w * row[x * stride_w + offset];
+            }
+          }
+        }
+      }
+      caffe_from_float(output_w, acc, output_o + y * output_w);
+    }
+  }
+}
+
+template void depthwise_conv_cpu<float>(const float* input,
+    const int channels, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, const float* weights, const int num_output,
+    const int output_h, const int output_w, float* buffer, float* output);
+template void depthwise_conv_cpu<half>(const half* input,
+    const int channels, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, const half* weights, const int num_output,
+    const int output_h, const int output_w, float* buffer, half* output);
+
+}  // namespace caffe
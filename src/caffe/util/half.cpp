@@ -0,0 +1,200 @@
+#include "caffe/util/cpu_features.hpp"
+#include "caffe/util/half.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__GNUC__)
+#include <immintrin.h>
+#define CAFFE_HALF_F16C
+#endif
+#elif defined(USE_NEON_MATH) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CAFFE_HALF_NEON
+#endif
+
+// The vector converters reproduce float2half_impl and half2float_impl bit
+// for bit. The tables round half away from zero, overflow to inf and keep
+// NaNs signaling, while the hardware rounds to nearest even and quiets
+// NaNs, so the conversions are fixed up around the instructions.
+
+namespace {
+
+// float2half_impl truncates the mantissa by shift_table[e] bits and adds
+// the highest bit shifted out. Adding 1 << (shift - 1) to the float bits
+// first makes plain truncation give the same result: the shift is 13 for a
+// normal half and 126 - e for a denormal one. Exponents below 102 round to
+// zero and keep doing so with the largest bias, 1 << 23.
+
+#ifdef CAFFE_HALF_F16C
+
+__attribute__((target("f16c")))
+void float2half_f16c(const int n, const float* in, half_b* out) {
+  const __m128i abs_mask = _mm_set1_epi32(0x7FFFFFFF);
+  const __m128i mantissa_mask = _mm_set1_epi32(0x7FFFFF);
+  const __m128i sign_mask = _mm_set1_epi32(0x8000);
+  const __m128i inf = _mm_set1_epi32(0x7C00);
+  const __m128i float_inf = _mm_set1_epi32(0x7F800000);
+  // Everything from 65520 up rounds to inf.
+  const __m128i overflow = _mm_set1_epi32(0x477FF000 - 1);
+  // The bias shift 125 - e, clamped to [12, 23], as a float exponent.
+  const __m128i shift_base = _mm_set1_epi32(125 + 127);
+  const __m128i shift_min = _mm_set1_epi32(12 + 127);
+  const __m128i shift_max = _mm_set1_epi32(23 + 127);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m128i bits = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(in + i));
+    const __m128i abs_bits = _mm_and_si128(bits, abs_mask);
+    __m128i shift = _mm_sub_epi32(shift_base, _mm_srli_epi32(abs_bits, 23));
+    shift = _mm_min_epi32(_mm_max_epi32(shift, shift_min), shift_max);
+    const __m128i bias = _mm_cvttps_epi32(
+        _mm_castsi128_ps(_mm_slli_epi32(shift, 23)));
+    const __m128 biased = _mm_castsi128_ps(_mm_add_epi32(bits, bias));
+    __m128i result = _mm_cvtepu16_epi32(
+        _mm_cvtps_ph(biased, _MM_FROUND_TO_ZERO));
+    // Overflow, inf and NaN become inf with the top of a NaN payload.
+    const __m128i payload = _mm_and_si128(
+        _mm_cmpgt_epi32(abs_bits, float_inf),
+        _mm_srli_epi32(_mm_and_si128(bits, mantissa_mask), 13));
+    const __m128i special = _mm_or_si128(
+        _mm_and_si128(_mm_srli_epi32(bits, 16), sign_mask),
+        _mm_or_si128(inf, payload));
+    result = _mm_blendv_epi8(result, special,
+        _mm_cmpgt_epi32(abs_bits, overflow));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i),
+        _mm_packus_epi32(result, result));
+  }
+  for (; i < n; ++i) {
+    out[i] = float2half_impl(in[i]);
+  }
+}
+
+__attribute__((target("f16c")))
+void half2float_f16c(const int n, const half_b* in, float* out) {
+  const __m128i nan_bits = _mm_set1_epi32(0x7E00);
+  const __m128i inf = _mm_set1_epi32(0x7C00);
+  const __m128i quiet = _mm_set1_epi32(0x400000);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m128i h = _mm_loadl_epi64(
+        reinterpret_cast<const __m128i*>(in + i));
+    const __m128i bits = _mm_castps_si128(_mm_cvtph_ps(h));
+    // A signaling NaN comes out quiet; the tables keep the quiet bit clear.
+    const __m128i signaling = _mm_cmpeq_epi32(
+        _mm_and_si128(_mm_cvtepu16_epi32(h), nan_bits), inf);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+        _mm_andnot_si128(_mm_and_si128(signaling, quiet), bits));
+  }
+  for (; i < n; ++i) {
+    out[i] = half2float_impl(in[i]);
+  }
+}
+
+#endif  // CAFFE_HALF_F16C
+
+#ifdef CAFFE_HALF_NEON
+
+// The rounding mode of vcvt_f16_f32 comes from the FPU, so the narrowing
+// is done on the integer bits: the biased value is shifted down for a
+// normal half and scaled to the denormal grid otherwise.
+void float2half_neon(const int n, const float* in, half_b* out) {
+  const uint32x4_t abs_mask = vdupq_n_u32(0x7FFFFFFF);
+  const uint32x4_t mantissa_mask = vdupq_n_u32(0x7FFFFF);
+  const uint32x4_t sign_mask = vdupq_n_u32(0x8000);
+  const uint32x4_t inf = vdupq_n_u32(0x7C00);
+  const uint32x4_t float_inf = vdupq_n_u32(0x7F800000);
+  const uint32x4_t overflow = vdupq_n_u32(0x477FF000 - 1);
+  const uint32x4_t min_normal = vdupq_n_u32(0x38800000);
+  const uint32x4_t exponent_rebias = vdupq_n_u32(112 << 10);
+  const uint32x4_t one = vdupq_n_u32(1);
+  const int32x4_t shift_base = vdupq_n_s32(125);
+  const int32x4_t shift_min = vdupq_n_s32(12);
+  const int32x4_t shift_max = vdupq_n_s32(23);
+  const float32x4_t denormal_scale = vdupq_n_f32(16777216.f);  // 2^24
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const uint32x4_t bits = vreinterpretq_u32_f32(vld1q_f32(in + i));
+    const uint32x4_t abs_bits = vandq_u32(bits, abs_mask);
+    const int32x4_t exponent = vreinterpretq_s32_u32(
+        vshrq_n_u32(abs_bits, 23));
+    int32x4_t shift = vsubq_s32(shift_base, exponent);
+    shift = vminq_s32(vmaxq_s32(shift, shift_min), shift_max);
+    const uint32x4_t biased = vaddq_u32(abs_bits, vshlq_u32(one, shift));
+    const uint32x4_t normal = vsubq_u32(vshrq_n_u32(biased, 13),
+        exponent_rebias);
+    const uint32x4_t denormal = vcvtq_u32_f32(vmulq_f32(
+        vreinterpretq_f32_u32(biased), denormal_scale));
+    uint32x4_t result = vbslq_u32(vcgeq_u32(biased, min_normal), normal,
+        denormal);
+    const uint32x4_t payload = vandq_u32(vcgtq_u32(abs_bits, float_inf),
+        vshrq_n_u32(vandq_u32(bits, mantissa_mask), 13));
+    result = vbslq_u32(vcgtq_u32(abs_bits, overflow),
+        vorrq_u32(inf, payload), result);
+    result = vorrq_u32(result, vandq_u32(vshrq_n_u32(bits, 16), sign_mask));
+    vst1_u16(out + i, vmovn_u32(result));
+  }
+  for (; i < n; ++i) {
+    out[i] = float2half_impl(in[i]);
+  }
+}
+
+#if defined(__aarch64__) || (__ARM_FP & 2)
+#define CAFFE_HALF_NEON_FP16
+
+void half2float_neon(const int n, const half_b* in, float* out) {
+  const uint32x4_t nan_bits = vdupq_n_u32(0x7E00);
+  const uint32x4_t inf = vdupq_n_u32(0x7C00);
+  const uint32x4_t quiet = vdupq_n_u32(0x400000);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const uint16x4_t h = vld1_u16(in + i);
+    const uint32x4_t bits = vreinterpretq_u32_f32(
+        vcvt_f32_f16(vreinterpret_f16_u16(h)));
+    const uint32x4_t signaling = vceqq_u32(vandq_u32(vmovl_u16(h), nan_bits),
+        inf);
+    vst1q_f32(out + i, vreinterpretq_f32_u32(
+        vbicq_u32(bits, vandq_u32(signaling, quiet))));
+  }
+  for (; i < n; ++i) {
+    out[i] = half2float_impl(in[i]);
+  }
+}
+
+#endif  // __aarch64__ || (__ARM_FP & 2)
+
+#endif  // CAFFE_HALF_NEON
+
+}  // namespace
+
+void float2half(const int n, const float* in, half_b* out) {
+#if defined(CAFFE_HALF_F16C)
+  if (caffe::cpu_features().f16c) {
+    float2half_f16c(n, in, out);
+    return;
+  }
+#elif defined(CAFFE_HALF_NEON)
+  if (caffe::cpu_features().neon) {
+    float2half_neon(n, in, out);
+    return;
+  }
+#endif
+  for (int i = 0; i < n; ++i) {
+    out[i] = float2half_impl(in[i]);
+  }
+}
+
+void half2float(const int n, const half_b* in, float* out) {
+#if defined(CAFFE_HALF_F16C)
+  if (caffe::cpu_features().f16c) {
+    half2float_f16c(n, in, out);
+    return;
+  }
+#elif defined(CAFFE_HALF_NEON_FP16)
+  if (caffe::cpu_features().neon_fp16) {
+    half2float_neon(n, in, out);
+    return;
+  }
+#endif
+  for (int i = 0; i < n; ++i) {
+    out[i] = half2float_impl(in[i]);
+  }
+}
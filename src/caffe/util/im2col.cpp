@@ -1,7 +1,9 @@
+#include <algorithm>
 #include <vector>
 
 #include "caffe/util/im2col.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -27,31 +29,38 @@ void im2col_cpu(const Dtype* data_im, const int channels,
   const int output_w = (width + 2 * pad_w -
     (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
   const int channel_size = height * width;
-  for (int channel = channels; channel--; data_im += channel_size) {
-    for (int kernel_row = 0; kernel_row < kernel_h; kernel_row++) {
-      for (int kernel_col = 0; kernel_col < kernel_w; kernel_col++) {
-        int input_row = -pad_h + kernel_row * dilation_h;
-        for (int output_rows = output_h; output_rows; output_rows--) {
-          if (!is_a_ge_zero_and_a_lt_b(input_row, height)) {
-            for (int output_cols = output_w; output_cols; output_cols--) {
-              *(data_col++) = 0;
-            }
-          } else {
-            int input_col = -pad_w + kernel_col * dilation_w;
-            for (int output_col = output_w; output_col; output_col--) {
-              if (is_a_ge_zero_and_a_lt_b(input_col, width)) {
-                *(data_col++) = data_im[input_row * width + input_col];
-              } else {
-                *(data_col++) = 0;
+  const int col_channel_size = kernel_h * kernel_w * output_h * output_w;
+  // The channels are unrolled in parallel.
+  parallel_for(channels, std::max(1, kParallelGrain / col_channel_size),
+      [&](int begin, int end) {
+    for (int channel = begin; channel < end; ++channel) {
+      const Dtype* channel_im = data_im + channel * channel_size;
+      Dtype* col = data_col + channel * col_channel_size;
+      for (int kernel_row = 0; kernel_row < kernel_h; kernel_row++) {
+        for (int kernel_col = 0; kernel_col < kernel_w; kernel_col++) {
+          int input_row = -pad_h + kernel_row * dilation_h;
+          for (int output_rows = output_h; output_rows; output_rows--) {
+            if (!is_a_ge_zero_and_a_lt_b(input_row, height)) {
+              for (int output_cols = output_w; output_cols; output_cols--) {
+                *(col++) = 0;
+              }
+            } else {
+              int input_col = -pad_w + kernel_col * dilation_w;
+              for (int output_col = output_w; output_col; output_col--) {
+                if (is_a_ge_zero_and_a_lt_b(input_col, width)) {
+                  *(col++) = channel_im[input_row * width + input_col];
+                } else {
+                  *(col++) = 0;
+                }
+                input_col += stride_w;
               }
-              input_col += stride_w;
             }
+            input_row += stride_h;
           }
-          input_row += stride_h;
         }
       }
     }
-  }
+  });
 }
 
 // Explicit instantiation
@@ -66,6 +75,41 @@ template void im2col_cpu<half>(const half* data_im, const int channels,
     const int stride_w, const int dilation_h, const int dilation_w,
     half* data_col);
 
+template <typename Dtype>
+void im2col_1x1_cpu(const Dtype* data_im, const int channels,
+    const int height, const int width, const int stride_h,
+    const int stride_w, Dtype* data_col) {
+  const int output_h = (height - 1) / stride_h + 1;
+  const int output_w = (width - 1) / stride_w + 1;
+  const int channel_size = height * width;
+  const int col_channel_size = output_h * output_w;
+  parallel_for(channels, std::max(1, kParallelGrain / col_channel_size),
+      [&](int begin, int end) {
+    Dtype* col = data_col + begin * col_channel_size;
+    for (int channel = begin; channel < end; ++channel) {
+      const Dtype* channel_im = data_im + channel * channel_size;
+      for (int input_row = 0; input_row < height; input_row += stride_h) {
+        const Dtype* row = channel_im + input_row * width;
+        if (stride_w == 1) {
+          caffe_copy(width, row, col);
+          col += width;
+        } else {
+          for (int output_col = 0; output_col < output_w; ++output_col) {
+            *(col++) = row[output_col * stride_w];
+          }
+        }
+      }
+    }
+  });
+}
+
+template void im2col_1x1_cpu<float>(const float* data_im, const int channels,
+    const int height, const int width, const int stride_h,
+    const int stride_w, float* data_col);
+template void im2col_1x1_cpu<half>(const half* data_im, const int channels,
+    const int height, const int width, const int stride_h,
+    const int stride_w, half* data_col);
+
 template <typename Dtype>
 inline void im2col_nd_core_cpu(const Dtype* data_input, const bool im2col,
     const int num_spatial_axes, const int* im_shape, const int* col_shape,
@@ -117,7 +161,9 @@ inline void im2col_nd_core_cpu(const Dtype* data_input, const bool im2col,
           data_output[index_col] = data_input[index_im];
         }
       } else if (!is_padding) {  // col2im
-        data_output[index_im] += data_input[index_col];
+        data_output[index_im] = caffe_from_float<Dtype>(
+            caffe_to_float(data_output[index_im]) +
+            caffe_to_float(data_input[index_col]));
       }
       // Loop over spatial axes in reverse order to choose an index,
       // like counting.
@@ -183,7 +229,9 @@ void col2im_cpu(const Dtype* data_col, const int channels,
             int input_col = -pad_w + kernel_col * dilation_w;
             for (int output_col = output_w; output_col; output_col--) {
               if (is_a_ge_zero_and_a_lt_b(input_col, width)) {
-                data_im[input_row * width + input_col] += *data_col;
+                Dtype* pixel = data_im + input_row * width + input_col;
+                *pixel = caffe_from_float<Dtype>(
+                    caffe_to_float(*pixel) + caffe_to_float(*data_col));
               }
               data_col++;
               input_col += stride_w;
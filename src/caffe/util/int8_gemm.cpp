@@ -0,0 +1,270 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "caffe/common.hpp"
+#include "caffe/util/cpu_features.hpp"
+#include "caffe/util/int8_gemm.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__GNUC__)
+#include <immintrin.h>
+#define CAFFE_INT8_X86
+#endif
+#elif defined(USE_NEON_MATH) && defined(__aarch64__)
+#if defined(__ARM_FEATURE_DOTPROD)
+#include <arm_neon.h>
+#define CAFFE_INT8_DOTPROD
+#define CAFFE_INT8_DOTPROD_TARGET
+#elif defined(__GNUC__) && !defined(__clang__)
+// GCC declares the dot product intrinsics for functions targeting them, so
+// they are built into any ARMv8 binary and used where the CPU has them.
+#include <arm_neon.h>
+#define CAFFE_INT8_DOTPROD
+#define CAFFE_INT8_DOTPROD_TARGET \
+    __attribute__((target("arch=armv8.2-a+dotprod")))
+#endif
+#endif
+
+namespace caffe {
+
+namespace {
+
+// The product is computed in tiles of up to kBlockM rows and kBlockN
+// columns, a tile per task of the thread pool.
+const int kBlockM = 16;
+const int kBlockN = 64;
+
+// Computes acc[n] = sum_k a[k] * B(k, n) for one row of weights a and the
+// nb columns of the packed B starting at b. Packed blocks of four rows are
+// N * 4 bytes apart.
+typedef void (*Int8Kernel)(const int8_t* a, const int8_t* b, const int N,
+    const int K4, const int nb, int32_t* acc);
+
+void int8_kernel_generic(const int8_t* a, const int8_t* b, const int N,
+    const int K4, const int nb, int32_t* acc) {
+  for (int n = 0; n < nb; ++n) {
+    acc[n] = 0;
+  }
+  for (int k = 0; k < K4; k += 4) {
+    const int8_t* b_k = b + k * N;
+    for (int n = 0; n < nb; ++n) {
+      acc[n] += a[k] * b_k[4 * n] + a[k + 1] * b_k[4 * n + 1] +
+          a[k + 2] * b_k[4 * n + 2] + a[k + 3] * b_k[4 * n + 3];
+    }
+  }
+}
+
+#ifdef CAFFE_INT8_X86
+
+// Eight columns at a time: the 4 x 8 block of B is widened to int16 and
+// multiplied with the four weights by madd, which leaves two partial sums
+// per column to be added up at the end.
+__attribute__((target("avx2")))
+void int8_kernel_avx2(const int8_t* a, const int8_t* b, const int N,
+    const int K4, const int nb, int32_t* acc) {
+  int n = 0;
+  for (; n + 8 <= nb; n += 8) {
+    __m256i lo = _mm256_setzero_si256();
+    __m256i hi = _mm256_setzero_si256();
+    for (int k = 0; k < K4; k += 4) {
+      const int16_t a16[4] = {a[k], a[k + 1], a[k + 2], a[k + 3]};
+      int64_t a64;
+      std::memcpy(&a64, a16, sizeof(a64));
+      const __m256i w = _mm256_set1_epi64x(a64);
+      const __m256i x = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(b + k * N + 4 * n));
+      lo = _mm256_add_epi32(lo, _mm256_madd_epi16(
+          _mm256_cvtepi8_epi16(_mm256_castsi256_si128(x)), w));
+      hi = _mm256_add_epi32(hi, _mm256_madd_epi16(
+          _mm256_cvtepi8_epi16(_mm256_extracti128_si256(x, 1)), w));
+    }
+    // hadd leaves columns 0 1 4 5 | 2 3 6 7.
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + n),
+        _mm256_permute4x64_epi64(_mm256_hadd_epi32(lo, hi), 0xD8));
+  }
+  if (n < nb) {
+    int8_kernel_generic(a, b + 4 * n, N, K4, nb - n, acc + n);
+  }
+}
+
+// vpdpbusd multiplies unsigned with signed bytes, so B is offset by 128
+// (flipping the sign bit) and 128 times the sum of the weights taken off.
+__attribute__((target("avx2,avx512vl,avx512vnni")))
+void int8_kernel_vnni(const int8_t* a, const int8_t* b, const int N,
+    const int K4, const int nb, int32_t* acc) {
+  int32_t a_sum = 0;
+  for (int k = 0; k < K4; ++k) {
+    a_sum += a[k];
+  }
+  const __m256i flip = _mm256_set1_epi8(static_cast<char>(0x80));
+  const __m256i offset = _mm256_set1_epi32(128 * a_sum);
+  int n = 0;
+  for (; n + 8 <= nb; n += 8) {
+    __m256i sum = _mm256_setzero_si256();
+    for (int k = 0; k < K4; k += 4) {
+      int32_t a32;
+      std::memcpy(&a32, a + k, sizeof(a32));
+      const __m256i x = _mm256_xor_si256(flip, _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(b + k * N + 4 * n)));
+      sum = _mm256_dpbusd_epi32(sum, x, _mm256_set1_epi32(a32));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + n),
+        _mm256_sub_epi32(sum, offset));
+  }
+  if (n < nb) {
+    int8_kernel_generic(a, b + 4 * n, N, K4, nb - n, acc + n);
+  }
+}
+
+#endif  // CAFFE_INT8_X86
+
+#ifdef CAFFE_INT8_DOTPROD
+
+CAFFE_INT8_DOTPROD_TARGET
+void int8_kernel_dotprod(const int8_t* a, const int8_t* b, const int N,
+    const int K4, const int nb, int32_t* acc) {
+  int n = 0;
+  for (; n + 4 <= nb; n += 4) {
+    int32x4_t sum = vdupq_n_s32(0);
+    for (int k = 0; k < K4; k += 4) {
+      int32_t a32;
+      std::memcpy(&a32, a + k, sizeof(a32));
+      sum = vdotq_s32(sum, vld1q_s8(b + k * N + 4 * n),
+          vreinterpretq_s8_s32(vdupq_n_s32(a32)));
+    }
+    vst1q_s32(acc + n, sum);
+  }
+  if (n < nb) {
+    int8_kernel_generic(a, b + 4 * n, N, K4, nb - n, acc + n);
+  }
+}
+
+#endif  // CAFFE_INT8_DOTPROD
+
+Int8Kernel select_kernel() {
+#if defined(CAFFE_INT8_X86)
+  if (cpu_features().avx512_vnni) {
+    return int8_kernel_vnni;
+  }
+  if (cpu_features().avx2) {
+    return int8_kernel_avx2;
+  }
+#elif defined(CAFFE_INT8_DOTPROD)
+  if (cpu_features().neon_dotprod) {
+    return int8_kernel_dotprod;
+  }
+#endif
+  return int8_kernel_generic;
+}
+
+inline int8_t quantize(const float x) {
+  return static_cast<int8_t>(
+      std::lrint(std::max(-127.f, std::min(127.f, x))));
+}
+
+}  // namespace
+
+template <typename Dtype>
+void int8_quantize_weights(const int M, const int K, const Dtype* weights,
+    const bool transposed, int8_t* quantized, float* scales) {
+  const int K4 = int8_padded_size(K);
+  const int stride_m = transposed ? 1 : K;
+  const int stride_k = transposed ? M : 1;
+  for (int m = 0; m < M; ++m) {
+    const Dtype* row = weights + m * stride_m;
+    float range = 0;
+    for (int k = 0; k < K; ++k) {
+      range = std::max(range, std::fabs(caffe_to_float(row[k * stride_k])));
+    }
+    scales[m] = int8_scale(range);
+    const float inverse = range > 0 ? 1.f / scales[m] : 0.f;
+    int8_t* q = quantized + m * K4;
+    for (int k = 0; k < K; ++k) {
+      q[k] = quantize(caffe_to_float(row[k * stride_k]) * inverse);
+    }
+    std::fill(q + K, q + K4, 0);
+  }
+}
+
+template void int8_quantize_weights<float>(const int M, const int K,
+    const float* weights, const bool transposed, int8_t* quantized,
+    float* scales);
+template void int8_quantize_weights<half>(const int M, const int K,
+    const half* weights, const bool transposed, int8_t* quantized,
+    float* scales);
+
+template <typename Dtype>
+void int8_quantize_columns(const int K, const int N, const Dtype* data,
+    const int stride_k, const int stride_n, const float scale,
+    int8_t* packed) {
+  const float inverse = scale > 0 ? 1.f / scale : 0.f;
+  parallel_for(int8_padded_size(K) / 4, std::max(1, kParallelGrain / (4 * N)),
+      [&](int begin, int end) {
+    for (int block = begin; block < end; ++block) {
+      int8_t* out = packed + block * N * 4;
+      for (int j = 0; j < 4; ++j) {
+        const int k = block * 4 + j;
+        if (k < K) {
+          const Dtype* row = data + k * stride_k;
+          for (int n = 0; n < N; ++n) {
+            out[4 * n + j] = quantize(caffe_to_float(row[n * stride_n]) *
+                inverse);
+          }
+        } else {
+          for (int n = 0; n < N; ++n) {
+            out[4 * n + j] = 0;
+          }
+        }
+      }
+    }
+  });
+}
+
+template void int8_quantize_columns<float>(const int K, const int N,
+    const float* data, const int stride_k, const int stride_n,
+    const float scale, int8_t* packed);
+template void int8_quantize_columns<half>(const int K, const int N,
+    const half* data, const int stride_k, const int stride_n,
+    const float scale, int8_t* packed);
+
+template <typename Dtype>
+void int8_gemm(const int M, const int N, const int K, const int8_t* weights,
+    const float* weight_scales, const int8_t* packed, const float scale,
+    Dtype* output, const int stride_m, const int stride_n) {
+  static const Int8Kernel kernel = select_kernel();
+  const int K4 = int8_padded_size(K);
+  const int m_blocks = (M + kBlockM - 1) / kBlockM;
+  const int n_blocks = (N + kBlockN - 1) / kBlockN;
+  // Consecutive tiles share their columns, which stay in cache. A task is
+  // worth a thread from about 16 elementwise grains of multiply-adds on.
+  const int grain = std::max(1, kParallelGrain * 16 / (kBlockM * kBlockN * K4));
+  parallel_for(m_blocks * n_blocks, grain, [&](int begin, int end) {
+    int32_t acc[kBlockN];
+    for (int tile = begin; tile < end; ++tile) {
+      const int m0 = (tile % m_blocks) * kBlockM;
+      const int n0 = (tile / m_blocks) * kBlockN;
+      const int mb = std::min(kBlockM, M - m0);
+      const int nb = std::min(kBlockN, N - n0);
+      for (int m = m0; m < m0 + mb; ++m) {
+        kernel(weights + m * K4, packed + n0 * 4, N, K4, nb, acc);
+        const float s = weight_scales[m] * scale;
+        Dtype* out = output + m * stride_m + n0 * stride_n;
+        for (int n = 0; n < nb; ++n) {
+          out[n * stride_n] = caffe_from_float<Dtype>(acc[n] * s);
+        }
+      }
+    }
+  });
+}
+
+template void int8_gemm<float>(const int M, const int N, const int K,
+    const int8_t* weights, const float* weight_scales, const int8_t* packed,
+    const float scale, float* output, const int stride_m, const int stride_n);
+template void int8_gemm<half>(const int M, const int N, const int K,
+    const int8_t* weights, const float* weight_scales, const int8_t* packed,
+    const float scale, half* output, const int stride_m, const int stride_n);
+
+}  // namespace caffe
@@ -5,27 +5,93 @@
 #include <math.h>
 #endif // USE_BOOST
 
+#include <algorithm>
 #include <limits>
+#include <vector>
 
 #include "caffe/common.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/math_kernels.hpp"
 #include "caffe/util/rng.hpp"
 
 #if defined(__APPLE__) && defined(__MACH__)
 #include <vecLib.h>
-#elif defined(USE_NEON_MATH) && defined(__ARM_NEON)
-#include <arm_neon.h>
 #endif
 
 namespace caffe {
 
+// On the CPU half is a storage format only: the half routines convert
+// their operands to float a block at a time, compute with the float
+// routines and convert the result back.
+namespace {
+
+// Values per block of the elementwise routines, kept on the stack.
+const int kHalfBlock = 1024;
+// Floats per panel of the gemm and gemv operands.
+const int kHalfPanel = 64 * 1024;
+
+template <typename Op>
+void half_unary(const int n, const half* a, half* y, Op op) {
+  float block[kHalfBlock];
+  for (int i = 0; i < n; i += kHalfBlock) {
+    const int len = std::min(kHalfBlock, n - i);
+    half2float(len, a + i, block);
+    op(len, block);
+    float2half(len, block, y + i);
+  }
+}
+
+template <typename Op>
+void half_binary(const int n, const half* a, const half* b, half* y, Op op) {
+  float a_block[kHalfBlock];
+  float b_block[kHalfBlock];
+  for (int i = 0; i < n; i += kHalfBlock) {
+    const int len = std::min(kHalfBlock, n - i);
+    half2float(len, a + i, a_block);
+    half2float(len, b + i, b_block);
+    op(len, a_block, b_block);
+    float2half(len, a_block, y + i);
+  }
+}
+
+}  // namespace
 
 template<>
 void caffe_cpu_gemm<half>(const CBLAS_TRANSPOSE TransA,
     const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
     const float alpha, const half* A, const half* B, const float beta,
     half* C) {
-  NOT_IMPLEMENT;
+  // A is converted once, B and C a panel of columns at a time.
+  std::vector<float> A_float(M * K);
+  half2float(M * K, A, A_float.data());
+  const int lda = (TransA == CblasNoTrans) ? K : M;
+  const int panel = std::max(1, std::min(N, kHalfPanel / std::max(K, M)));
+  std::vector<float> B_panel(K * panel);
+  std::vector<float> C_panel(M * panel);
+  for (int j = 0; j < N; j += panel) {
+    const int cols = std::min(panel, N - j);
+    int ldb;
+    if (TransB == CblasNoTrans) {
+      for (int k = 0; k < K; ++k) {
+        half2float(cols, B + k * N + j, B_panel.data() + k * cols);
+      }
+      ldb = cols;
+    } else {
+      // The rows of B are the columns of op(B).
+      half2float(cols * K, B + j * K, B_panel.data());
+      ldb = K;
+    }
+    if (beta != 0) {
+      for (int i = 0; i < M; ++i) {
+        half2float(cols, C + i * N + j, C_panel.data() + i * cols);
+      }
+    }
+    cblas_sgemm(CblasRowMajor, TransA, TransB, M, cols, K, alpha,
+        A_float.data(), lda, B_panel.data(), ldb, beta, C_panel.data(), cols);
+    for (int i = 0; i < M; ++i) {
+      float2half(cols, C_panel.data() + i * cols, C + i * N + j);
+    }
+  }
 }
 
 
@@ -45,7 +111,30 @@ template <>
 void caffe_cpu_gemv<half>(const CBLAS_TRANSPOSE TransA, const int M,
     const int N, const float alpha, const half* A, const half* x,
     const float beta, half* y) {
-  NOT_IMPLEMENT;
+  const int x_size = (TransA == CblasNoTrans) ? N : M;
+  const int y_size = (TransA == CblasNoTrans) ? M : N;
+  std::vector<float> x_float(x_size);
+  std::vector<float> y_float(y_size, 0.f);
+  half2float(x_size, x, x_float.data());
+  if (beta != 0) {
+    half2float(y_size, y, y_float.data());
+  }
+  // A is converted a panel of rows at a time.
+  const int panel = std::max(1, std::min(M, kHalfPanel / N));
+  std::vector<float> A_panel(panel * N);
+  for (int i = 0; i < M; i += panel) {
+    const int rows = std::min(panel, M - i);
+    half2float(rows * N, A + i * N, A_panel.data());
+    if (TransA == CblasNoTrans) {
+      cblas_sgemv(CblasRowMajor, CblasNoTrans, rows, N, alpha, A_panel.data(),
+          N, x_float.data(), 1, beta, y_float.data() + i, 1);
+    } else {
+      // Every panel adds to all of y.
+      cblas_sgemv(CblasRowMajor, CblasTrans, rows, N, alpha, A_panel.data(),
+          N, x_float.data() + i, 1, i == 0 ? beta : 1.f, y_float.data(), 1);
+    }
+  }
+  float2half(y_size, y_float.data(), y);
 }
 
 template <>
@@ -58,7 +147,11 @@ void caffe_cpu_gemv<float>(const CBLAS_TRANSPOSE TransA, const int M,
 
 template <>
 void caffe_axpy<half>(const int N, const float alpha, const half* X,
-    half* Y) { NOT_IMPLEMENT; }
+    half* Y) {
+  half_binary(N, Y, X, Y, [alpha](int n, float* y, const float* x) {
+    cblas_saxpy(n, alpha, x, 1, y, 1);
+  });
+}
 
 template <>
 void caffe_axpy<float>(const int N, const float alpha, const float* X,
@@ -79,41 +172,14 @@ void caffe_set(const int N, const float alpha, half* Y) {
   }
 }
 
-#ifdef __VECLIB__
 template <>
 void caffe_set(const int N, const float alpha, float* Y) {
+#ifdef __VECLIB__
   vDSP_vfill(&alpha, Y, 1, N);
-}
-
-#elif defined(__ARM_NEON_H)
-template <>
-void caffe_set(const int N, const float alpha, float* Y) {
-  int tail_frames = N % 4;
-  const float* end = Y + N - tail_frames;
-  while (Y < end) {
-    float32x4_t alpha_dup = vld1q_dup_f32(&alpha);
-    vst1q_f32(Y, alpha_dup);
-    Y += 4;
-  }
-  for (int i = 0; i < tail_frames; ++i) {
-    Y[i] = alpha;
-  }
-}
-
 #else
-
-template <>
-void caffe_set(const int N, const float alpha, float* Y) {
-  if (alpha == 0) {
-    memset(Y, 0, sizeof(float) * N);  // NOLINT(caffe/alt_fn)
-    return;
-  }
-  for (int i = 0; i < N; ++i) {
-    Y[i] = alpha;
-  }
-}
-
+  math_kernels().set(N, alpha, Y);
 #endif
+}
 
 
 // template void caffe_set<half>(const int N, const float alpha, half* Y);
@@ -130,32 +196,23 @@ void caffe_set(const int N, const int alpha, int* Y) {
 }
 
 
-template <>
-void caffe_add_scalar(const int N, const float alpha, half* Y) { NOT_IMPLEMENT; }
 
 template <>
 void caffe_add_scalar(const int N, const float alpha, float* Y) {
 #ifdef __VECLIB__
   vDSP_vsadd(Y, 1, &alpha, Y, 1, N);
-#elif defined(__ARM_NEON_H)
-  int tail_frames = N % 4;
-  const float* end = Y + N - tail_frames;
-  while (Y < end) {
-    float32x4_t a_frame = vld1q_f32(Y);
-    float32x4_t alpha_dup = vld1q_dup_f32(&alpha);
-    vst1q_f32(Y, vaddq_f32(a_frame, alpha_dup));
-    Y += 4;
-  }
-  for (int i = 0; i < tail_frames; ++i) {
-    Y[i] += alpha;
-  }
 #else
-  for (int i = 0; i < N; ++i) {
-    Y[i] += alpha;
-  }
+  math_kernels().add_scalar(N, alpha, Y);
 #endif
 }
 
+template <>
+void caffe_add_scalar(const int N, const float alpha, half* Y) {
+  half_unary(N, Y, Y, [alpha](int n, float* y) {
+    caffe_add_scalar(n, alpha, y);
+  });
+}
+
 
 
 template <typename Dtype>
@@ -179,30 +236,15 @@ template void caffe_copy<unsigned int>(const int N, const unsigned int* X,
 
 template void caffe_copy<half>(const int N, const half* X, half* Y);
 
-#if defined(__ARM_NEON_H)
-template <>
-void caffe_copy<float>(const int N, const float* X, float* Y) {
-  int tail_frames = N % 4;
-  const float* end = Y + N - tail_frames;
-  while (Y < end) {
-    float32x4_t x_frame = vld1q_f32(X);
-    vst1q_f32(Y, x_frame);
-    X += 4;
-    Y += 4;
-  }
-  for (int i = 0; i < tail_frames; ++i) {
-    Y[i] = X[i];
-  }
-}
-#else
 template void caffe_copy<float>(const int N, const float* X, float* Y);
-#endif
 
 
 
 template <>
 void caffe_scal<half>(const int N, const float alpha, half *X) {
-  NOT_IMPLEMENT;
+  half_unary(N, X, X, [alpha](int n, float* x) {
+    cblas_sscal(n, alpha, x, 1);
+  });
 }
 
 template <>
@@ -216,7 +258,9 @@ void caffe_scal<float>(const int N, const float alpha, float *X) {
 template <>
 void caffe_cpu_axpby<half>(const int N, const float alpha, const half* X,
                             const float beta, half* Y) {
-  NOT_IMPLEMENT;
+  half_binary(N, Y, X, Y, [alpha, beta](int n, float* y, const float* x) {
+    cblas_saxpby(n, alpha, x, 1, beta, y, 1);
+  });
 }
 
 template <>
@@ -227,37 +271,27 @@ void caffe_cpu_axpby<float>(const int N, const float alpha, const float* X,
 
 
 
-template <>
-void caffe_add<half>(const int n, const half* a, const half* b,
-    half* y) { NOT_IMPLEMENT; }
 
 template <>
 void caffe_add<float>(const int n, const float* a, const float* b,
     float* y) {
 #ifdef __VECLIB__
   vDSP_vadd(a, 1, b, 1, y, 1, n);
-#elif defined(__ARM_NEON_H)
-  int tail_frames = n % 4;
-  const float* end = y + n - tail_frames;
-  while (y < end) {
-    float32x4_t a_frame = vld1q_f32(a);
-    float32x4_t b_frame = vld1q_f32(b);
-    vst1q_f32(y, vaddq_f32(a_frame, b_frame));
-    a += 4;
-    b += 4;
-    y += 4;
-  }
-  vsAdd(tail_frames, a, b, y);
 #else
-  vsAdd(n, a, b, y);
+  math_kernels().add(n, a, b, y);
 #endif
 }
 
+template <>
+void caffe_add<half>(const int n, const half* a, const half* b,
+    half* y) {
+  half_binary(n, a, b, y, [](int len, float* a, const float* b) {
+    caffe_add<float>(len, a, b, a);
+  });
+}
+
 
 
-template <>
-void caffe_sub<half>(const int n, const half* a, const half* b,
-    half* y) { NOT_IMPLEMENT; }
 
 
 template <>
@@ -265,28 +299,21 @@ void caffe_sub<float>(const int n, const float* a, const float* b,
     float* y) {
 #ifdef __VECLIB__
   vDSP_vsub(a, 1, b, 1, y, 1, n);
-#elif defined(__ARM_NEON_H)
-  int tail_frames = n % 4;
-  const float* end = y + n - tail_frames;
-  while (y < end) {
-    float32x4_t a_frame = vld1q_f32(a);
-    float32x4_t b_frame = vld1q_f32(b);
-    vst1q_f32(y, vsubq_f32(a_frame, b_frame));
-    a += 4;
-    b += 4;
-    y += 4;
-  }
-  vsSub(tail_frames, a, b, y);
 #else
-  vsSub(n, a, b, y);
+  math_kernels().sub(n, a, b, y);
 #endif
 }
 
+template <>
+void caffe_sub<half>(const int n, const half* a, const half* b,
+    half* y) {
+  half_binary(n, a, b, y, [](int len, float* a, const float* b) {
+    caffe_sub<float>(len, a, b, a);
+  });
+}
+
 
 
-template <>
-void caffe_mul<half>(const int n, const half* a, const half* b,
-    half* y) { NOT_IMPLEMENT; }
 
 
 template <>
@@ -294,92 +321,79 @@ void caffe_mul<float>(const int n, const float* a, const float* b,
     float* y) {
 #ifdef __VECLIB__
   vDSP_vmul(a, 1, b, 1, y, 1, n);
-#elif defined(__ARM_NEON_H)
-  int tail_frames = n % 4;
-  const float* end = y + n - tail_frames;
-  while (y < end) {
-    float32x4_t a_frame = vld1q_f32(a);
-    float32x4_t b_frame = vld1q_f32(b);
-    vst1q_f32(y, vmulq_f32(a_frame, b_frame));
-    a += 4;
-    b += 4;
-    y += 4;
-  }
-  vsMul(tail_frames, a, b, y);
 #else
-  vsMul(n, a, b, y);
+  math_kernels().mul(n, a, b, y);
 #endif
 }
 
+template <>
+void caffe_mul<half>(const int n, const half* a, const half* b,
+    half* y) {
+  half_binary(n, a, b, y, [](int len, float* a, const float* b) {
+    caffe_mul<float>(len, a, b, a);
+  });
+}
+
 
 
-template <>
-void caffe_div<half>(const int n, const half* a, const half* b,
-    half* y) { NOT_IMPLEMENT; }
 
 template <>
 void caffe_div<float>(const int n, const float* a, const float* b,
     float* y) {
 #ifdef __VECLIB__
   vDSP_vdiv(b, 1, a, 1, y, 1, n);
-#elif defined(__ARM_NEON_H)
-  int tail_frames = n % 4;
-  const float* end = y + n - tail_frames;
-  while (y < end) {
-    float32x4_t a_frame = vld1q_f32(a);
-    float32x4_t b_frame = vld1q_f32(b);
-    vst1q_f32(y, vdivq_f32(a_frame, b_frame));
-    a += 4;
-    b += 4;
-    y += 4;
-  }
-  vsDiv(tail_frames, a, b, y);
 #else
-  vsDiv(n, a, b, y);
+  math_kernels().div(n, a, b, y);
 #endif
 }
 
+template <>
+void caffe_div<half>(const int n, const half* a, const half* b,
+    half* y) {
+  half_binary(n, a, b, y, [](int len, float* a, const float* b) {
+    caffe_div<float>(len, a, b, a);
+  });
+}
+
 
 
-template <>
-void caffe_powx<half>(const int n, const half* a, const float b,
-    half* y) { NOT_IMPLEMENT; }
 
 template <>
 void caffe_powx<float>(const int n, const float* a, const float b,
     float* y) {
-  vsPowx(n, a, b, y);
+  transcendental_math_kernels().powx(n, a, b, y);
+}
+
+template <>
+void caffe_powx<half>(const int n, const half* a, const float b,
+    half* y) {
+  half_unary(n, a, y, [b](int len, float* a) {
+    caffe_powx<float>(len, a, b, a);
+  });
 }
 
 
 
 
-template <>
-void caffe_sqr<half>(const int n, const half* a, half* y) { NOT_IMPLEMENT; }
 
 template <>
 void caffe_sqr<float>(const int n, const float* a, float* y) {
 #ifdef __VECLIB__
   vDSP_vsq(a, 1, y, 1, n);
-#elif defined(__ARM_NEON_H)
-  int tail_frames = n % 4;
-  const float* end = y + n - tail_frames;
-  while (y < end) {
-    float32x4_t a_frame = vld1q_f32(a);
-    vst1q_f32(y, vmulq_f32(a_frame, a_frame));
-    a += 4;
-    y += 4;
-  }
-  vsSqr(tail_frames, a, y);
 #else
-  vsSqr(n, a, y);
+  math_kernels().sqr(n, a, y);
 #endif
 }
 
+template <>
+void caffe_sqr<half>(const int n, const half* a, half* y) {
+  half_unary(n, a, y, [](int len, float* a) {
+    caffe_sqr<float>(len, a, a);
+  });
+}
+
 
 
-template <>
-void caffe_sqrt<half>(const int n, const half* a, half* y) { NOT_IMPLEMENT; }
 
 
 
@@ -387,25 +401,20 @@ template <>
 void caffe_sqrt<float>(const int n, const float* a, float* y) {
 #ifdef __VECLIB__
   vvsqrtf(y, a, &n);
-#elif defined(__ARM_NEON_H)
-  int tail_frames = n % 4;
-  const float* end = y + n - tail_frames;
-  while (y < end) {
-    float32x4_t a_frame = vld1q_f32(a);
-    vst1q_f32(y, vsqrtq_f32(a_frame));
-    a += 4;
-    y += 4;
-  }
-  vsSqrt(tail_frames, a, y);
 #else
-  vsSqrt(n, a, y);
+  math_kernels().sqrt(n, a, y);
 #endif
 }
 
+template <>
+void caffe_sqrt<half>(const int n, const half* a, half* y) {
+  half_unary(n, a, y, [](int len, float* a) {
+    caffe_sqrt<float>(len, a, a);
+  });
+}
+
 
 
-template <>
-void caffe_exp<half>(const int n, const half* a, half* y) { NOT_IMPLEMENT; }
 
 
 
@@ -414,13 +423,18 @@ void caffe_exp<float>(const int n, const float* a, float* y) {
 #ifdef __VECLIB__
   vvexpf(y, a, &n);
 #else
-  vsExp(n, a, y);
+  transcendental_math_kernels().exp(n, a, y);
 #endif
 }
 
-
 template <>
-void caffe_log<half>(const int n, const half* a, half* y) { NOT_IMPLEMENT; }
+void caffe_exp<half>(const int n, const half* a, half* y) {
+  half_unary(n, a, y, [](int len, float* a) {
+    caffe_exp<float>(len, a, a);
+  });
+}
+
+
 
 
 template <>
@@ -428,35 +442,61 @@ void caffe_log<float>(const int n, const float* a, float* y) {
 #ifdef __VECLIB__
   vvlogf(y, a, &n);
 #else
-  vsLn(n, a, y);
+  transcendental_math_kernels().log(n, a, y);
 #endif
 }
 
+template <>
+void caffe_log<half>(const int n, const half* a, half* y) {
+  half_unary(n, a, y, [](int len, float* a) {
+    caffe_log<float>(len, a, a);
+  });
+}
+
+template <>
+void caffe_tanh<float>(const int n, const float* a, float* y) {
+  transcendental_math_kernels().tanh(n, a, y);
+}
+
+template <>
+void caffe_tanh<half>(const int n, const half* a, half* y) {
+  half_unary(n, a, y, [](int len, float* a) {
+    caffe_tanh<float>(len, a, a);
+  });
+}
 
+template <>
+void caffe_sigmoid<float>(const int n, const float* a, float* y) {
+  transcendental_math_kernels().sigmoid(n, a, y);
+}
 
 template <>
-void caffe_abs<half>(const int n, const half* a, half* y) { NOT_IMPLEMENT; }
+void caffe_sigmoid<half>(const int n, const half* a, half* y) {
+  half_unary(n, a, y, [](int len, float* a) {
+    caffe_sigmoid<float>(len, a, a);
+  });
+}
+
+
+
 
 
 template <>
 void caffe_abs<float>(const int n, const float* a, float* y) {
 #ifdef __VECLIB__
   vDSP_vabs(a, 1, y , 1, n);
-#elif defined(__ARM_NEON_H)
-  int tail_frames = n % 4;
-  const float* end = y + n - tail_frames;
-  while (y < end) {
-    float32x4_t a_frame = vld1q_f32(a);
-    vst1q_f32(y, vabsq_f32(a_frame));
-    a += 4;
-    y += 4;
-  }
-  vsAbs(tail_frames, a, y);
 #else
-  vsAbs(n, a, y);
+  math_kernels().abs(n, a, y);
 #endif
 }
 
+template <>
+void caffe_abs<half>(const int n, const half* a, half* y) {
+  half_unary(n, a, y, [](int len, float* a) {
+    caffe_abs<float>(len, a, a);
+  });
+}
+
 
 
 unsigned int caffe_rng_rand() {
@@ -479,7 +519,17 @@ float caffe_nextafter(const float b);
 // when using android ndk
 
 half caffe_nextafter(const half b) {
-  NOT_IMPLEMENT;
+  // Half values of one sign are ordered like their bits.
+  if ((b & 0x7FFF) > 0x7C00 || b == 0x7BFF) {
+    return b;  // NaN or the largest finite value
+  }
+  if (b == 0x7C00) {
+    return 0x7BFF;
+  }
+  if (b == 0x8000) {
+    return 0x0001;
+  }
+  return (b & 0x8000) ? b - 1 : b + 1;
 }
 
 float caffe_nextafter(const float b) {
@@ -599,7 +649,7 @@ void caffe_rng_bernoulli(const int n, const Dtype p, int* r) {
 
 template <>
 void caffe_rng_bernoulli<half>(const int n, const half p, int* r) {
-  NOT_IMPLEMENT;
+  caffe_rng_bernoulli<float>(n, half2float_impl(p), r);
 }
 
 
@@ -640,7 +690,11 @@ void caffe_rng_bernoulli<float>(const int n, const float p, unsigned int* r);
 template <>
 half caffe_cpu_strided_dot<half>(const int n, const half* x, const int incx,
     const half* y, const int incy) {
-  NOT_IMPLEMENT;
+  float sum = 0;
+  for (int i = 0; i < n; ++i) {
+    sum += half2float_impl(x[i * incx]) * half2float_impl(y[i * incy]);
+  }
+  return float2half_impl(sum);
 }
 
 template <>
@@ -650,40 +704,56 @@ float caffe_cpu_strided_dot<float>(const int n, const float* x, const int incx,
 }
 
 
-template <typename Dtype>
-Dtype caffe_cpu_dot(const int n, const Dtype* x, const Dtype* y) {
-  return caffe_cpu_strided_dot(n, x, 1, y, 1);
+template <>
+half caffe_cpu_dot<half>(const int n, const half* x, const half* y) {
+  float x_block[kHalfBlock];
+  float y_block[kHalfBlock];
+  float sum = 0;
+  for (int i = 0; i < n; i += kHalfBlock) {
+    const int len = std::min(kHalfBlock, n - i);
+    half2float(len, x + i, x_block);
+    half2float(len, y + i, y_block);
+    sum += math_kernels().dot(len, x_block, y_block);
+  }
+  return float2half_impl(sum);
 }
 
-template
-half caffe_cpu_dot<half>(const int n, const half* x, const half* y);
-
-template
-float caffe_cpu_dot<float>(const int n, const float* x, const float* y);
+template <>
+float caffe_cpu_dot<float>(const int n, const float* x, const float* y) {
+  return math_kernels().dot(n, x, y);
+}
 
 
 
 template <>
 half caffe_cpu_asum<half>(const int n, const half* x) {
-  NOT_IMPLEMENT;
+  float block[kHalfBlock];
+  float sum = 0;
+  for (int i = 0; i < n; i += kHalfBlock) {
+    const int len = std::min(kHalfBlock, n - i);
+    half2float(len, x + i, block);
+    sum += math_kernels().asum(len, block);
+  }
+  return float2half_impl(sum);
 }
 
 template <>
 float caffe_cpu_asum<float>(const int n, const float* x) {
-  return cblas_sasum(n, x, 1);
+  return math_kernels().asum(n, x);
 }
 
 template <>
 void caffe_cpu_scale<half>(const int n, const float alpha, const half *x,
                             half* y) {
-  NOT_IMPLEMENT;
+  half_unary(n, x, y, [alpha](int len, float* x) {
+    math_kernels().scale(len, alpha, x, x);
+  });
 }
 
 template <>
 void caffe_cpu_scale<float>(const int n, const float alpha, const float *x,
                             float* y) {
-  cblas_scopy(n, x, 1, y, 1);
-  cblas_sscal(n, alpha, y, 1);
+  math_kernels().scale(n, alpha, x, y);
 }
 
 }  // namespace caffe
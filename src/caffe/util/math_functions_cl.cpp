@@ -131,12 +131,8 @@ template <>
 void caffe_gpu_bsum<float>(const int m, const int n, const float* X, const float alpha, const float beta,
                             float* y, const int x_inc) {
 
-  cl_int ret;
-
-  cl_kernel kernel1 = clCreateKernel(Caffe::Get().math_program, "Xasum", &ret);
-  OPENCL_CHECK(ret);
-  cl_kernel kernel2 = clCreateKernel(Caffe::Get().math_program, "XasumEpilogue", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel1 = Caffe::Get().get_kernel(Caffe::Get().math_program, "Xasum");
+  cl_kernel kernel2 = Caffe::Get().get_kernel(Caffe::Get().math_program, "XasumEpilogue");
 
 
   size_t temp_size = 2*64;
@@ -151,11 +147,11 @@ void caffe_gpu_bsum<float>(const int m, const int n, const float* X, const float
 
 
 
-  size_t* local_size = new size_t[2];
+  size_t local_size[2];
   local_size[0] = static_cast<size_t>(64);
   local_size[1] = static_cast<size_t>(1);
 
-  size_t* global_size = new size_t[2];
+  size_t global_size[2];
   global_size[0] = static_cast<size_t>(temp_size * 64);
   global_size[1] = static_cast<size_t>(m);
 
@@ -172,7 +168,7 @@ void caffe_gpu_bsum<float>(const int m, const int n, const float* X, const float
 
   OPENCL_CHECK(clEnqueueNDRangeKernel(Caffe::Get().commandQueue, kernel2, 2, NULL, global_size, local_size, 0, NULL, NULL));  
  
-  // OPENCL_CHECK(clReleaseMemObject(temp_buffer));
+  OPENCL_CHECK(clReleaseMemObject(temp_buffer));
 
 
 }
@@ -182,11 +178,8 @@ template <>
 void caffe_gpu_bsum<half>(const int m, const int n, const half* X, const float alpha,  const float beta,
                             half* y, const int x_inc) {
   
-  cl_int ret;
-  cl_kernel kernel1 = clCreateKernel(Caffe::Get().math_program, "Xasum", &ret);
-  OPENCL_CHECK(ret);
-  cl_kernel kernel2 = clCreateKernel(Caffe::Get().math_program, "XasumEpilogue", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel1 = Caffe::Get().get_kernel(Caffe::Get().math_program, "Xasum");
+  cl_kernel kernel2 = Caffe::Get().get_kernel(Caffe::Get().math_program, "XasumEpilogue");
 
   half alpha_half = float2half_impl(alpha);
 
@@ -202,11 +195,11 @@ void caffe_gpu_bsum<half>(const int m, const int n, const half* X, const float a
   OPENCL_CHECK(clSetKernelArg(kernel1, 4, sizeof(cl_half), (void *)&alpha_half));  
 
 
-  size_t* local_size = new size_t[2];
+  size_t local_size[2];
   local_size[0] = static_cast<size_t>(64);
   local_size[1] = static_cast<size_t>(1);
 
-  size_t* global_size = new size_t[2];
+  size_t global_size[2];
   global_size[0] = static_cast<size_t>(temp_size * 64);
   global_size[1] = static_cast<size_t>(m);
 
@@ -224,6 +217,7 @@ void caffe_gpu_bsum<half>(const int m, const int n, const half* X, const float a
 
   OPENCL_CHECK(clEnqueueNDRangeKernel(Caffe::Get().commandQueue, kernel2, 2, NULL, global_size, local_size, 0, NULL, NULL));  
  
+  OPENCL_CHECK(clReleaseMemObject(temp_buffer));
 
 }
 
@@ -232,10 +226,7 @@ template <>
 void caffe_gpu_axpy<float>(const int N, const float alpha, const float* X,
     float* Y) {
       
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "axpy_kernel", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "axpy_kernel");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&X));  
@@ -253,9 +244,7 @@ template <>
 void caffe_gpu_axpy<half>(const int N, const float alpha, const half* X,
     half* Y) {
   
-  cl_int ret;
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "axpy_kernel", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "axpy_kernel");
 
   // Set arguments for kernel
   half alpha_half = float2half_impl(alpha);
@@ -293,10 +282,7 @@ void caffe_gpu_set(const int N, const int alpha, int *Y) {
 template <>
 void caffe_gpu_add_scalar<float>(const int N, const float alpha, float *X) {
   
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "add_scalar_kernel", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "add_scalar_kernel");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&X));  
@@ -313,10 +299,7 @@ void caffe_gpu_add_scalar<float>(const int N, const float alpha, float *X) {
 template <>
 void caffe_gpu_add_scalar<half>(const int N, const float alpha, half *X) {
   
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "add_scalar_kernel", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "add_scalar_kernel");
 
   half alpha_half = float2half_impl(alpha);
 
@@ -337,10 +320,7 @@ void caffe_gpu_add_scalar<half>(const int N, const float alpha, half *X) {
 template <>
 void caffe_gpu_scal<float>(const int N, const float alpha, float* X){
   
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "scal_kernel", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "scal_kernel");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&X));  
@@ -357,10 +337,7 @@ void caffe_gpu_scal<float>(const int N, const float alpha, float* X){
 template <>
 void caffe_gpu_scal<half>(const int N, const float alpha, half* X){
   
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "scal_kernel", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "scal_kernel");
 
   // Set arguments for kernel
   half alpha_half = float2half_impl(alpha);
@@ -394,10 +371,7 @@ void caffe_gpu_axpby<half>(const int N, const float alpha, const half* X,
 template <>
 void caffe_gpu_add<float>(const int N, const float* a, const float* b, float* y){
     
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "add_kernel", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "add_kernel");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&a));  
@@ -414,10 +388,7 @@ void caffe_gpu_add<float>(const int N, const float* a, const float* b, float* y)
 template <>
 void caffe_gpu_add<half>(const int N, const half* a, const half* b, half* y){
   
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "add_kernel", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "add_kernel");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&a));  
@@ -435,10 +406,7 @@ void caffe_gpu_add<half>(const int N, const half* a, const half* b, half* y){
 template <>
 void caffe_gpu_sub<float>(const int N, const float* a, const float* b, float* y){
     
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "sub_kernel", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "sub_kernel");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&a));  
@@ -455,10 +423,7 @@ void caffe_gpu_sub<float>(const int N, const float* a, const float* b, float* y)
 template <>
 void caffe_gpu_sub<half>(const int N, const half* a, const half* b, half* y){
   
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "sub_kernel", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "sub_kernel");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&a));  
@@ -475,10 +440,7 @@ void caffe_gpu_sub<half>(const int N, const half* a, const half* b, half* y){
 template <>
 void caffe_gpu_mul<float>(const int N, const float* a, const float* b, float* y){
   
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "mul_kernel", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "mul_kernel");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&a));  
@@ -497,10 +459,7 @@ void caffe_gpu_mul<float>(const int N, const float* a, const float* b, float* y)
 template <>
 void caffe_gpu_mul<half>(const int N, const half* a, const half* b, half* y){
   
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "mul_kernel", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "mul_kernel");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&a));  
@@ -516,10 +475,7 @@ void caffe_gpu_mul<half>(const int N, const half* a, const half* b, half* y){
 template <>
 void caffe_gpu_div<float>(const int N, const float* a, const float* b, float* y){
     
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "div_kernel", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "div_kernel");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&a));  
@@ -537,10 +493,7 @@ void caffe_gpu_div<float>(const int N, const float* a, const float* b, float* y)
 template <>
 void caffe_gpu_div<half>(const int N, const half* a, const half* b, half* y){
   
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "div_kernel", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "div_kernel");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&a));  
@@ -558,10 +511,7 @@ void caffe_gpu_div<half>(const int N, const half* a, const half* b, half* y){
 template <>
 void caffe_gpu_abs<float>(const int n, const float* a, float* y){
   
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "abs_kernel", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "abs_kernel");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&a));  
@@ -578,10 +528,7 @@ void caffe_gpu_abs<float>(const int n, const float* a, float* y){
 template <>
 void caffe_gpu_abs<half>(const int n, const half* a, half* y){
   
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "abs_kernel", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "abs_kernel");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&a));  
@@ -598,10 +545,7 @@ void caffe_gpu_abs<half>(const int n, const half* a, half* y){
 template <>
 void caffe_gpu_exp<float>(const int n, const float* a, float* y){
   
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "exp_kernel", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "exp_kernel");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&a));  
@@ -618,10 +562,7 @@ void caffe_gpu_exp<float>(const int n, const float* a, float* y){
 template <>
 void caffe_gpu_exp<half>(const int n, const half* a, half* y){
   
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "exp_kernel", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "exp_kernel");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&a));  
@@ -640,10 +581,7 @@ void caffe_gpu_exp<half>(const int n, const half* a, half* y){
 template <>
 void caffe_gpu_log<float>(const int n, const float* a, float* y){
   
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "log_kernel", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "log_kernel");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&a));  
@@ -660,10 +598,7 @@ void caffe_gpu_log<float>(const int n, const float* a, float* y){
 template <>
 void caffe_gpu_log<half>(const int n, const half* a, half* y){
   
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "log_kernel", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "log_kernel");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&a));  
@@ -681,10 +616,7 @@ void caffe_gpu_log<half>(const int n, const half* a, half* y){
 template <>
 void caffe_gpu_powx<float>(const int n, const float* a, const float b, float* y){
   
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "powx_kernel", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "powx_kernel");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&a));  
@@ -702,10 +634,7 @@ void caffe_gpu_powx<float>(const int n, const float* a, const float b, float* y)
 template <>
 void caffe_gpu_powx<half>(const int n, const half* a, const float b, half* y){
   
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "powx_kernel", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "powx_kernel");
 
   half b_half = float2half_impl(b);
 
@@ -727,10 +656,7 @@ void caffe_gpu_powx<half>(const int n, const half* a, const float b, half* y){
 template <>
 void caffe_gpu_sqrt<float>(const int n, const float* a, float* y){
       
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "sqrt_kernel", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "sqrt_kernel");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&a));  
@@ -856,10 +782,7 @@ void caffe_gpu_sgnbit<half>(const int n, const half* x, half* y){
 template <>
 void caffe_gpu_fabs<float>(const int n, const float* x, float* y){
   
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "abs_kernel", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "abs_kernel");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&x));  
@@ -874,10 +797,7 @@ void caffe_gpu_fabs<float>(const int n, const float* x, float* y){
 template <>
 void caffe_gpu_fabs<half>(const int n, const half* x, half* y){
   
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "abs_kernel", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "abs_kernel");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&x));  
@@ -913,10 +833,7 @@ void caffe_gpu_scale<half>(const int n, const float alpha, const half *x, half*
 template <>
 void caffe_gpu_sqrt<half>(const int n, const half* a, half* y){
   
-  cl_int ret;
-
-  cl_kernel kernel = clCreateKernel(Caffe::Get().math_program, "sqrt_kernel", &ret);
-  OPENCL_CHECK(ret);
+  cl_kernel kernel = Caffe::Get().get_kernel(Caffe::Get().math_program, "sqrt_kernel");
 
   // Set arguments for kernel
   OPENCL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&a));  
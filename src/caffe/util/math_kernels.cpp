@@ -0,0 +1,817 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "caffe/util/cpu_features.hpp"
+#include "caffe/util/math_kernels.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__GNUC__)
+#include <immintrin.h>
+#define CAFFE_MATH_X86
+#endif
+#elif defined(USE_NEON_MATH) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CAFFE_MATH_NEON
+#endif
+
+namespace caffe {
+
+namespace {
+
+namespace scalar {
+
+void set(const int n, const float alpha, float* y) {
+  if (alpha == 0) {
+    memset(y, 0, sizeof(float) * n);  // NOLINT(caffe/alt_fn)
+    return;
+  }
+  for (int i = 0; i < n; ++i) {
+    y[i] = alpha;
+  }
+}
+
+void add_scalar(const int n, const float alpha, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] += alpha;
+  }
+}
+
+void scale(const int n, const float alpha, const float* x, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = alpha * x[i];
+  }
+}
+
+void add(const int n, const float* a, const float* b, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = a[i] + b[i];
+  }
+}
+
+void sub(const int n, const float* a, const float* b, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = a[i] - b[i];
+  }
+}
+
+void mul(const int n, const float* a, const float* b, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = a[i] * b[i];
+  }
+}
+
+void div(const int n, const float* a, const float* b, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = a[i] / b[i];
+  }
+}
+
+void sqr(const int n, const float* a, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = a[i] * a[i];
+  }
+}
+
+void sqrt(const int n, const float* a, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = std::sqrt(a[i]);
+  }
+}
+
+void abs(const int n, const float* a, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = std::fabs(a[i]);
+  }
+}
+
+float dot(const int n, const float* x, const float* y) {
+  float sum = 0;
+  for (int i = 0; i < n; ++i) {
+    sum += x[i] * y[i];
+  }
+  return sum;
+}
+
+float asum(const int n, const float* x) {
+  float sum = 0;
+  for (int i = 0; i < n; ++i) {
+    sum += std::fabs(x[i]);
+  }
+  return sum;
+}
+
+void maximum(const int n, const float* a, const float* b, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = a[i] > b[i] ? a[i] : b[i];
+  }
+}
+
+float sum(const int n, const float* x) {
+  float sum = 0;
+  for (int i = 0; i < n; ++i) {
+    sum += x[i];
+  }
+  return sum;
+}
+
+float max(const int n, const float* x) {
+  float max = -FLT_MAX;
+  for (int i = 0; i < n; ++i) {
+    max = x[i] > max ? x[i] : max;
+  }
+  return max;
+}
+
+void exp(const int n, const float* a, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = std::exp(a[i]);
+  }
+}
+
+void log(const int n, const float* a, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = std::log(a[i]);
+  }
+}
+
+void powx(const int n, const float* a, const float b, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = std::pow(a[i], b);
+  }
+}
+
+void tanh(const int n, const float* a, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = std::tanh(a[i]);
+  }
+}
+
+void sigmoid(const int n, const float* a, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = 1 / (1 + std::exp(-a[i]));
+  }
+}
+
+}  // namespace scalar
+
+// Generates the kernels of one instruction set in the current namespace
+// from its vector type Vec of kWidth floats, its target attribute
+// CAFFE_MATH_TARGET and these primitives: vload, vstore, vsplat, vadd, vsub,
+// vmul, vdiv, vsqrt, vabs, vfma(a, b, c) = a * b + c, vsum, the sum of the
+// lanes, and vgt and vselect as below. The remainder of an array is left to
+// the scalar kernels.
+#define DEFINE_UNARY_KERNEL(name, op) \
+  CAFFE_MATH_TARGET void name(const int n, const float* a, float* y) { \
+    int i = 0; \
+    for (; i + kWidth <= n; i += kWidth) { \
+      vstore(y + i, op(vload(a + i))); \
+    } \
+    scalar::name(n - i, a + i, y + i); \
+  }
+
+#define DEFINE_BINARY_KERNEL(name, op) \
+  CAFFE_MATH_TARGET void name(const int n, const float* a, const float* b, \
+      float* y) { \
+    int i = 0; \
+    for (; i + kWidth <= n; i += kWidth) { \
+      vstore(y + i, op(vload(a + i), vload(b + i))); \
+    } \
+    scalar::name(n - i, a + i, b + i, y + i); \
+  }
+
+#define DEFINE_MATH_KERNELS \
+  CAFFE_MATH_TARGET void set(const int n, const float alpha, float* y) { \
+    const Vec v = vsplat(alpha); \
+    int i = 0; \
+    for (; i + kWidth <= n; i += kWidth) { \
+      vstore(y + i, v); \
+    } \
+    scalar::set(n - i, alpha, y + i); \
+  } \
+  CAFFE_MATH_TARGET void add_scalar(const int n, const float alpha, \
+      float* y) { \
+    const Vec v = vsplat(alpha); \
+    int i = 0; \
+    for (; i + kWidth <= n; i += kWidth) { \
+      vstore(y + i, vadd(vload(y + i), v)); \
+    } \
+    scalar::add_scalar(n - i, alpha, y + i); \
+  } \
+  CAFFE_MATH_TARGET void scale(const int n, const float alpha, \
+      const float* x, float* y) { \
+    const Vec v = vsplat(alpha); \
+    int i = 0; \
+    for (; i + kWidth <= n; i += kWidth) { \
+      vstore(y + i, vmul(vload(x + i), v)); \
+    } \
+    scalar::scale(n - i, alpha, x + i, y + i); \
+  } \
+  CAFFE_MATH_TARGET inline Vec vsqr(const Vec x) { \
+    return vmul(x, x); \
+  } \
+  DEFINE_BINARY_KERNEL(add, vadd) \
+  DEFINE_BINARY_KERNEL(sub, vsub) \
+  DEFINE_BINARY_KERNEL(mul, vmul) \
+  DEFINE_BINARY_KERNEL(div, vdiv) \
+  DEFINE_UNARY_KERNEL(sqr, vsqr) \
+  DEFINE_UNARY_KERNEL(sqrt, vsqrt) \
+  DEFINE_UNARY_KERNEL(abs, vabs) \
+  /* Two accumulators hide the latency of the additions. */ \
+  CAFFE_MATH_TARGET float dot(const int n, const float* x, const float* y) { \
+    Vec sum0 = vsplat(0); \
+    Vec sum1 = vsplat(0); \
+    int i = 0; \
+    for (; i + 2 * kWidth <= n; i += 2 * kWidth) { \
+      sum0 = vfma(vload(x + i), vload(y + i), sum0); \
+      sum1 = vfma(vload(x + i + kWidth), vload(y + i + kWidth), sum1); \
+    } \
+    return vsum(vadd(sum0, sum1)) + scalar::dot(n - i, x + i, y + i); \
+  } \
+  CAFFE_MATH_TARGET float asum(const int n, const float* x) { \
+    Vec sum0 = vsplat(0); \
+    Vec sum1 = vsplat(0); \
+    int i = 0; \
+    for (; i + 2 * kWidth <= n; i += 2 * kWidth) { \
+      sum0 = vadd(sum0, vabs(vload(x + i))); \
+      sum1 = vadd(sum1, vabs(vload(x + i + kWidth))); \
+    } \
+    return vsum(vadd(sum0, sum1)) + scalar::asum(n - i, x + i); \
+  } \
+  CAFFE_MATH_TARGET inline Vec vmaximum(const Vec a, const Vec b) { \
+    return vselect(vgt(a, b), a, b); \
+  } \
+  DEFINE_BINARY_KERNEL(maximum, vmaximum) \
+  CAFFE_MATH_TARGET float sum(const int n, const float* x) { \
+    Vec sum0 = vsplat(0); \
+    Vec sum1 = vsplat(0); \
+    int i = 0; \
+    for (; i + 2 * kWidth <= n; i += 2 * kWidth) { \
+      sum0 = vadd(sum0, vload(x + i)); \
+      sum1 = vadd(sum1, vload(x + i + kWidth)); \
+    } \
+    return vsum(vadd(sum0, sum1)) + scalar::sum(n - i, x + i); \
+  } \
+  CAFFE_MATH_TARGET float max(const int n, const float* x) { \
+    Vec max = vsplat(-FLT_MAX); \
+    int i = 0; \
+    for (; i + kWidth <= n; i += kWidth) { \
+      max = vmaximum(vload(x + i), max); \
+    } \
+    float lanes[kWidth]; \
+    vstore(lanes, max); \
+    return std::max(scalar::max(kWidth, lanes), \
+        scalar::max(n - i, x + i)); \
+  }
+
+// The splits of ln(2) into a part with few bits, exact in n * kLn2Hi, and
+// the rest; and the polynomial coefficients, all from Cephes.
+const float kLn2Hi = 0.693359375f;
+const float kLn2Lo = -2.12194440e-4f;
+const float kLog2e = 1.44269504088896341f;
+const float kExpMax = 88.7228391f;  // ln(FLT_MAX)
+const float kExpMin = -87.3365448f;  // ln(FLT_MIN)
+const float kExpP[] = {1.9875691500e-4f, 1.3981999507e-3f, 8.3334519073e-3f,
+    4.1665795894e-2f, 1.6666665459e-1f, 5.0000001201e-1f};
+const float kLogP[] = {7.0376836292e-2f, -1.1514610310e-1f, 1.1676998740e-1f,
+    -1.2420140846e-1f, 1.4249322787e-1f, -1.6668057665e-1f, 2.0000714765e-1f,
+    -2.4999993993e-1f, 3.3333331174e-1f};
+const float kTanhP[] = {-5.70498872745e-3f, 2.06390887954e-2f,
+    -5.37397155531e-2f, 1.33314422036e-1f, -3.33332819422e-1f};
+// Below this tanh is its odd polynomial, above 1 - 2 / (exp(2x) + 1).
+const float kTanhSmall = 0.625f;
+// Up to this integral exponents are multiplied out rather than exp(b log a).
+const float kPowiMax = 8;
+
+// Generates exp, log, powx, tanh and sigmoid from the primitives above and
+// vmin, vmax, vround (to the nearest integer), vpow2 (2^n for an integer n
+// in [-126, 127]), vfrexp (as frexp, for positive normal x), the
+// comparisons vlt, vgt, veq and visnan returning a Mask, and vselect(m, a,
+// b) = m ? a : b. The remainder of an array goes through the same
+// polynomials, so a result does not depend on where its chunk starts.
+#define DEFINE_POLY_KERNEL(name, op) \
+  CAFFE_MATH_TARGET void name(const int n, const float* a, float* y) { \
+    int i = 0; \
+    for (; i + kWidth <= n; i += kWidth) { \
+      vstore(y + i, op(vload(a + i))); \
+    } \
+    if (i < n) { \
+      float tail[kWidth] = {0}; \
+      memcpy(tail, a + i, sizeof(float) * (n - i));  /* NOLINT */ \
+      vstore(tail, op(vload(tail))); \
+      memcpy(y + i, tail, sizeof(float) * (n - i));  /* NOLINT */ \
+    } \
+  }
+
+#define DEFINE_TRANSCENDENTAL_KERNELS \
+  CAFFE_MATH_TARGET inline Vec vpoly(const Vec x, const float* p, \
+      const int degree) { \
+    Vec y = vsplat(p[0]); \
+    for (int i = 1; i <= degree; ++i) { \
+      y = vfma(y, x, vsplat(p[i])); \
+    } \
+    return y; \
+  } \
+  /* x = n ln(2) + r with |r| <= ln(2) / 2, and exp(r) a polynomial. */ \
+  CAFFE_MATH_TARGET inline Vec vexp(const Vec x) { \
+    const Vec c = vmax(vmin(x, vsplat(kExpMax)), vsplat(kExpMin)); \
+    const Vec n = vround(vmul(c, vsplat(kLog2e))); \
+    Vec r = vfma(n, vsplat(-kLn2Hi), c); \
+    r = vfma(n, vsplat(-kLn2Lo), r); \
+    const Vec p = vfma(vpoly(r, kExpP, 5), vmul(r, r), \
+        vadd(r, vsplat(1))); \
+    /* 2^n in two factors, since n reaches 128 just below FLT_MAX. */ \
+    const Vec half_n = vround(vmul(n, vsplat(0.5f))); \
+    Vec y = vmul(vmul(p, vpow2(half_n)), vpow2(vsub(n, half_n))); \
+    y = vselect(vgt(x, vsplat(kExpMax)), vsplat(INFINITY), y); \
+    y = vselect(vlt(x, vsplat(kExpMin)), vsplat(0), y); \
+    return vselect(visnan(x), x, y); \
+  } \
+  /* x = m 2^e with m in [sqrt(1/2), sqrt(2)), and log(m) a polynomial. */ \
+  CAFFE_MATH_TARGET inline Vec vlog(const Vec x) { \
+    const Mask subnormal = vlt(x, vsplat(FLT_MIN)); \
+    Vec e; \
+    Vec m = vfrexp(vselect(subnormal, vmul(x, vsplat(33554432.f)), x), &e); \
+    e = vselect(subnormal, vsub(e, vsplat(25)), e); \
+    const Mask low = vlt(m, vsplat(0.707106781186547524f)); \
+    e = vselect(low, vsub(e, vsplat(1)), e); \
+    m = vsub(vselect(low, vadd(m, m), m), vsplat(1)); \
+    const Vec z = vmul(m, m); \
+    Vec y = vmul(vmul(vpoly(m, kLogP, 8), m), z); \
+    y = vfma(e, vsplat(kLn2Lo), y); \
+    y = vfma(z, vsplat(-0.5f), y); \
+    y = vfma(e, vsplat(kLn2Hi), vadd(m, y)); \
+    y = vselect(vgt(x, vsplat(FLT_MAX)), x, y); \
+    y = vselect(veq(x, vsplat(0)), vsplat(-INFINITY), y); \
+    y = vselect(vlt(x, vsplat(0)), vsplat(NAN), y); \
+    return vselect(visnan(x), x, y); \
+  } \
+  CAFFE_MATH_TARGET inline Vec vtanh(const Vec x) { \
+    const Vec t = vexp(vadd(vabs(x), vabs(x))); \
+    Vec y = vsub(vsplat(1), vdiv(vsplat(2), vadd(t, vsplat(1)))); \
+    y = vselect(vlt(x, vsplat(0)), vsub(vsplat(0), y), y); \
+    const Vec z = vmul(x, x); \
+    const Vec small = vfma(vmul(vpoly(z, kTanhP, 4), z), x, x); \
+    return vselect(vlt(vabs(x), vsplat(kTanhSmall)), small, y); \
+  } \
+  CAFFE_MATH_TARGET inline Vec vsigmoid(const Vec x) { \
+    return vdiv(vsplat(1), vadd(vsplat(1), vexp(vsub(vsplat(0), x)))); \
+  } \
+  DEFINE_POLY_KERNEL(exp, vexp) \
+  DEFINE_POLY_KERNEL(log, vlog) \
+  DEFINE_POLY_KERNEL(tanh, vtanh) \
+  DEFINE_POLY_KERNEL(sigmoid, vsigmoid) \
+  /* Small integral powers by repeated squaring, which is more accurate. */ \
+  CAFFE_MATH_TARGET inline Vec vpowi(const Vec x, const int b) { \
+    Vec y = vsplat(1); \
+    Vec p = x; \
+    for (int i = b < 0 ? -b : b; i > 0; i >>= 1) { \
+      if (i & 1) { \
+        y = vmul(y, p); \
+      } \
+      p = vmul(p, p); \
+    } \
+    return b < 0 ? vdiv(vsplat(1), y) : y; \
+  } \
+  CAFFE_MATH_TARGET inline Vec vpowx(const Vec a, const float b) { \
+    if (b == std::floor(b) && std::fabs(b) <= kPowiMax) { \
+      return vpowi(a, static_cast<int>(b)); \
+    } \
+    const Vec y = vexp(vmul(vsplat(b), vlog(vabs(a)))); \
+    /* A negative base has a real power only for integral exponents. */ \
+    const float negative = b != std::floor(b) ? NAN : \
+        std::fmod(b, 2.f) == 0 ? 1 : -1; \
+    return vselect(vlt(a, vsplat(0)), vmul(y, vsplat(negative)), y); \
+  } \
+  CAFFE_MATH_TARGET void powx(const int n, const float* a, const float b, \
+      float* y) { \
+    int i = 0; \
+    for (; i + kWidth <= n; i += kWidth) { \
+      vstore(y + i, vpowx(vload(a + i), b)); \
+    } \
+    if (i < n) { \
+      float tail[kWidth] = {0}; \
+      memcpy(tail, a + i, sizeof(float) * (n - i));  /* NOLINT */ \
+      vstore(tail, vpowx(vload(tail), b)); \
+      memcpy(y + i, tail, sizeof(float) * (n - i));  /* NOLINT */ \
+    } \
+  }
+
+#ifdef CAFFE_MATH_X86
+
+#define CAFFE_MATH_TARGET __attribute__((target("sse2")))
+
+namespace sse2 {
+
+typedef __m128 Vec;
+const int kWidth = 4;
+
+CAFFE_MATH_TARGET inline Vec vload(const float* p) { return _mm_loadu_ps(p); }
+CAFFE_MATH_TARGET inline void vstore(float* p, const Vec x) {
+  _mm_storeu_ps(p, x);
+}
+CAFFE_MATH_TARGET inline Vec vsplat(const float x) { return _mm_set1_ps(x); }
+CAFFE_MATH_TARGET inline Vec vadd(const Vec a, const Vec b) {
+  return _mm_add_ps(a, b);
+}
+CAFFE_MATH_TARGET inline Vec vsub(const Vec a, const Vec b) {
+  return _mm_sub_ps(a, b);
+}
+CAFFE_MATH_TARGET inline Vec vmul(const Vec a, const Vec b) {
+  return _mm_mul_ps(a, b);
+}
+CAFFE_MATH_TARGET inline Vec vdiv(const Vec a, const Vec b) {
+  return _mm_div_ps(a, b);
+}
+CAFFE_MATH_TARGET inline Vec vsqrt(const Vec x) { return _mm_sqrt_ps(x); }
+CAFFE_MATH_TARGET inline Vec vabs(const Vec x) {
+  return _mm_andnot_ps(_mm_set1_ps(-0.f), x);
+}
+CAFFE_MATH_TARGET inline Vec vfma(const Vec a, const Vec b, const Vec c) {
+  return _mm_add_ps(_mm_mul_ps(a, b), c);
+}
+CAFFE_MATH_TARGET inline float vsum(Vec x) {
+  x = _mm_add_ps(x, _mm_movehl_ps(x, x));
+  x = _mm_add_ss(x, _mm_shuffle_ps(x, x, 1));
+  return _mm_cvtss_f32(x);
+}
+
+typedef __m128 Mask;
+
+CAFFE_MATH_TARGET inline Vec vmin(const Vec a, const Vec b) {
+  return _mm_min_ps(a, b);
+}
+CAFFE_MATH_TARGET inline Vec vmax(const Vec a, const Vec b) {
+  return _mm_max_ps(a, b);
+}
+CAFFE_MATH_TARGET inline Vec vround(const Vec x) {
+  return _mm_cvtepi32_ps(_mm_cvtps_epi32(x));
+}
+CAFFE_MATH_TARGET inline Vec vpow2(const Vec n) {
+  return _mm_castsi128_ps(_mm_slli_epi32(
+      _mm_add_epi32(_mm_cvtps_epi32(n), _mm_set1_epi32(127)), 23));
+}
+CAFFE_MATH_TARGET inline Vec vfrexp(const Vec x, Vec* e) {
+  const __m128i bits = _mm_castps_si128(x);
+  *e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23),
+      _mm_set1_epi32(126)));
+  return _mm_castsi128_ps(_mm_or_si128(
+      _mm_and_si128(bits, _mm_set1_epi32(0x007fffff)),
+      _mm_set1_epi32(0x3f000000)));
+}
+CAFFE_MATH_TARGET inline Mask vlt(const Vec a, const Vec b) {
+  return _mm_cmplt_ps(a, b);
+}
+CAFFE_MATH_TARGET inline Mask vgt(const Vec a, const Vec b) {
+  return _mm_cmpgt_ps(a, b);
+}
+CAFFE_MATH_TARGET inline Mask veq(const Vec a, const Vec b) {
+  return _mm_cmpeq_ps(a, b);
+}
+CAFFE_MATH_TARGET inline Mask visnan(const Vec x) {
+  return _mm_cmpunord_ps(x, x);
+}
+CAFFE_MATH_TARGET inline Vec vselect(const Mask m, const Vec a, const Vec b) {
+  return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+}
+
+DEFINE_MATH_KERNELS
+DEFINE_TRANSCENDENTAL_KERNELS
+
+}  // namespace sse2
+
+#undef CAFFE_MATH_TARGET
+#define CAFFE_MATH_TARGET __attribute__((target("avx2,fma")))
+
+namespace avx2 {
+
+typedef __m256 Vec;
+const int kWidth = 8;
+
+CAFFE_MATH_TARGET inline Vec vload(const float* p) {
+  return _mm256_loadu_ps(p);
+}
+CAFFE_MATH_TARGET inline void vstore(float* p, const Vec x) {
+  _mm256_storeu_ps(p, x);
+}
+CAFFE_MATH_TARGET inline Vec vsplat(const float x) {
+  return _mm256_set1_ps(x);
+}
+CAFFE_MATH_TARGET inline Vec vadd(const Vec a, const Vec b) {
+  return _mm256_add_ps(a, b);
+}
+CAFFE_MATH_TARGET inline Vec vsub(const Vec a, const Vec b) {
+  return _mm256_sub_ps(a, b);
+}
+CAFFE_MATH_TARGET inline Vec vmul(const Vec a, const Vec b) {
+  return _mm256_mul_ps(a, b);
+}
+CAFFE_MATH_TARGET inline Vec vdiv(const Vec a, const Vec b) {
+  return _mm256_div_ps(a, b);
+}
+CAFFE_MATH_TARGET inline Vec vsqrt(const Vec x) { return _mm256_sqrt_ps(x); }
+CAFFE_MATH_TARGET inline Vec vabs(const Vec x) {
+  return _mm256_andnot_ps(_mm256_set1_ps(-0.f), x);
+}
+CAFFE_MATH_TARGET inline Vec vfma(const Vec a, const Vec b, const Vec c) {
+  return _mm256_fmadd_ps(a, b, c);
+}
+CAFFE_MATH_TARGET inline float vsum(const Vec x) {
+  __m128 half = _mm_add_ps(_mm256_castps256_ps128(x),
+      _mm256_extractf128_ps(x, 1));
+  half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+  half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+  return _mm_cvtss_f32(half);
+}
+
+typedef __m256 Mask;
+
+CAFFE_MATH_TARGET inline Vec vmin(const Vec a, const Vec b) {
+  return _mm256_min_ps(a, b);
+}
+CAFFE_MATH_TARGET inline Vec vmax(const Vec a, const Vec b) {
+  return _mm256_max_ps(a, b);
+}
+CAFFE_MATH_TARGET inline Vec vround(const Vec x) {
+  return _mm256_round_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+}
+CAFFE_MATH_TARGET inline Vec vpow2(const Vec n) {
+  return _mm256_castsi256_ps(_mm256_slli_epi32(
+      _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23));
+}
+CAFFE_MATH_TARGET inline Vec vfrexp(const Vec x, Vec* e) {
+  const __m256i bits = _mm256_castps_si256(x);
+  *e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23),
+      _mm256_set1_epi32(126)));
+  return _mm256_castsi256_ps(_mm256_or_si256(
+      _mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)),
+      _mm256_set1_epi32(0x3f000000)));
+}
+CAFFE_MATH_TARGET inline Mask vlt(const Vec a, const Vec b) {
+  return _mm256_cmp_ps(a, b, _CMP_LT_OQ);
+}
+CAFFE_MATH_TARGET inline Mask vgt(const Vec a, const Vec b) {
+  return _mm256_cmp_ps(a, b, _CMP_GT_OQ);
+}
+CAFFE_MATH_TARGET inline Mask veq(const Vec a, const Vec b) {
+  return _mm256_cmp_ps(a, b, _CMP_EQ_OQ);
+}
+CAFFE_MATH_TARGET inline Mask visnan(const Vec x) {
+  return _mm256_cmp_ps(x, x, _CMP_UNORD_Q);
+}
+CAFFE_MATH_TARGET inline Vec vselect(const Mask m, const Vec a, const Vec b) {
+  return _mm256_blendv_ps(b, a, m);
+}
+
+DEFINE_MATH_KERNELS
+DEFINE_TRANSCENDENTAL_KERNELS
+
+}  // namespace avx2
+
+#undef CAFFE_MATH_TARGET
+#define CAFFE_MATH_TARGET __attribute__((target("avx512f")))
+
+// GCC 12 warns about the vectors its AVX-512 intrinsics leave undefined on
+// purpose (_mm512_undefined_ps), once they are inlined here.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+namespace avx512 {
+
+typedef __m512 Vec;
+const int kWidth = 16;
+
+CAFFE_MATH_TARGET inline Vec vload(const float* p) {
+  return _mm512_loadu_ps(p);
+}
+CAFFE_MATH_TARGET inline void vstore(float* p, const Vec x) {
+  _mm512_storeu_ps(p, x);
+}
+CAFFE_MATH_TARGET inline Vec vsplat(const float x) {
+  return _mm512_set1_ps(x);
+}
+CAFFE_MATH_TARGET inline Vec vadd(const Vec a, const Vec b) {
+  return _mm512_add_ps(a, b);
+}
+CAFFE_MATH_TARGET inline Vec vsub(const Vec a, const Vec b) {
+  return _mm512_sub_ps(a, b);
+}
+CAFFE_MATH_TARGET inline Vec vmul(const Vec a, const Vec b) {
+  return _mm512_mul_ps(a, b);
+}
+CAFFE_MATH_TARGET inline Vec vdiv(const Vec a, const Vec b) {
+  return _mm512_div_ps(a, b);
+}
+CAFFE_MATH_TARGET inline Vec vsqrt(const Vec x) { return _mm512_sqrt_ps(x); }
+CAFFE_MATH_TARGET inline Vec vabs(const Vec x) { return _mm512_abs_ps(x); }
+CAFFE_MATH_TARGET inline Vec vfma(const Vec a, const Vec b, const Vec c) {
+  return _mm512_fmadd_ps(a, b, c);
+}
+CAFFE_MATH_TARGET inline float vsum(const Vec x) {
+  return _mm512_reduce_add_ps(x);
+}
+
+typedef __mmask16 Mask;
+
+CAFFE_MATH_TARGET inline Vec vmin(const Vec a, const Vec b) {
+  return _mm512_min_ps(a, b);
+}
+CAFFE_MATH_TARGET inline Vec vmax(const Vec a, const Vec b) {
+  return _mm512_max_ps(a, b);
+}
+CAFFE_MATH_TARGET inline Vec vround(const Vec x) {
+  return _mm512_roundscale_ps(x, _MM_FROUND_TO_NEAREST_INT |
+      _MM_FROUND_NO_EXC);
+}
+CAFFE_MATH_TARGET inline Vec vpow2(const Vec n) {
+  return _mm512_castsi512_ps(_mm512_slli_epi32(
+      _mm512_add_epi32(_mm512_cvtps_epi32(n), _mm512_set1_epi32(127)), 23));
+}
+CAFFE_MATH_TARGET inline Vec vfrexp(const Vec x, Vec* e) {
+  const __m512i bits = _mm512_castps_si512(x);
+  *e = _mm512_cvtepi32_ps(_mm512_sub_epi32(_mm512_srli_epi32(bits, 23),
+      _mm512_set1_epi32(126)));
+  return _mm512_castsi512_ps(_mm512_or_si512(
+      _mm512_and_si512(bits, _mm512_set1_epi32(0x007fffff)),
+      _mm512_set1_epi32(0x3f000000)));
+}
+CAFFE_MATH_TARGET inline Mask vlt(const Vec a, const Vec b) {
+  return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ);
+}
+CAFFE_MATH_TARGET inline Mask vgt(const Vec a, const Vec b) {
+  return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ);
+}
+CAFFE_MATH_TARGET inline Mask veq(const Vec a, const Vec b) {
+  return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ);
+}
+CAFFE_MATH_TARGET inline Mask visnan(const Vec x) {
+  return _mm512_cmp_ps_mask(x, x, _CMP_UNORD_Q);
+}
+CAFFE_MATH_TARGET inline Vec vselect(const Mask m, const Vec a, const Vec b) {
+  return _mm512_mask_blend_ps(m, b, a);
+}
+
+DEFINE_MATH_KERNELS
+DEFINE_TRANSCENDENTAL_KERNELS
+
+}  // namespace avx512
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#undef CAFFE_MATH_TARGET
+
+#endif  // CAFFE_MATH_X86
+
+#ifdef CAFFE_MATH_NEON
+
+#define CAFFE_MATH_TARGET
+
+namespace neon {
+
+typedef float32x4_t Vec;
+const int kWidth = 4;
+
+inline Vec vload(const float* p) { return vld1q_f32(p); }
+inline void vstore(float* p, const Vec x) { vst1q_f32(p, x); }
+inline Vec vsplat(const float x) { return vdupq_n_f32(x); }
+inline Vec vadd(const Vec a, const Vec b) { return vaddq_f32(a, b); }
+inline Vec vsub(const Vec a, const Vec b) { return vsubq_f32(a, b); }
+inline Vec vmul(const Vec a, const Vec b) { return vmulq_f32(a, b); }
+inline Vec vabs(const Vec x) { return vabsq_f32(x); }
+
+typedef uint32x4_t Mask;
+
+inline Mask vgt(const Vec a, const Vec b) { return vcgtq_f32(a, b); }
+inline Vec vselect(const Mask m, const Vec a, const Vec b) {
+  return vbslq_f32(m, a, b);
+}
+
+#ifdef __aarch64__
+
+inline Vec vdiv(const Vec a, const Vec b) { return vdivq_f32(a, b); }
+inline Vec vsqrt(const Vec x) { return vsqrtq_f32(x); }
+inline Vec vfma(const Vec a, const Vec b, const Vec c) {
+  return vfmaq_f32(c, a, b);
+}
+inline float vsum(const Vec x) { return vaddvq_f32(x); }
+
+#else
+
+// ARMv7 NEON only has estimates for these, so they go lane by lane.
+inline Vec vdiv(const Vec a, const Vec b) {
+  float lanes_a[4], lanes_b[4];
+  vst1q_f32(lanes_a, a);
+  vst1q_f32(lanes_b, b);
+  for (int i = 0; i < 4; ++i) {
+    lanes_a[i] /= lanes_b[i];
+  }
+  return vld1q_f32(lanes_a);
+}
+inline Vec vsqrt(const Vec x) {
+  float lanes[4];
+  vst1q_f32(lanes, x);
+  for (int i = 0; i < 4; ++i) {
+    lanes[i] = std::sqrt(lanes[i]);
+  }
+  return vld1q_f32(lanes);
+}
+inline Vec vfma(const Vec a, const Vec b, const Vec c) {
+  return vmlaq_f32(c, a, b);
+}
+inline float vsum(const Vec x) {
+  const float32x2_t pair = vadd_f32(vget_low_f32(x), vget_high_f32(x));
+  return vget_lane_f32(vpadd_f32(pair, pair), 0);
+}
+
+#endif  // __aarch64__
+
+DEFINE_MATH_KERNELS
+
+// The error bounds of the polynomial approximations have only been
+// measured on x86, so the transcendentals stay with libm here.
+using scalar::exp;
+using scalar::log;
+using scalar::powx;
+using scalar::tanh;
+using scalar::sigmoid;
+
+}  // namespace neon
+
+#undef CAFFE_MATH_TARGET
+
+#endif  // CAFFE_MATH_NEON
+
+#define MATH_KERNELS_OF(isa) { #isa, isa::set, isa::add_scalar, isa::scale, \
+    isa::add, isa::sub, isa::mul, isa::div, isa::sqr, isa::sqrt, isa::abs, \
+    isa::dot, isa::asum, isa::maximum, isa::sum, isa::max, isa::exp, \
+    isa::log, isa::powx, isa::tanh, isa::sigmoid }
+
+const MathKernels kScalarKernels = MATH_KERNELS_OF(scalar);
+#ifdef CAFFE_MATH_X86
+const MathKernels kSse2Kernels = MATH_KERNELS_OF(sse2);
+const MathKernels kAvx2Kernels = MATH_KERNELS_OF(avx2);
+const MathKernels kAvx512Kernels = MATH_KERNELS_OF(avx512);
+#endif
+#ifdef CAFFE_MATH_NEON
+const MathKernels kNeonKernels = MATH_KERNELS_OF(neon);
+#endif
+
+}  // namespace
+
+std::vector<const MathKernels*> supported_math_kernels() {
+  std::vector<const MathKernels*> kernels(1, &kScalarKernels);
+#if defined(CAFFE_MATH_X86)
+  const CpuFeatures& features = cpu_features();
+  if (features.sse2) {
+    kernels.push_back(&kSse2Kernels);
+  }
+  if (features.avx2) {
+    kernels.push_back(&kAvx2Kernels);
+  }
+  if (features.avx512) {
+    kernels.push_back(&kAvx512Kernels);
+  }
+#elif defined(CAFFE_MATH_NEON)
+  if (cpu_features().neon) {
+    kernels.push_back(&kNeonKernels);
+  }
+#endif
+  return kernels;
+}
+
+const MathKernels& math_kernels() {
+  static const MathKernels* kernels = supported_math_kernels().back();
+  return *kernels;
+}
+
+namespace {
+
+thread_local bool current_strict_math = false;
+
+}  // namespace
+
+bool strict_math() {
+  return current_strict_math;
+}
+
+const MathKernels& transcendental_math_kernels() {
+  return current_strict_math ? kScalarKernels : math_kernels();
+}
+
+StrictMathScope::StrictMathScope(bool strict)
+    : previous_(current_strict_math) {
+  current_strict_math = strict;
+}
+
+StrictMathScope::~StrictMathScope() {
+  current_strict_math = previous_;
+}
+
+}  // namespace caffe
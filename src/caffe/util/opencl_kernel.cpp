@@ -205,54 +205,28 @@ std::string generate_opencl_math(bool is_half) {
 	ss << "}" << std::endl;
 
 
-	ss << "__kernel void kernel_channel_max(__global Dtype *data," << std::endl;
+	ss << "__kernel void kernel_channel_softmax(__global Dtype *in," << std::endl;
 	ss << "__global Dtype *out," << std::endl;
 	ss << "int num, int channels, int spatial_dim) {" << std::endl;
 	ss << "OPENCL_KERNEL_LOOP(index, num * spatial_dim) {" << std::endl;
 	ss << " int n = index / spatial_dim;" << std::endl;
 	ss << " int s = index % spatial_dim;" << std::endl;
-	ss << " Dtype maxval = -FLT_MAX;" << std::endl;
+	ss << " __global Dtype *x = in + n * channels * spatial_dim + s;" << std::endl;
+	ss << " __global Dtype *y = out + n * channels * spatial_dim + s;" << std::endl;
+	ss << " float maxval = -FLT_MAX;" << std::endl;
+	ss << " float sum = 0;" << std::endl;
 	ss << " for (int c = 0; c < channels; ++c) {" << std::endl;
-	ss << "  maxval = max(data[(n * channels + c) * spatial_dim + s], maxval);" << std::endl;
+	ss << "  float value = x[c * spatial_dim];" << std::endl;
+	ss << "  if (value > maxval) {" << std::endl;
+	ss << "   sum *= exp(maxval - value);" << std::endl;
+	ss << "   maxval = value;" << std::endl;
+	ss << "  }" << std::endl;
+	ss << "  sum += exp(value - maxval);" << std::endl;
 	ss << " }" << std::endl;
-	ss << " out[index] = maxval;" << std::endl;
-	ss << "}" << std::endl;
-	ss << "}" << std::endl;
-
-	ss << "__kernel void kernel_channel_subtract(__global Dtype *channel_max," << std::endl;
-	ss << "__global Dtype *data," << std::endl;
-	ss << "int count, int num, int channels, int spatial_dim) {" << std::endl;
-	ss << "OPENCL_KERNEL_LOOP(index, count) {" << std::endl;
-	ss << " int n = index / channels / spatial_dim;" << std::endl;
-	ss << " int s = index % spatial_dim;" << std::endl;
-	ss << " data[index] -= channel_max[n * spatial_dim + s];" << std::endl;
-	ss << "}" << std::endl;
-	ss << "}" << std::endl;
-
-
-	ss << "__kernel void kernel_channel_sum(__global Dtype *data," << std::endl;
-	ss << "__global Dtype *channel_sum," << std::endl;
-	ss << "int num, int channels, int spatial_dim) {" << std::endl;
-	ss << "OPENCL_KERNEL_LOOP(index, num * spatial_dim) {" << std::endl;
-	ss << " int n = index / spatial_dim;" << std::endl;
-	ss << " int s = index % spatial_dim;" << std::endl;
-	ss << " Dtype sum = 0;" << std::endl;
+	ss << " float scale = 1 / sum;" << std::endl;
 	ss << " for (int c = 0; c < channels; ++c) {" << std::endl;
-	ss << "  sum += data[(n * channels + c) * spatial_dim + s];" << std::endl;
+	ss << "  y[c * spatial_dim] = exp((float)x[c * spatial_dim] - maxval) * scale;" << std::endl;
 	ss << " }" << std::endl;
-	ss << " channel_sum[index] = sum;" << std::endl;
-	ss << "}" << std::endl;
-	ss << "}" << std::endl;
-
-
-
-	ss << "__kernel void kernel_channel_div(__global Dtype *channel_max," << std::endl;
-	ss << "__global Dtype *data," << std::endl;
-	ss << "int count, int num, int channels, int spatial_dim) {" << std::endl;
-	ss << "OPENCL_KERNEL_LOOP(index, count) {" << std::endl;
-	ss << " int n = index / channels / spatial_dim;" << std::endl;
-	ss << " int s = index % spatial_dim;" << std::endl;
-	ss << " data[index] /= channel_max[n * spatial_dim + s];" << std::endl;
 	ss << "}" << std::endl;
 	ss << "}" << std::endl;
 
@@ -695,4 +669,66 @@ std::string generate_opencl_math(bool is_half) {
   	return ss.str();
 }
 
+std::string generate_opencl_int8_helpers() {
+	std::stringstream ss;
+
+	// The dot product instructions of the device where the compiler has
+	// them, four multiply-adds in int32 otherwise.
+	ss << "#if defined(__opencl_c_integer_dot_product_input_4x8bit)" << std::endl;
+	ss << "#define int8_dot4(a, b) dot(a, b)" << std::endl;
+	ss << "#elif defined(cl_arm_integer_dot_product_int8)" << std::endl;
+	ss << "#pragma OPENCL EXTENSION cl_arm_integer_dot_product_int8 : enable" << std::endl;
+	ss << "#define int8_dot4(a, b) arm_dot(a, b)" << std::endl;
+	ss << "#else" << std::endl;
+	ss << "inline int int8_dot4(char4 a, char4 b) {" << std::endl;
+	ss << "const int4 p = convert_int4(a) * convert_int4(b);" << std::endl;
+	ss << "return p.x + p.y + p.z + p.w;" << std::endl;
+	ss << "}" << std::endl;
+	ss << "#endif" << std::endl;
+
+	// Rounds to nearest even like the lrint of the CPU path.
+	ss << "inline char int8_quantize(float x, float inverse) {" << std::endl;
+	ss << "return convert_char_rte(clamp(x * inverse, -127.0f, 127.0f));" << std::endl;
+	ss << "}" << std::endl;
+
+	return ss.str();
+}
+
+std::string generate_opencl_int8_gemm() {
+	std::stringstream ss;
+
+	ss << "__kernel void int8_quantize_rows(__global const Dtype* in," << std::endl;
+	ss << "__global char* out, int rows, int K, int K4, float inverse) {" << std::endl;
+	ss << "const int k = get_global_id(0);" << std::endl;
+	ss << "const int row = get_global_id(1);" << std::endl;
+	ss << "if (k < K4 && row < rows) {" << std::endl;
+	ss << "out[row * K4 + k] = k < K ? int8_quantize((float)in[row * K + k], inverse) : 0;" << std::endl;
+	ss << "}" << std::endl;
+	ss << "}" << std::endl;
+
+	ss << "__kernel void int8_gemm_rows(__global const char* x," << std::endl;
+	ss << "__global const char* w, __global const float* w_scales," << std::endl;
+	ss << "__global Dtype* out, __global const Dtype* bias, int N, int K4," << std::endl;
+	ss << "float scale) {" << std::endl;
+	ss << "const int n = get_global_id(0);" << std::endl;
+	ss << "const int row = get_global_id(1);" << std::endl;
+	ss << "if (n >= N) {" << std::endl;
+	ss << "return;" << std::endl;
+	ss << "}" << std::endl;
+	ss << "__global const char* x_row = x + row * K4;" << std::endl;
+	ss << "__global const char* w_row = w + n * K4;" << std::endl;
+	ss << "int acc = 0;" << std::endl;
+	ss << "for (int k = 0; k < K4; k += 4) {" << std::endl;
+	ss << "acc += int8_dot4(vload4(0, w_row + k), vload4(0, x_row + k));" << std::endl;
+	ss << "}" << std::endl;
+	ss << "Dtype outval = (Dtype)(acc * (w_scales[n] * scale));" << std::endl;
+	ss << "if (bias) {" << std::endl;
+	ss << "outval += bias[n];" << std::endl;
+	ss << "}" << std::endl;
+	ss << "out[row * N + n] = outval;" << std::endl;
+	ss << "}" << std::endl;
+
+	return ss.str();
+}
+
 }  // namespace caffe
@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <cfloat>
+
+#include "caffe/common.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/math_kernels.hpp"
+#include "caffe/util/pooling.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Clips the window of output p along one axis to [0, size) and returns its
+// size counting the padding, the divisor of average pooling.
+inline int pooling_window(const int p, const int stride, const int pad,
+    const int kernel, const int size, int* start, int* end) {
+  *start = p * stride - pad;
+  *end = std::min(*start + kernel, size + pad);
+  const int padded_size = *end - *start;
+  *start = std::max(*start, 0);
+  *end = std::min(*end, size);
+  return padded_size;
+}
+
+template <bool kMax>
+inline void reduce_row(const MathKernels& kernels, const int n,
+    const float* x, float* y) {
+  if (kMax) {
+    kernels.maximum(n, x, y, y);
+  } else {
+    kernels.add(n, x, y, y);
+  }
+}
+
+template <typename Dtype, bool kMax>
+void pool_cpu(const Dtype* input, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int pooled_h,
+    const int pooled_w, float* buffer, Dtype* output) {
+  const MathKernels& kernels = math_kernels();
+  const float init = kMax ? -FLT_MAX : 0;
+  const float* plane = caffe_float_data(height * width, input, buffer);
+  float* row = buffer + height * width;
+  float* pooled = row + width;
+  if (pooled_h == 1 && pooled_w == 1 && pad_h == 0 && pad_w == 0 &&
+      kernel_h >= height && kernel_w >= width) {
+    const int count = height * width;
+    pooled[0] = kMax ? kernels.max(count, plane) :
+        kernels.sum(count, plane) / count;
+    caffe_from_float(1, pooled, output);
+    return;
+  }
+  const bool contiguous = stride_w == 1 && pad_w == 0 && kernel_w <= width;
+  for (int ph = 0; ph < pooled_h; ++ph) {
+    int hstart, hend;
+    const int window_h = pooling_window(ph, stride_h, pad_h, kernel_h,
+        height, &hstart, &hend);
+    kernels.set(width, init, row);
+    for (int h = hstart; h < hend; ++h) {
+      reduce_row<kMax>(kernels, width, plane + h * width, row);
+    }
+    if (contiguous) {
+      // Every window is whole, and column kw of all of them is the row
+      // shifted by kw.
+      kernels.set(pooled_w, init, pooled);
+      for (int kw = 0; kw < kernel_w; ++kw) {
+        reduce_row<kMax>(kernels, pooled_w, row + kw, pooled);
+      }
+      if (!kMax) {
+        const int size = window_h * kernel_w;
+        for (int pw = 0; pw < pooled_w; ++pw) {
+          pooled[pw] /= size;
+        }
+      }
+    } else {
+      for (int pw = 0; pw < pooled_w; ++pw) {
+        int wstart, wend;
+        const int window_w = pooling_window(pw, stride_w, pad_w, kernel_w,
+            width, &wstart, &wend);
+        float value = init;
+        for (int w = wstart; w < wend; ++w) {
+          value = kMax ? (row[w] > value ? row[w] : value) : value + row[w];
+        }
+        pooled[pw] = kMax ? value : value / (window_h * window_w);
+      }
+    }
+    caffe_from_float(pooled_w, pooled, output + ph * pooled_w);
+  }
+}
+
+}  // namespace
+
+int pooling_buffer_size(const int height, const int width,
+    const int pooled_w) {
+  return height * width + width + pooled_w;
+}
+
+template <typename Dtype>
+void max_pool_cpu(const Dtype* input, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int pooled_h,
+    const int pooled_w, float* buffer, Dtype* output) {
+  pool_cpu<Dtype, true>(input, height, width, kernel_h, kernel_w, pad_h,
+      pad_w, stride_h, stride_w, pooled_h, pooled_w, buffer, output);
+}
+
+template <typename Dtype>
+void ave_pool_cpu(const Dtype* input, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int pooled_h,
+    const int pooled_w, float* buffer, Dtype* output) {
+  pool_cpu<Dtype, false>(input, height, width, kernel_h, kernel_w, pad_h,
+      pad_w, stride_h, stride_w, pooled_h, pooled_w, buffer, output);
+}
+
+#define INSTANTIATE_POOLING(Dtype) \
+  template void max_pool_cpu<Dtype>(const Dtype* input, const int height, \
+      const int width, const int kernel_h, const int kernel_w, \
+      const int pad_h, const int pad_w, const int stride_h, \
+      const int stride_w, const int pooled_h, const int pooled_w, \
+      float* buffer, Dtype* output); \
+  template void ave_pool_cpu<Dtype>(const Dtype* input, const int height, \
+      const int width, const int kernel_h, const int kernel_w, \
+      const int pad_h, const int pad_w, const int stride_h, \
+      const int stride_w, const int pooled_h, const int pooled_w, \
+      float* buffer, Dtype* output);
+
+INSTANTIATE_POOLING(float);
+INSTANTIATE_POOLING(half);
+
+}  // namespace caffe
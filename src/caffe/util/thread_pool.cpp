@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <condition_variable>  // NOLINT(build/c++11)
+#include <deque>
+#include <mutex>  // NOLINT(build/c++11)
+
+#include "caffe/util/math_kernels.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+class ThreadPool::sync {
+ public:
+  std::mutex mutex_;
+  // Signals the workers that a loop was queued or that they should stop.
+  std::condition_variable work_;
+  // Signals the callers that a chunk finished.
+  std::condition_variable done_;
+  // The loops with chunks nobody has started yet, oldest first.
+  std::deque<Loop*> loops_;
+  bool stop_ = false;
+};
+
+struct ThreadPool::Loop {
+  const std::function<void(int, int)>* f;
+  int n;
+  int num_chunks;
+  int next;
+  int done;
+  // The caller's strict_math(), for the chunks other threads run.
+  bool strict_math;
+
+  void RunChunk(const int chunk) const {
+    const int begin = static_cast<int64_t>(n) * chunk / num_chunks;
+    const int end = static_cast<int64_t>(n) * (chunk + 1) / num_chunks;
+    StrictMathScope strict_math_scope(strict_math);
+    (*f)(begin, end);
+  }
+};
+
+ThreadPool& ThreadPool::Get() {
+  static ThreadPool pool;
+  return pool;
+}
+
+ThreadPool::ThreadPool() : num_threads_(1), sync_(new sync()) {}
+
+ThreadPool::~ThreadPool() {
+  Stop();
+}
+
+void ThreadPool::set_num_threads(int num_threads) {
+  CHECK_GE(num_threads, 0);
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  if (num_threads == num_threads_) {
+    return;
+  }
+  Stop();
+  num_threads_ = num_threads;
+  for (int i = 1; i < num_threads_; ++i) {
+    threads_.push_back(shared_ptr<std::thread>(
+        new std::thread(&ThreadPool::Work, this)));
+  }
+}
+
+void ThreadPool::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(sync_->mutex_);
+    sync_->stop_ = true;
+  }
+  sync_->work_.notify_all();
+  for (int i = 0; i < threads_.size(); ++i) {
+    threads_[i]->join();
+  }
+  threads_.clear();
+  sync_->stop_ = false;
+}
+
+void ThreadPool::Work() {
+  std::unique_lock<std::mutex> lock(sync_->mutex_);
+  while (true) {
+    sync_->work_.wait(lock, [this] {
+      return sync_->stop_ || !sync_->loops_.empty();
+    });
+    if (sync_->stop_) {
+      return;
+    }
+    Loop* loop = sync_->loops_.front();
+    const int chunk = loop->next++;
+    if (loop->next == loop->num_chunks) {
+      sync_->loops_.pop_front();
+    }
+    lock.unlock();
+    loop->RunChunk(chunk);
+    lock.lock();
+    // The caller may return and free the loop as soon as the count is full.
+    if (++loop->done == loop->num_chunks) {
+      sync_->done_.notify_all();
+    }
+  }
+}
+
+void ThreadPool::Run(const int n, const int grain,
+    const std::function<void(int, int)>& f) {
+  const int num_chunks = std::min(num_threads_,
+      n / std::max(grain, 1));
+  if (num_chunks <= 1) {
+    if (n > 0) {
+      f(0, n);
+    }
+    return;
+  }
+  Loop loop = {&f, n, num_chunks, 0, 0, strict_math()};
+  std::unique_lock<std::mutex> lock(sync_->mutex_);
+  sync_->loops_.push_back(&loop);
+  lock.unlock();
+  sync_->work_.notify_all();
+  lock.lock();
+  // Work on the own loop until every chunk has been started.
+  while (loop.next < loop.num_chunks) {
+    const int chunk = loop.next++;
+    if (loop.next == loop.num_chunks) {
+      sync_->loops_.erase(std::find(sync_->loops_.begin(),
+          sync_->loops_.end(), &loop));
+    }
+    lock.unlock();
+    loop.RunChunk(chunk);
+    lock.lock();
+    ++loop.done;
+  }
+  sync_->done_.wait(lock, [&loop] { return loop.done == loop.num_chunks; });
+}
+
+}  // namespace caffe
@@ -0,0 +1,263 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "caffe/util/half.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/weight_file.hpp"
+
+namespace caffe {
+
+namespace {
+
+const char kMagic[8] = {'C', 'A', 'F', 'F', 'E', 'W', 'T', '1'};
+const size_t kHeaderSize = 24;
+
+inline size_t Align(size_t offset) {
+  return (offset + kWeightFileAlignment - 1) / kWeightFileAlignment *
+      kWeightFileAlignment;
+}
+
+template <typename T>
+void Write(std::ofstream* out, const T& value) {
+  out->write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Reads the index, checking every field against the end of the mapping.
+// Nothing is read past it: a field that does not fit leaves the reader
+// where it was and reports the failure.
+class IndexReader {
+ public:
+  IndexReader(const char* begin, const char* end)
+      : pos_(begin), end_(end) {}
+
+  template <typename T>
+  bool Read(T* value) {
+    const char* data = Take(sizeof(*value));
+    if (!data) {
+      return false;
+    }
+    std::memcpy(value, data, sizeof(*value));
+    return true;
+  }
+  /// Returns the next size bytes, or NULL if the index is truncated.
+  const char* Take(size_t size) {
+    if (size > static_cast<size_t>(end_ - pos_)) {
+      return NULL;
+    }
+    const char* data = pos_;
+    pos_ += size;
+    return data;
+  }
+  inline size_t remaining() const { return end_ - pos_; }
+
+ private:
+  const char* pos_;
+  const char* end_;
+};
+
+}  // namespace
+
+bool IsWeightFile(const string& filename) {
+  std::ifstream file(filename.c_str(), std::ios::binary);
+  char magic[sizeof(kMagic)];
+  return file.read(magic, sizeof(magic)) &&
+      std::memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+}
+
+template <typename Dtype>
+void WriteWeightFile(const string& filename,
+    const vector<string>& layer_names,
+    const vector<vector<shared_ptr<Blob<Dtype> > > >& layer_blobs,
+    bool write_half) {
+  CHECK_EQ(layer_names.size(), layer_blobs.size());
+  const size_t value_size = write_half ? sizeof(half) : sizeof(float);
+  uint64_t index_size = 0;
+  for (int i = 0; i < layer_names.size(); ++i) {
+    index_size += 2 * sizeof(uint32_t) + layer_names[i].size();
+    for (int j = 0; j < layer_blobs[i].size(); ++j) {
+      index_size += sizeof(uint32_t) + sizeof(uint64_t) +
+          layer_blobs[i][j]->num_axes() * sizeof(int32_t);
+    }
+  }
+  std::ofstream out(filename.c_str(), std::ios::binary | std::ios::trunc);
+  CHECK(out) << "Cannot write " << filename;
+  out.write(kMagic, sizeof(kMagic));
+  Write<uint32_t>(&out, write_half ? 1 : 0);
+  Write<uint32_t>(&out, layer_names.size());
+  Write<uint64_t>(&out, index_size);
+  uint64_t offset = Align(kHeaderSize + index_size);
+  for (int i = 0; i < layer_names.size(); ++i) {
+    Write<uint32_t>(&out, layer_names[i].size());
+    out.write(layer_names[i].data(), layer_names[i].size());
+    Write<uint32_t>(&out, layer_blobs[i].size());
+    for (int j = 0; j < layer_blobs[i].size(); ++j) {
+      const Blob<Dtype>& blob = *layer_blobs[i][j];
+      Write<uint32_t>(&out, blob.num_axes());
+      for (int k = 0; k < blob.num_axes(); ++k) {
+        Write<int32_t>(&out, blob.shape(k));
+      }
+      Write<uint64_t>(&out, offset);
+      offset = Align(offset + blob.count() * value_size);
+    }
+  }
+  vector<float> values;
+  vector<half> half_values;
+  for (int i = 0; i < layer_blobs.size(); ++i) {
+    for (int j = 0; j < layer_blobs[i].size(); ++j) {
+      const Blob<Dtype>& blob = *layer_blobs[i][j];
+      const std::streamoff position = out.tellp();
+      const vector<char> padding(Align(position) - position, 0);
+      out.write(padding.data(), padding.size());
+      values.resize(blob.count());
+      for (int k = 0; k < blob.count(); ++k) {
+        values[k] = caffe_to_float(blob.cpu_data()[k]);
+      }
+      if (write_half) {
+        half_values.resize(values.size());
+        float2half(values.size(), values.data(), half_values.data());
+        out.write(reinterpret_cast<const char*>(half_values.data()),
+            half_values.size() * sizeof(half));
+      } else {
+        out.write(reinterpret_cast<const char*>(values.data()),
+            values.size() * sizeof(float));
+      }
+    }
+  }
+  CHECK(out) << "Error writing " << filename;
+}
+
+template void WriteWeightFile<half>(const string& filename,
+    const vector<string>& layer_names,
+    const vector<vector<shared_ptr<Blob<half> > > >& layer_blobs,
+    bool write_half);
+template void WriteWeightFile<float>(const string& filename,
+    const vector<string>& layer_names,
+    const vector<vector<shared_ptr<Blob<float> > > >& layer_blobs,
+    bool write_half);
+
+MappedWeightFile::MappedWeightFile()
+    : base_(NULL), size_(0), is_half_(false) {}
+
+MappedWeightFile::~MappedWeightFile() {
+  Close();
+}
+
+void MappedWeightFile::Close() {
+  if (base_) {
+    munmap(base_, size_);
+  }
+  base_ = NULL;
+  size_ = 0;
+  is_half_ = false;
+  layers_.clear();
+}
+
+bool MappedWeightFile::Open(const string& filename) {
+  Close();
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    LOG(ERROR) << "Cannot open " << filename;
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    LOG(ERROR) << "Cannot stat " << filename;
+    close(fd);
+    return false;
+  }
+  if (static_cast<size_t>(st.st_size) < kHeaderSize) {
+    LOG(ERROR) << "Truncated weight file " << filename;
+    close(fd);
+    return false;
+  }
+  // Private and writable, so that a blob written to, e.g. by folding, gets
+  // its own copy of the pages instead of changing the file.
+  void* base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+      fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    LOG(ERROR) << "Cannot map " << filename;
+    return false;
+  }
+  base_ = base;
+  size_ = st.st_size;
+  if (!ReadIndex()) {
+    LOG(ERROR) << "Corrupt or truncated weight file " << filename;
+    Close();
+    return false;
+  }
+  return true;
+}
+
+bool MappedWeightFile::ReadIndex() {
+  const char* begin = static_cast<const char*>(base_);
+  IndexReader reader(begin, begin + size_);
+  const char* magic = reader.Take(sizeof(kMagic));
+  uint32_t dtype, num_layers;
+  uint64_t index_size;
+  if (!magic || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+      !reader.Read(&dtype) || dtype > 1 || !reader.Read(&num_layers) ||
+      !reader.Read(&index_size)) {
+    return false;
+  }
+  is_half_ = dtype == 1;
+  const size_t value_size = is_half_ ? sizeof(half) : sizeof(float);
+  // Every layer takes at least its name and blob sizes, so a count the
+  // index cannot hold is caught before allocating for it.
+  if (num_layers > reader.remaining() / (2 * sizeof(uint32_t))) {
+    return false;
+  }
+  layers_.resize(num_layers);
+  for (int i = 0; i < layers_.size(); ++i) {
+    uint32_t name_size, num_blobs;
+    if (!reader.Read(&name_size)) {
+      return false;
+    }
+    const char* name = reader.Take(name_size);
+    if (!name || !reader.Read(&num_blobs) ||
+        num_blobs > reader.remaining() / (sizeof(uint32_t) +
+            sizeof(uint64_t))) {
+      return false;
+    }
+    layers_[i].name.assign(name, name_size);
+    layers_[i].blobs.resize(num_blobs);
+    for (int j = 0; j < layers_[i].blobs.size(); ++j) {
+      BlobEntry& blob = layers_[i].blobs[j];
+      uint32_t num_axes;
+      if (!reader.Read(&num_axes) || num_axes > kMaxBlobAxes) {
+        return false;
+      }
+      uint64_t count = 1;
+      for (int k = 0; k < num_axes; ++k) {
+        int32_t dim;
+        if (!reader.Read(&dim) || dim < 0) {
+          return false;
+        }
+        // Bounding the count by the file size at every axis keeps the
+        // product from overflowing.
+        count *= dim;
+        if (count > size_) {
+          return false;
+        }
+        blob.shape.push_back(dim);
+      }
+      uint64_t offset;
+      if (!reader.Read(&offset) || offset > size_ ||
+          count > (size_ - offset) / value_size || offset % value_size) {
+        return false;
+      }
+      blob.data = static_cast<char*>(base_) + offset;
+    }
+  }
+  return true;
+}
+
+}  // namespace caffe
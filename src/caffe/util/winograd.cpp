@@ -0,0 +1,223 @@
+#include <algorithm>
+
+#include "caffe/common.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/winograd.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Tiles transformed and multiplied at a time, which bounds the scratch space.
+const int kTileBlock = 64;
+
+// G, the (tile + 2) x 3 filter transform.
+const float kG2[4 * 3] = {
+  1.f, 0.f, 0.f,
+  0.5f, 0.5f, 0.5f,
+  0.5f, -0.5f, 0.5f,
+  0.f, 0.f, 1.f
+};
+const float kG4[6 * 3] = {
+  1.f / 4, 0.f, 0.f,
+  -1.f / 6, -1.f / 6, -1.f / 6,
+  -1.f / 6, 1.f / 6, -1.f / 6,
+  1.f / 24, 1.f / 12, 1.f / 6,
+  1.f / 24, -1.f / 12, 1.f / 6,
+  0.f, 0.f, 1.f
+};
+
+// The input (B^T d) and output (A^T m) transforms of one line of a tile,
+// read with stride s and written with stride t. They are applied to the
+// columns and then to the rows.
+struct F2 {
+  static const int kTile = 2;
+  static const int kAlpha = 4;
+  static inline void input(const float* d, int s, float* r, int t) {
+    r[0] = d[0] - d[2 * s];
+    r[t] = d[s] + d[2 * s];
+    r[2 * t] = d[2 * s] - d[s];
+    r[3 * t] = d[s] - d[3 * s];
+  }
+  static inline void output(const float* m, int s, float* y, int t) {
+    y[0] = m[0] + m[s] + m[2 * s];
+    y[t] = m[s] - m[2 * s] - m[3 * s];
+  }
+};
+
+struct F4 {
+  static const int kTile = 4;
+  static const int kAlpha = 6;
+  static inline void input(const float* d, int s, float* r, int t) {
+    const float d0 = d[0], d1 = d[s], d2 = d[2 * s];
+    const float d3 = d[3 * s], d4 = d[4 * s], d5 = d[5 * s];
+    r[0] = 4 * d0 - 5 * d2 + d4;
+    r[t] = d3 + d4 - 4 * (d1 + d2);
+    r[2 * t] = 4 * (d1 - d2) + d4 - d3;
+    r[3 * t] = 2 * (d3 - d1) + d4 - d2;
+    r[4 * t] = 2 * (d1 - d3) + d4 - d2;
+    r[5 * t] = 4 * d1 - 5 * d3 + d5;
+  }
+  static inline void output(const float* m, int s, float* y, int t) {
+    const float a = m[s] + m[2 * s], b = m[s] - m[2 * s];
+    const float c = m[3 * s] + m[4 * s], d = m[3 * s] - m[4 * s];
+    y[0] = m[0] + a + c;
+    y[t] = b + 2 * d;
+    y[2 * t] = a + 4 * c;
+    y[3 * t] = b + 8 * d + m[5 * s];
+  }
+};
+
+template <typename F>
+inline void transform_input_tile(const float* d, float* v) {
+  float tmp[F::kAlpha * F::kAlpha];
+  for (int j = 0; j < F::kAlpha; ++j) {
+    F::input(d + j, F::kAlpha, tmp + j, F::kAlpha);
+  }
+  for (int i = 0; i < F::kAlpha; ++i) {
+    F::input(tmp + i * F::kAlpha, 1, v + i * F::kAlpha, 1);
+  }
+}
+
+template <typename F>
+inline void transform_output_tile(const float* m, float* y) {
+  float tmp[F::kTile * F::kAlpha];
+  for (int j = 0; j < F::kAlpha; ++j) {
+    F::output(m + j, F::kAlpha, tmp + j, F::kAlpha);
+  }
+  for (int i = 0; i < F::kTile; ++i) {
+    F::output(tmp + i * F::kAlpha, 1, y + i * F::kTile, 1);
+  }
+}
+
+template <typename F, typename Dtype>
+void winograd_conv(const Dtype* input, const int channels, const int height,
+    const int width, const int pad_h, const int pad_w, const float* filters,
+    const int num_output, const int output_h, const int output_w,
+    float* buffer, Dtype* output) {
+  const int alpha = F::kAlpha;
+  const int tile = F::kTile;
+  const int points = alpha * alpha;
+  const int tiles_w = (output_w + tile - 1) / tile;
+  const int num_tiles = ((output_h + tile - 1) / tile) * tiles_w;
+  // The transformed input and output of a block of tiles, point by point.
+  float* V = buffer;
+  float* M = buffer + points * channels * kTileBlock;
+  for (int t0 = 0; t0 < num_tiles; t0 += kTileBlock) {
+    const int nt = std::min(kTileBlock, num_tiles - t0);
+    for (int c = 0; c < channels; ++c) {
+      const Dtype* input_c = input + c * height * width;
+      for (int t = 0; t < nt; ++t) {
+        const int y0 = ((t0 + t) / tiles_w) * tile - pad_h;
+        const int x0 = ((t0 + t) % tiles_w) * tile - pad_w;
+        float d[points];
+        for (int i = 0; i < alpha; ++i) {
+          const int y = y0 + i;
+          for (int j = 0; j < alpha; ++j) {
+            const int x = x0 + j;
+            d[i * alpha + j] = (y >= 0 && y < height && x >= 0 && x < width) ?
+                caffe_to_float(input_c[y * width + x]) : 0.f;
+          }
+        }
+        float v[points];
+        transform_input_tile<F>(d, v);
+        for (int p = 0; p < points; ++p) {
+          V[(p * channels + c) * nt + t] = v[p];
+        }
+      }
+    }
+    for (int p = 0; p < points; ++p) {
+      caffe_cpu_gemm<float>(CblasNoTrans, CblasNoTrans, num_output, nt,
+          channels, 1.f, filters + p * num_output * channels,
+          V + p * channels * nt, 0.f, M + p * num_output * nt);
+    }
+    for (int k = 0; k < num_output; ++k) {
+      Dtype* output_k = output + k * output_h * output_w;
+      for (int t = 0; t < nt; ++t) {
+        float m[points];
+        for (int p = 0; p < points; ++p) {
+          m[p] = M[(p * num_output + k) * nt + t];
+        }
+        float y[tile * tile];
+        transform_output_tile<F>(m, y);
+        const int oy = ((t0 + t) / tiles_w) * tile;
+        const int ox = ((t0 + t) % tiles_w) * tile;
+        const int rows = std::min(tile, output_h - oy);
+        const int cols = std::min(tile, output_w - ox);
+        for (int i = 0; i < rows; ++i) {
+          for (int j = 0; j < cols; ++j) {
+            output_k[(oy + i) * output_w + ox + j] =
+                caffe_from_float<Dtype>(y[i * tile + j]);
+          }
+        }
+      }
+    }
+  }
+}
+
+}  // namespace
+
+void winograd_transform_filters(const int tile, const int num_output,
+    const int channels, const float* filters, float* transformed) {
+  CHECK(tile == 2 || tile == 4) << "Unsupported Winograd tile " << tile;
+  const int alpha = tile + 2;
+  const float* G = tile == 2 ? kG2 : kG4;
+  for (int k = 0; k < num_output; ++k) {
+    for (int c = 0; c < channels; ++c) {
+      const float* g = filters + (k * channels + c) * 9;
+      // U = G g G^T
+      float tmp[6 * 3];
+      for (int i = 0; i < alpha; ++i) {
+        for (int j = 0; j < 3; ++j) {
+          tmp[i * 3 + j] = G[i * 3] * g[j] + G[i * 3 + 1] * g[3 + j] +
+              G[i * 3 + 2] * g[6 + j];
+        }
+      }
+      for (int i = 0; i < alpha; ++i) {
+        for (int j = 0; j < alpha; ++j) {
+          transformed[((i * alpha + j) * num_output + k) * channels + c] =
+              tmp[i * 3] * G[j * 3] + tmp[i * 3 + 1] * G[j * 3 + 1] +
+              tmp[i * 3 + 2] * G[j * 3 + 2];
+        }
+      }
+    }
+  }
+}
+
+int winograd_filters_size(const int tile, const int num_output,
+    const int channels) {
+  return (tile + 2) * (tile + 2) * num_output * channels;
+}
+
+int winograd_buffer_size(const int tile, const int num_output,
+    const int channels) {
+  return (tile + 2) * (tile + 2) * kTileBlock * (channels + num_output);
+}
+
+template <typename Dtype>
+void winograd_conv_cpu(const Dtype* input, const int channels,
+    const int height, const int width, const int pad_h, const int pad_w,
+    const int tile, const float* transformed_filters, const int num_output,
+    const int output_h, const int output_w, float* buffer, Dtype* output) {
+  if (tile == 2) {
+    winograd_conv<F2>(input, channels, height, width, pad_h, pad_w,
+        transformed_filters, num_output, output_h, output_w, buffer, output);
+  } else {
+    CHECK_EQ(tile, 4) << "Unsupported Winograd tile";
+    winograd_conv<F4>(input, channels, height, width, pad_h, pad_w,
+        transformed_filters, num_output, output_h, output_w, buffer, output);
+  }
+}
+
+template void winograd_conv_cpu<float>(const float* input,
+    const int channels, const int height, const int width, const int pad_h,
+    const int pad_w, const int tile, const float* transformed_filters,
+    const int num_output, const int output_h, const int output_w,
+    float* buffer, float* output);
+template void winograd_conv_cpu<half>(const half* input,
+    const int channels, const int height, const int width, const int pad_h,
+    const int pad_w, const int tile, const float* transformed_filters,
+    const int num_output, const int output_h, const int output_w,
+    float* buffer, half* output);
+
+}  // namespace caffe
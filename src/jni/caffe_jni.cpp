@@ -18,6 +18,12 @@ Java_com_example_gsq_caffe_1android_1project_CaffeMobile_setBlasThreadNum(JNIEnv
   openblas_set_num_threads(numThreads);
 }
 
+JNIEXPORT void JNICALL
+Java_com_example_gsq_caffe_1android_1project_CaffeMobile_setThreadNum(JNIEnv *env, jobject instance,
+                                                        jint numThreads) {
+  caffe::ThreadPool::Get().set_num_threads(numThreads);
+}
+
 JNIEXPORT jboolean JNICALL
 Java_com_example_gsq_caffe_1android_1project_CaffeMobile_loadModelh(JNIEnv *env, jobject instance,
                                                      jstring modelPath_, jstring weightPath_, int engine) {
@@ -46,7 +46,9 @@ CaffeMobilef::CaffeMobilef(const string &param_file, const string &trained_file,
   }
 
 
-  net_->CopyTrainedLayersFrom(trained_file);
+  if (!net_->CopyTrainedLayersFrom(trained_file)) {
+    throw std::invalid_argument("Invalid arg: trained_file=" + trained_file);
+  }
   timer.Stop();
   LOG(INFO) << "Load (" << param_file << "," << trained_file << "), time:"
             << timer.MilliSeconds() << " ms.";
@@ -206,7 +208,9 @@ CaffeMobileh::CaffeMobileh(const string &param_file, const string &trained_file,
   }
 
 
-  net_->CopyTrainedLayersFrom(trained_file);
+  if (!net_->CopyTrainedLayersFrom(trained_file)) {
+    throw std::invalid_argument("Invalid arg: trained_file=" + trained_file);
+  }
   timer.Stop();
   LOG(INFO) << "Load (" << param_file << "," << trained_file << "), time:"
             << timer.MilliSeconds() << " ms.";
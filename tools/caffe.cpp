@@ -3,7 +3,10 @@
 namespace bp = boost::python;
 #endif
 
+#include <algorithm>
 #include <cstring>
+#include <fstream>  // NOLINT(readability/streams)
+#include <iomanip>
 #include <map>
 #include <string>
 #include <vector>
@@ -12,6 +15,8 @@ namespace bp = boost::python;
 #include "boost/algorithm/string.hpp"
 #endif
 #include "caffe/caffe.hpp"
+#include "caffe/util/cpu_features.hpp"
+#include "caffe/util/math_kernels.hpp"
 #ifdef NO_CAFFE_MOBILE
 #include "caffe/util/signal_handler.h"
 #else
@@ -54,6 +59,18 @@ DEFINE_string(weights, "",
     "separated by ','. Cannot be set simultaneously with snapshot.");
 DEFINE_int32(iterations, 50,
     "The number of iterations to run.");
+DEFINE_int32(warmup, 5,
+    "Optional; the number of untimed iterations to run first. "
+    "Only used for 'time'.");
+DEFINE_int32(batch_size, 0,
+    "Optional; the batch size of the input blobs, or 0 to keep the one "
+    "of the model. Only used for 'time'.");
+DEFINE_string(json, "",
+    "Optional; a file to write the timings to as JSON. "
+    "Only used for 'time'.");
+DEFINE_int32(threads, 1,
+    "Optional; the number of threads the CPU layers split their loops over, "
+    "or 0 for one per hardware thread. Independent of the BLAS threads.");
 DEFINE_string(sigint_effect, "stop",
              "Optional; action to take when a SIGINT signal is received: "
               "snapshot, stop or none.");
@@ -362,11 +379,66 @@ int test() {
 RegisterBrewFunction(test);
 
 
-// Time: benchmark the execution time of a model.
+// Latency statistics of a series of timings, in milliseconds.
+struct LatencyStats {
+  double mean, p50, p90, p99, max;
+};
+
+// The percentiles are nearest-rank over the sorted samples.
+static LatencyStats ComputeLatencyStats(vector<double> samples) {
+  LatencyStats stats = {0, 0, 0, 0, 0};
+  if (samples.empty()) {
+    return stats;
+  }
+  std::sort(samples.begin(), samples.end());
+  const int n = samples.size();
+  for (int i = 0; i < n; ++i) {
+    stats.mean += samples[i] / n;
+  }
+  stats.p50 = samples[std::max(0, (50 * n + 99) / 100 - 1)];
+  stats.p90 = samples[std::max(0, (90 * n + 99) / 100 - 1)];
+  stats.p99 = samples[std::max(0, (99 * n + 99) / 100 - 1)];
+  stats.max = samples[n - 1];
+  return stats;
+}
+
+static string JsonString(const string& s) {
+  ostringstream out;
+  out << '"';
+  for (int i = 0; i < s.size(); ++i) {
+    const unsigned char c = s[i];
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (c < 0x20) {
+      out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+          << static_cast<int>(c) << std::dec;
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+  return out.str();
+}
+
+static void WriteLatencyJson(std::ostream& out, const LatencyStats& stats) {
+  out << "\"mean_ms\": " << stats.mean << ", \"p50_ms\": " << stats.p50
+      << ", \"p90_ms\": " << stats.p90 << ", \"p99_ms\": " << stats.p99
+      << ", \"max_ms\": " << stats.max;
+}
+
+static void LogLatency(const string& name, const LatencyStats& stats) {
+  LOG(INFO) << std::setfill(' ') << std::setw(10) << name
+      << "\tmean: " << stats.mean << " ms, p50: " << stats.p50
+      << " ms, p90: " << stats.p90 << " ms, p99: " << stats.p99
+      << " ms, max: " << stats.max << " ms.";
+}
+
+// Time: benchmark the forward pass of a model.
 int time() {
-#ifdef NO_BACKWORD
   CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition to time.";
-  caffe::Phase phase = get_phase_from_flags(caffe::TRAIN);
+  CHECK_GE(FLAGS_warmup, 0);
+  CHECK_GT(FLAGS_iterations, 0);
+  caffe::Phase phase = get_phase_from_flags(caffe::TEST);
   vector<string> stages = get_stages_from_flags();
 
   // Set device id and mode
@@ -380,77 +452,112 @@ int time() {
     LOG(INFO) << "Use CPU.";
     Caffe::set_mode(Caffe::CPU);
   }
+  LOG(INFO) << "CPU features: " << caffe::cpu_features_string()
+      << "; math kernels: " << caffe::math_kernels().name;
   // Instantiate the caffe net.
   Net<float> caffe_net(FLAGS_model, phase, FLAGS_level, &stages);
-
-  // Do a clean forward and backward pass, so that memory allocation are done
-  // and future iterations will be more stable.
-  LOG(INFO) << "Performing Forward";
+  if (FLAGS_weights.size()) {
+    caffe_net.CopyTrainedLayersFrom(FLAGS_weights);
+  }
   // Note that for the speed benchmark, we will assume that the network does
-  // not take any input blobs.
-  float initial_loss;
-  caffe_net.Forward(&initial_loss);
-  LOG(INFO) << "Initial loss: " << initial_loss;
-  LOG(INFO) << "Performing Backward";
-  caffe_net.Backward();
+  // not take any input blobs but the batch of the Input layers.
+  if (FLAGS_batch_size > 0) {
+    for (int i = 0; i < caffe_net.input_blobs().size(); ++i) {
+      Blob<float>* input = caffe_net.input_blobs()[i];
+      vector<int> shape = input->shape();
+      CHECK_GT(shape.size(), 0) << "Input blobs need a batch axis.";
+      shape[0] = FLAGS_batch_size;
+      input->Reshape(shape);
+    }
+    caffe_net.Reshape();
+  }
+  const int batch_size = caffe_net.input_blobs().size() ?
+      caffe_net.input_blobs()[0]->shape(0) : 1;
+
+  // Warm up, so that memory allocations and kernel compilation are done
+  // and the timed iterations are more stable.
+  LOG(INFO) << "Performing " << FLAGS_warmup << " warmup iterations";
+  for (int j = 0; j < FLAGS_warmup; ++j) {
+    caffe_net.Forward();
+  }
 
   const vector<shared_ptr<Layer<float> > >& layers = caffe_net.layers();
-  const vector<vector<Blob<float>*> >& bottom_vecs = caffe_net.bottom_vecs();
-  const vector<vector<Blob<float>*> >& top_vecs = caffe_net.top_vecs();
-  const vector<vector<bool> >& bottom_need_backward =
-      caffe_net.bottom_need_backward();
+  const vector<bool>& fused = caffe_net.layer_fused();
   LOG(INFO) << "*** Benchmark begins ***";
   LOG(INFO) << "Testing for " << FLAGS_iterations << " iterations.";
   Timer total_timer;
   total_timer.Start();
   Timer forward_timer;
-  Timer backward_timer;
   Timer timer;
-  std::vector<double> forward_time_per_layer(layers.size(), 0.0);
-  std::vector<double> backward_time_per_layer(layers.size(), 0.0);
-  double forward_time = 0.0;
-  double backward_time = 0.0;
+  vector<vector<double> > forward_time_per_layer(layers.size());
+  vector<double> forward_time;
   for (int j = 0; j < FLAGS_iterations; ++j) {
-    Timer iter_timer;
-    iter_timer.Start();
     forward_timer.Start();
     for (int i = 0; i < layers.size(); ++i) {
+      // A fused activation is computed, and timed, by the layer it was
+      // fused into, as in Net::Forward.
+      if (fused[i]) {
+        forward_time_per_layer[i].push_back(0);
+        continue;
+      }
       timer.Start();
-      layers[i]->Forward(bottom_vecs[i], top_vecs[i]);
-      forward_time_per_layer[i] += timer.MicroSeconds();
-    }
-    forward_time += forward_timer.MicroSeconds();
-    backward_timer.Start();
-    for (int i = layers.size() - 1; i >= 0; --i) {
-      timer.Start();
-      layers[i]->Backward(top_vecs[i], bottom_need_backward[i],
-                          bottom_vecs[i]);
-      backward_time_per_layer[i] += timer.MicroSeconds();
+      caffe_net.ForwardFromTo(i, i);
+      forward_time_per_layer[i].push_back(timer.MicroSeconds() / 1000);
     }
-    backward_time += backward_timer.MicroSeconds();
-    LOG(INFO) << "Iteration: " << j + 1 << " forward-backward time: "
-      << iter_timer.MilliSeconds() << " ms.";
+    forward_time.push_back(forward_timer.MicroSeconds() / 1000);
+    DLOG(INFO) << "Iteration: " << j + 1 << " forward time: "
+      << forward_time.back() << " ms.";
   }
-  LOG(INFO) << "Average time per layer: ";
+  total_timer.Stop();
+  vector<LatencyStats> layer_stats(layers.size());
+  LOG(INFO) << "Forward time per layer: ";
   for (int i = 0; i < layers.size(); ++i) {
-    const caffe::string& layername = layers[i]->layer_param().name();
-    LOG(INFO) << std::setfill(' ') << std::setw(10) << layername <<
-      "\tforward: " << forward_time_per_layer[i] / 1000 /
-      FLAGS_iterations << " ms.";
-    LOG(INFO) << std::setfill(' ') << std::setw(10) << layername  <<
-      "\tbackward: " << backward_time_per_layer[i] / 1000 /
-      FLAGS_iterations << " ms.";
+    layer_stats[i] = ComputeLatencyStats(forward_time_per_layer[i]);
+    if (fused[i]) {
+      LOG(INFO) << std::setfill(' ') << std::setw(10)
+          << layers[i]->layer_param().name() << "\tfused";
+    } else {
+      LogLatency(layers[i]->layer_param().name(), layer_stats[i]);
+    }
   }
-  total_timer.Stop();
-  LOG(INFO) << "Average Forward pass: " << forward_time / 1000 /
-    FLAGS_iterations << " ms.";
-  LOG(INFO) << "Average Backward pass: " << backward_time / 1000 /
-    FLAGS_iterations << " ms.";
-  LOG(INFO) << "Average Forward-Backward: " << total_timer.MilliSeconds() /
-    FLAGS_iterations << " ms.";
+  const LatencyStats net_stats = ComputeLatencyStats(forward_time);
+  LOG(INFO) << "Forward pass: ";
+  LogLatency("net", net_stats);
+  const double throughput = net_stats.mean > 0 ?
+      batch_size * 1000. / net_stats.mean : 0;
+  LOG(INFO) << "Throughput: " << throughput << " images/s at batch size "
+      << batch_size << ".";
   LOG(INFO) << "Total Time: " << total_timer.MilliSeconds() << " ms.";
   LOG(INFO) << "*** Benchmark ends ***";
-#endif
+
+  if (FLAGS_json.size()) {
+    std::ofstream out(FLAGS_json.c_str());
+    CHECK(out) << "Cannot write " << FLAGS_json;
+    out << "{\n"
+        << "  \"model\": " << JsonString(FLAGS_model) << ",\n"
+        << "  \"mode\": \""
+        << (Caffe::mode() == Caffe::GPU ? "GPU" : "CPU") << "\",\n"
+        << "  \"cpu_features\": "
+        << JsonString(caffe::cpu_features_string()) << ",\n"
+        << "  \"batch_size\": " << batch_size << ",\n"
+        << "  \"warmup\": " << FLAGS_warmup << ",\n"
+        << "  \"iterations\": " << FLAGS_iterations << ",\n"
+        << "  \"throughput\": " << throughput << ",\n"
+        << "  \"forward\": {";
+    WriteLatencyJson(out, net_stats);
+    out << "},\n"
+        << "  \"layers\": [";
+    for (int i = 0; i < layers.size(); ++i) {
+      out << (i ? ",\n" : "\n") << "    {\"name\": "
+          << JsonString(layers[i]->layer_param().name())
+          << ", \"type\": " << JsonString(layers[i]->type())
+          << ", \"fused\": " << (fused[i] ? "true" : "false") << ", ";
+      WriteLatencyJson(out, layer_stats[i]);
+      out << "}";
+    }
+    out << "\n  ]\n}\n";
+    LOG(INFO) << "Wrote the timings to " << FLAGS_json;
+  }
   return 0;
 }
 RegisterBrewFunction(time);
@@ -471,13 +578,14 @@ int main(int argc, char** argv) {
 #ifdef NO_CAFFE_MOBILE
       "  device_query    show GPU diagnostic information\n"
 #endif
-      "  time            benchmark model execution time");
+      "  time            benchmark the forward pass of a model");
 
   // Run tool or show usage.
   caffe::GlobalInit(&argc, &argv);
 #ifndef NO_CAFFE_MOBILE
   ::gflags::ParseCommandLineFlags(&argc, &argv, true);
 #endif
+  caffe::ThreadPool::Get().set_num_threads(FLAGS_threads);
   if (argc == 2) {
 #ifdef WITH_PYTHON_LAYER
     try {
@@ -0,0 +1,97 @@
+// Calibrates the int8 inference of the Convolution and InnerProduct layers
+// of a net: runs it on sample inputs, records the largest magnitude each of
+// them sees on its input and writes a caffemodel with a quantization_param
+// per layer and their weights stored as int8, see caffe/util/int8_gemm.hpp.
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "caffe/caffe.hpp"
+
+namespace {
+
+// The inputs of a layer are only valid right before it runs, as later
+// layers may reuse their memory.
+class RangeRecorder : public caffe::Net<float>::Callback {
+ public:
+  explicit RangeRecorder(const caffe::Net<float>& net)
+      : net_(net), ranges_(net.layers().size(), 0.f) {}
+
+  bool calibrated(int layer) const {
+    const std::string type = net_.layers()[layer]->type();
+    return type == "Convolution" || type == "InnerProduct";
+  }
+  float range(int layer) const { return ranges_[layer]; }
+
+ protected:
+  virtual void run(int layer) {
+    if (!calibrated(layer)) {
+      return;
+    }
+    const caffe::Blob<float>* bottom = net_.bottom_vecs()[layer][0];
+    const float* data = bottom->cpu_data();
+    for (int i = 0; i < bottom->count(); ++i) {
+      ranges_[layer] = std::max(ranges_[layer], std::fabs(data[i]));
+    }
+  }
+
+ private:
+  const caffe::Net<float>& net_;
+  std::vector<float> ranges_;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 4) {
+    LOG(INFO) << "./calibrate_int8.bin prototxt_file "
+        << "model.caffemodel(input) model.caffemodel(output) "
+        << "[input.binaryproto ...]";
+    LOG(INFO) << "Without input blobs, the net runs 10 batches of its own "
+        << "data layers.";
+    return 1;
+  }
+  caffe::NetParameter param;
+#ifdef USE_PROTOBUF_FULL
+  caffe::ReadNetParamsFromTextFileOrDie(argv[1], &param);
+#else
+  caffe::ReadNetParamsFromBinaryFileOrDie(argv[1], &param);
+#endif
+  // Calibrate the layers as stored; the net loading them folds if it wants.
+  param.set_fold_batch_norm(false);
+  param.mutable_state()->set_phase(caffe::TEST);
+  caffe::Net<float> net(param);
+  net.CopyTrainedLayersFrom(argv[2]);
+  RangeRecorder recorder(net);
+  net.add_before_forward(&recorder);
+  if (argc > 4) {
+    CHECK_GE(net.num_inputs(), 1) << "The net has no input to feed";
+    for (int i = 4; i < argc; ++i) {
+      caffe::BlobProto sample;
+      caffe::ReadProtoFromBinaryFileOrDie(argv[i], &sample);
+      net.input_blobs()[0]->FromProto(sample);
+      net.Reshape();
+      net.Forward();
+    }
+  } else {
+    for (int i = 0; i < 10; ++i) {
+      net.Forward();
+    }
+  }
+  for (int i = 0; i < net.layers().size(); ++i) {
+    if (recorder.calibrated(i)) {
+      caffe::QuantizationParameter quantization;
+      quantization.set_input_range(recorder.range(i));
+      net.layers()[i]->set_quantization_param(quantization);
+      LOG(INFO) << net.layer_names()[i] << ": input range "
+          << recorder.range(i);
+    }
+  }
+  caffe::NetParameter net_param;
+  net.ToInt8Proto(&net_param);
+  caffe::WriteProtoToBinaryFile(net_param, argv[3]);
+  return 0;
+}
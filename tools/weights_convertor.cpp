@@ -0,0 +1,28 @@
+// Converts a caffemodel to the flat weight file that Net maps into memory,
+// see caffe/util/weight_file.hpp.
+
+#include <cstring>
+#include <string>
+
+#include "caffe/caffe.hpp"
+
+int main(int argc, char** argv) {
+  if (argc != 4 && !(argc == 5 && std::strcmp(argv[4], "half") == 0)) {
+    LOG(INFO) << "./weights_convertor.bin prototxt_file "
+        << "model.caffemodel(input) model.caffeweights(output) [half]";
+    return 1;
+  }
+  caffe::NetParameter param;
+#ifdef USE_PROTOBUF_FULL
+  caffe::ReadNetParamsFromTextFileOrDie(argv[1], &param);
+#else
+  caffe::ReadNetParamsFromBinaryFileOrDie(argv[1], &param);
+#endif
+  // Store the weights as trained; the net loading them folds if it wants.
+  param.set_fold_batch_norm(false);
+  param.mutable_state()->set_phase(caffe::TEST);
+  caffe::Net<float> net(param);
+  net.CopyTrainedLayersFrom(argv[2]);
+  net.ToWeightFile(argv[3], argc == 5);
+  return 0;
+}